@@ -22,13 +22,44 @@
 #include <unistd.h>
 #endif
 
+#include "output.h"
+#define GBX_LEGACY_GLOBALS // Uses currAddr, romSize and the rest
 #include "setup.h" // See defines, variables, constants, functions here
+#include "store.h"
+
+struct store_snapshot snapshot;
+struct output_file romOutput;
+uint8_t useStore = 0;
+
+// Write each block read to the ROM file or the backup store
+uint8_t write_rom_block(void *context, uint32_t romOffset, const uint8_t *data,
+                        uint16_t length) {
+  if (useStore == 1) {
+    store_write(&snapshot, data, length);
+  } else {
+    output_write(&romOutput, data, length);
+  }
+  return 1;
+}
 
 int main(int argc, char **argv) {
 
   printf("GBxCart RW v1.24 by insideGadgets\n");
   printf("################################\n");
 
+  // "store" backs up into gbx-store/ instead of a .gb/.gba file,
+  // "extract <manifest> [file]" gets a stored backup back out
+  if (argc >= 2 && strncmp(argv[1], "extract", 7) == 0) {
+    if (argc < 3) {
+      printf("Usage: backup-rom extract <manifest> [ROMFile]\n");
+      return 1;
+    }
+    return store_extract(argv[2], (argc >= 4) ? argv[3] : NULL);
+  }
+  if (argc >= 2 && strncmp(argv[1], "store", 5) == 0) {
+    useStore = 1;
+  }
+
   read_config();
 
   // Open COM port
@@ -39,25 +70,16 @@ int main(int argc, char **argv) {
   }
   printf("Connected on COM port: %i\n", cport_nr + 1);
 
-  // Break out of any existing functions on ATmega
-  set_mode('0');
-
-  // Get firmware version
-  gbxcartFirmwareVersion = request_value(READ_FIRMWARE_VERSION);
-
-  // Get PCB version
-  gbxcartPcbVersion = request_value(READ_PCB_VERSION);
-
-  // Prompt for GB or GBA mode
-  if (gbxcartPcbVersion == PCB_1_3) {
-    set_mode(VOLTAGE_5V);
+  // Get firmware/PCB version and cartridge mode, set the voltage and read the
+  // header in one go
+  struct cart_identity cart;
+  if (cart_identify(&cart, 0) == 0) {
+    printf("Device didn't respond, please re-seat the cartridge and try "
+           "again\n");
+    read_one_letter();
+    return 1;
   }
 
-  read_gb_header();
-
-  // Get cartridge mode - Gameboy or Gameboy Advance
-  cartridgeMode = request_value(CART_MODE);
-
   // Dump ROM
   // else if (optionSelected == '1') {
   printf("\n--- Read ROM ---\n");
@@ -77,166 +99,40 @@ int main(int argc, char **argv) {
   } else {
     strncat(titleFilename, ".gba", 4);
   }
-  printf("Reading ROM to %s\n", titleFilename);
-  printf("[             25%%             50%%             75%%            "
-         "100%%]\n[");
-
-  // Create a new file
-  FILE *romFile = fopen(titleFilename, "wb");
-
-  uint32_t readBytes = 0;
-  cartridgeMode == GB_MODE;
-  if (cartridgeMode == GB_MODE) {
-    // Set start and end address
-    currAddr = 0x0000;
-    endAddr = 0x7FFF;
-
-    // Read ROM
-    for (uint16_t bank = 1; bank < romBanks; bank++) {
-      if (cartridgeType >= 5) { // MBC2 and above
-        set_bank(0x2100, bank & 0xFF);
-        if (bank >= 256) {
-          set_bank(0x3000, 1); // High bit
-        }
-      } else { // MBC1
-        if ((strncmp(gameTitle, "MOMOCOL", 7) == 0) ||
-            (strncmp(gameTitle, "BOMCOL", 6) == 0)) { // MBC1 Hudson
-          set_bank(0x4000, bank >> 4);
-          if (bank < 10) {
-            set_bank(0x2000, bank & 0x1F);
-          } else {
-            set_bank(0x2000, 0x10 | (bank & 0x1F));
-          }
-        } else {                       // Regular MBC1
-          set_bank(0x6000, 0);         // Set ROM Mode
-          set_bank(0x4000, bank >> 5); // Set bits 5 & 6 (01100000) of ROM bank
-          set_bank(0x2000,
-                   bank & 0x1F); // Set bits 0 & 4 (00011111) of ROM bank
-        }
-      }
-
-      if (bank > 1) {
-        currAddr = 0x4000;
-      }
-
-      // Set start address and rom reading mode
-      set_number(currAddr, SET_START_ADDRESS);
-      set_mode(READ_ROM_RAM);
-
-      // Read data
-      while (currAddr < endAddr) {
-        uint8_t comReadBytes = com_read_bytes(romFile, 64);
-        if (comReadBytes == 64) {
-          currAddr += 64;
-          readBytes += 64;
-
-          // Request 64 bytes more
-          if (currAddr < endAddr) {
-            com_read_cont();
-          }
-        } else { // Didn't receive 64 bytes, usually this only happens for Apple
-                 // MACs
-          fflush(romFile);
-          com_read_stop();
-          delay_ms(500);
-          printf("Retrying\n");
-
-          // Flush buffer
-          RS232_PollComport(cport_nr, readBuffer, 64);
-
-          // Start off where we left off
-          fseek(romFile, readBytes, SEEK_SET);
-          set_number(currAddr, SET_START_ADDRESS);
-          set_mode(READ_ROM_RAM);
-        }
-
-        // Print progress
-        print_progress_percent(readBytes, (romBanks * 16384) / 64);
-      }
-      com_read_stop(); // Stop reading ROM (as we will bank switch)
+  uint32_t romLength = (cartridgeMode == GB_MODE) ? (uint32_t)romBanks * 0x4000
+                                                  : romEndAddr;
+  if (useStore == 1) {
+    if (store_begin(&snapshot, gameTitle, timebuffer,
+                    (cartridgeMode == GB_MODE) ? "gb" : "gba",
+                    STORE_ROM_CHUNK_SIZE) != 0) {
+      read_one_letter();
+      return 1;
     }
-    printf("]");
-  } else { // GBA mode
-    // Set start and end address
-    currAddr = 0x00000;
-    endAddr = romEndAddr;
-    set_number(currAddr, SET_START_ADDRESS);
-
-    uint16_t readLength = 64;
-#if defined(__APPLE__)
-    set_mode(GBA_READ_ROM);
-#else
-    if (gbxcartPcbVersion != PCB_1_0) {
-      set_mode(GBA_READ_ROM_256BYTE);
-      readLength = 256;
-    } else {
-      set_mode(GBA_READ_ROM);
+    printf("Reading ROM to %s\n", STORE_DIR);
+  } else {
+    printf("Reading ROM to %s\n", titleFilename);
+
+    // Written to a temporary file that's renamed once the dump is complete
+    if (output_open(&romOutput, titleFilename, romLength) != 0) {
+      read_one_letter();
+      return 1;
     }
-#endif
+  }
+  printf("[             25%%             50%%             75%%            "
+         "100%%]\n[");
 
-    // Read data
-    while (currAddr < endAddr) {
-#if defined(__APPLE__) // Apple only seems to like reading 64 bytes and has
-                       // occasional time outs
-      uint8_t comReadBytes = com_read_bytes(romFile, readLength);
-      if (comReadBytes == readLength) {
-        currAddr += readLength;
-
-        // Request 64 bytes more
-        if (currAddr < endAddr) {
-          com_read_cont();
-        }
-      } else { // Didn't receive 64 bytes, usually this only happens for Apple
-               // MACs
-        fflush(romFile);
-        com_read_stop();
-        delay_ms(500);
-
-        // Flush buffer
-        RS232_PollComport(cport_nr, readBuffer, readLength);
-
-        // Start off where we left off
-        fseek(romFile, currAddr, SEEK_SET);
-        set_number(currAddr / 2, SET_START_ADDRESS);
-        set_mode(GBA_READ_ROM);
-      }
-#else // For Windows / Linux
-      int comReadBytes = com_read_bytes(romFile, readLength);
-      if (comReadBytes == readLength) {
-        currAddr += readLength;
-
-        // Request 64 bytes more
-        if (currAddr < endAddr) {
-          com_read_cont();
-        }
-      } else { // Didn't receive 256 bytes
-        fflush(romFile);
-        com_read_stop();
-        delay_ms(500);
-        printf("Retrying\n");
-
-        // Flush buffer
-        RS232_PollComport(cport_nr, readBuffer, readLength);
-
-        // Start off where we left off
-        fseek(romFile, currAddr, SEEK_SET);
-        set_number(currAddr / 2, SET_START_ADDRESS);
-        if (gbxcartPcbVersion != PCB_1_0) {
-          set_mode(GBA_READ_ROM_256BYTE);
-        } else {
-          set_mode(GBA_READ_ROM);
-        }
-      }
-#endif
+  read_rom(0, romLength, write_rom_block, NULL);
+  printf("]");
 
-      // Print progress
-      print_progress_percent(currAddr, endAddr / 64);
+  print_retry_stats();
+  if (useStore == 1) {
+    printf("\n");
+    if (store_finish(&snapshot) != 0) {
+      return 1;
     }
-    printf("]");
-    com_read_stop();
+  } else if (output_finish(&romOutput) != 0) {
+    return 1;
   }
-
-  fclose(romFile);
   printf("\nFinished\n");
   //}
   return 0;
@@ -16,13 +16,269 @@
 #include <string.h>
 #include <time.h>
 
+#include <sys/stat.h>
+
 #ifdef _WIN32
 #include <windows.h>
 #else
 #include <unistd.h>
 #endif
 
+#include "lsdj.h"
+#include "output.h"
+#define GBX_LEGACY_GLOBALS // Uses currAddr, romSize and the rest
 #include "setup.h" // See defines, variables, constants, functions here
+#include "store.h"
+
+struct store_snapshot snapshot;
+struct output_file saveOutput;
+uint8_t useStore = 0;
+
+// Create the save file (written to a temporary file and renamed once it's
+// complete), or start a backup in the store when using it
+void open_save_output(char *titleFilename, uint32_t saveLength) {
+  if (useStore == 0) {
+    if (output_open(&saveOutput, titleFilename, saveLength) != 0) {
+      read_one_letter();
+      exit(1);
+    }
+    return;
+  }
+
+  time_t rawtime;
+  char timebuffer[25];
+  time(&rawtime);
+  strftime(timebuffer, sizeof(timebuffer), "%Y%m%d%H%M%S", localtime(&rawtime));
+  if (store_begin(&snapshot, gameTitle, timebuffer, "sav",
+                  STORE_RAM_CHUNK_SIZE) != 0) {
+    read_one_letter();
+    exit(1);
+  }
+}
+
+void write_save_block(const uint8_t *data, uint32_t length) {
+  if (useStore == 1) {
+    store_write(&snapshot, data, length);
+  } else {
+    output_write(&saveOutput, data, length);
+  }
+}
+
+#define PROBE_MAX_WINDOWS 40
+#define PROBE_DEFAULT_MAX_AGE_HOURS 24
+
+// Compare the save with the last backup, the last snapshot in lsdj-archive/ if
+// archive is 1 or the last backup in the store if not. A few RAM windows are
+// read first: the LSDj header and file allocation table plus some of the
+// working song, or windows spread across the RAM for anything else. If any of
+// them differ the save has changed. If they all match, that alone doesn't show
+// the save is the same, so the whole RAM is read into ramData and compared.
+// *ramRead is set to 1 once ramData holds the whole RAM, so the backup doesn't
+// read it again. Returns 1 if the save matches and the last backup is newer
+// than maxAgeHours.
+uint8_t save_unchanged(uint32_t ramLength, long maxAgeHours, uint8_t archive,
+                       uint8_t *ramData, uint8_t *ramRead) {
+  *ramRead = 0;
+  char lastPath[256];
+  if (archive == 1) {
+    if (lsdj_archive_last(gameTitle, lastPath) == 0) {
+      return 0;
+    }
+  } else if (store_last_manifest(gameTitle, "sav", lastPath) == 0) {
+    return 0;
+  }
+  struct stat lastStat;
+  if (stat(lastPath, &lastStat) != 0 ||
+      difftime(time(NULL), lastStat.st_mtime) >= maxAgeHours * 3600.0) {
+    return 0;
+  }
+
+  uint32_t windows[PROBE_MAX_WINDOWS];
+  uint8_t windowCount = 0;
+  if (strncmp(gameTitle, "LSDj", 4) == 0 && ramLength == LSDJ_SRAM_SIZE) {
+    for (uint32_t offset = 0; offset < LSDJ_WORKING_SONG_SIZE;
+         offset += 0x800) {
+      windows[windowCount++] = offset;
+    }
+    for (uint32_t offset = 0; offset < LSDJ_HEADER_SIZE; offset += 64) {
+      windows[windowCount++] = LSDJ_HEADER_ADDRESS + offset;
+    }
+  } else {
+    uint32_t stride = ((ramLength / 32) / 64) * 64;
+    if (stride < 64) {
+      stride = 64;
+    }
+    for (uint32_t offset = 0; offset + 64 <= ramLength && windowCount < 32;
+         offset += stride) {
+      windows[windowCount++] = offset;
+    }
+  }
+
+  // The stored backup has to be the same size for any of this to count
+  uint8_t *storedData = (uint8_t *)malloc(ramLength);
+  if (storedData == NULL) {
+    return 0;
+  }
+  int loaded = 1;
+  if (archive == 1) {
+    if (ramLength == LSDJ_SRAM_SIZE) {
+      loaded = lsdj_archive_rebuild(lastPath, storedData);
+    }
+  } else {
+    struct store_reader stored;
+    if (store_reader_open(&stored, lastPath) == 0) {
+      if (stored.length == ramLength) {
+        loaded = store_read_range(&stored, 0, storedData, ramLength);
+      }
+      store_reader_close(&stored);
+    }
+  }
+  if (loaded != 0) {
+    free(storedData);
+    return 0;
+  }
+
+  gb_ram_enable();
+  uint8_t unchanged = 1;
+  for (uint8_t x = 0; x < windowCount && unchanged == 1; x++) {
+    gb_read_ram_sample(windows[x]);
+    if (memcmp(readBuffer, &storedData[windows[x]], 64) != 0) {
+      unchanged = 0;
+    }
+  }
+  set_bank(0x0000, 0x00); // Disable RAM
+
+  if (unchanged == 1) {
+    printf("Save looks the same as %s, comparing all of it\n", lastPath);
+    printf("[             25%%             50%%             75%%            "
+           "100%%]\n[");
+    gb_read_ram(ramData);
+    printf("]\n");
+    *ramRead = 1;
+    if (memcmp(ramData, storedData, ramLength) != 0) {
+      unchanged = 0;
+    }
+  }
+  free(storedData);
+
+  if (unchanged == 1) {
+    printf("Save matches %s, skipping the backup\n", lastPath);
+  }
+  return unchanged;
+}
+
+#define WATCH_POLL_MS 1000
+#define WATCH_SETTLE_MS 500
+
+// Poll the open port for the cart to come out (if asked) and for the next one
+// to go in, a cart counts as in once it has read back for WATCH_SETTLE_MS
+void wait_for_cart(uint8_t waitForRemoval) {
+  if (waitForRemoval == 1) {
+    printf("\nWaiting for the cartridge to be removed...\n");
+    while (cart_present() == 1) {
+      delay_ms(WATCH_POLL_MS);
+    }
+  }
+  printf("\nWaiting for a cartridge...\n");
+  while (1) {
+    while (cart_present() == 0) {
+      delay_ms(WATCH_POLL_MS);
+    }
+    delay_ms(WATCH_SETTLE_MS); // Let the contacts settle
+    if (cart_present() == 1) {
+      break;
+    }
+  }
+}
+
+// Give up on the backup being written, closing it then fails
+void fail_save_output(void) {
+  if (useStore == 1) {
+    snapshot.failed = 1;
+  } else {
+    saveOutput.failed = 1;
+  }
+}
+
+// Returns 0 if the backup went into place
+int close_save_output(void) {
+  if (useStore == 1) {
+    printf("\n");
+    return store_finish(&snapshot);
+  }
+  return output_finish(&saveOutput);
+}
+
+// Rebuild a full .sav from an LSDj archive snapshot, no device needed
+int rebuild_sav(char *snapshotPath, char *savPath) {
+  char defaultPath[256];
+  if (savPath == NULL) {
+    char *baseName = strrchr(snapshotPath, '/');
+    baseName = (baseName != NULL) ? baseName + 1 : snapshotPath;
+    strncpy(defaultPath, baseName, 240);
+    defaultPath[240] = '\0';
+    char *extension = strrchr(defaultPath, '.');
+    if (extension != NULL) {
+      *extension = '\0';
+    }
+    strncat(defaultPath, ".sav", 5);
+    savPath = defaultPath;
+  }
+
+  uint8_t *sram = (uint8_t *)malloc(LSDJ_SRAM_SIZE);
+  if (sram == NULL || lsdj_archive_rebuild(snapshotPath, sram) != 0) {
+    free(sram);
+    return 1;
+  }
+
+  struct output_file savOutput;
+  int result = output_open(&savOutput, savPath, LSDJ_SRAM_SIZE);
+  if (result == 0) {
+    output_write(&savOutput, sram, LSDJ_SRAM_SIZE);
+    result = output_finish(&savOutput);
+  }
+  free(sram);
+  if (result != 0) {
+    return 1;
+  }
+
+  printf("Rebuilt %s from %s\n", savPath, snapshotPath);
+  return 0;
+}
+
+// Store only the songs that changed in lsdj-archive/ from the LSDj SRAM in
+// ramData, read first unless ramRead is 1. Saves that LSDj hasn't set up yet go
+// to the .sav file as usual. Returns 0 if the backup went into place.
+int backup_lsdj_incremental(char *titleFilename, char *timestamp,
+                            uint8_t *ramData, uint8_t ramRead) {
+  printf("Backing up save to %s/\n", LSDJ_ARCHIVE_DIR);
+  if (ramRead == 0) {
+    printf("[             25%%             50%%             75%%            "
+           "100%%]\n[");
+    gb_read_ram(ramData);
+    printf("]");
+  }
+  print_retry_stats();
+  printf("\n");
+
+  int result = 0;
+  if (lsdj_sram_valid(ramData)) {
+    char snapshotPath[256];
+    result = lsdj_archive_backup(ramData, gameTitle, timestamp, snapshotPath);
+    if (result == 0) {
+      printf("Snapshot: %s\n", snapshotPath);
+    }
+  } else {
+    printf("No LSDj songs found, saving to %s\n", titleFilename);
+    struct output_file savOutput;
+    result = output_open(&savOutput, titleFilename, LSDJ_SRAM_SIZE);
+    if (result == 0) {
+      output_write(&savOutput, ramData, LSDJ_SRAM_SIZE);
+      result = output_finish(&savOutput);
+    }
+  }
+  return result;
+}
 
 int main(int argc, char **argv) {
 
@@ -30,6 +286,45 @@ int main(int argc, char **argv) {
   printf("based on GBxCart RW v1.24 by insideGadgets\n");
   printf("################################\n");
 
+  // "inc" stores LSDj saves song by song in lsdj-archive/ instead of a .sav
+  // (watch always does for LSDj carts),
+  // "rebuild <snapshot> [sav]" turns an archive snapshot back into a .sav
+  uint8_t incremental = 0;
+  if (argc >= 2 && strncmp(argv[1], "rebuild", 7) == 0) {
+    if (argc < 3) {
+      printf("Usage: backup-sav rebuild <snapshot.lsdj> [SAVFile]\n");
+      return 1;
+    }
+    return rebuild_sav(argv[2], (argc >= 4) ? argv[3] : NULL);
+  }
+  if (argc >= 2 && strncmp(argv[1], "inc", 3) == 0) {
+    incremental = 1;
+  }
+
+  // "store" backs up into gbx-store/ instead of a .sav file,
+  // "extract <manifest> [file]" gets a stored backup back out
+  if (argc >= 2 && strncmp(argv[1], "extract", 7) == 0) {
+    if (argc < 3) {
+      printf("Usage: backup-sav extract <manifest> [SAVFile]\n");
+      return 1;
+    }
+    return store_extract(argv[2], (argc >= 4) ? argv[3] : NULL);
+  }
+  // With the store, saves that look the same as the last backup are skipped
+  // unless it's older than the maximum age: "store [hours]", 0 always backs up
+  // "watch [hours]" does the same for every cart put in until it's stopped
+  long maxAgeHours = PROBE_DEFAULT_MAX_AGE_HOURS;
+  uint8_t watchMode = 0;
+  if (argc >= 2 && strncmp(argv[1], "watch", 5) == 0) {
+    watchMode = 1;
+  }
+  if (argc >= 2 && (strncmp(argv[1], "store", 5) == 0 || watchMode == 1)) {
+    useStore = 1;
+    if (argc >= 3) {
+      maxAgeHours = atol(argv[2]);
+    }
+  }
+
   read_config();
 
   // Open COM port
@@ -40,41 +335,44 @@ int main(int argc, char **argv) {
   }
   printf("Connected on COM port: %i\n", cport_nr + 1);
 
-  // Break out of any existing functions on ATmega
-  set_mode('0');
-
-  // Get firmware version
-  gbxcartFirmwareVersion = request_value(READ_FIRMWARE_VERSION);
-
-  // Get PCB version
-  gbxcartPcbVersion = request_value(READ_PCB_VERSION);
-
-  // Prompt for GB or GBA mode
-  if (gbxcartPcbVersion == PCB_1_3) {
-    //	printf("\nPlease select a mode:\n"\
-	//			"1. GB/GBC\n"\
-	//			"2. GBA\n");
-
-    //	char modeSelected = read_one_letter();
-    //	if (modeSelected == '1') {
-    set_mode(VOLTAGE_5V);
-    //	}
-    //	else {
-    //		set_mode(VOLTAGE_3_3V);
-    //	}
+  // Get firmware/PCB version and cartridge mode, set the voltage and read the
+  // header in one go
+  struct cart_identity cart;
+  if (watchMode == 1) {
+    // The device is only asked once, carts are then found by polling the
+    // header on the port that's already open
+    if (request_device_info() == 0 ||
+        (cartridgeMode != GB_MODE && cartridgeMode != GBA_MODE)) {
+      printf("Device didn't respond, please unplug GBxCart RW and try "
+             "again\n");
+      return 1;
+    }
+    if (gbxcartPcbVersion == PCB_1_3) {
+      set_mode((cartridgeMode == GBA_MODE) ? VOLTAGE_3_3V : VOLTAGE_5V);
+    }
+    wait_for_cart(0);
+    cart_read_identity(&cart, 0);
+  } else if (cart_identify(&cart, 0) == 0) {
+    printf("Device didn't respond, please re-seat the cartridge and try "
+           "again\n");
+    read_one_letter();
+    return 1;
   }
 
   uint8_t inLoop = true;
+  uint8_t waitForNextCart = 0;
+  int exitCode = 0; // 1 once a backup couldn't be written
   while (inLoop == true) {
+    if (waitForNextCart == 1) {
+      wait_for_cart(1);
+      reset_retry_stats(); // The totals shown are for this cart
+      cart_read_identity(&cart, 0);
+    }
+    waitForNextCart = watchMode;
+
     printf("\nBacking up save...\n");
     char optionSelected = '2';
 
-    // Get cartridge mode - Gameboy or Gameboy Advance
-    cartridgeMode = request_value(CART_MODE);
-
-    // Read header
-        read_gb_header();
-
     if (optionSelected == '2') {
       printf("\n--- Backup save from Cartridge to PC---\n");
 
@@ -93,8 +391,52 @@ int main(int argc, char **argv) {
           strncat(titleFilename, "-", 1);
           strncat(titleFilename, timebuffer, 25);
           strncat(titleFilename, ".sav", 4);
+          uint32_t ramLength = ramBanks * (ramEndAddress - 0xA000 + 1);
+
+          // LSDj saves go into the archive song by song, in watch mode too
+          uint8_t lsdjArchive = 0;
+          if ((incremental == 1 || watchMode == 1) &&
+              strncmp(gameTitle, "LSDj", 4) == 0 &&
+              ramLength == LSDJ_SRAM_SIZE) {
+            lsdjArchive = 1;
+          }
+
+          // Read by the probe when it had to compare the whole save. Gameboy
+          // Camera carts on R1 firmware can only be read the slow way below.
+          uint8_t *ramData = NULL;
+          uint8_t ramRead = 0;
+          if ((useStore == 1 || lsdjArchive == 1) && maxAgeHours > 0 &&
+              !(cartridgeType == 252 && gbxcartFirmwareVersion == 1)) {
+            ramData = (uint8_t *)malloc(ramLength);
+            if (ramData != NULL &&
+                save_unchanged(ramLength, maxAgeHours, lsdjArchive, ramData,
+                               &ramRead) == 1) {
+              free(ramData);
+              inLoop = watchMode;
+              continue;
+            }
+          }
+
+          if (lsdjArchive == 1) {
+            if (ramData == NULL) {
+              ramData = (uint8_t *)malloc(ramLength);
+            }
+            if (ramData == NULL) {
+              printf("Not enough memory\n");
+              exitCode = 1;
+            } else if (backup_lsdj_incremental(titleFilename, timebuffer,
+                                               ramData, ramRead) != 0) {
+              exitCode = 1;
+            } else {
+              printf("\nFinished\n");
+            }
+            free(ramData);
+            inLoop = watchMode;
+            continue;
+          }
+
           // Check if file exists
-          FILE *ramFile = fopen(titleFilename, "rb");
+          FILE *ramFile = (useStore == 1) ? NULL : fopen(titleFilename, "rb");
           char confirmWrite = 'y';
           if (ramFile != NULL) {
             printf("File %s exists on your PC.", titleFilename);
@@ -108,21 +450,20 @@ int main(int argc, char **argv) {
 
           if (confirmWrite == 'y') {
             printf("Backing up save to %s\n", titleFilename);
-            printf("[             25%%             50%%             75%%       "
-                   "     100%%]\n[");
+            if (ramRead == 0) {
+              printf("[             25%%             50%%             75%%     "
+                     "       100%%]\n[");
+            }
 
             // Create a new file
-            FILE *ramFile = fopen(titleFilename, "wb");
-
-            mbc2_fix();
-            if (cartridgeType <= 4) { // MBC1
-              set_bank(0x6000, 1);    // Set RAM Mode
-            }
-            set_bank(0x0000, 0x0A); // Initialise MBC
+            open_save_output(titleFilename, ramLength);
 
             // Check if Gameboy Camera cart with v1.0/1.1 PCB with R1 firmware,
             // read data slower
             if (cartridgeType == 252 && gbxcartFirmwareVersion == 1) {
+              mbc2_fix();
+              set_bank(0x0000, 0x0A); // Initialise MBC
+
               // Read RAM
               uint32_t readBytes = 0;
               for (uint8_t bank = 0; bank < ramBanks; bank++) {
@@ -174,7 +515,8 @@ int main(int argc, char **argv) {
                     RS232_drain(cport_nr);
                   }
 
-                  com_read_bytes(ramFile, 64);
+                  com_read_bytes(NULL, 64);
+                  write_save_block(readBuffer, 64);
 
                   ramAddress += 64;
                   readBytes += 64;
@@ -200,67 +542,37 @@ int main(int argc, char **argv) {
 
               RS232_cputs(cport_nr, "M1");
               RS232_drain(cport_nr);
+              set_bank(0x0000, 0x00); // Disable RAM
             }
 
             else {
-              // Read RAM
-              uint32_t readBytes = 0;
-              for (uint8_t bank = 0; bank < ramBanks; bank++) {
-                uint16_t ramAddress = 0xA000;
-                set_bank(0x4000, bank);
-                set_number(ramAddress,
-                           SET_START_ADDRESS); // Set start address again
-                set_mode(READ_ROM_RAM);        // Set rom/ram reading mode
-
-                while (ramAddress < ramEndAddress) {
-                  uint8_t comReadBytes = com_read_bytes(ramFile, 64);
-                  if (comReadBytes == 64) {
-                    ramAddress += 64;
-                    readBytes += 64;
-
-                    // Request 64 bytes more
-                    if (ramAddress < ramEndAddress) {
-                      com_read_cont();
-                    }
-                  } else { // Didn't receive 64 bytes, usually this only happens
-                           // for Apple MACs
-                    fflush(ramFile);
-                    com_read_stop();
-                    delay_ms(500);
-                    printf("Retrying\n");
-
-                    // Flush buffer
-                    RS232_PollComport(cport_nr, readBuffer, 64);
-
-                    // Start off where we left off
-                    fseek(ramFile, readBytes, SEEK_SET);
-                    set_number(ramAddress, SET_START_ADDRESS);
-                    set_mode(READ_ROM_RAM);
-                  }
-
-                  // Print progress
-                  if (ramEndAddress == 0xA1FF) {
-                    print_progress_percent(readBytes, 64);
-                  } else if (ramEndAddress == 0xA7FF) {
-                    print_progress_percent(readBytes / 4, 64);
-                  } else {
-                    print_progress_percent(
-                        readBytes,
-                        (ramBanks * (ramEndAddress - 0xA000 + 1)) / 64);
-                  }
+              if (ramData == NULL) {
+                ramData = (uint8_t *)malloc(ramLength);
+              }
+              if (ramData == NULL) {
+                printf("Not enough memory");
+                fail_save_output();
+              } else {
+                if (ramRead == 0) {
+                  gb_read_ram(ramData);
                 }
-                com_read_stop(); // Stop reading RAM (as we will bank switch)
+                write_save_block(ramData, ramLength);
               }
             }
-            printf("]");
-
-            set_bank(0x0000, 0x00); // Disable RAM
+            if (ramRead == 0) {
+              printf("]");
+            }
 
-            fclose(ramFile);
-            printf("\nFinished\n");
+            print_retry_stats();
+            if (close_save_output() != 0) {
+              exitCode = 1;
+            } else {
+              printf("\nFinished\n");
+            }
           } else {
             printf("Aborted\n");
           }
+          free(ramData);
         } else {
           printf("Cartridge has no RAM\n");
         }
@@ -274,7 +586,7 @@ int main(int argc, char **argv) {
           strncat(titleFilename, ".sav", 4);
 
           // Check if file exists
-          FILE *ramFile = fopen(titleFilename, "rb");
+          FILE *ramFile = (useStore == 1) ? NULL : fopen(titleFilename, "rb");
           char confirmWrite = 'y';
           if (ramFile != NULL) {
             printf("File %s exists on your PC.", titleFilename);
@@ -288,7 +600,10 @@ int main(int argc, char **argv) {
 
           if (confirmWrite == 'y') {
             // Create a new file
-            FILE *ramFile = fopen(titleFilename, "wb");
+            uint32_t saveLength = (ramEndAddress > 0)
+                                      ? (uint32_t)ramBanks * ramEndAddress
+                                      : eepromEndAddress;
+            open_save_output(titleFilename, saveLength);
 
             // SRAM/Flash
             if (ramEndAddress > 0) {
@@ -311,29 +626,14 @@ int main(int argc, char **argv) {
                 set_mode(GBA_READ_SRAM);
 
                 while (currAddr < endAddr) {
-                  uint8_t comReadBytes = com_read_bytes(ramFile, 64);
-                  if (comReadBytes == 64) {
-                    currAddr += 64;
-                    readBytes += 64;
+                  com_read_block_checked(currAddr, GBA_READ_SRAM, 64);
+                  write_save_block(readBuffer, 64);
+                  currAddr += 64;
+                  readBytes += 64;
 
-                    // Request 64 bytes more
-                    if (currAddr < endAddr) {
-                      com_read_cont();
-                    }
-                  } else { // Didn't receive 64 bytes, usually this only happens
-                           // for Apple MACs
-                    fflush(ramFile);
-                    com_read_stop();
-                    delay_ms(500);
-                    printf("Retrying\n");
-
-                    // Flush buffer
-                    RS232_PollComport(cport_nr, readBuffer, 64);
-
-                    // Start off where we left off
-                    fseek(ramFile, currAddr, SEEK_SET);
-                    set_number(currAddr, SET_START_ADDRESS);
-                    set_mode(GBA_READ_SRAM);
+                  // Request 64 bytes more
+                  if (currAddr < endAddr) {
+                    com_read_cont();
                   }
 
                   print_progress_percent(readBytes,
@@ -355,35 +655,18 @@ int main(int argc, char **argv) {
               printf("[             25%%             50%%             75%%     "
                      "       100%%]\n[");
 
-              set_number(eepromSize, GBA_SET_EEPROM_SIZE);
-
-              // Set start and end address
-              currAddr = 0x000;
-              endAddr = eepromEndAddress;
-              set_number(currAddr, SET_START_ADDRESS);
-              set_mode(GBA_READ_EEPROM);
-
-              // Read EEPROM
-              uint32_t readBytes = 0;
-              while (currAddr < endAddr) {
-                com_read_bytes(ramFile, 8);
-                currAddr += 8;
-                readBytes += 8;
-
-                // Request 8 bytes more
-                if (currAddr < endAddr) {
-                  com_read_cont();
-                }
-
-                print_progress_percent(readBytes, endAddr / 64);
-              }
-
-              com_read_stop(); // End read
+              uint8_t eepromData[0x2000];
+              gba_read_eeprom(eepromData);
+              write_save_block(eepromData, eepromEndAddress);
             }
 
-            fclose(ramFile);
             printf("]");
-            printf("\nFinished\n");
+            print_retry_stats();
+            if (close_save_output() != 0) {
+              exitCode = 1;
+            } else {
+              printf("\nFinished\n");
+            }
           } else {
             printf("Aborted\n");
           }
@@ -391,7 +674,7 @@ int main(int argc, char **argv) {
           printf("Cartridge has no RAM\n");
         }
       }
-      inLoop = false;
+      inLoop = watchMode;
     }
 
     // Write RAM
@@ -529,27 +812,19 @@ int main(int argc, char **argv) {
                 }
               }
 
-              // EEPROM
+              // EEPROM, only the blocks that differ get written
               else if (eepromSize != EEPROM_NONE) {
-                set_number(eepromSize, GBA_SET_EEPROM_SIZE);
-
-                // Set start and end address
-                currAddr = 0x000;
-                endAddr = eepromEndAddress;
-                set_number(currAddr, SET_START_ADDRESS);
-
-                // Write
-                uint32_t readBytes = 0;
-                while (currAddr < endAddr) {
-                  com_write_bytes_from_file(GBA_WRITE_EEPROM, ramFile, 8);
-                  currAddr += 8;
-                  readBytes += 8;
-
-                  print_progress_percent(readBytes, endAddr / 64);
-
-                  // Wait for ATmega to process write (~320us) and for EEPROM to
-                  // write data (6ms)
-                  com_wait_for_ack();
+                uint8_t eepromFileData[0x2000];
+                uint32_t dataLength =
+                    fread(eepromFileData, 1, eepromEndAddress, ramFile);
+                uint32_t changedBlocks = 0;
+                if (gba_write_eeprom_delta(eepromFileData, dataLength,
+                                           &changedBlocks) > 0) {
+                  printf("]\nSome blocks didn't verify, please re-seat the "
+                         "cartridge and try again\n");
+                  fclose(ramFile);
+                  read_one_letter();
+                  return 1;
                 }
               }
 
@@ -1583,5 +1858,5 @@ int main(int argc, char **argv) {
     }
   }
 
-  return 0;
+  return exitCode;
 }
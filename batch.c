@@ -0,0 +1,445 @@
+/*
+ Batch flashing by DEFENSE MECHANISM
+
+ See batch.h. The log gets one line per job:
+
+   <date>,<job>,<ROMFile>,<result>,<identify ms>,<flash ms>,<verify ms>,<save ms>,<total ms>
+
+ */
+
+#ifndef _WIN32
+#define _XOPEN_SOURCE 600 // Must come before the first system header
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "batch.h"
+#include "hotplug.h"
+#include "image.h"
+#define GBX_LEGACY_GLOBALS // Uses currAddr, romSize and the rest
+#include "setup.h" // See defines, variables, constants, functions here
+
+// Milliseconds from a clock that doesn't jump, for the job times
+static uint32_t batch_ms(void) {
+#ifdef _WIN32
+  return GetTickCount();
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+#endif
+}
+
+// Copy a manifest field without the spaces around it
+static void batch_field(char *field, const char *start, size_t length,
+                        size_t size) {
+  while (length > 0 && (*start == ' ' || *start == '\t')) {
+    start++;
+    length--;
+  }
+  while (length > 0 && (start[length - 1] == ' ' || start[length - 1] == '\t' ||
+                        start[length - 1] == '\r' ||
+                        start[length - 1] == '\n')) {
+    length--;
+  }
+  if (length >= size) {
+    length = size - 1;
+  }
+  memcpy(field, start, length);
+  field[length] = '\0';
+}
+
+int batch_parse_job(const char *line, struct batch_job *job) {
+  char text[1024];
+  strncpy(text, line, sizeof(text) - 1);
+  text[sizeof(text) - 1] = '\0';
+  char *comment = strchr(text, '#');
+  if (comment != NULL) {
+    *comment = '\0';
+  }
+
+  // Up to 4 comma separated fields, the last ones can be left out
+  char fields[4][256];
+  memset(fields, 0, sizeof(fields));
+  const char *start = text;
+  for (uint8_t f = 0; f < 4 && start != NULL; f++) {
+    const char *comma = strchr(start, ',');
+    size_t length = (comma != NULL) ? (size_t)(comma - start) : strlen(start);
+    batch_field(fields[f], start, length, sizeof(fields[f]));
+    start = (comma != NULL) ? comma + 1 : NULL;
+  }
+  if (fields[0][0] == '\0') {
+    return 0;
+  }
+
+  memset(job, 0, sizeof(struct batch_job));
+  strncpy(job->romPath, fields[0], sizeof(job->romPath) - 1);
+  job->cartType = atoi(fields[1]);
+  if (strcmp(fields[2], "-") != 0) {
+    strncpy(job->savPath, fields[2], sizeof(job->savPath) - 1);
+  }
+  job->verifyLevel = VERIFY_QUICK;
+  if (strcmp(fields[3], "none") == 0) {
+    job->verifyLevel = VERIFY_NONE;
+  } else if (strcmp(fields[3], "full") == 0) {
+    job->verifyLevel = VERIFY_FULL;
+  } else if (fields[3][0] != '\0' && strcmp(fields[3], "quick") != 0) {
+    return -1;
+  }
+  return 1;
+}
+
+int batch_read_manifest(const char *manifestPath, struct batch_job *jobs,
+                        int maxJobs) {
+  FILE *manifestFile = fopen(manifestPath, "rt");
+  if (manifestFile == NULL) {
+    return -1;
+  }
+
+  int jobCount = 0;
+  int lineNumber = 0;
+  char line[1024];
+  while (fgets(line, sizeof(line), manifestFile) != NULL &&
+         jobCount < maxJobs) {
+    lineNumber++;
+    int parsed = batch_parse_job(line, &jobs[jobCount]);
+    if (parsed < 0) {
+      printf("%s line %i: verify should be none, quick or full\n",
+             manifestPath, lineNumber);
+      fclose(manifestFile);
+      return -1;
+    }
+    jobCount += parsed;
+  }
+  fclose(manifestFile);
+  return jobCount;
+}
+
+// CRC of the header block cart_present() has just read, to tell carts apart
+static uint32_t batch_header_crc(void) {
+  return crc32_update(0, readBuffer, 64);
+}
+
+// Connect to the device again after it's been unplugged (to power cycle a
+// cart, or after a hang) and plugged back in
+static uint8_t batch_reconnect(int watchFd) {
+  printf("\nDevice unplugged, waiting for it to come back...\n");
+  fflush(stdout);
+  RS232_CloseComport(cport_nr);
+  hotplug_wait(watchFd, cport_nr + 1, 1);
+  if (com_test_port() == 0 || request_device_info() == 0) {
+    return 0;
+  }
+  printf("Connected on COM port: %i\n", cport_nr + 1);
+  xmas_wake_up();
+  return 1;
+}
+
+// Wait for the device to be unplugged and plugged back in, for a cart that
+// needs powering off before the rest of its image can be written
+static uint8_t batch_power_cycle(int watchFd) {
+  printf("\nUnplug the device and plug it back in to carry on\n");
+  fflush(stdout);
+#ifdef _WIN32
+  // The port can't be watched here
+  printf("Press enter once it's back\n");
+  char line[8];
+  if (fgets(line, sizeof(line), stdin) == NULL) {
+    return 0;
+  }
+#else
+  hotplug_wait(watchFd, cport_nr + 1, 0);
+#endif
+  return batch_reconnect(watchFd);
+}
+
+// Wait for the cart that was just done to come out and the next one to go in.
+// The header reading differently from the last cart's means it's out, a cart
+// with a readable header for BATCH_SETTLE_MS means the next one is in. If the
+// device is unplugged meanwhile, the cart's been swapped with it unplugged
+// and the one that's in when it's back is the next. Returns 0 if the device
+// didn't answer again after being plugged back in.
+static uint8_t batch_wait_for_swap(uint32_t lastHeader, uint8_t waitForKey,
+                                   int watchFd) {
+  if (waitForKey == 1) {
+    printf("\nPut in the next cartridge and press enter\n");
+    char line[8];
+    if (fgets(line, sizeof(line), stdin) == NULL) {
+      return 1;
+    }
+    if (hotplug_present(cport_nr + 1) == 0) {
+      return batch_reconnect(watchFd);
+    }
+    return 1;
+  }
+
+  printf("\nWaiting for the next cartridge...\n");
+  uint8_t swapped = 0;
+  while (swapped == 0) {
+    if (hotplug_present(cport_nr + 1) == 0) {
+      if (batch_reconnect(watchFd) == 0) {
+        return 0;
+      }
+      break;
+    }
+    if (cart_present() == 0 || batch_header_crc() != lastHeader) {
+      swapped = 1;
+    } else {
+      delay_ms(BATCH_POLL_MS);
+    }
+  }
+  while (1) {
+    if (hotplug_present(cport_nr + 1) == 0) {
+      if (batch_reconnect(watchFd) == 0) {
+        return 0;
+      }
+      continue;
+    }
+    if (cart_present() == 0) {
+      delay_ms(BATCH_POLL_MS);
+      continue;
+    }
+    uint32_t header = batch_header_crc();
+    delay_ms(BATCH_SETTLE_MS); // Let the contacts settle
+    if (cart_present() == 1 && batch_header_crc() == header) {
+      return 1;
+    }
+  }
+}
+
+// Keep where the first difference is and stop the compare there
+static uint8_t batch_first_diff(void *context, uint16_t bank,
+                                uint32_t romOffset, const uint8_t *cartData,
+                                const uint8_t *romData, uint16_t length,
+                                uint16_t diffOffset) {
+  *(int32_t *)context = romOffset + diffOffset;
+  return 0;
+}
+
+int batch_verify(const char *romPath, uint8_t verifyLevel) {
+  // Mapped once for the whole batch when every cart gets the same image
+  const struct image *romImage = image_open(romPath);
+  if (romImage == NULL) {
+    return 1;
+  }
+  const uint8_t *romData = romImage->data;
+  uint32_t romLength = romImage->length;
+
+  uint32_t compareLength = romLength;
+  if (verifyLevel == VERIFY_QUICK) {
+    uint32_t quickLength = (cartridgeMode == GB_MODE) ? BATCH_QUICK_VERIFY_GB
+                                                      : BATCH_QUICK_VERIFY_GBA;
+    if (compareLength > quickLength) {
+      compareLength = quickLength;
+    }
+  }
+
+  if (cartridgeMode == GB_MODE) {
+    read_gb_header(); // For the MBC, to switch banks
+  }
+  printf("\nVerifying %u bytes\n", (unsigned int)compareLength);
+  printf("[             25%%             50%%             75%%            "
+         "100%%]\n[");
+
+  int32_t firstDiff = -1;
+  compare_rom(romData, compareLength, batch_first_diff, &firstDiff);
+
+  if (firstDiff >= 0) {
+    printf("]\nFirst difference at 0x%06X\n", (unsigned int)firstDiff);
+    return 1;
+  }
+  printf("]\n");
+  return 0;
+}
+
+// Append a job's times to the log
+static void batch_log(const char *logPath, int jobNumber,
+                      const struct batch_job *job, const char *result,
+                      const uint32_t *times) {
+  FILE *logFile = fopen(logPath, "at");
+  if (logFile == NULL) {
+    return;
+  }
+  char timebuffer[25];
+  time_t rawtime;
+  time(&rawtime);
+  strftime(timebuffer, sizeof(timebuffer), "%Y-%m-%d %H:%M:%S",
+           localtime(&rawtime));
+  fprintf(logFile, "%s,%i,%s,%s,%u,%u,%u,%u,%u\n", timebuffer, jobNumber,
+          job->romPath, result, (unsigned int)times[0], (unsigned int)times[1],
+          (unsigned int)times[2], (unsigned int)times[3],
+          (unsigned int)(times[0] + times[1] + times[2] + times[3]));
+  fclose(logFile);
+}
+
+const char *batch_run_job(const struct batch_job *job, int defaultCartType,
+                          uint32_t *times) {
+  const char *result = "ok";
+  memset(times, 0, 4 * sizeof(uint32_t));
+
+  uint32_t started = batch_ms();
+  cartridgeMode = read_cartridge_mode();
+  const char *extension = strrchr(job->romPath, '.');
+  uint8_t romMode = (extension != NULL && strncmp(extension, ".gba", 4) == 0)
+                        ? GBA_MODE
+                        : GB_MODE;
+  times[0] = batch_ms() - started;
+
+  if (romMode != cartridgeMode) {
+    printf("%s is for %s but the device is in %s mode\n", job->romPath,
+           (romMode == GBA_MODE) ? "GBA" : "GB",
+           (cartridgeMode == GBA_MODE) ? "GBA" : "GB");
+    return "wrong mode";
+  }
+
+  started = batch_ms();
+  flashCartType = (job->cartType > 0) ? job->cartType : defaultCartType;
+  mode5vOverride = 0;
+  int flashResult = flash_rom(job->romPath);
+  if (flashResult == FLASH_ROM_POWER_CYCLE) {
+    result = "power cycle";
+  } else if (flashResult != 0 && flashResult != FLASH_ROM_VERIFIED) {
+    result = "flash failed";
+  }
+  times[1] = batch_ms() - started;
+
+  started = batch_ms();
+  if (strcmp(result, "ok") == 0 && job->verifyLevel != VERIFY_NONE &&
+      flashResult != FLASH_ROM_VERIFIED &&
+      batch_verify(job->romPath, job->verifyLevel) != 0) {
+    result = "verify failed";
+  }
+  times[2] = batch_ms() - started;
+
+  started = batch_ms();
+  if (strcmp(result, "ok") == 0 && job->savPath[0] != '\0') {
+    printf("\n");
+    if (restore_save(job->savPath) != 0) {
+      result = "save failed";
+    }
+  }
+  times[3] = batch_ms() - started;
+  return result;
+}
+
+int batch_run(const char *manifestPath, uint8_t waitForKey) {
+  struct batch_job *jobs =
+      (struct batch_job *)malloc(BATCH_MAX_JOBS * sizeof(struct batch_job));
+  if (jobs == NULL) {
+    return 1;
+  }
+  int jobCount = batch_read_manifest(manifestPath, jobs, BATCH_MAX_JOBS);
+  if (jobCount <= 0) {
+    printf("No jobs in %s\n", manifestPath);
+    free(jobs);
+    return 1;
+  }
+  char logPath[272];
+  snprintf(logPath, sizeof(logPath), "%s.log", manifestPath);
+
+  // A batch that stopped part way (the device went in the middle of a job)
+  // carries on from the job it was on
+  char resumePath[272];
+  snprintf(resumePath, sizeof(resumePath), "%s.resume", manifestPath);
+  int firstJob = 0;
+  FILE *resumeFile = fopen(resumePath, "rt");
+  if (resumeFile != NULL) {
+    if (fscanf(resumeFile, "%d", &firstJob) != 1 || firstJob < 0 ||
+        firstJob >= jobCount) {
+      firstJob = 0;
+    }
+    fclose(resumeFile);
+  }
+  if (firstJob > 0) {
+    printf("Carrying on from job %i, delete %s to start over\n", firstJob + 1,
+           resumePath);
+  }
+
+  // Connect once for the whole batch
+  read_config();
+  if (com_test_port() == 0) {
+    printf("Device not connected and couldn't be auto detected\n");
+    free(jobs);
+    return 1;
+  }
+  printf("Connected on COM port: %i\n", cport_nr + 1);
+  if (request_device_info() == 0) {
+    printf("Device didn't respond, please unplug GBxCart RW and try again\n");
+    free(jobs);
+    return 1;
+  }
+  xmas_wake_up();
+  if (gbxcartPcbVersion == PCB_1_0 || gbxcartFirmwareVersion <= 8) {
+    printf("PCB v1.1 or newer with firmware R9 or higher is required\n");
+    free(jobs);
+    return 1;
+  }
+  read_config_flash();
+  int defaultCartType = flashCartType;
+
+  int watchFd = hotplug_watch();
+  int failedCount = 0;
+  int doneCount = 0;
+  uint32_t lastHeader = 0;
+  uint8_t sameCart = 1; // The job is for the cart that's in already
+  for (int x = firstJob; x < jobCount; x++) {
+    struct batch_job *job = &jobs[x];
+    uint32_t times[4];
+    printf("\n=== Job %i of %i: %s ===\n", x + 1, jobCount, job->romPath);
+
+    if (sameCart == 0 &&
+        batch_wait_for_swap(lastHeader, waitForKey, watchFd) == 0) {
+      printf("Device didn't respond, run the batch again to carry on\n");
+      break;
+    }
+    resumeFile = fopen(resumePath, "wt");
+    if (resumeFile != NULL) {
+      fprintf(resumeFile, "%d\n", x);
+      fclose(resumeFile);
+    }
+    const char *result = batch_run_job(job, defaultCartType, times);
+
+    // What the cart reads as now, it has to change before the next job
+    cart_present();
+    lastHeader = batch_header_crc();
+
+    if (strcmp(result, "ok") != 0 && strcmp(result, "power cycle") != 0) {
+      failedCount++;
+    }
+    printf("\nJob %i: %s (identify %ums, flash %ums, verify %ums, save %ums)\n",
+           x + 1, result, (unsigned int)times[0], (unsigned int)times[1],
+           (unsigned int)times[2], (unsigned int)times[3]);
+    batch_log(logPath, x + 1, job, result, times);
+
+    // The same job again for the next segment once the cart's powered back on
+    if (strcmp(result, "power cycle") == 0) {
+      if (batch_power_cycle(watchFd) == 0) {
+        printf("Device didn't respond, run the batch again to carry on\n");
+        break;
+      }
+      sameCart = 1;
+      x--;
+      continue;
+    }
+    sameCart = 0;
+    doneCount++;
+  }
+  if (firstJob + doneCount == jobCount) {
+    remove(resumePath);
+  }
+
+  printf("\n%i of %i jobs finished, times are in %s\n", doneCount - failedCount,
+         jobCount - firstJob, logPath);
+  xmas_idle_on();
+  image_close_all();
+  free(jobs);
+  return (failedCount > 0 || firstJob + doneCount < jobCount) ? 1 : 0;
+}
@@ -0,0 +1,65 @@
+/*
+ Batch flashing by DEFENSE MECHANISM
+
+ Runs a list of flash jobs one cart after another while the device stays
+ connected, so the port, firmware and PCB checks happen once for the whole
+ batch. The manifest has one job per line ('#' starts a comment):
+
+   <ROMFile>,<cart type>,<SAVFile>,<verify>
+
+ The cart type is the number flash-cart takes after the ROM file (empty or 0
+ for the one in config-flash.ini), the save file is written after the ROM
+ (empty or - for none) and verify is none, quick (the first 32KB on GB, 64KB
+ on GBA) or full. Each job's times go to <manifest>.log.
+
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define BATCH_MAX_JOBS 256
+#define BATCH_POLL_MS 250
+#define BATCH_SETTLE_MS 500
+#define BATCH_QUICK_VERIFY_GB 0x8000
+#define BATCH_QUICK_VERIFY_GBA 0x10000
+
+#define VERIFY_NONE 0
+#define VERIFY_QUICK 1
+#define VERIFY_FULL 2
+
+// One line of the manifest
+struct batch_job {
+  char romPath[256];
+  int cartType;
+  char savPath[256];
+  uint8_t verifyLevel;
+};
+
+// Parse one manifest line into job, returns 1 for a job, 0 for a blank or comment line and -1 if verify isn't
+// none, quick or full
+int batch_parse_job(const char *line, struct batch_job *job);
+
+// Read the manifest into jobs, returns the number of jobs or -1 if it can't be read
+int batch_read_manifest(const char *manifestPath, struct batch_job *jobs, int maxJobs);
+
+// Run one job on the cart that's in: check the mode matches the image, write it (with the cart type from
+// config-flash.ini if the job has none), verify it and write the save. The identify/flash/verify/save times go
+// in times[4]. Returns "ok" or what failed.
+const char *batch_run_job(const struct batch_job *job, int defaultCartType, uint32_t *times);
+
+// Read the start (quick) or all of the ROM back and compare it with the file. Returns 0 if it matches.
+int batch_verify(const char *romPath, uint8_t verifyLevel);
+
+// Connect and run every job in the manifest. Between carts it waits for the header to change, or for enter to be
+// pressed if waitForKey is set (for blank carts, which read the same as no cart), and for the device to come back if
+// it's been unplugged. The job being run is kept in <manifest>.resume until the batch is done, so running a batch
+// that stopped part way again carries on from that job. Returns 0 if every job worked.
+int batch_run(const char *manifestPath, uint8_t waitForKey);
+
+// In flash-cart.c. flash_rom() returns 0 when the ROM is written, 1 if it couldn't be or one of these.
+#define FLASH_ROM_POWER_CYCLE 2 // One segment of a 32MB image is written, run it again after a power cycle
+#define FLASH_ROM_VERIFIED 3    // Written and verified already (segment by segment)
+#define SEGMENT_SIZE 0x800000   // What the 4x 8MB bank carts can select at once
+#define SEGMENT_JOURNAL_FILE "flash-journal.ini"
+int flash_rom(const char *romPath);
+int restore_save(const char *savPath);
@@ -0,0 +1,1158 @@
+/*
+ Cart Daemon by DEFENSE MECHANISM
+ based on GBxCart RW - Console Interface by insideGadgets
+
+ Keeps one or more GBxCart RW devices connected and runs the jobs other
+ programs (a web front end, a barcode scanner script) send it over a Unix
+ domain socket, so nothing has to start a tool and set the device up again
+ for every cart:
+
+   cart-daemon <socket> <port,port,...>
+
+ Each device gets a worker process that connects once and then runs the jobs
+ queued for it one at a time. Ports are numbered as in config.ini. Clients
+ send one request per line:
+
+   devices                                   list the devices and their queues
+   jobs                                      list the jobs and when they finish
+   identify <port|any>                       read the cart's header
+   flash <port|any> <ROMFile>,<cart type>,<SAVFile>,<verify>
+                                             a flash-cart batch manifest line
+   verify <port|any> <ROMFile> [full]        compare the cart with a ROM file
+   backup-rom <port|any> <ROMFile>           dump the ROM
+   backup-sav <port|any> <SAVFile>           back up the save
+
+ A job is answered with "queued <job> <port> <ms>" (the port it's planned
+ for and when it should be done) or "error <reason>" and its events follow on
+ the same connection:
+
+   output <job> <text>         a line the job printed
+   progress <job> <percent>    how far the current step (erase, write, ...) is
+   done <job> <ms> <result>    ok or what failed, the job is finished
+
+ "devices" is answered with a "device <port> <state> <jobs waiting> <ms>"
+ line for each device, with when it should be free, and "jobs" with a
+ "job <job> <command> <queued|running> <port> <estimate ms> <ms>" line for
+ each job, then both with "ok". The estimates come from how fast each device
+ has been so far (see schedule.h), jobs for any device are planned longest
+ first onto whichever device would finish them soonest and move when another
+ device frees up first. Files are opened from the daemon's folder, so send
+ full paths. Jobs keep running if their client goes away, or is dropped for
+ falling 64KB behind reading what it's sent. When a worker dies (the device
+ stopped answering) the job it was running fails and it's started again
+ after a few seconds, the rest of its queue waits for it. A device that's unplugged is shown as
+ unplugged and its worker started again as soon as it's plugged back in (see
+ hotplug.h); the job it was in the middle of goes back to the front of its
+ queue and runs again then, up to DAEMON_MAX_ATTEMPTS times, since the cart
+ is still in that device. A 32MB image for the 4x 8MB bank carts is written a
+ segment at a time: after each one the device shows as power-cycle and the
+ job waits at the front of its queue until the device has been unplugged and
+ plugged back in.
+
+ */
+
+#define _XOPEN_SOURCE 600 // Must come before the first system header
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "hotplug.h"
+#include "output.h"
+#include "schedule.h"
+#define GBX_LEGACY_GLOBALS // Uses currAddr, romSize and the rest
+#include "setup.h" // See defines, variables, constants, functions here
+
+#define DAEMON_MAX_DEVICES 16
+#define DAEMON_MAX_CLIENTS 16
+#define DAEMON_MAX_JOBS 256
+#define DAEMON_LINE 1024
+#define DAEMON_CLIENT_OUTPUT 0x10000 // Unsent bytes a client can fall behind by
+#define DAEMON_RESTART_MS 5000
+#define DAEMON_MAX_ATTEMPTS 3 // Runs of a job the device was unplugged in
+#define DAEMON_MARKER "@gbx " // Starts the lines a worker sends the daemon
+
+#define DEVICE_STARTING 0
+#define DEVICE_READY 1
+#define DEVICE_BUSY 2
+#define DEVICE_DOWN 3
+
+#define JOB_FREE 0
+#define JOB_QUEUED 1
+#define JOB_RUNNING 2
+
+const char *deviceStates[] = {"starting", "ready", "busy", "down"};
+const char *jobCommands[] = {"identify", "flash", "verify", "backup-rom",
+                             "backup-sav"};
+
+struct daemon_device {
+  int port;
+  pid_t process;
+  int jobFd;    // Job lines to the worker
+  int outputFd; // Everything the worker prints
+  char output[DAEMON_LINE];
+  size_t outputLength;
+  uint8_t progressHashes;
+  uint8_t state;
+  int runningJob; // Job id, 0 for none
+  uint32_t restartAt;
+  uint8_t unplugged;  // Down until its port is back
+  uint8_t powerCycle; // Waiting to be unplugged, for the rest of a 32MB image
+  uint32_t freeMs; // Planned, from now
+};
+
+struct daemon_client {
+  int fd; // -1 if free, non-blocking so one slow client can't stall the rest
+  char input[DAEMON_LINE];
+  size_t inputLength;
+  char output[DAEMON_CLIENT_OUTPUT]; // Waiting for the socket to take it
+  size_t outputLength;
+};
+
+struct daemon_job {
+  int id;
+  uint8_t state;
+  int device; // Once it's running
+  int client; // -1 once the client has gone
+  char command[16];
+  char arguments[DAEMON_LINE];
+  struct schedule_job plan;
+  uint32_t estimateMs;
+  uint32_t started;
+  uint32_t writeStarted; // When flashing got past erasing, 0 if it didn't say
+  uint32_t times[4];     // Identify, flash, verify and save ms from the worker
+  uint8_t attempts;      // Times it's been started
+  uint8_t segmented;     // Written over power cycles, its times aren't rates
+};
+
+struct daemon_device devices[DAEMON_MAX_DEVICES];
+uint8_t deviceCount = 0;
+struct daemon_client clients[DAEMON_MAX_CLIENTS];
+struct daemon_job jobs[DAEMON_MAX_JOBS];
+int nextJobId = 1;
+int listenFd = -1;
+int hotplugFd = -1;
+volatile sig_atomic_t stopRequested = 0;
+
+static uint32_t daemon_ms(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
+
+static void daemon_stop(int signalNumber) {
+  (void)signalNumber;
+  stopRequested = 1;
+}
+
+// ****** Worker, one process per device ******
+
+static uint8_t worker_write_rom_block(void *context, uint32_t romOffset,
+                                      const uint8_t *data, uint16_t length) {
+  output_write((struct output_file *)context, data, length);
+  return 1;
+}
+
+// Dump the whole ROM to the file given
+static const char *worker_backup_rom(const char *romPath) {
+  struct cart_identity cart;
+  if (cart_identify(&cart, 0) == 0 || cart.romLength == 0) {
+    return "no cart";
+  }
+  struct output_file output;
+  if (output_open(&output, romPath, cart.romLength) != 0) {
+    return "couldn't create the file";
+  }
+
+  printf("\nBacking up ROM to %s\n", romPath);
+  printf("[             25%%             50%%             75%%            "
+         "100%%]\n[");
+  read_rom(0, cart.romLength, worker_write_rom_block, &output);
+  printf("]\n");
+
+  if (output_finish(&output) != 0) {
+    return "couldn't write the file";
+  }
+  return "ok";
+}
+
+// Back up the save (GB RAM, GBA SRAM/Flash or EEPROM) to the file given
+static const char *worker_backup_sav(const char *savPath) {
+  struct cart_identity cart;
+  if (cart_identify(&cart, 0) == 0) {
+    return "no cart";
+  }
+  uint32_t saveLength = cart.saveLength;
+  if (cartridgeMode == GBA_MODE) {
+    saveLength = (ramEndAddress > 0) ? (uint32_t)ramBanks * ramEndAddress
+                                     : eepromEndAddress;
+  }
+  if (saveLength == 0) {
+    return "cart has no save";
+  }
+  uint8_t *saveData = (uint8_t *)malloc(saveLength);
+  if (saveData == NULL) {
+    return "not enough memory";
+  }
+
+  printf("\nBacking up save to %s\n", savPath);
+  if (cartridgeMode == GB_MODE) {
+    printf("[             25%%             50%%             75%%            "
+           "100%%]\n[");
+    gb_read_ram(saveData);
+    printf("]\n");
+  } else if (ramEndAddress > 0) {
+    for (uint8_t bank = 0; bank < ramBanks; bank++) {
+      if (hasFlashSave >= FLASH_FOUND && bank == 1) {
+        set_number(1, GBA_FLASH_SET_BANK);
+      }
+      gba_read_save(0x00000, &saveData[(uint32_t)bank * ramEndAddress],
+                    ramEndAddress);
+      if (hasFlashSave >= FLASH_FOUND && bank == 1) {
+        set_number(0, GBA_FLASH_SET_BANK);
+      }
+    }
+  } else {
+    printf("[             25%%             50%%             75%%            "
+           "100%%]\n[");
+    gba_read_eeprom(saveData);
+    printf("]\n");
+  }
+
+  const char *result = "ok";
+  struct output_file output;
+  if (output_open(&output, savPath, saveLength) != 0) {
+    result = "couldn't create the file";
+  } else {
+    output_write(&output, saveData, saveLength);
+    if (output_finish(&output) != 0) {
+      result = "couldn't write the file";
+    }
+  }
+  free(saveData);
+  return result;
+}
+
+// Run one job, returns "ok" or what failed
+static const char *worker_job(const char *command, char *arguments,
+                              int defaultCartType) {
+  if (strcmp(command, "identify") == 0) {
+    struct cart_identity cart;
+    if (cart_identify(&cart, 0) == 0) {
+      return "no cart";
+    }
+    printf("%s cart %s, ROM %u bytes, save %u bytes, header %s\n",
+           (cart.mode == GBA_MODE) ? "GBA" : "GB", cart.title,
+           (unsigned int)cart.romLength, (unsigned int)cart.saveLength,
+           (cart.headerOk == 1) ? "ok" : "bad");
+    return "ok";
+  }
+
+  if (strcmp(command, "flash") == 0) {
+    struct batch_job job;
+    if (batch_parse_job(arguments, &job) != 1) {
+      return "bad job";
+    }
+    if (gbxcartPcbVersion == PCB_1_0 || gbxcartFirmwareVersion <= 8) {
+      return "needs PCB v1.1 or newer with firmware R9 or higher";
+    }
+    uint32_t times[4];
+    const char *result = batch_run_job(&job, defaultCartType, times);
+    printf("\nIdentify %ums, flash %ums, verify %ums, save %ums\n",
+           (unsigned int)times[0], (unsigned int)times[1],
+           (unsigned int)times[2], (unsigned int)times[3]);
+    return result;
+  }
+
+  if (strcmp(command, "verify") == 0) {
+    uint8_t verifyLevel = VERIFY_QUICK;
+    char *lastSpace = strrchr(arguments, ' ');
+    if (lastSpace != NULL && strcmp(lastSpace + 1, "full") == 0) {
+      verifyLevel = VERIFY_FULL;
+      *lastSpace = '\0';
+    }
+    struct cart_identity cart;
+    if (cart_identify(&cart, 0) == 0) {
+      return "no cart";
+    }
+    if (batch_verify(arguments, verifyLevel) != 0) {
+      return "verify failed";
+    }
+    return "ok";
+  }
+
+  if (strcmp(command, "backup-rom") == 0) {
+    return worker_backup_rom(arguments);
+  }
+  if (strcmp(command, "backup-sav") == 0) {
+    return worker_backup_sav(arguments);
+  }
+  return "unknown job";
+}
+
+// Connect to the device given by the port in the environment, then run each
+// "<command> <arguments>" line that comes in until the daemon closes the pipe
+static void worker_run(int jobFd) {
+  setvbuf(stdout, NULL, _IONBF, 0); // The daemon follows the progress bars
+
+  read_config();
+  if (com_test_port() == 0) {
+    printf(DAEMON_MARKER "down device not connected\n");
+    return;
+  }
+  if (request_device_info() == 0) {
+    printf(DAEMON_MARKER "down device didn't respond\n");
+    return;
+  }
+  xmas_wake_up();
+  read_config_flash();
+  int defaultCartType = flashCartType;
+  printf(DAEMON_MARKER "ready\n");
+
+  FILE *jobFile = fdopen(jobFd, "r");
+  char line[DAEMON_LINE];
+  while (jobFile != NULL && fgets(line, sizeof(line), jobFile) != NULL) {
+    line[strcspn(line, "\r\n")] = '\0';
+    char *arguments = strchr(line, ' ');
+    if (arguments != NULL) {
+      *arguments++ = '\0';
+    } else {
+      arguments = line + strlen(line);
+    }
+    const char *result = worker_job(line, arguments, defaultCartType);
+    printf("\n" DAEMON_MARKER "done %s\n", result);
+  }
+  xmas_idle_on();
+}
+
+// ****** Daemon ******
+
+// Close a client's connection, its jobs still run
+static void daemon_client_close(int clientIndex) {
+  close(clients[clientIndex].fd);
+  clients[clientIndex].fd = -1;
+  for (int x = 0; x < DAEMON_MAX_JOBS; x++) {
+    if (jobs[x].client == clientIndex) {
+      jobs[x].client = -1;
+    }
+  }
+}
+
+// Write as much of a client's output as its socket takes without waiting
+static void daemon_client_flush(int clientIndex) {
+  struct daemon_client *client = &clients[clientIndex];
+  size_t sent = 0;
+  while (sent < client->outputLength) {
+    ssize_t length = write(client->fd, client->output + sent,
+                           client->outputLength - sent);
+    if (length < 0 && errno == EINTR) {
+      continue;
+    }
+    if (length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break; // The rest goes when poll() says there's room
+    }
+    if (length < 0) {
+      daemon_client_close(clientIndex);
+      return;
+    }
+    sent += length;
+  }
+  memmove(client->output, client->output + sent, client->outputLength - sent);
+  client->outputLength -= sent;
+}
+
+// Send a line to a client, dropped if the client has gone. A client that
+// isn't reading is closed once DAEMON_CLIENT_OUTPUT bytes are waiting for it.
+static void daemon_send(int clientIndex, const char *format, ...) {
+  if (clientIndex < 0 || clients[clientIndex].fd < 0) {
+    return;
+  }
+  char line[DAEMON_LINE + 64];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  if (length < 0) {
+    return;
+  }
+  if ((size_t)length >= sizeof(line)) {
+    length = sizeof(line) - 1;
+    line[length - 1] = '\n';
+  }
+  struct daemon_client *client = &clients[clientIndex];
+  if (client->outputLength + length > sizeof(client->output)) {
+    printf("Client %i: isn't reading what it's sent, dropped\n", clientIndex);
+    daemon_client_close(clientIndex);
+    return;
+  }
+  memcpy(client->output + client->outputLength, line, length);
+  client->outputLength += length;
+  daemon_client_flush(clientIndex);
+}
+
+static struct daemon_job *daemon_find_job(int id) {
+  for (int x = 0; x < DAEMON_MAX_JOBS; x++) {
+    if (jobs[x].state != JOB_FREE && jobs[x].id == id) {
+      return &jobs[x];
+    }
+  }
+  return NULL;
+}
+
+// Jobs planned for a device, not counting the one it's running
+static int daemon_queued_jobs(int deviceIndex) {
+  int queued = 0;
+  for (int x = 0; x < DAEMON_MAX_JOBS; x++) {
+    if (jobs[x].state == JOB_QUEUED &&
+        jobs[x].plan.plannedPort == devices[deviceIndex].port) {
+      queued++;
+    }
+  }
+  return queued;
+}
+
+static uint32_t daemon_file_length(const char *path) {
+  struct stat fileStat;
+  if (path[0] == '\0' || stat(path, &fileStat) != 0) {
+    return 0;
+  }
+  return (uint32_t)fileStat.st_size;
+}
+
+// How much of a ROM file a verify reads back
+static uint32_t daemon_verify_length(const char *romPath, uint8_t verifyLevel) {
+  uint32_t romLength = daemon_file_length(romPath);
+  const char *extension = strrchr(romPath, '.');
+  uint32_t quickLength =
+      (extension != NULL && strncmp(extension, ".gba", 4) == 0)
+          ? BATCH_QUICK_VERIFY_GBA
+          : BATCH_QUICK_VERIFY_GB;
+  if (verifyLevel == VERIFY_NONE) {
+    return 0;
+  }
+  if (verifyLevel == VERIFY_QUICK && romLength > quickLength) {
+    return quickLength;
+  }
+  return romLength;
+}
+
+// What a job will do, to estimate how long it takes
+static void daemon_job_work(struct daemon_job *job) {
+  struct schedule_work *work = &job->plan.work;
+  memset(work, 0, sizeof(struct schedule_work));
+
+  if (strcmp(job->command, "flash") == 0) {
+    struct batch_job flashJob;
+    if (batch_parse_job(job->arguments, &flashJob) == 1) {
+      work->profile = flashJob.cartType;
+      work->programLength = daemon_file_length(flashJob.romPath);
+      work->readLength =
+          daemon_verify_length(flashJob.romPath, flashJob.verifyLevel);
+      work->saveLength = daemon_file_length(flashJob.savPath);
+    }
+  } else if (strcmp(job->command, "verify") == 0) {
+    char romPath[DAEMON_LINE];
+    strncpy(romPath, job->arguments, sizeof(romPath) - 1);
+    romPath[sizeof(romPath) - 1] = '\0';
+    uint8_t verifyLevel = VERIFY_QUICK;
+    char *lastSpace = strrchr(romPath, ' ');
+    if (lastSpace != NULL && strcmp(lastSpace + 1, "full") == 0) {
+      verifyLevel = VERIFY_FULL;
+      *lastSpace = '\0';
+    }
+    work->readLength = daemon_verify_length(romPath, verifyLevel);
+  } else if (strcmp(job->command, "backup-rom") == 0) {
+    work->readLength = SCHEDULE_UNKNOWN_ROM_LENGTH;
+  } else if (strcmp(job->command, "backup-sav") == 0) {
+    work->saveLength = SCHEDULE_UNKNOWN_SAVE_LENGTH;
+  }
+}
+
+// Plan the queued jobs onto the devices from what each is doing now
+static void daemon_plan(void) {
+  int ports[DAEMON_MAX_DEVICES];
+  uint32_t busyMs[DAEMON_MAX_DEVICES];
+  uint32_t now = daemon_ms();
+  for (uint8_t d = 0; d < deviceCount; d++) {
+    ports[d] = devices[d].port;
+    busyMs[d] = 0;
+    if (devices[d].state == DEVICE_DOWN || devices[d].powerCycle == 1) {
+      busyMs[d] = SCHEDULE_DEVICE_DOWN_MS;
+    }
+    struct daemon_job *running = daemon_find_job(devices[d].runningJob);
+    if (running != NULL && now - running->started < running->estimateMs) {
+      busyMs[d] = running->estimateMs - (now - running->started);
+    }
+    devices[d].freeMs = busyMs[d];
+  }
+
+  struct schedule_job planned[DAEMON_MAX_JOBS];
+  int plannedJobs[DAEMON_MAX_JOBS];
+  int plannedCount = 0;
+  for (int x = 0; x < DAEMON_MAX_JOBS; x++) {
+    if (jobs[x].state == JOB_QUEUED) {
+      planned[plannedCount] = jobs[x].plan;
+      plannedJobs[plannedCount++] = x;
+    }
+  }
+  schedule_plan(ports, busyMs, deviceCount, planned, plannedCount);
+
+  for (int x = 0; x < plannedCount; x++) {
+    struct daemon_job *job = &jobs[plannedJobs[x]];
+    job->plan = planned[x];
+    for (uint8_t d = 0; d < deviceCount; d++) {
+      if (devices[d].port == job->plan.plannedPort &&
+          devices[d].freeMs < job->plan.finishMs) {
+        devices[d].freeMs = job->plan.finishMs;
+      }
+    }
+  }
+}
+
+// Keep how fast a job that worked went, for the next estimates
+static void daemon_measure(struct daemon_job *job, int port,
+                           uint32_t elapsed) {
+  struct schedule_work *work = &job->plan.work;
+  if (strcmp(job->command, "flash") == 0) {
+    uint32_t flashMs = job->times[1];
+    uint32_t eraseMs = 0;
+    if (job->writeStarted != 0) {
+      eraseMs = job->writeStarted - job->started - job->times[0];
+      eraseMs = (eraseMs > flashMs) ? flashMs : eraseMs;
+    }
+    schedule_measure(port, work->profile, eraseMs, work->programLength,
+                     flashMs - eraseMs);
+    schedule_measure(port, SCHEDULE_PROFILE_READ, 0, work->readLength,
+                     job->times[2]);
+    schedule_measure(port, SCHEDULE_PROFILE_SAVE, 0, work->saveLength,
+                     job->times[3]);
+  } else if (strcmp(job->command, "verify") == 0) {
+    schedule_measure(port, SCHEDULE_PROFILE_READ, 0, work->readLength,
+                     elapsed);
+  } else if (strcmp(job->command, "backup-rom") == 0) {
+    schedule_measure(port, SCHEDULE_PROFILE_READ, 0,
+                     daemon_file_length(job->arguments), elapsed);
+  } else if (strcmp(job->command, "backup-sav") == 0) {
+    schedule_measure(port, SCHEDULE_PROFILE_SAVE, 0,
+                     daemon_file_length(job->arguments), elapsed);
+  }
+}
+
+// Start the worker for a device with a pipe each way
+static uint8_t daemon_start_worker(int deviceIndex) {
+  struct daemon_device *device = &devices[deviceIndex];
+  int jobPipe[2];
+  int outputPipe[2];
+  if (pipe(jobPipe) != 0) {
+    return 0;
+  }
+  if (pipe(outputPipe) != 0) {
+    close(jobPipe[0]);
+    close(jobPipe[1]);
+    return 0;
+  }
+
+  fflush(stdout);
+  device->process = fork();
+  if (device->process < 0) {
+    close(jobPipe[0]);
+    close(jobPipe[1]);
+    close(outputPipe[0]);
+    close(outputPipe[1]);
+    return 0;
+  }
+  if (device->process == 0) {
+    // Only keep this device's pipes, so the others see the daemon closing
+    close(listenFd);
+    for (int x = 0; x < DAEMON_MAX_CLIENTS; x++) {
+      if (clients[x].fd >= 0) {
+        close(clients[x].fd);
+      }
+    }
+    for (uint8_t x = 0; x < deviceCount; x++) {
+      if (x != deviceIndex && devices[x].state != DEVICE_DOWN) {
+        close(devices[x].jobFd);
+        close(devices[x].outputFd);
+      }
+    }
+    close(jobPipe[1]);
+    close(outputPipe[0]);
+
+    char portString[12];
+    snprintf(portString, sizeof(portString), "%i", device->port);
+    setenv(PORT_ENV_VARIABLE, portString, 1);
+    signal(SIGINT, SIG_IGN); // The daemon stops us by closing the pipe
+    signal(SIGTERM, SIG_DFL);
+    int nullFile = open("/dev/null", O_RDONLY);
+    if (nullFile >= 0) {
+      dup2(nullFile, 0); // Anything that asks first is aborted
+      close(nullFile);
+    }
+    dup2(outputPipe[1], 1);
+    dup2(outputPipe[1], 2);
+    close(outputPipe[1]);
+
+    worker_run(jobPipe[0]);
+    exit(0);
+  }
+
+  close(jobPipe[0]);
+  close(outputPipe[1]);
+  device->jobFd = jobPipe[1];
+  device->outputFd = outputPipe[0];
+  device->outputLength = 0;
+  device->progressHashes = 0;
+  device->runningJob = 0;
+  device->state = DEVICE_STARTING;
+  return 1;
+}
+
+// Finish the job a device was running
+static void daemon_job_done(struct daemon_device *device, const char *result) {
+  struct daemon_job *job = daemon_find_job(device->runningJob);
+  device->runningJob = 0;
+  if (job == NULL) {
+    return;
+  }
+  uint32_t elapsed = daemon_ms() - job->started;
+  if (strcmp(result, "ok") == 0 && job->segmented == 0) {
+    daemon_measure(job, device->port, elapsed);
+  }
+  daemon_send(job->client, "done %i %u %s\n", job->id, (unsigned int)elapsed,
+              result);
+  printf("Job %i (%s) on port %i: %s after %ums\n", job->id, job->command,
+         device->port, result, (unsigned int)elapsed);
+  job->state = JOB_FREE;
+}
+
+// The device was unplugged in the middle of a job, or the cart needs powering
+// off before it can carry on, put the job back at the front of its queue to
+// run again when the device is back
+static void daemon_job_again(struct daemon_device *device, uint8_t powerCycle) {
+  struct daemon_job *job = daemon_find_job(device->runningJob);
+  if (job == NULL || job->attempts >= DAEMON_MAX_ATTEMPTS) {
+    daemon_job_done(device, "device unplugged");
+    return;
+  }
+  device->runningJob = 0;
+  if (powerCycle == 1) {
+    job->attempts--; // Each segment is a run of its own
+    job->segmented = 1;
+    daemon_send(job->client,
+                "output %i unplug port %i and plug it back in to carry on\n",
+                job->id, device->port);
+  } else {
+    daemon_send(job->client,
+                "output %i port %i unplugged, the job runs again when it's "
+                "back\n",
+                job->id, device->port);
+  }
+  printf("Job %i (%s) on port %i: waiting for the device\n", job->id,
+         job->command, device->port);
+  job->state = JOB_QUEUED;
+  job->plan.port = device->port; // The cart is in that one
+  job->plan.order = 0;
+  job->writeStarted = 0;
+}
+
+// The worker has exited, fail its job and start it again later, or when the
+// device is back if it was unplugged
+static void daemon_worker_ended(struct daemon_device *device) {
+  close(device->jobFd);
+  close(device->outputFd);
+  int status;
+  waitpid(device->process, &status, 0);
+  device->state = DEVICE_DOWN;
+  if (device->unplugged == 1 || hotplug_present(device->port) == 0) {
+    device->unplugged = 1;
+    device->powerCycle = 0;
+    if (device->runningJob != 0) {
+      daemon_job_again(device, 0);
+    }
+    printf("Port %i: unplugged, waiting for it\n", device->port);
+    return;
+  }
+  if (device->runningJob != 0) {
+    daemon_job_done(device, "device stopped answering");
+  }
+  device->restartAt = daemon_ms() + DAEMON_RESTART_MS;
+  printf("Port %i: worker ended, starting it again in %is\n", device->port,
+         DAEMON_RESTART_MS / 1000);
+}
+
+// A whole line from a worker, either for the daemon or the job's output
+static void daemon_worker_line(struct daemon_device *device, char *line) {
+  line[strcspn(line, "\r")] = '\0';
+  if (strncmp(line, DAEMON_MARKER, strlen(DAEMON_MARKER)) == 0) {
+    char *message = line + strlen(DAEMON_MARKER);
+    if (strcmp(message, "ready") == 0) {
+      device->state = DEVICE_READY;
+      printf("Port %i: ready\n", device->port);
+    } else if (strncmp(message, "down ", 5) == 0) {
+      printf("Port %i: %s\n", device->port, message + 5);
+    } else if (strcmp(message, "done power cycle") == 0) {
+      daemon_job_again(device, 1);
+      device->powerCycle = 1;
+      device->state = DEVICE_READY;
+    } else if (strncmp(message, "done ", 5) == 0) {
+      daemon_job_done(device, message + 5);
+      device->state = DEVICE_READY;
+    }
+    return;
+  }
+
+  struct daemon_job *job = daemon_find_job(device->runningJob);
+  if (job == NULL) {
+    return;
+  }
+  // Erasing (for the cart types that erase it all first) is done by now
+  if (strncmp(line, "Writing to ROM", 14) == 0) {
+    job->writeStarted = daemon_ms();
+  }
+  unsigned int times[4];
+  if (sscanf(line, "Identify %ums, flash %ums, verify %ums, save %ums",
+             &times[0], &times[1], &times[2], &times[3]) == 4) {
+    for (uint8_t x = 0; x < 4; x++) {
+      job->times[x] = times[x];
+    }
+  }
+  if (line[0] != '\0' && strspn(line, "[#]") < strlen(line)) {
+    daemon_send(job->client, "output %i %s\n", job->id, line);
+  }
+}
+
+// Read what a worker printed, counting the #s of progress bars as they come
+static void daemon_worker_output(struct daemon_device *device) {
+  char buffer[512];
+  ssize_t length = read(device->outputFd, buffer, sizeof(buffer));
+  if (length <= 0) {
+    daemon_worker_ended(device);
+    return;
+  }
+
+  struct daemon_job *job = daemon_find_job(device->runningJob);
+  for (ssize_t x = 0; x < length; x++) {
+    char c = buffer[x];
+    if (c == '\n') {
+      device->output[device->outputLength] = '\0';
+      daemon_worker_line(device, device->output);
+      device->outputLength = 0;
+      device->progressHashes = 0;
+      job = daemon_find_job(device->runningJob);
+      continue;
+    }
+    if (c == '#' && device->outputLength > 0 && device->output[0] == '[' &&
+        job != NULL) {
+      device->progressHashes++;
+      uint8_t percent = device->progressHashes * 100 / 64;
+      daemon_send(job->client, "progress %i %i\n", job->id,
+                  (percent > 100) ? 100 : percent);
+    }
+    if (device->outputLength < DAEMON_LINE - 1) {
+      device->output[device->outputLength++] = c;
+    }
+  }
+}
+
+// A port came or went: stop the workers whose device has gone (they'd only
+// find out once it stops answering) and start the ones that are back
+static void daemon_hotplug(uint32_t now) {
+  for (uint8_t d = 0; d < deviceCount; d++) {
+    struct daemon_device *device = &devices[d];
+    uint8_t present = hotplug_present(device->port);
+    if (device->state != DEVICE_DOWN && present == 0 &&
+        device->unplugged == 0) {
+      device->unplugged = 1;
+      kill(device->process, SIGTERM); // Its output ending takes it down
+    } else if (device->state == DEVICE_DOWN && device->unplugged == 1 &&
+               present == 1) {
+      device->unplugged = 0;
+      device->restartAt = now + HOTPLUG_SETTLE_MS;
+      printf("Port %i: plugged back in\n", device->port);
+    }
+  }
+}
+
+// Plan again and give each idle device the first job planned for it
+static void daemon_dispatch(void) {
+  uint8_t idle = 0;
+  for (uint8_t d = 0; d < deviceCount; d++) {
+    if (devices[d].state == DEVICE_READY && devices[d].runningJob == 0 &&
+        devices[d].powerCycle == 0) {
+      idle = 1;
+    }
+  }
+  if (idle == 0) {
+    return; // Not worth planning on every bit of output
+  }
+  daemon_plan();
+  for (uint8_t d = 0; d < deviceCount; d++) {
+    if (devices[d].state != DEVICE_READY || devices[d].runningJob != 0 ||
+        devices[d].powerCycle == 1) {
+      continue;
+    }
+    struct daemon_job *next = NULL;
+    for (int x = 0; x < DAEMON_MAX_JOBS; x++) {
+      if (jobs[x].state == JOB_QUEUED &&
+          jobs[x].plan.plannedPort == devices[d].port &&
+          (next == NULL || jobs[x].plan.startMs < next->plan.startMs ||
+           (jobs[x].plan.startMs == next->plan.startMs &&
+            jobs[x].id < next->id))) {
+        next = &jobs[x];
+      }
+    }
+    if (next == NULL) {
+      continue;
+    }
+
+    char line[DAEMON_LINE + 32];
+    int length = snprintf(line, sizeof(line), "%s %s\n", next->command,
+                          next->arguments);
+    if (write(devices[d].jobFd, line, length) != length) {
+      continue; // The worker has gone, its output pipe will say so
+    }
+    next->state = JOB_RUNNING;
+    next->device = d;
+    next->estimateMs = schedule_estimate(devices[d].port, &next->plan.work);
+    next->started = daemon_ms();
+    next->attempts++;
+    devices[d].runningJob = next->id;
+    devices[d].state = DEVICE_BUSY;
+  }
+}
+
+// Handle one request line from a client
+static void daemon_request(int clientIndex, char *line) {
+  line[strcspn(line, "\r")] = '\0';
+  char *command = strtok(line, " ");
+  if (command == NULL) {
+    return;
+  }
+
+  if (strcmp(command, "devices") == 0) {
+    daemon_plan();
+    for (uint8_t d = 0; d < deviceCount; d++) {
+      daemon_send(clientIndex, "device %i %s %i %u\n", devices[d].port,
+                  (devices[d].unplugged == 1)    ? "unplugged"
+                  : (devices[d].powerCycle == 1) ? "power-cycle"
+                                                 : deviceStates[devices[d].state],
+                  daemon_queued_jobs(d),
+                  (unsigned int)devices[d].freeMs);
+    }
+    daemon_send(clientIndex, "ok\n");
+    return;
+  }
+
+  if (strcmp(command, "jobs") == 0) {
+    daemon_plan();
+    uint32_t now = daemon_ms();
+    for (int x = 0; x < DAEMON_MAX_JOBS; x++) {
+      struct daemon_job *job = &jobs[x];
+      if (job->state == JOB_QUEUED) {
+        daemon_send(clientIndex, "job %i %s queued %i %u %u\n", job->id,
+                    job->command, job->plan.plannedPort,
+                    (unsigned int)(job->plan.finishMs - job->plan.startMs),
+                    (unsigned int)job->plan.finishMs);
+      } else if (job->state == JOB_RUNNING) {
+        uint32_t elapsed = now - job->started;
+        daemon_send(clientIndex, "job %i %s running %i %u %u\n", job->id,
+                    job->command, devices[job->device].port,
+                    (unsigned int)job->estimateMs,
+                    (unsigned int)((elapsed < job->estimateMs)
+                                       ? job->estimateMs - elapsed
+                                       : 0));
+      }
+    }
+    daemon_send(clientIndex, "ok\n");
+    return;
+  }
+
+  uint8_t isJob = 0;
+  for (uint8_t x = 0; x < sizeof(jobCommands) / sizeof(jobCommands[0]); x++) {
+    if (strcmp(command, jobCommands[x]) == 0) {
+      isJob = 1;
+    }
+  }
+  if (isJob == 0) {
+    daemon_send(clientIndex, "error unknown request %s\n", command);
+    return;
+  }
+
+  char *port = strtok(NULL, " ");
+  char *arguments = strtok(NULL, "");
+  if (arguments == NULL) {
+    arguments = "";
+  }
+  if (port == NULL) {
+    daemon_send(clientIndex, "error %s needs a port or any\n", command);
+    return;
+  }
+  struct batch_job flashJob;
+  if (strcmp(command, "identify") != 0 && arguments[0] == '\0') {
+    daemon_send(clientIndex, "error %s needs a file\n", command);
+    return;
+  }
+  if (strcmp(command, "flash") == 0 &&
+      batch_parse_job(arguments, &flashJob) != 1) {
+    daemon_send(clientIndex,
+                "error flash takes <ROMFile>,<cart type>,<SAVFile>,<verify> "
+                "with verify none, quick or full\n");
+    return;
+  }
+
+  // Jobs for any device are only given one when it's their turn
+  int portNumber = 0;
+  if (strcmp(port, "any") != 0) {
+    for (uint8_t d = 0; d < deviceCount; d++) {
+      if (devices[d].port == atoi(port)) {
+        portNumber = devices[d].port;
+      }
+    }
+    if (portNumber == 0) {
+      daemon_send(clientIndex, "error no device on port %s\n", port);
+      return;
+    }
+  }
+
+  struct daemon_job *job = NULL;
+  for (int x = 0; x < DAEMON_MAX_JOBS && job == NULL; x++) {
+    if (jobs[x].state == JOB_FREE) {
+      job = &jobs[x];
+    }
+  }
+  if (job == NULL) {
+    daemon_send(clientIndex, "error queue full\n");
+    return;
+  }
+  memset(job, 0, sizeof(struct daemon_job));
+  job->id = nextJobId++;
+  job->state = JOB_QUEUED;
+  job->client = clientIndex;
+  strncpy(job->command, command, sizeof(job->command) - 1);
+  strncpy(job->arguments, arguments, sizeof(job->arguments) - 1);
+  job->plan.port = portNumber;
+  job->plan.order = job->id;
+  daemon_job_work(job);
+  daemon_plan();
+  daemon_send(clientIndex, "queued %i %i %u\n", job->id, job->plan.plannedPort,
+              (unsigned int)job->plan.finishMs);
+}
+
+// Read from a client, handling each whole line
+static void daemon_client_input(int clientIndex) {
+  struct daemon_client *client = &clients[clientIndex];
+  char buffer[512];
+  ssize_t length = read(client->fd, buffer, sizeof(buffer));
+  if (length < 0 && (errno == EAGAIN || errno == EINTR)) {
+    return;
+  }
+  if (length <= 0) {
+    daemon_client_close(clientIndex);
+    return;
+  }
+
+  // Stop if it's dropped for not reading the answers
+  for (ssize_t x = 0; x < length && client->fd >= 0; x++) {
+    if (buffer[x] == '\n') {
+      client->input[client->inputLength] = '\0';
+      daemon_request(clientIndex, client->input);
+      client->inputLength = 0;
+    } else if (client->inputLength < DAEMON_LINE - 1) {
+      client->input[client->inputLength++] = buffer[x];
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+
+  printf("Cart Daemon by DEFENSE MECHANISM\n");
+  printf("based on GBxCart RW v1.24 by insideGadgets\n");
+  printf("################################\n");
+
+  if (argc < 3) {
+    printf("Usage: cart-daemon <socket> <port,port,...>\n");
+    return 1;
+  }
+
+  // Ports
+  char portList[256];
+  strncpy(portList, argv[2], sizeof(portList) - 1);
+  portList[sizeof(portList) - 1] = '\0';
+  for (char *token = strtok(portList, ","); token != NULL;
+       token = strtok(NULL, ",")) {
+    int port = atoi(token);
+    if (port <= 0 || deviceCount >= DAEMON_MAX_DEVICES) {
+      printf("Bad port list %s (up to %i ports, numbered as in config.ini)\n",
+             argv[2], DAEMON_MAX_DEVICES);
+      return 1;
+    }
+    memset(&devices[deviceCount], 0, sizeof(struct daemon_device));
+    devices[deviceCount].port = port;
+    devices[deviceCount].state = DEVICE_DOWN;
+    deviceCount++;
+  }
+  for (int x = 0; x < DAEMON_MAX_CLIENTS; x++) {
+    clients[x].fd = -1;
+  }
+
+  // Socket
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (strlen(argv[1]) >= sizeof(address.sun_path)) {
+    printf("Socket path %s is too long\n", argv[1]);
+    return 1;
+  }
+  strncpy(address.sun_path, argv[1], sizeof(address.sun_path) - 1);
+  listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(argv[1]); // Left over from the last run
+  if (listenFd < 0 ||
+      bind(listenFd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+      listen(listenFd, DAEMON_MAX_CLIENTS) != 0) {
+    printf("Couldn't listen on %s: %s\n", argv[1], strerror(errno));
+    return 1;
+  }
+
+  setvbuf(stdout, NULL, _IOLBF, 0); // For when the log goes to a file
+  schedule_load_rates();
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, daemon_stop);
+  signal(SIGTERM, daemon_stop);
+  hotplugFd = hotplug_watch();
+
+  for (uint8_t d = 0; d < deviceCount; d++) {
+    if (daemon_start_worker(d) == 0) {
+      printf("Port %i: couldn't start a worker\n", devices[d].port);
+      devices[d].restartAt = daemon_ms() + DAEMON_RESTART_MS;
+    }
+  }
+  printf("Listening on %s\n", argv[1]);
+
+  while (stopRequested == 0) {
+    daemon_dispatch();
+
+    struct pollfd fds[2 + DAEMON_MAX_CLIENTS + DAEMON_MAX_DEVICES];
+    int clientFds[DAEMON_MAX_CLIENTS];
+    int deviceFds[DAEMON_MAX_DEVICES];
+    nfds_t fdCount = 0;
+    fds[fdCount].fd = listenFd;
+    fds[fdCount++].events = POLLIN;
+    for (int x = 0; x < DAEMON_MAX_CLIENTS; x++) {
+      clientFds[x] = -1;
+      if (clients[x].fd >= 0) {
+        clientFds[x] = fdCount;
+        fds[fdCount].fd = clients[x].fd;
+        fds[fdCount++].events =
+            (clients[x].outputLength > 0) ? (POLLIN | POLLOUT) : POLLIN;
+      }
+    }
+
+    // Wake up for ports coming and going (looking for them every
+    // HOTPLUG_POLL_MS without a way to watch) and the next worker to restart
+    int timeout = -1;
+    int hotplugIndex = -1;
+    if (hotplugFd >= 0) {
+      hotplugIndex = fdCount;
+      fds[fdCount].fd = hotplugFd;
+      fds[fdCount++].events = POLLIN;
+    } else {
+      timeout = HOTPLUG_POLL_MS;
+    }
+    uint32_t now = daemon_ms();
+    for (uint8_t d = 0; d < deviceCount; d++) {
+      deviceFds[d] = -1;
+      if (devices[d].state != DEVICE_DOWN) {
+        deviceFds[d] = fdCount;
+        fds[fdCount].fd = devices[d].outputFd;
+        fds[fdCount++].events = POLLIN;
+      } else if (devices[d].unplugged == 0) {
+        int wait = (int32_t)(devices[d].restartAt - now);
+        wait = (wait < 0) ? 0 : wait;
+        if (timeout < 0 || wait < timeout) {
+          timeout = wait;
+        }
+      }
+    }
+
+    if (poll(fds, fdCount, timeout) < 0) {
+      continue; // Interrupted, check for stopping
+    }
+
+    now = daemon_ms();
+    if (hotplugIndex < 0 || fds[hotplugIndex].revents != 0) {
+      hotplug_drain(hotplugFd);
+      daemon_hotplug(now);
+    }
+    for (uint8_t d = 0; d < deviceCount; d++) {
+      if (deviceFds[d] >= 0 && fds[deviceFds[d]].revents != 0) {
+        daemon_worker_output(&devices[d]);
+      } else if (devices[d].state == DEVICE_DOWN && deviceFds[d] < 0 &&
+                 devices[d].unplugged == 0 &&
+                 (int32_t)(devices[d].restartAt - now) <= 0) {
+        if (daemon_start_worker(d) == 0) {
+          devices[d].restartAt = now + DAEMON_RESTART_MS;
+        }
+      }
+    }
+    for (int x = 0; x < DAEMON_MAX_CLIENTS; x++) {
+      // Dropped since the poll if it fell behind on the workers' output
+      if (clientFds[x] < 0 || clients[x].fd < 0) {
+        continue;
+      }
+      if (fds[clientFds[x]].revents & POLLOUT) {
+        daemon_client_flush(x);
+      }
+      if (clients[x].fd >= 0 && (fds[clientFds[x]].revents & ~POLLOUT) != 0) {
+        daemon_client_input(x);
+      }
+    }
+    if (fds[0].revents & POLLIN) {
+      int clientFd = accept(listenFd, NULL, NULL);
+      int clientIndex = -1;
+      for (int x = 0; x < DAEMON_MAX_CLIENTS && clientIndex < 0; x++) {
+        if (clients[x].fd < 0) {
+          clientIndex = x;
+        }
+      }
+      if (clientFd >= 0 && clientIndex < 0) {
+        close(clientFd); // Too many clients
+      } else if (clientFd >= 0) {
+        fcntl(clientFd, F_SETFL, fcntl(clientFd, F_GETFL) | O_NONBLOCK);
+        clients[clientIndex].fd = clientFd;
+        clients[clientIndex].inputLength = 0;
+        clients[clientIndex].outputLength = 0;
+      }
+    }
+  }
+
+  // Closing the job pipes lets each worker finish its job and exit
+  printf("Stopping\n");
+  close(listenFd);
+  unlink(argv[1]);
+  for (uint8_t d = 0; d < deviceCount; d++) {
+    if (devices[d].state != DEVICE_DOWN) {
+      close(devices[d].jobFd);
+    }
+  }
+  for (uint8_t d = 0; d < deviceCount; d++) {
+    if (devices[d].state != DEVICE_DOWN) {
+      int status;
+      waitpid(devices[d].process, &status, 0);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,324 @@
+/*
+ LSDj Cart Fingerprint by DEFENSE MECHANISM
+ based on GBxCart RW - Console Interface by insideGadgets
+
+ Works out which LSDj build (and kit set) a cart holds without dumping the
+ whole ROM. A handful of 64 byte windows are read, hashed and matched against
+ the builds listed in lsdj-builds.ini. More windows are only read when more
+ than one build matches.
+
+ Run with a ROM file to add it to lsdj-builds.ini:
+   fingerprint-cart <ROMFile> [name]
+
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#define GBX_LEGACY_GLOBALS // Uses currAddr, romSize and the rest
+#include "setup.h" // See defines, variables, constants, functions here
+
+#define MAX_WINDOWS 128
+#define MAX_BUILDS 256
+
+struct sample_window {
+  uint16_t bank;
+  uint16_t address;
+};
+
+struct build_entry {
+  char name[64];
+  uint16_t bankCount;
+  uint32_t primaryHash;
+  uint32_t confirmHash;
+};
+
+// Work out the windows to sample for this image family, primary windows first.
+// LSDj keeps its program in the low banks and one kit per bank above that, so
+// the program banks and the start of every 4th kit bank (where the kit name
+// is) make up the primary set and the other kit banks are kept for confirming.
+// Anything else gets windows spread evenly across the ROM.
+uint8_t build_sample_plan(struct sample_window *plan, uint16_t banks,
+                          uint8_t *primaryCount) {
+  uint8_t count = 0;
+
+  if (strncmp(gameTitle, "LSDj", 4) == 0) {
+    for (uint16_t bank = 0; bank < 8 && bank < banks; bank++) {
+      plan[count].bank = bank;
+      plan[count].address = (bank == 0) ? 0x0150 : 0x4000;
+      count++;
+    }
+    for (uint16_t bank = 8; bank < banks && count < MAX_WINDOWS; bank += 4) {
+      plan[count].bank = bank;
+      plan[count].address = 0x4040;
+      count++;
+    }
+    *primaryCount = count;
+
+    for (uint16_t bank = 8; bank < banks && count < MAX_WINDOWS; bank++) {
+      if (bank % 4 != 0) {
+        plan[count].bank = bank;
+        plan[count].address = 0x4040;
+        count++;
+      }
+    }
+    for (uint16_t bank = 1; bank < 8 && bank < banks && count < MAX_WINDOWS;
+         bank++) {
+      plan[count].bank = bank;
+      plan[count].address = 0x6000;
+      count++;
+    }
+  } else {
+    for (uint8_t x = 0; x < 8; x++) {
+      plan[count].bank = (x * banks) / 8;
+      plan[count].address = (plan[count].bank == 0) ? 0x0150 : 0x5000;
+      count++;
+    }
+    *primaryCount = count;
+
+    for (uint8_t x = 0; x < 16; x++) {
+      plan[count].bank = (x * banks) / 16;
+      plan[count].address = (plan[count].bank == 0) ? 0x2000 : 0x7000;
+      count++;
+    }
+  }
+
+  return count;
+}
+
+// Hash the windows from first to last (not included) read from the cart
+uint32_t hash_cart_windows(struct sample_window *plan, uint8_t first,
+                           uint8_t last) {
+  uint32_t hash = 0;
+  for (uint8_t x = first; x < last; x++) {
+    if (plan[x].bank != 0) {
+      gb_set_rom_bank(plan[x].bank);
+    }
+    read_rom_sample(GB_MODE, plan[x].address);
+    hash = crc32_update(hash, readBuffer, 64);
+  }
+  return hash;
+}
+
+// Hash the windows from first to last (not included) taken from a ROM image
+uint32_t hash_file_windows(struct sample_window *plan, uint8_t first,
+                           uint8_t last, uint8_t *romData, long romLength) {
+  uint32_t hash = 0;
+  for (uint8_t x = first; x < last; x++) {
+    long offset = plan[x].address;
+    if (plan[x].bank != 0) {
+      offset = (plan[x].bank * 0x4000L) + (plan[x].address - 0x4000);
+    }
+
+    uint8_t window[64];
+    memset(window, 0xFF, 64);
+    if (offset + 64 <= romLength) {
+      memcpy(window, &romData[offset], 64);
+    }
+    hash = crc32_update(hash, window, 64);
+  }
+  return hash;
+}
+
+static void builds_index_path(char *indexFilePath) {
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__)
+  strncpy(indexFilePath, "lsdj-builds.ini", 16);
+#else
+  strncpy(indexFilePath, getenv("USERPROFILE"), 200);
+  strncat(indexFilePath, "\\gbxcart-lsdj-builds.ini", 25);
+#endif
+}
+
+// Load lsdj-builds.ini, one "name,banks,primary hash,confirm hash" per line
+uint16_t load_builds_index(struct build_entry *builds) {
+  char indexFilePath[253];
+  builds_index_path(indexFilePath);
+
+  uint16_t buildCount = 0;
+  FILE *indexFile = fopen(indexFilePath, "rt");
+  if (indexFile != NULL) {
+    char line[256];
+    while (fgets(line, sizeof(line), indexFile) != NULL &&
+           buildCount < MAX_BUILDS) {
+      unsigned int banks = 0;
+      unsigned int primaryHash = 0;
+      unsigned int confirmHash = 0;
+      if (sscanf(line, "%63[^,],%u,%x,%x", builds[buildCount].name, &banks,
+                 &primaryHash, &confirmHash) == 4) {
+        builds[buildCount].bankCount = banks;
+        builds[buildCount].primaryHash = primaryHash;
+        builds[buildCount].confirmHash = confirmHash;
+        buildCount++;
+      }
+    }
+    fclose(indexFile);
+  }
+
+  return buildCount;
+}
+
+// Add a ROM image to the builds index
+int add_build(char *romPath, char *buildName) {
+  FILE *romFile = fopen(romPath, "rb");
+  if (romFile == NULL) {
+    printf("\n%s \nFile not found\n", romPath);
+    return 1;
+  }
+  fseek(romFile, 0, SEEK_END);
+  long romLength = ftell(romFile);
+  fseek(romFile, 0, SEEK_SET);
+
+  if (romLength < 0x8000) {
+    fclose(romFile);
+    printf("%s is too small to be a Gameboy ROM\n", romPath);
+    return 1;
+  }
+
+  uint8_t *romData = (uint8_t *)malloc(romLength);
+  if (romData == NULL ||
+      fread(romData, 1, romLength, romFile) != (size_t)romLength) {
+    fclose(romFile);
+    free(romData);
+    printf("Couldn't read %s\n", romPath);
+    return 1;
+  }
+  fclose(romFile);
+
+  // Same bank count and family as read_gb_header() would give for this image
+  strncpy(gameTitle, (char *)&romData[0x0134], 16);
+  gameTitle[16] = '\0';
+  romBanks = 2;
+  if (romData[0x0148] >= 1) {
+    romBanks = 2 << romData[0x0148];
+  }
+
+  struct sample_window plan[MAX_WINDOWS];
+  uint8_t primaryCount = 0;
+  uint8_t windowCount = build_sample_plan(plan, romBanks, &primaryCount);
+  uint32_t primaryHash =
+      hash_file_windows(plan, 0, primaryCount, romData, romLength);
+  uint32_t confirmHash =
+      hash_file_windows(plan, primaryCount, windowCount, romData, romLength);
+  free(romData);
+
+  char indexFilePath[253];
+  builds_index_path(indexFilePath);
+  FILE *indexFile = fopen(indexFilePath, "at");
+  if (indexFile == NULL) {
+    printf("Couldn't open %s\n", indexFilePath);
+    return 1;
+  }
+  fprintf(indexFile, "%s,%u,%08X,%08X\n", buildName, romBanks,
+          (unsigned int)primaryHash, (unsigned int)confirmHash);
+  fclose(indexFile);
+
+  printf("Added %s (%u banks, %i windows) to %s\n", buildName, romBanks,
+         windowCount, indexFilePath);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+
+  printf("LSDj Cart Fingerprint by DEFENSE MECHANISM\n");
+  printf("based on GBxCart RW v1.24 by insideGadgets\n");
+  printf("################################\n");
+
+  if (argc >= 2) {
+    char *buildName = argv[1];
+    if (argc >= 3) {
+      buildName = argv[2];
+    }
+    return add_build(argv[1], buildName);
+  }
+
+  struct build_entry builds[MAX_BUILDS];
+  uint16_t buildCount = load_builds_index(builds);
+  if (buildCount == 0) {
+    printf("No builds in lsdj-builds.ini, add some with: fingerprint-cart "
+           "<ROMFile> [name]\n");
+    read_one_letter();
+    return 1;
+  }
+
+  read_config();
+
+  // Open COM port
+  if (com_test_port() == 0) {
+    printf("Device not connected and couldn't be auto detected\n");
+    read_one_letter();
+    return 1;
+  }
+  printf("Connected on COM port: %i\n", cport_nr + 1);
+
+  // Get firmware/PCB version and cartridge mode, set the voltage and read the
+  // header in one go
+  struct cart_identity cart;
+  if (cart_identify(&cart, 0) == 0) {
+    printf("Device didn't respond, please re-seat the cartridge and try "
+           "again\n");
+    read_one_letter();
+    return 1;
+  }
+  if (cart.mode != GB_MODE) {
+    printf("Fingerprinting is only supported for Gameboy carts\n");
+    read_one_letter();
+    return 1;
+  }
+
+  printf("\n--- Fingerprint cart ---\n");
+
+  struct sample_window plan[MAX_WINDOWS];
+  uint8_t primaryCount = 0;
+  uint8_t windowCount = build_sample_plan(plan, romBanks, &primaryCount);
+
+  uint32_t primaryHash = hash_cart_windows(plan, 0, primaryCount);
+  printf("Primary hash: %08X (%i windows)\n", (unsigned int)primaryHash,
+         primaryCount);
+
+  uint16_t matches[MAX_BUILDS];
+  uint16_t matchCount = 0;
+  for (uint16_t x = 0; x < buildCount; x++) {
+    if (builds[x].bankCount == romBanks &&
+        builds[x].primaryHash == primaryHash) {
+      matches[matchCount] = x;
+      matchCount++;
+    }
+  }
+
+  // Only read the confirm windows if the primary ones can't tell builds apart
+  if (matchCount > 1) {
+    uint32_t confirmHash = hash_cart_windows(plan, primaryCount, windowCount);
+    printf("Confirm hash: %08X (%i windows)\n", (unsigned int)confirmHash,
+           windowCount - primaryCount);
+
+    uint16_t confirmedCount = 0;
+    for (uint16_t x = 0; x < matchCount; x++) {
+      if (builds[matches[x]].confirmHash == confirmHash) {
+        matches[confirmedCount] = matches[x];
+        confirmedCount++;
+      }
+    }
+    matchCount = confirmedCount;
+  }
+
+  gb_set_rom_bank(1); // Leave bank 1 mapped as after a reset
+
+  if (matchCount == 0) {
+    printf("Build: unknown\n");
+  } else {
+    for (uint16_t x = 0; x < matchCount; x++) {
+      printf("Build: %s\n", builds[matches[x]].name);
+    }
+  }
+
+  return 0;
+}
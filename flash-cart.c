@@ -22,3672 +22,4309 @@
 #include <unistd.h>
 #endif
 
+#include "batch.h"
+#include "image.h"
+#define GBX_LEGACY_GLOBALS // Uses currAddr, romSize and the rest
 #include "setup.h" // See defines, variables, constants, functions here
 
-int main(int argc, char **argv) {
+// The image being written, mapped from the ROM file, and where in it the next
+// write comes from
+const struct image *romImage = NULL;
+static uint32_t romPosition = 0;
+
+// Copy the next length bytes of the image to buffer, past its end they're
+// 0xFF as the erase has left them
+static void rom_read(uint8_t *buffer, uint32_t length) {
+  uint32_t available = 0;
+  if (romPosition < romImage->length) {
+    available = romImage->length - romPosition;
+    if (available > length) {
+      available = length;
+    }
+    memcpy(buffer, &romImage->data[romPosition], available);
+  }
+  memset(&buffer[available], 0xFF, length - available);
+  romPosition += length;
+}
 
-  printf("GBxCart RW Flasher v1.37 by insideGadgets\n");
-  printf("#########################################\n");
+// Send the next count bytes of the image with the write command
+static void rom_write_bytes(uint8_t command, int count) {
+  rom_read(writeBuffer, count);
+  com_write_bytes_from_file(command, NULL, count);
+}
 
-  if (argc >= 2) {
-    char filenameOnly[100];
-    char filename[254];
-    strncpy(filename, argv[1], 253);
-    char filetype[4];
+// Move past the next length bytes of the image if they're all 0xFF, as the
+// erase has left them that way already. Returns 1 if they were skipped, the
+// address has to be set again before the next write.
+static uint8_t skip_blank_block(uint32_t length) {
+  if (image_blank(romImage, romPosition, length) == 0) {
+    return 0;
+  }
+  romPosition += length;
+  return 1;
+}
 
-#ifdef _WIN32
-    char *token = strtok(filename, "\\");
-    while (token != NULL) {
-      strncpy(filenameOnly, token, 99);
-      token = strtok(NULL, "\\");
-    }
-#else
-    char *token = strtok(filename, "/");
-    while (token != NULL) {
-      strncpy(filenameOnly, token, 99);
-      token = strtok(NULL, "/");
-    }
-#endif
-    // check if filename ends with '.gb'
-    token = strtok(filenameOnly, ".");
-    while (token != NULL) {
-      strncpy(filetype, token, 4);
-      token = strtok(NULL, ".");
+// Which segments of the image have been written since the chip was erased, as
+// a mask, from flash-journal.ini. It has a line for each image being written:
+//
+//   <image hash> <erased> <done segments>
+static uint8_t segment_journal_read(uint64_t hash, uint8_t *erased) {
+  *erased = 0;
+  FILE *journalFile = fopen(SEGMENT_JOURNAL_FILE, "rt");
+  if (journalFile == NULL) {
+    return 0;
+  }
+  unsigned long long lineHash;
+  unsigned int lineErased;
+  unsigned int lineDone;
+  uint8_t doneMask = 0;
+  while (fscanf(journalFile, "%llx %u %u", &lineHash, &lineErased,
+                &lineDone) == 3) {
+    if (lineHash == hash) {
+      *erased = (uint8_t)lineErased;
+      doneMask = (uint8_t)lineDone;
     }
-    if (strncmp(filetype, "gb", 2) == 0) {
-      read_config();
-      // Check arguments
+  }
+  fclose(journalFile);
+  return doneMask;
+}
 
-      // Open COM port
-      if (com_test_port() == 0) {
-        printf(
-            "Device not connected and couldn't be auto detected. Please make "
-            "sure the COM port isn't open elsewhere. If you are using "
-            "Linux/Mac, make sure you use \"sudo\".\n");
-        read_one_letter();
-        return 1;
+// Keep the image's line in flash-journal.ini up to date, or drop it once the
+// image is all written
+static void segment_journal_write(uint64_t hash, uint8_t erased,
+                                  uint8_t doneMask, uint8_t finished) {
+  char lines[32][40];
+  uint8_t lineCount = 0;
+  FILE *journalFile = fopen(SEGMENT_JOURNAL_FILE, "rt");
+  if (journalFile != NULL) {
+    unsigned long long lineHash;
+    unsigned int lineErased;
+    unsigned int lineDone;
+    while (lineCount < 31 && fscanf(journalFile, "%llx %u %u", &lineHash,
+                                    &lineErased, &lineDone) == 3) {
+      if (lineHash != hash) {
+        snprintf(lines[lineCount++], sizeof(lines[0]), "%016llx %u %u",
+                 lineHash, lineErased, lineDone);
       }
-      printf("Connected on COM port: %i\n", cport_nr + 1);
-
-      // Break out of any existing functions on ATmega
-      set_mode('0');
-
-      // Get cartridge mode - Gameboy or Gameboy Advance
-      cartridgeMode = request_value(CART_MODE);
-
-      // Get firmware version
-      gbxcartFirmwareVersion = request_value(READ_FIRMWARE_VERSION);
+    }
+    fclose(journalFile);
+  }
+  if (finished == 0) {
+    snprintf(lines[lineCount++], sizeof(lines[0]), "%016llx %u %u",
+             (unsigned long long)hash, (unsigned int)erased,
+             (unsigned int)doneMask);
+  }
 
-      // Get PCB version
-      gbxcartPcbVersion = request_value(READ_PCB_VERSION);
-      xmas_wake_up();
+  if (lineCount == 0) {
+    remove(SEGMENT_JOURNAL_FILE);
+    return;
+  }
+  journalFile = fopen(SEGMENT_JOURNAL_FILE, "wt");
+  if (journalFile == NULL) {
+    return;
+  }
+  for (uint8_t x = 0; x < lineCount; x++) {
+    fprintf(journalFile, "%s\n", lines[x]);
+  }
+  fclose(journalFile);
+}
 
-      if (gbxcartPcbVersion == PCB_1_0) {
-        printf("\nPCB v1.0 is not supported for this function.");
-        read_one_letter();
-        return 1;
+// Read the first sector (banks 0 and 1) of the 8MB segment that's selected,
+// or of the first segment before one has been selected
+static void segment_read_start(uint8_t *sector) {
+  for (uint16_t bank = 0; bank < 2; bank++) {
+    uint16_t address = bank * 0x4000;
+    if (bank > 0) {
+      set_bank(0x2100, 1);
+      set_bank(0x3000, 0); // High bit
+    }
+    set_number(address, SET_START_ADDRESS);
+    set_mode(READ_ROM_RAM);
+    for (uint16_t x = 0; x < 0x4000; x += 64) {
+      com_read_block_checked(address + x, READ_ROM_RAM, 64);
+      memcpy(&sector[address + x], readBuffer, 64);
+      if (x + 64 < 0x4000) {
+        com_read_cont();
       }
+    }
+    com_read_stop();
+  }
+}
 
-      if (gbxcartFirmwareVersion <= 8) {
-        printf("Firmware R9 or higher is required for this functionality.\n");
-        read_one_letter();
-        return 1;
+// Compare the 8MB segment that's selected with the image from offset, a
+// sector at a time against the image's sector hashes. Returns 1 if it matches.
+static uint8_t segment_verifies(uint32_t offset, uint32_t length) {
+  uint8_t sector[IMAGE_SECTOR_SIZE];
+  uint16_t bankCount = (length + 0x3FFF) / 0x4000;
+  uint8_t matches = 1;
+
+  printf("\nChecking the cart against segment at 0x%06X\n",
+         (unsigned int)offset);
+  printf("[             25%%             50%%             75%%            "
+         "100%%]\n[");
+  for (uint16_t bank = 0; bank < bankCount && matches == 1; bank++) {
+    // Bank 0 stays at 0x0000, the rest are switched in at 0x4000
+    uint16_t address = 0x0000;
+    if (bank > 0) {
+      set_bank(0x2100, bank & 0xFF);
+      set_bank(0x3000, bank >> 8); // High bit
+      address = 0x4000;
+    }
+    set_number(address, SET_START_ADDRESS);
+    set_mode(READ_ROM_RAM);
+    uint8_t *bankData = &sector[(bank % 2) * 0x4000];
+    for (uint16_t x = 0; x < 0x4000; x += 64) {
+      com_read_block_checked(address + x, READ_ROM_RAM, 64);
+      memcpy(&bankData[x], readBuffer, 64);
+      if (x + 64 < 0x4000) {
+        com_read_cont();
       }
+    }
+    com_read_stop();
 
-      // Separate the file name
-      char filenameOnly[100];
-      char filename[254];
-      strncpy(filename, argv[1], 253);
-
-#ifdef _WIN32
-      char *token = strtok(filename, "\\");
-      while (token != NULL) {
-        strncpy(filenameOnly, token, 99);
-        token = strtok(NULL, "\\");
+    if (bank % 2 == 1 || bank == bankCount - 1) {
+      uint32_t sectorOffset = offset + (bank / 2) * IMAGE_SECTOR_SIZE;
+      uint32_t sectorLength = romImage->length - sectorOffset;
+      if (sectorLength > IMAGE_SECTOR_SIZE) {
+        sectorLength = IMAGE_SECTOR_SIZE;
       }
-#else
-      char *token = strtok(filename, "/");
-      while (token != NULL) {
-        strncpy(filenameOnly, token, 99);
-        token = strtok(NULL, "/");
+      if (hash64_update(HASH64_START, sector, sectorLength) !=
+          romImage->sectorHashes[sectorOffset / IMAGE_SECTOR_SIZE]) {
+        matches = 0;
       }
-#endif
+    }
+    print_progress_percent((uint32_t)(bank + 1) * 0x4000,
+                           (uint32_t)bankCount * 0x4000 / 64);
+  }
+  set_bank(0x2100, 1);
+  set_bank(0x3000, 0);
+  printf("]\n");
+  return matches;
+}
 
-      printf("\n--- Write ROM to Flash Cart ---\n");
-      printf("Cart selected: ");
+// Write the next 8MB segment of an image bigger than the 4x 8MB bank carts
+// can select at once. The bank select only takes once after powering on, so
+// each run (after a power cycle) does one segment, skipping it if the cart
+// already has it, and flash-journal.ini keeps which are done. Returns
+// FLASH_ROM_POWER_CYCLE while there are more to do and FLASH_ROM_VERIFIED
+// once they're all written.
+static int flash_next_segment(void) {
+  uint32_t fileSize = romImage->length;
+  uint8_t segmentCount = (fileSize + SEGMENT_SIZE - 1) / SEGMENT_SIZE;
+  uint8_t erased;
+  uint8_t doneMask = segment_journal_read(romImage->hash, &erased);
+  uint8_t segment = 0;
+  while (segment < segmentCount && (doneMask & (1 << segment)) != 0) {
+    segment++;
+  }
+  if (segment >= segmentCount) {
+    segment = 0;
+    doneMask = 0;
+    erased = 0;
+  }
 
-      uint32_t readBytes = 0;
-      uint16_t sector = 0;
-      long fileSize = 0;
+  // The journal is only for the cart the first segment was written to, which
+  // reads as the first segment until another is selected
+  uint8_t sector[IMAGE_SECTOR_SIZE];
+  if ((doneMask & 1) != 0) {
+    uint32_t sectorLength =
+        (fileSize < IMAGE_SECTOR_SIZE) ? fileSize : IMAGE_SECTOR_SIZE;
+    segment_read_start(sector);
+    if (hash64_update(HASH64_START, sector, sectorLength) !=
+        romImage->sectorHashes[0]) {
+      printf("\nThis isn't the cart in %s, starting over\n",
+             SEGMENT_JOURNAL_FILE);
+      segment = 0;
+      doneMask = 0;
+      erased = 0;
+    }
+  }
+  if (doneMask != 0) {
+    printf("\nCarrying on from segment %i of %i, delete %s to start over\n",
+           segment + 1, segmentCount, SEGMENT_JOURNAL_FILE);
+  }
+  uint32_t offset = (uint32_t)segment * SEGMENT_SIZE;
+  uint32_t length = fileSize - offset;
+  if (length > SEGMENT_SIZE) {
+    length = SEGMENT_SIZE;
+  }
 
-      // Grab file size
-      FILE *romFile = fopen(argv[1], "rb");
-      if (romFile != NULL) {
-        fseek(romFile, 0, SEEK_END);
-        fileSize = ftell(romFile);
-        fseek(romFile, 0, SEEK_SET);
-      } else {
-        printf("\n%s \nFile not found\n", argv[1]);
-        read_one_letter();
-        return 1;
-      }
+  // Select the segment's 8MB bank
+  gb_flash_write_address_byte(0x7000, 0x00);
+  gb_flash_write_address_byte(0x7001, 0x00);
+  gb_flash_write_address_byte(0x7002, 0x90 + segment);
+  delay_ms(1);
 
-      // Read flash config file and match to a cart type
-      if (argc == 2) {
-        read_config_flash();
-      } else if (argc == 3) {
-        flashCartType = atoi(argv[2]);
-      } else if (argc == 4) {
-        flashCartType = atoi(argv[2]);
-        mode5vOverride = atoi(argv[3]);
+  if (segment_verifies(offset, length) == 1) {
+    printf("The cart already has segment %i of %i\n", segment + 1,
+           segmentCount);
+  } else {
+    // A segment that isn't written yet should still be blank from the erase,
+    // if not it's another cart (or one written since) and needs erasing again
+    if (erased == 1) {
+      segment_read_start(sector);
+      for (uint32_t x = 0; x < IMAGE_SECTOR_SIZE && erased == 1; x++) {
+        if (sector[x] != 0xFF) {
+          printf("The cart has been written since it was erased\n");
+          erased = 0;
+        }
       }
+    }
 
-      // ****** GB Flash Carts ******
-      if (flashCartType >= 101) {
-        if (flashCartType == 101) {
-          printf("32 KByte AM29F010B Gameboy Flash Cart (Audio as WE)\n");
-        } else if (flashCartType == 102) {
-          printf("32 KByte AM29F010B Gameboy Flash Cart (WR as WE)\n");
-        } else if (flashCartType == 103) {
-          printf("32 KByte SST39SF010A / AT49F040 Gameboy Flash Cart (Audio as "
-                 "WE)\n");
-        } else if (flashCartType == 104) {
-          printf("32 KByte SST39SF010A / AT49F040 Gameboy Flash Cart (WR as "
-                 "WE)\n");
-        }
+    // The whole chip is erased, segments that were there have to be written
+    // again
+    if (erased == 0) {
+      printf("\nErasing Flash (may take 1 minute)");
+      xmas_chip_erase_animation();
+      gb_flash_write_address_byte(0xAAA, 0xA9);
+      gb_flash_write_address_byte(0x555, 0x56);
+      gb_flash_write_address_byte(0xAAA, 0x80);
+      gb_flash_write_address_byte(0xAAA, 0xA9);
+      gb_flash_write_address_byte(0x555, 0x56);
+      gb_flash_write_address_byte(0xAAA, 0x10);
+
+      // Wait for first byte to be 0xFF
+      wait_for_flash_chip_erase_ff(1);
+      erased = 1;
+      doneMask = 0;
+    }
 
-        currAddr = 0x0000;
-        endAddr = 0x7FFF;
+    romBanks = (length + 0x3FFF) / 0x4000;
+    if (romBanks < 2) {
+      romBanks = 2; // Bank 1 is written along with bank 0
+    }
+    xmas_setup((romBanks * 16384) / 28);
+
+    printf("\n\nWriting to ROM (Flash cart) segment %i of %i\n", segment + 1,
+           segmentCount);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    romPosition = offset;
+    uint32_t readBytes = 0;
+    uint8_t addressMoved = 0; // Blank blocks skipped since the last write
+    currAddr = 0x0000;
+    endAddr = 0x7FFF;
+    for (uint16_t bank = 1; bank < romBanks; bank++) {
+      if (bank > 1) {
+        currAddr = 0x4000;
+      }
 
-        // PCB v1.3 - Set 5V
-        if (gbxcartPcbVersion == PCB_1_3 || gbxcartPcbVersion == GBXMAS) {
-          set_mode(VOLTAGE_5V);
-          delay_ms(500);
-        }
+      // Set start address
+      set_number(currAddr, SET_START_ADDRESS);
+      delay_ms(5);
 
-        // Check file size
-        if (fileSize > (endAddr + 1)) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 32K\n",
-              argv[1]);
-          read_one_letter();
-          return 1;
+      while (currAddr < endAddr) {
+        if (currAddr == 0x4000) { // Switch banks here just before the next
+                                  // bank, not any time sooner
+          set_bank(0x2100, bank);
+          if (bank >= 256) {
+            set_bank(0x3000, 1); // High bit
+          } else {
+            set_bank(0x3000, 0); // High bit
+          }
         }
 
-        // Flash Setup
-        set_mode(GB_CART_MODE); // Gameboy mode
-        if (flashCartType == 101 || flashCartType == 103) {
-          gb_flash_pin_setup(WE_AS_AUDIO_PIN); // Audio pin
-        } else {
-          gb_flash_pin_setup(WE_AS_WR_PIN); // WR pin
-        }
-        if (flashCartType == 101 || flashCartType == 102) {
-          gb_flash_program_setup(
-              GB_FLASH_PROGRAM_555); // Flash program byte method
-          gb_check_change_flash_id(GB_FLASH_PROGRAM_555);
+        if (skip_blank_block(64) == 1) {
+          addressMoved = 1;
         } else {
-          gb_flash_program_setup(
-              GB_FLASH_PROGRAM_5555); // Flash program byte method
-          gb_check_change_flash_id(GB_FLASH_PROGRAM_5555);
+          if (addressMoved == 1) {
+            set_number(currAddr, SET_START_ADDRESS);
+            delay_ms(5);
+            addressMoved = 0;
+          }
+          rom_write_bytes(GB_FLASH_WRITE_64BYTE, 64);
+          com_wait_for_ack();
         }
+        currAddr += 64;
+        readBytes += 64;
 
-        // Chip erase for this flash chip
-        if (flashCartType == 103 || flashCartType == 104) {
-          printf("\nErasing Flash");
-          xmas_chip_erase_animation();
-          gb_flash_write_address_byte(0x5555, 0xAA);
-          gb_flash_write_address_byte(0x2AAA, 0x55);
-          gb_flash_write_address_byte(0x5555, 0x80);
-          gb_flash_write_address_byte(0x5555, 0xAA);
-          gb_flash_write_address_byte(0x2AAA, 0x55);
-          gb_flash_write_address_byte(0x5555, 0x10);
-
-          // Wait for first byte to be 0xFF
-          wait_for_flash_chip_erase_ff(1);
-        }
+        print_progress_percent(readBytes, (romBanks * 16384) / 64);
+        led_progress_percent(readBytes, (romBanks * 16384) / 28);
+      }
+    }
+    printf("]\n");
 
-        xmas_setup((endAddr + 1) / 28);
+    if (segment_verifies(offset, length) == 0) {
+      // It's been programmed over, the next try has to erase it first
+      printf("Segment %i of %i didn't verify\n", segment + 1, segmentCount);
+      segment_journal_write(romImage->hash, 0, 0, 1);
+      return 1;
+    }
+  }
 
-        printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
+  doneMask |= 1 << segment;
+  uint8_t finished = (doneMask == (1 << segmentCount) - 1) ? 1 : 0;
+  segment_journal_write(romImage->hash, erased, doneMask, finished);
+  if (finished == 1) {
+    printf("\nAll %i segments are written\n", segmentCount);
+    return FLASH_ROM_VERIFIED;
+  }
+  printf("\nSegment %i of %i is written. Power cycle the device (unplug it "
+         "and plug it back in) and run this again for the next one\n",
+         segment + 1, segmentCount);
+  return FLASH_ROM_POWER_CYCLE;
+}
 
-        // Write ROM
-        set_number(currAddr, SET_START_ADDRESS);
-        while (currAddr <= endAddr) {
-          if (flashCartType == 101 ||
-              flashCartType == 102) {     // Sector erase for this flash chip
-            if (currAddr % 0x4000 == 0) { // Erase sectors
-              gb_flash_write_address_byte(0x555, 0xAA);
-              gb_flash_write_address_byte(0x2AA, 0x55);
-              gb_flash_write_address_byte(0x555, 0x80);
-              gb_flash_write_address_byte(0x555, 0xAA);
-              gb_flash_write_address_byte(0x2AA, 0x55);
-              gb_flash_write_address_byte(sector << 14, 0x30);
+// Write a ROM file to the flash cart type in flashCartType, on a device that
+// has already been set up. Returns 1 if it couldn't be written.
+int flash_rom(const char *romPath) {
+  // Separate the file name
+  char filenameOnly[100];
+  char filename[254];
+  strncpy(filename, romPath, 253);
 
-              wait_for_flash_sector_ff(currAddr);
-              sector++;
+#ifdef _WIN32
+  char *token = strtok(filename, "\\");
+  while (token != NULL) {
+    strncpy(filenameOnly, token, 99);
+    token = strtok(NULL, "\\");
+  }
+#else
+  char *token = strtok(filename, "/");
+  while (token != NULL) {
+    strncpy(filenameOnly, token, 99);
+    token = strtok(NULL, "/");
+  }
+#endif
 
-              set_number(currAddr, SET_START_ADDRESS);
-              delay_ms(5);
-            }
-          }
+  printf("\n--- Write ROM to Flash Cart ---\n");
+  printf("Cart selected: ");
 
-          com_write_bytes_from_file(GB_FLASH_WRITE_64BYTE, romFile, 64);
-          com_wait_for_ack();
-          currAddr += 64;
-          readBytes += 64;
+  uint32_t readBytes = 0;
+  uint16_t sector = 0;
+  long fileSize = 0;
 
-          print_progress_percent(readBytes, (endAddr + 1) / 64);
-          led_progress_percent(readBytes, (endAddr + 1) / 28);
-        }
+  // Grab file size
+  romImage = image_open(romPath);
+  if (romImage != NULL) {
+    fileSize = romImage->length;
+    romPosition = 0;
+  } else {
+    printf("\n%s \nFile not found\n", romPath);
+    read_one_letter();
+    return 1;
+  }
 
-        printf("]");
-        fclose(romFile);
-      }
+  // ****** GB Flash Carts ******
+  if (flashCartType >= 101) {
+    if (flashCartType == 101) {
+      printf("32 KByte AM29F010B Gameboy Flash Cart (Audio as WE)\n");
+    } else if (flashCartType == 102) {
+      printf("32 KByte AM29F010B Gameboy Flash Cart (WR as WE)\n");
+    } else if (flashCartType == 103) {
+      printf("32 KByte SST39SF010A / AT49F040 Gameboy Flash Cart (Audio as "
+             "WE)\n");
+    } else if (flashCartType == 104) {
+      printf("32 KByte SST39SF010A / AT49F040 Gameboy Flash Cart (WR as "
+             "WE)\n");
+    }
 
-      else if (flashCartType == 1) {
-        printf(" 32 KByte Gameboy Flash Cart\n");
-        printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+    currAddr = 0x0000;
+    endAddr = 0x7FFF;
 
-        currAddr = 0x0000;
-        endAddr = 0x7FFF;
+    // PCB v1.3 - Set 5V
+    if (gbxcartPcbVersion == PCB_1_3 || gbxcartPcbVersion == GBXMAS) {
+      set_mode(VOLTAGE_5V);
+      delay_ms(500);
+    }
 
-        // PCB v1.3 - Set 5V
-        if (gbxcartPcbVersion == PCB_1_3 || gbxcartPcbVersion == GBXMAS) {
-          set_mode(VOLTAGE_5V);
-          delay_ms(500);
-        }
+    // Check file size
+    if (fileSize > (endAddr + 1)) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 32K\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    }
 
-        // Check file size
-        if (fileSize > (endAddr + 1)) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 32K\n",
-              argv[1]);
-          read_one_letter();
-          return 1;
-        }
+    // Flash Setup
+    set_mode(GB_CART_MODE); // Gameboy mode
+    if (flashCartType == 101 || flashCartType == 103) {
+      gb_flash_pin_setup(WE_AS_AUDIO_PIN); // Audio pin
+    } else {
+      gb_flash_pin_setup(WE_AS_WR_PIN); // WR pin
+    }
+    if (flashCartType == 101 || flashCartType == 102) {
+      gb_flash_program_setup(
+          GB_FLASH_PROGRAM_555); // Flash program byte method
+      gb_check_change_flash_id(GB_FLASH_PROGRAM_555);
+    } else {
+      gb_flash_program_setup(
+          GB_FLASH_PROGRAM_5555); // Flash program byte method
+      gb_check_change_flash_id(GB_FLASH_PROGRAM_5555);
+    }
 
-        // Flash Setup
-        set_mode(GB_CART_MODE);           // Gameboy mode
-        gb_flash_pin_setup(WE_AS_WR_PIN); // WR pin
-        gb_flash_program_setup(
-            GB_FLASH_PROGRAM_5555); // Flash program byte method
-        gb_check_change_flash_id(GB_FLASH_PROGRAM_5555);
+    // Chip erase for this flash chip
+    if (flashCartType == 103 || flashCartType == 104) {
+      printf("\nErasing Flash");
+      xmas_chip_erase_animation();
+      gb_flash_write_address_byte(0x5555, 0xAA);
+      gb_flash_write_address_byte(0x2AAA, 0x55);
+      gb_flash_write_address_byte(0x5555, 0x80);
+      gb_flash_write_address_byte(0x5555, 0xAA);
+      gb_flash_write_address_byte(0x2AAA, 0x55);
+      gb_flash_write_address_byte(0x5555, 0x10);
+
+      // Wait for first byte to be 0xFF
+      wait_for_flash_chip_erase_ff(1);
+    }
 
-        // Check if Flash ID matches
-        if (flashID[0] != 0xBF || flashID[1] != 0xB5 || flashID[2] != 0x01 ||
-            flashID[3] != 0xFF) {
-          printf(
-              "*** Flash ID doesn't match expected value of 0xBF, 0xB5, 0x01, "
-              "0xFF ***\n");
-          read_one_letter();
+    xmas_setup((endAddr + 1) / 28);
+
+    printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    // Write ROM
+    set_number(currAddr, SET_START_ADDRESS);
+    while (currAddr <= endAddr) {
+      if (flashCartType == 101 ||
+          flashCartType == 102) {     // Sector erase for this flash chip
+        if (currAddr % 0x4000 == 0) { // Erase sectors
+          gb_flash_write_address_byte(0x555, 0xAA);
+          gb_flash_write_address_byte(0x2AA, 0x55);
+          gb_flash_write_address_byte(0x555, 0x80);
+          gb_flash_write_address_byte(0x555, 0xAA);
+          gb_flash_write_address_byte(0x2AA, 0x55);
+          gb_flash_write_address_byte(sector << 14, 0x30);
+
+          wait_for_flash_sector_ff(currAddr);
+          sector++;
+
+          set_number(currAddr, SET_START_ADDRESS);
+          delay_ms(5);
         }
+      }
 
-        // Chip erase for this flash chip
-        printf("\nErasing Flash");
-        xmas_chip_erase_animation();
-        gb_flash_write_address_byte(0x5555, 0xAA);
-        gb_flash_write_address_byte(0x2AAA, 0x55);
-        gb_flash_write_address_byte(0x5555, 0x80);
-        gb_flash_write_address_byte(0x5555, 0xAA);
-        gb_flash_write_address_byte(0x2AAA, 0x55);
-        gb_flash_write_address_byte(0x5555, 0x10);
-
-        // Wait for first byte to be 0xFF
-        wait_for_flash_chip_erase_ff(1);
-        xmas_setup((endAddr + 1) / 28);
-
-        printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
+      rom_write_bytes(GB_FLASH_WRITE_64BYTE, 64);
+      com_wait_for_ack();
+      currAddr += 64;
+      readBytes += 64;
 
-        // Write ROM
-        set_number(currAddr, SET_START_ADDRESS);
-        while (currAddr <= endAddr) {
-          com_write_bytes_from_file(GB_FLASH_WRITE_64BYTE, romFile, 64);
-          com_wait_for_ack();
-          currAddr += 64;
-          readBytes += 64;
+      print_progress_percent(readBytes, (endAddr + 1) / 64);
+      led_progress_percent(readBytes, (endAddr + 1) / 28);
+    }
 
-          print_progress_percent(readBytes, (endAddr + 1) / 64);
-          led_progress_percent(readBytes, (endAddr + 1) / 28);
-        }
+    printf("]");
+  }
 
-        printf("]");
-        fclose(romFile);
-      }
+  else if (flashCartType == 1) {
+    printf(" 32 KByte Gameboy Flash Cart\n");
+    printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
 
-      else if (flashCartType == 8 || flashCartType == 29) {
-        if (flashCartType == 8) {
-          printf("512 KByte (SST39SF040) Gameboy Flash Cart\n");
-        } else {
-          printf("insideGadgets 512 KByte Gameboy Flash Cart\n");
-        }
-        printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+    currAddr = 0x0000;
+    endAddr = 0x7FFF;
 
-        // PCB v1.3 - Set 5V
-        if (gbxcartPcbVersion == PCB_1_3 || gbxcartPcbVersion == GBXMAS) {
-          set_mode(VOLTAGE_5V);
-          delay_ms(500);
-        }
+    // PCB v1.3 - Set 5V
+    if (gbxcartPcbVersion == PCB_1_3 || gbxcartPcbVersion == GBXMAS) {
+      set_mode(VOLTAGE_5V);
+      delay_ms(500);
+    }
 
-        // Check file size
-        if (fileSize > 0x80000) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 512 KByte\n",
-              argv[1]);
-          read_one_letter();
-          return 1;
-        }
+    // Check file size
+    if (fileSize > (endAddr + 1)) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 32K\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    }
 
-        currAddr = 0x0000;
-        endAddr = 0x7FFF;
+    // Flash Setup
+    set_mode(GB_CART_MODE);           // Gameboy mode
+    gb_flash_pin_setup(WE_AS_WR_PIN); // WR pin
+    gb_flash_program_setup(
+        GB_FLASH_PROGRAM_5555); // Flash program byte method
+    gb_check_change_flash_id(GB_FLASH_PROGRAM_5555);
+
+    // Check if Flash ID matches
+    if (flashID[0] != 0xBF || flashID[1] != 0xB5 || flashID[2] != 0x01 ||
+        flashID[3] != 0xFF) {
+      printf(
+          "*** Flash ID doesn't match expected value of 0xBF, 0xB5, 0x01, "
+          "0xFF ***\n");
+      read_one_letter();
+    }
 
-        // Calculate banks needed from ROM file size
-        romBanks = fileSize / 16384;
+    // Chip erase for this flash chip
+    printf("\nErasing Flash");
+    xmas_chip_erase_animation();
+    gb_flash_write_address_byte(0x5555, 0xAA);
+    gb_flash_write_address_byte(0x2AAA, 0x55);
+    gb_flash_write_address_byte(0x5555, 0x80);
+    gb_flash_write_address_byte(0x5555, 0xAA);
+    gb_flash_write_address_byte(0x2AAA, 0x55);
+    gb_flash_write_address_byte(0x5555, 0x10);
+
+    // Wait for first byte to be 0xFF
+    wait_for_flash_chip_erase_ff(1);
+    xmas_setup((endAddr + 1) / 28);
+
+    printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    // Write ROM
+    set_number(currAddr, SET_START_ADDRESS);
+    while (currAddr <= endAddr) {
+      rom_write_bytes(GB_FLASH_WRITE_64BYTE, 64);
+      com_wait_for_ack();
+      currAddr += 64;
+      readBytes += 64;
+
+      print_progress_percent(readBytes, (endAddr + 1) / 64);
+      led_progress_percent(readBytes, (endAddr + 1) / 28);
+    }
 
-        // Flash Setup
-        set_mode(GB_CART_MODE);                   // Gameboy mode
-        set_mode(GB_FLASH_BANK_1_COMMAND_WRITES); // Set bank 1 before issuing
-                                                  // flash commands
-        if (flashCartType == 8) {
-          gb_flash_pin_setup(WE_AS_WR_PIN);
-        } else {
-          gb_flash_pin_setup(WE_AS_AUDIO_PIN);
-        }
-        gb_flash_program_setup(
-            GB_FLASH_PROGRAM_5555); // Flash program byte method
-
-        set_bank(0x2100, 1); // Set bank 1 before checking flash ID and erase
-        gb_check_change_flash_id(GB_FLASH_PROGRAM_5555);
-
-        // Chip erase for this flash chip
-        printf("\nErasing Flash");
-        xmas_chip_erase_animation();
-        gb_flash_write_address_byte(0x5555, 0xAA);
-        gb_flash_write_address_byte(0x2AAA, 0x55);
-        gb_flash_write_address_byte(0x5555, 0x80);
-        gb_flash_write_address_byte(0x5555, 0xAA);
-        gb_flash_write_address_byte(0x2AAA, 0x55);
-        gb_flash_write_address_byte(0x5555, 0x10);
-
-        // Wait for first byte to be 0xFF
-        wait_for_flash_chip_erase_ff(1);
-        xmas_setup((romBanks * 16384) / 28);
-        set_bank(0x2100, 0); // Set bank 0 back
-
-        printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
-
-        // Write ROM
-        currAddr = 0x0000;
-        for (uint16_t bank = 1; bank < romBanks; bank++) {
-          if (bank > 1) {
-            currAddr = 0x4000;
-          }
+    printf("]");
+  }
 
-          // Set start address
-          set_number(currAddr, SET_START_ADDRESS);
-          delay_ms(5);
+  else if (flashCartType == 8 || flashCartType == 29) {
+    if (flashCartType == 8) {
+      printf("512 KByte (SST39SF040) Gameboy Flash Cart\n");
+    } else {
+      printf("insideGadgets 512 KByte Gameboy Flash Cart\n");
+    }
+    printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
 
-          // Read data
-          while (currAddr < endAddr) {
-            if (currAddr == 0x4000) { // Switch banks here just before the next
-                                      // bank, not any time sooner
-              set_bank(0x2100, bank);
-            }
+    // PCB v1.3 - Set 5V
+    if (gbxcartPcbVersion == PCB_1_3 || gbxcartPcbVersion == GBXMAS) {
+      set_mode(VOLTAGE_5V);
+      delay_ms(500);
+    }
 
-            com_write_bytes_from_file(GB_FLASH_WRITE_64BYTE, romFile, 64);
-            com_wait_for_ack();
-            currAddr += 64;
-            readBytes += 64;
+    // Check file size
+    if (fileSize > 0x80000) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 512 KByte\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    }
 
-            // Print progress
-            print_progress_percent(readBytes, (romBanks * 16384) / 64);
-            led_progress_percent(readBytes, (romBanks * 16384) / 28);
-          }
-        }
+    currAddr = 0x0000;
+    endAddr = 0x7FFF;
 
-        printf("]");
-        fclose(romFile);
+    // Calculate banks needed from ROM file size
+    romBanks = fileSize / 16384;
+
+    // Flash Setup
+    set_mode(GB_CART_MODE);                   // Gameboy mode
+    set_mode(GB_FLASH_BANK_1_COMMAND_WRITES); // Set bank 1 before issuing
+                                              // flash commands
+    if (flashCartType == 8) {
+      gb_flash_pin_setup(WE_AS_WR_PIN);
+    } else {
+      gb_flash_pin_setup(WE_AS_AUDIO_PIN);
+    }
+    gb_flash_program_setup(
+        GB_FLASH_PROGRAM_5555); // Flash program byte method
+
+    set_bank(0x2100, 1); // Set bank 1 before checking flash ID and erase
+    gb_check_change_flash_id(GB_FLASH_PROGRAM_5555);
+
+    // Chip erase for this flash chip
+    printf("\nErasing Flash");
+    xmas_chip_erase_animation();
+    gb_flash_write_address_byte(0x5555, 0xAA);
+    gb_flash_write_address_byte(0x2AAA, 0x55);
+    gb_flash_write_address_byte(0x5555, 0x80);
+    gb_flash_write_address_byte(0x5555, 0xAA);
+    gb_flash_write_address_byte(0x2AAA, 0x55);
+    gb_flash_write_address_byte(0x5555, 0x10);
+
+    // Wait for first byte to be 0xFF
+    wait_for_flash_chip_erase_ff(1);
+    xmas_setup((romBanks * 16384) / 28);
+    set_bank(0x2100, 0); // Set bank 0 back
+
+    printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    // Write ROM
+    currAddr = 0x0000;
+    for (uint16_t bank = 1; bank < romBanks; bank++) {
+      if (bank > 1) {
+        currAddr = 0x4000;
       }
 
-      else if (flashCartType == 32 || flashCartType == 33 ||
-               flashCartType == 44 || flashCartType == 46) {
-        // 5v override and set to default cart selections
-        if (flashCartType == 44) {
-          flashCartType = 32;
-          mode5vOverride = 1;
-        } else if (flashCartType == 46) {
-          flashCartType = 33;
-          mode5vOverride = 1;
-        }
+      // Set start address
+      set_number(currAddr, SET_START_ADDRESS);
+      delay_ms(5);
 
-        if (flashCartType == 32) {
-          printf("512 KByte (AM29LV160 with CPLD) Gameboy Flash Cart\n");
-        } else {
-          printf("1 MByte (29LV320 with CPLD) Gameboy Flash Cart\n");
+      // Read data
+      while (currAddr < endAddr) {
+        if (currAddr == 0x4000) { // Switch banks here just before the next
+                                  // bank, not any time sooner
+          set_bank(0x2100, bank);
         }
 
-        // PCB v1.1/1.2
-        if (gbxcartPcbVersion == PCB_1_1 && cartridgeMode == GB_MODE) {
-          printf("You must switch GBxCart RW to be powered by 3.3V.\n");
-          printf("Please unplug it, switch the voltage and re-connect.\n");
-          read_one_letter();
-          return 1;
-        } else if (gbxcartPcbVersion == PCB_1_3 ||
-                   gbxcartPcbVersion == GBXMAS) { // PCB v1.3, Set 3.3V
-          if (mode5vOverride == 0) {
-            set_mode(VOLTAGE_3_3V);
-            delay_ms(500);
-          } else {
-            printf("Overriding voltage to 5V, use at your own risk.\n");
-            set_mode(VOLTAGE_5V);
-            delay_ms(500);
-          }
-        }
+        rom_write_bytes(GB_FLASH_WRITE_64BYTE, 64);
+        com_wait_for_ack();
+        currAddr += 64;
+        readBytes += 64;
 
-        // Check file size
-        if (flashCartType == 32 && fileSize > 0x80000) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 512 KByte\n",
-              argv[1]);
-          read_one_letter();
-          return 1;
-        } else if (flashCartType == 33 && fileSize > 0x100000) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 1 MByte\n",
-              argv[1]);
-          read_one_letter();
-          return 1;
-        }
+        // Print progress
+        print_progress_percent(readBytes, (romBanks * 16384) / 64);
+        led_progress_percent(readBytes, (romBanks * 16384) / 28);
+      }
+    }
 
-        currAddr = 0x0000;
-        endAddr = 0x7FFF;
-
-        // Calculate banks needed from ROM file size
-        romBanks = fileSize / 16384;
-
-        // Flash Setup
-        set_mode(GB_CART_MODE);           // Gameboy mode
-        gb_flash_pin_setup(WE_AS_WR_PIN); // WR pin
-        gb_flash_program_setup(
-            GB_FLASH_PROGRAM_7AAA_BIT01_SWAPPED); // Flash program byte method
-        gb_check_change_flash_id(GB_FLASH_PROGRAM_7AAA_BIT01_SWAPPED);
-
-        // Chip erase (data byte's bit 0 & 1 are swapped for chip commands as D0
-        // & D1 lines are swapped)
-        printf("\nErasing Flash");
-        xmas_chip_erase_animation();
-        gb_flash_write_address_byte(0x7AAA, 0xA9);
-        gb_flash_write_address_byte(0x7555, 0x56);
-        gb_flash_write_address_byte(0x7AAA, 0x80);
-        gb_flash_write_address_byte(0x7AAA, 0xA9);
-        gb_flash_write_address_byte(0x7555, 0x56);
-        gb_flash_write_address_byte(0x7AAA, 0x10);
-
-        // Wait for first byte to be 0xFF
-        wait_for_flash_chip_erase_ff(1);
-        xmas_setup((romBanks * 16384) / 28);
-
-        printf("\n\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
+    printf("]");
+  }
 
-        // Write ROM
-        for (uint16_t bank = 0; bank < romBanks; bank++) {
-          currAddr = 0x4000;
+  else if (flashCartType == 32 || flashCartType == 33 ||
+           flashCartType == 44 || flashCartType == 46) {
+    // 5v override and set to default cart selections
+    if (flashCartType == 44) {
+      flashCartType = 32;
+      mode5vOverride = 1;
+    } else if (flashCartType == 46) {
+      flashCartType = 33;
+      mode5vOverride = 1;
+    }
 
-          // Set start address
-          set_number(currAddr, SET_START_ADDRESS);
-          delay_ms(5);
+    if (flashCartType == 32) {
+      printf("512 KByte (AM29LV160 with CPLD) Gameboy Flash Cart\n");
+    } else {
+      printf("1 MByte (29LV320 with CPLD) Gameboy Flash Cart\n");
+    }
 
-          if (bank >= 1) {
-            set_mode(
-                GB_FLASH_BANK_1_COMMAND_WRITES); // Set bank again as we reset
-                                                 // the CPLD after every write
-            delay_ms(5);
-            set_bank(0x2100, bank);
-          }
+    // PCB v1.1/1.2
+    if (gbxcartPcbVersion == PCB_1_1 && cartridgeMode == GB_MODE) {
+      printf("You must switch GBxCart RW to be powered by 3.3V.\n");
+      printf("Please unplug it, switch the voltage and re-connect.\n");
+      read_one_letter();
+      return 1;
+    } else if (gbxcartPcbVersion == PCB_1_3 ||
+               gbxcartPcbVersion == GBXMAS) { // PCB v1.3, Set 3.3V
+      if (mode5vOverride == 0) {
+        set_mode(VOLTAGE_3_3V);
+        delay_ms(500);
+      } else {
+        printf("Overriding voltage to 5V, use at your own risk.\n");
+        set_mode(VOLTAGE_5V);
+        delay_ms(500);
+      }
+    }
 
-          // Read data
-          while (currAddr < endAddr) {
-            com_write_bytes_from_file(GB_FLASH_WRITE_64BYTE_PULSE_RESET,
-                                      romFile, 64);
-            com_wait_for_ack();
-            currAddr += 64;
-            readBytes += 64;
+    // Check file size
+    if (flashCartType == 32 && fileSize > 0x80000) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 512 KByte\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    } else if (flashCartType == 33 && fileSize > 0x100000) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 1 MByte\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    }
 
-            // Print progress
-            print_progress_percent(readBytes, (romBanks * 16384) / 64);
-            led_progress_percent(readBytes, (romBanks * 16384) / 28);
-          }
-        }
+    currAddr = 0x0000;
+    endAddr = 0x7FFF;
+
+    // Calculate banks needed from ROM file size
+    romBanks = fileSize / 16384;
+
+    // Flash Setup
+    set_mode(GB_CART_MODE);           // Gameboy mode
+    gb_flash_pin_setup(WE_AS_WR_PIN); // WR pin
+    gb_flash_program_setup(
+        GB_FLASH_PROGRAM_7AAA_BIT01_SWAPPED); // Flash program byte method
+    gb_check_change_flash_id(GB_FLASH_PROGRAM_7AAA_BIT01_SWAPPED);
+
+    // Chip erase (data byte's bit 0 & 1 are swapped for chip commands as D0
+    // & D1 lines are swapped)
+    printf("\nErasing Flash");
+    xmas_chip_erase_animation();
+    gb_flash_write_address_byte(0x7AAA, 0xA9);
+    gb_flash_write_address_byte(0x7555, 0x56);
+    gb_flash_write_address_byte(0x7AAA, 0x80);
+    gb_flash_write_address_byte(0x7AAA, 0xA9);
+    gb_flash_write_address_byte(0x7555, 0x56);
+    gb_flash_write_address_byte(0x7AAA, 0x10);
+
+    // Wait for first byte to be 0xFF
+    wait_for_flash_chip_erase_ff(1);
+    xmas_setup((romBanks * 16384) / 28);
+
+    printf("\n\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    // Write ROM
+    for (uint16_t bank = 0; bank < romBanks; bank++) {
+      currAddr = 0x4000;
+
+      // Set start address
+      set_number(currAddr, SET_START_ADDRESS);
+      delay_ms(5);
+
+      if (bank >= 1) {
+        set_mode(
+            GB_FLASH_BANK_1_COMMAND_WRITES); // Set bank again as we reset
+                                             // the CPLD after every write
+        delay_ms(5);
+        set_bank(0x2100, bank);
+      }
 
-        printf("]");
-        fclose(romFile);
+      // Read data
+      while (currAddr < endAddr) {
+        rom_write_bytes(GB_FLASH_WRITE_64BYTE_PULSE_RESET, 64);
+        com_wait_for_ack();
+        currAddr += 64;
+        readBytes += 64;
+
+        // Print progress
+        print_progress_percent(readBytes, (romBanks * 16384) / 64);
+        led_progress_percent(readBytes, (romBanks * 16384) / 28);
       }
+    }
 
-      else if (flashCartType == 9 || flashCartType == 45) {
-        printf("1 MByte (ES29LV160) Gameboy Flash Cart\n");
+    printf("]");
+  }
 
-        // 5v override
-        if (flashCartType == 45) {
-          mode5vOverride = 1;
-        }
-        // PCB v1.1/1.2
-        if (gbxcartPcbVersion == PCB_1_1 && cartridgeMode == GB_MODE) {
-          printf("You must switch GBxCart RW to be powered by 3.3V.\n");
-          printf("Please unplug it, switch the voltage and re-connect.\n");
-          read_one_letter();
-          return 1;
-        } else if (gbxcartPcbVersion == PCB_1_3 ||
-                   gbxcartPcbVersion == GBXMAS) { // PCB v1.3, set 3.3V
-          if (mode5vOverride == 0) {
-            set_mode(VOLTAGE_3_3V);
-            delay_ms(500);
-          } else {
-            printf("Overriding voltage to 5V, use at your own risk.\n");
-            set_mode(VOLTAGE_5V);
-            delay_ms(500);
-          }
-        }
+  else if (flashCartType == 9 || flashCartType == 45) {
+    printf("1 MByte (ES29LV160) Gameboy Flash Cart\n");
 
-        printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+    // 5v override
+    if (flashCartType == 45) {
+      mode5vOverride = 1;
+    }
+    // PCB v1.1/1.2
+    if (gbxcartPcbVersion == PCB_1_1 && cartridgeMode == GB_MODE) {
+      printf("You must switch GBxCart RW to be powered by 3.3V.\n");
+      printf("Please unplug it, switch the voltage and re-connect.\n");
+      read_one_letter();
+      return 1;
+    } else if (gbxcartPcbVersion == PCB_1_3 ||
+               gbxcartPcbVersion == GBXMAS) { // PCB v1.3, set 3.3V
+      if (mode5vOverride == 0) {
+        set_mode(VOLTAGE_3_3V);
+        delay_ms(500);
+      } else {
+        printf("Overriding voltage to 5V, use at your own risk.\n");
+        set_mode(VOLTAGE_5V);
+        delay_ms(500);
+      }
+    }
 
-        currAddr = 0x0000;
-        endAddr = 0x7FFF;
+    printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
 
-        // Check file size
-        if (fileSize > 0x100000) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 1 MByte\n",
-              argv[1]);
-          read_one_letter();
-          return 1;
-        }
+    currAddr = 0x0000;
+    endAddr = 0x7FFF;
 
-        // Calculate banks needed from ROM file size
-        romBanks = fileSize / 16384;
+    // Check file size
+    if (fileSize > 0x100000) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 1 MByte\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    }
 
-        // Flash Setup
-        set_mode(GB_CART_MODE);           // Gameboy mode
-        gb_flash_pin_setup(WE_AS_WR_PIN); // WR pin
-        gb_flash_program_setup(
-            GB_FLASH_PROGRAM_555_BIT01_SWAPPED); // Flash program byte method
-        gb_check_change_flash_id(GB_FLASH_PROGRAM_555_BIT01_SWAPPED);
+    // Calculate banks needed from ROM file size
+    romBanks = fileSize / 16384;
+
+    // Flash Setup
+    set_mode(GB_CART_MODE);           // Gameboy mode
+    gb_flash_pin_setup(WE_AS_WR_PIN); // WR pin
+    gb_flash_program_setup(
+        GB_FLASH_PROGRAM_555_BIT01_SWAPPED); // Flash program byte method
+    gb_check_change_flash_id(GB_FLASH_PROGRAM_555_BIT01_SWAPPED);
+
+    // Chip erase (data byte's bit 0 & 1 are swapped for chip commands as D0
+    // & D1 lines are swapped)
+    printf("\nErasing Flash");
+    xmas_chip_erase_animation();
+    gb_flash_write_address_byte(0x555, 0xA9);
+    gb_flash_write_address_byte(0x2AA, 0x56);
+    gb_flash_write_address_byte(0x555, 0x80);
+    gb_flash_write_address_byte(0x555, 0xA9);
+    gb_flash_write_address_byte(0x2AA, 0x56);
+    gb_flash_write_address_byte(0x555, 0x10);
+
+    // Wait for first byte to be 0xFF
+    wait_for_flash_chip_erase_ff(1);
+    xmas_setup((romBanks * 16384) / 28);
+
+    printf("\n\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    // Write ROM
+    currAddr = 0x0000;
+    for (uint16_t bank = 1; bank < romBanks; bank++) {
+      if (bank > 1) {
+        currAddr = 0x4000;
+      }
 
-        // Chip erase (data byte's bit 0 & 1 are swapped for chip commands as D0
-        // & D1 lines are swapped)
-        printf("\nErasing Flash");
-        xmas_chip_erase_animation();
-        gb_flash_write_address_byte(0x555, 0xA9);
-        gb_flash_write_address_byte(0x2AA, 0x56);
-        gb_flash_write_address_byte(0x555, 0x80);
-        gb_flash_write_address_byte(0x555, 0xA9);
-        gb_flash_write_address_byte(0x2AA, 0x56);
-        gb_flash_write_address_byte(0x555, 0x10);
+      // Set start address
+      set_number(currAddr, SET_START_ADDRESS);
+      delay_ms(5);
 
-        // Wait for first byte to be 0xFF
-        wait_for_flash_chip_erase_ff(1);
-        xmas_setup((romBanks * 16384) / 28);
+      // Read data
+      while (currAddr < endAddr) {
+        if (currAddr == 0x4000) { // Switch banks here just before the next
+                                  // bank, not any time sooner
+          set_bank(0x2100, bank);
+        }
 
-        printf("\n\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
-
-        // Write ROM
-        currAddr = 0x0000;
-        for (uint16_t bank = 1; bank < romBanks; bank++) {
-          if (bank > 1) {
-            currAddr = 0x4000;
-          }
+        rom_write_bytes(GB_FLASH_WRITE_64BYTE, 64);
+        com_wait_for_ack();
+        currAddr += 64;
+        readBytes += 64;
 
-          // Set start address
-          set_number(currAddr, SET_START_ADDRESS);
-          delay_ms(5);
+        // Print progress
+        print_progress_percent(readBytes, (romBanks * 16384) / 64);
+        led_progress_percent(readBytes, (romBanks * 16384) / 28);
+      }
+    }
 
-          // Read data
-          while (currAddr < endAddr) {
-            if (currAddr == 0x4000) { // Switch banks here just before the next
-                                      // bank, not any time sooner
-              set_bank(0x2100, bank);
-            }
+    printf("]");
+  }
 
-            com_write_bytes_from_file(GB_FLASH_WRITE_64BYTE, romFile, 64);
-            com_wait_for_ack();
-            currAddr += 64;
-            readBytes += 64;
+  else if (flashCartType == 10) {
+    printf("2 MByte (BV5) Gameboy Flash Cart\n");
+    printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
 
-            // Print progress
-            print_progress_percent(readBytes, (romBanks * 16384) / 64);
-            led_progress_percent(readBytes, (romBanks * 16384) / 28);
-          }
-        }
+    // PCB v1.3 - Set 5V
+    if (gbxcartPcbVersion == PCB_1_3 || gbxcartPcbVersion == GBXMAS) {
+      set_mode(VOLTAGE_5V);
+      delay_ms(500);
+    }
 
-        printf("]");
-        fclose(romFile);
-      }
+    // Check file size
+    if (fileSize > 0x200000) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 2 MByte\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    }
 
-      else if (flashCartType == 10) {
-        printf("2 MByte (BV5) Gameboy Flash Cart\n");
-        printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+    currAddr = 0x0000;
+    endAddr = 0x7FFF;
+
+    // Calculate banks needed from ROM file size
+    romBanks = fileSize / 16384;
+
+    // Flash Setup
+    set_mode(GB_CART_MODE);           // Gameboy mode
+    gb_flash_pin_setup(WE_AS_WR_PIN); // WR pin
+    gb_flash_program_setup(
+        GB_FLASH_PROGRAM_AAA_BIT01_SWAPPED); // Flash program byte method
+    gb_check_change_flash_id(GB_FLASH_PROGRAM_AAA_BIT01_SWAPPED);
+
+    // Chip erase (data byte's bit 0 & 1 are swapped for chip commands as
+    // BV5 D0 & D1 lines are swapped)
+    printf("\nErasing Flash");
+    xmas_chip_erase_animation();
+    gb_flash_write_address_byte(0xAAA, 0xA9);
+    gb_flash_write_address_byte(0x555, 0x56);
+    gb_flash_write_address_byte(0xAAA, 0x80);
+    gb_flash_write_address_byte(0xAAA, 0xA9);
+    gb_flash_write_address_byte(0x555, 0x56);
+    gb_flash_write_address_byte(0xAAA, 0x10);
+
+    // Wait for first byte to be 0xFF
+    wait_for_flash_chip_erase_ff(1);
+    xmas_setup((romBanks * 16384) / 28);
+
+    printf("\n\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    // Write ROM
+    currAddr = 0x0000;
+    for (uint16_t bank = 1; bank < romBanks; bank++) {
+      if (bank > 1) {
+        currAddr = 0x4000;
+      }
 
-        // PCB v1.3 - Set 5V
-        if (gbxcartPcbVersion == PCB_1_3 || gbxcartPcbVersion == GBXMAS) {
-          set_mode(VOLTAGE_5V);
-          delay_ms(500);
-        }
+      // Set start address
+      set_number(currAddr, SET_START_ADDRESS);
+      delay_ms(5);
 
-        // Check file size
-        if (fileSize > 0x200000) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 2 MByte\n",
-              argv[1]);
-          read_one_letter();
-          return 1;
+      // Read data
+      while (currAddr < endAddr) {
+        if (currAddr == 0x4000) { // Switch banks here just before the next
+                                  // bank, not any time sooner
+          set_bank(0x2100, bank);
         }
 
-        currAddr = 0x0000;
-        endAddr = 0x7FFF;
-
-        // Calculate banks needed from ROM file size
-        romBanks = fileSize / 16384;
+        rom_write_bytes(GB_FLASH_WRITE_64BYTE, 64);
+        com_wait_for_ack();
+        currAddr += 64;
+        readBytes += 64;
 
-        // Flash Setup
-        set_mode(GB_CART_MODE);           // Gameboy mode
-        gb_flash_pin_setup(WE_AS_WR_PIN); // WR pin
-        gb_flash_program_setup(
-            GB_FLASH_PROGRAM_AAA_BIT01_SWAPPED); // Flash program byte method
-        gb_check_change_flash_id(GB_FLASH_PROGRAM_AAA_BIT01_SWAPPED);
-
-        // Chip erase (data byte's bit 0 & 1 are swapped for chip commands as
-        // BV5 D0 & D1 lines are swapped)
-        printf("\nErasing Flash");
-        xmas_chip_erase_animation();
-        gb_flash_write_address_byte(0xAAA, 0xA9);
-        gb_flash_write_address_byte(0x555, 0x56);
-        gb_flash_write_address_byte(0xAAA, 0x80);
-        gb_flash_write_address_byte(0xAAA, 0xA9);
-        gb_flash_write_address_byte(0x555, 0x56);
-        gb_flash_write_address_byte(0xAAA, 0x10);
+        // Print progress
+        print_progress_percent(readBytes, (romBanks * 16384) / 64);
+        led_progress_percent(readBytes, (romBanks * 16384) / 28);
+      }
+    }
 
-        // Wait for first byte to be 0xFF
-        wait_for_flash_chip_erase_ff(1);
-        xmas_setup((romBanks * 16384) / 28);
+    printf("]");
+  }
 
-        printf("\n\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
-
-        // Write ROM
-        currAddr = 0x0000;
-        for (uint16_t bank = 1; bank < romBanks; bank++) {
-          if (bank > 1) {
-            currAddr = 0x4000;
-          }
+  else if (flashCartType == 11 || flashCartType == 47) {
+    printf("2 MByte (AM29LV160DB / 29LV160CTTC / 29LV160TE / S29AL016) "
+           "Gameboy Flash Cart\n");
 
-          // Set start address
-          set_number(currAddr, SET_START_ADDRESS);
-          delay_ms(5);
+    // 5v override
+    if (flashCartType == 47) {
+      mode5vOverride = 1;
+    }
+    // PCB v1.1/1.2
+    if (gbxcartPcbVersion == PCB_1_1 && cartridgeMode == GB_MODE) {
+      printf("You must switch GBxCart RW to be powered by 3.3V.\n");
+      printf("Please unplug it, switch the voltage and re-connect.\n");
+      read_one_letter();
+      return 1;
+    } else if (gbxcartPcbVersion == PCB_1_3 ||
+               gbxcartPcbVersion == GBXMAS) { // PCB v1.3, Set 3.3V
+      if (mode5vOverride == 0) {
+        set_mode(VOLTAGE_3_3V);
+        delay_ms(500);
+      } else {
+        printf("Overriding voltage to 5V, use at your own risk.\n");
+        set_mode(VOLTAGE_5V);
+        delay_ms(500);
+      }
+    }
 
-          // Read data
-          while (currAddr < endAddr) {
-            if (currAddr == 0x4000) { // Switch banks here just before the next
-                                      // bank, not any time sooner
-              set_bank(0x2100, bank);
-            }
+    printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
 
-            com_write_bytes_from_file(GB_FLASH_WRITE_64BYTE, romFile, 64);
-            com_wait_for_ack();
-            currAddr += 64;
-            readBytes += 64;
+    currAddr = 0x0000;
+    endAddr = 0x7FFF;
 
-            // Print progress
-            print_progress_percent(readBytes, (romBanks * 16384) / 64);
-            led_progress_percent(readBytes, (romBanks * 16384) / 28);
-          }
-        }
+    // Check file size
+    if (fileSize > 0x200000) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 2 MByte\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    }
 
-        printf("]");
-        fclose(romFile);
+    // Calculate banks needed from ROM file size
+    romBanks = fileSize / 16384;
+
+    // Flash Setup
+    set_mode(GB_CART_MODE);           // Gameboy mode
+    gb_flash_pin_setup(WE_AS_WR_PIN); // WR pin
+    gb_flash_program_setup(
+        GB_FLASH_PROGRAM_AAA); // Flash program byte method
+    gb_check_change_flash_id(GB_FLASH_PROGRAM_AAA);
+
+    // Chip erase
+    printf("\nErasing Flash");
+    xmas_chip_erase_animation();
+    gb_flash_write_address_byte(0xAAA, 0xAA);
+    gb_flash_write_address_byte(0x555, 0x55);
+    gb_flash_write_address_byte(0xAAA, 0x80);
+    gb_flash_write_address_byte(0xAAA, 0xAA);
+    gb_flash_write_address_byte(0x555, 0x55);
+    gb_flash_write_address_byte(0xAAA, 0x10);
+
+    // Wait for first byte to be 0xFF
+    wait_for_flash_chip_erase_ff(1);
+    xmas_setup((romBanks * 16384) / 28);
+
+    printf("\n\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    // Write ROM
+    currAddr = 0x0000;
+    for (uint16_t bank = 1; bank < romBanks; bank++) {
+      if (bank > 1) {
+        currAddr = 0x4000;
       }
 
-      else if (flashCartType == 11 || flashCartType == 47) {
-        printf("2 MByte (AM29LV160DB / 29LV160CTTC / 29LV160TE / S29AL016) "
-               "Gameboy Flash Cart\n");
+      // Set start address
+      set_number(currAddr, SET_START_ADDRESS);
+      delay_ms(5);
 
-        // 5v override
-        if (flashCartType == 47) {
-          mode5vOverride = 1;
-        }
-        // PCB v1.1/1.2
-        if (gbxcartPcbVersion == PCB_1_1 && cartridgeMode == GB_MODE) {
-          printf("You must switch GBxCart RW to be powered by 3.3V.\n");
-          printf("Please unplug it, switch the voltage and re-connect.\n");
-          read_one_letter();
-          return 1;
-        } else if (gbxcartPcbVersion == PCB_1_3 ||
-                   gbxcartPcbVersion == GBXMAS) { // PCB v1.3, Set 3.3V
-          if (mode5vOverride == 0) {
-            set_mode(VOLTAGE_3_3V);
-            delay_ms(500);
-          } else {
-            printf("Overriding voltage to 5V, use at your own risk.\n");
-            set_mode(VOLTAGE_5V);
-            delay_ms(500);
-          }
+      // Read data
+      while (currAddr < endAddr) {
+        if (currAddr == 0x4000) { // Switch banks here just before the next
+                                  // bank, not any time sooner
+          set_bank(0x2100, bank);
         }
 
-        printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+        rom_write_bytes(GB_FLASH_WRITE_64BYTE, 64);
+        com_wait_for_ack();
+        currAddr += 64;
+        readBytes += 64;
 
-        currAddr = 0x0000;
-        endAddr = 0x7FFF;
-
-        // Check file size
-        if (fileSize > 0x200000) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 2 MByte\n",
-              argv[1]);
-          read_one_letter();
-          return 1;
-        }
+        // Print progress
+        print_progress_percent(readBytes, (romBanks * 16384) / 64);
+        led_progress_percent(readBytes, (romBanks * 16384) / 28);
+      }
+    }
 
-        // Calculate banks needed from ROM file size
-        romBanks = fileSize / 16384;
+    printf("]");
+  }
 
-        // Flash Setup
-        set_mode(GB_CART_MODE);           // Gameboy mode
-        gb_flash_pin_setup(WE_AS_WR_PIN); // WR pin
-        gb_flash_program_setup(
-            GB_FLASH_PROGRAM_AAA); // Flash program byte method
-        gb_check_change_flash_id(GB_FLASH_PROGRAM_AAA);
+  else if (flashCartType == 12 || flashCartType == 2 ||
+           flashCartType == 3 || flashCartType == 34) {
+    if (flashCartType == 12) {
+      printf("2 MByte (AM29F016B) / 4 MByte (AM29F032B) (WR as WE) Gameboy "
+             "Flash Cart\n");
+      printf("\nGoing to write to ROM (Flash cart) from %s\n",
+             filenameOnly);
+
+      // Check file size
+      if (fileSize > 0x400000) {
+        printf("\n%s \nFile size is larger than the available Flash cart "
+               "space of 4 MByte\n",
+               romPath);
+        read_one_letter();
+        return 1;
+      }
+    } else if (flashCartType == 34) {
+      printf("2 MByte (AM29F016B) / 4 MByte (AM29F032B) (Audio as WE) "
+             "Gameboy Flash Cart\n");
+      printf("\nGoing to write to ROM (Flash cart) from %s\n",
+             filenameOnly);
+
+      // Check file size
+      if (fileSize > 0x400000) {
+        printf("\n%s \nFile size is larger than the available Flash cart "
+               "space of 4 MByte\n",
+               romPath);
+        read_one_letter();
+        return 1;
+      }
+    } else if (flashCartType == 2) {
+      printf("insideGadgets 2 MByte 128KB SRAM Flash Cart\n");
+      printf("\nGoing to write to ROM (Flash cart) from %s\n",
+             filenameOnly);
+
+      // Check file size
+      if (fileSize > 0x200000) {
+        printf("\n%s \nFile size is larger than the available Flash cart "
+               "space of 2 MByte\n",
+               romPath);
+        read_one_letter();
+        return 1;
+      }
+    } else if (flashCartType == 3) {
+      printf("insideGadgets 2 MByte 32KB FRAM Flash Cart\n");
+      printf("\nGoing to write to ROM (Flash cart) from %s\n",
+             filenameOnly);
+
+      // Check file size
+      if (fileSize > 0x200000) {
+        printf("\n%s \nFile size is larger than the available Flash cart "
+               "space of 2 MByte\n",
+               romPath);
+        read_one_letter();
+        return 1;
+      }
+    }
 
-        // Chip erase
-        printf("\nErasing Flash");
-        xmas_chip_erase_animation();
-        gb_flash_write_address_byte(0xAAA, 0xAA);
-        gb_flash_write_address_byte(0x555, 0x55);
-        gb_flash_write_address_byte(0xAAA, 0x80);
-        gb_flash_write_address_byte(0xAAA, 0xAA);
-        gb_flash_write_address_byte(0x555, 0x55);
-        gb_flash_write_address_byte(0xAAA, 0x10);
+    // PCB v1.3 - Set 5V
+    if (gbxcartPcbVersion == PCB_1_3 || gbxcartPcbVersion == GBXMAS) {
+      set_mode(VOLTAGE_5V);
+      delay_ms(500);
+    }
 
-        // Wait for first byte to be 0xFF
-        wait_for_flash_chip_erase_ff(1);
-        xmas_setup((romBanks * 16384) / 28);
+    currAddr = 0x0000;
+    endAddr = 0x7FFF;
 
-        printf("\n\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
-
-        // Write ROM
-        currAddr = 0x0000;
-        for (uint16_t bank = 1; bank < romBanks; bank++) {
-          if (bank > 1) {
-            currAddr = 0x4000;
-          }
+    // Calculate banks needed from ROM file size
+    romBanks = fileSize / 16384;
 
-          // Set start address
-          set_number(currAddr, SET_START_ADDRESS);
-          delay_ms(5);
+    // Flash Setup
+    set_mode(GB_CART_MODE); // Gameboy mode
 
-          // Read data
-          while (currAddr < endAddr) {
-            if (currAddr == 0x4000) { // Switch banks here just before the next
-                                      // bank, not any time sooner
-              set_bank(0x2100, bank);
-            }
+    if (flashCartType == 34) {
+      gb_flash_pin_setup(WE_AS_AUDIO_PIN); // Audio pin
+    } else {
+      gb_flash_pin_setup(WE_AS_WR_PIN); // WR pin
+    }
 
-            com_write_bytes_from_file(GB_FLASH_WRITE_64BYTE, romFile, 64);
-            com_wait_for_ack();
-            currAddr += 64;
-            readBytes += 64;
+    gb_flash_program_setup(
+        GB_FLASH_PROGRAM_555); // Flash program byte method
+    gb_check_change_flash_id(GB_FLASH_PROGRAM_555);
 
-            // Print progress
-            print_progress_percent(readBytes, (romBanks * 16384) / 64);
-            led_progress_percent(readBytes, (romBanks * 16384) / 28);
-          }
-        }
+    // Check if Flash ID matches
+    if (flashCartType == 2 || flashCartType == 3) {
+      if (flashID[0] != 0x01 || flashID[1] != 0xAD || flashID[2] != 0x00 ||
+          flashID[3] != 0x00) {
+        printf("*** Flash ID doesn't match expected value of 0x01, 0xAD, "
+               "0x00, 0x00 ***\n");
+        read_one_letter();
+      }
+    }
 
-        printf("]");
-        fclose(romFile);
+    // Chip erase
+    printf("\nErasing Flash");
+    xmas_chip_erase_animation();
+    gb_flash_write_address_byte(0x555, 0xAA);
+    gb_flash_write_address_byte(0x2AA, 0x55);
+    gb_flash_write_address_byte(0x555, 0x80);
+    gb_flash_write_address_byte(0x555, 0xAA);
+    gb_flash_write_address_byte(0x2AA, 0x55);
+    gb_flash_write_address_byte(0x555, 0x10);
+
+    // Wait for first byte to be 0xFF
+    wait_for_flash_chip_erase_ff(1);
+    xmas_setup((romBanks * 16384) / 28);
+
+    printf("\n\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    // Write ROM
+    currAddr = 0x0000;
+    for (uint16_t bank = 1; bank < romBanks; bank++) {
+      if (bank > 1) {
+        currAddr = 0x4000;
       }
 
-      else if (flashCartType == 12 || flashCartType == 2 ||
-               flashCartType == 3 || flashCartType == 34) {
-        if (flashCartType == 12) {
-          printf("2 MByte (AM29F016B) / 4 MByte (AM29F032B) (WR as WE) Gameboy "
-                 "Flash Cart\n");
-          printf("\nGoing to write to ROM (Flash cart) from %s\n",
-                 filenameOnly);
-
-          // Check file size
-          if (fileSize > 0x400000) {
-            fclose(romFile);
-            printf("\n%s \nFile size is larger than the available Flash cart "
-                   "space of 4 MByte\n",
-                   argv[1]);
-            read_one_letter();
-            return 1;
-          }
-        } else if (flashCartType == 34) {
-          printf("2 MByte (AM29F016B) / 4 MByte (AM29F032B) (Audio as WE) "
-                 "Gameboy Flash Cart\n");
-          printf("\nGoing to write to ROM (Flash cart) from %s\n",
-                 filenameOnly);
-
-          // Check file size
-          if (fileSize > 0x400000) {
-            fclose(romFile);
-            printf("\n%s \nFile size is larger than the available Flash cart "
-                   "space of 4 MByte\n",
-                   argv[1]);
-            read_one_letter();
-            return 1;
-          }
-        } else if (flashCartType == 2) {
-          printf("insideGadgets 2 MByte 128KB SRAM Flash Cart\n");
-          printf("\nGoing to write to ROM (Flash cart) from %s\n",
-                 filenameOnly);
-
-          // Check file size
-          if (fileSize > 0x200000) {
-            fclose(romFile);
-            printf("\n%s \nFile size is larger than the available Flash cart "
-                   "space of 2 MByte\n",
-                   argv[1]);
-            read_one_letter();
-            return 1;
-          }
-        } else if (flashCartType == 3) {
-          printf("insideGadgets 2 MByte 32KB FRAM Flash Cart\n");
-          printf("\nGoing to write to ROM (Flash cart) from %s\n",
-                 filenameOnly);
-
-          // Check file size
-          if (fileSize > 0x200000) {
-            fclose(romFile);
-            printf("\n%s \nFile size is larger than the available Flash cart "
-                   "space of 2 MByte\n",
-                   argv[1]);
-            read_one_letter();
-            return 1;
-          }
-        }
+      // Set start address
+      set_number(currAddr, SET_START_ADDRESS);
+      delay_ms(5);
 
-        // PCB v1.3 - Set 5V
-        if (gbxcartPcbVersion == PCB_1_3 || gbxcartPcbVersion == GBXMAS) {
-          set_mode(VOLTAGE_5V);
-          delay_ms(500);
+      // Read data
+      while (currAddr < endAddr) {
+        if (currAddr == 0x4000) { // Switch banks here just before the next
+                                  // bank, not any time sooner
+          set_bank(0x2100, bank);
         }
 
-        currAddr = 0x0000;
-        endAddr = 0x7FFF;
-
-        // Calculate banks needed from ROM file size
-        romBanks = fileSize / 16384;
+        rom_write_bytes(GB_FLASH_WRITE_64BYTE, 64);
+        com_wait_for_ack();
+        currAddr += 64;
+        readBytes += 64;
 
-        // Flash Setup
-        set_mode(GB_CART_MODE); // Gameboy mode
+        // Print progress
+        print_progress_percent(readBytes, (romBanks * 16384) / 64);
+        led_progress_percent(readBytes, (romBanks * 16384) / 28);
+      }
+    }
 
-        if (flashCartType == 34) {
-          gb_flash_pin_setup(WE_AS_AUDIO_PIN); // Audio pin
-        } else {
-          gb_flash_pin_setup(WE_AS_WR_PIN); // WR pin
-        }
+    printf("]");
+  }
 
-        gb_flash_program_setup(
-            GB_FLASH_PROGRAM_555); // Flash program byte method
-        gb_check_change_flash_id(GB_FLASH_PROGRAM_555);
+  else if (flashCartType == 13) {
+    printf("2 MByte (GB Smart 16M) Gameboy Flash Cart\n");
+    printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
 
-        // Check if Flash ID matches
-        if (flashCartType == 2 || flashCartType == 3) {
-          if (flashID[0] != 0x01 || flashID[1] != 0xAD || flashID[2] != 0x00 ||
-              flashID[3] != 0x00) {
-            printf("*** Flash ID doesn't match expected value of 0x01, 0xAD, "
-                   "0x00, 0x00 ***\n");
-            read_one_letter();
-          }
-        }
+    // PCB v1.3 - Set 5V
+    if (gbxcartPcbVersion == PCB_1_3 || gbxcartPcbVersion == GBXMAS) {
+      set_mode(VOLTAGE_5V);
+      delay_ms(500);
+    }
 
-        // Chip erase
-        printf("\nErasing Flash");
-        xmas_chip_erase_animation();
-        gb_flash_write_address_byte(0x555, 0xAA);
-        gb_flash_write_address_byte(0x2AA, 0x55);
-        gb_flash_write_address_byte(0x555, 0x80);
-        gb_flash_write_address_byte(0x555, 0xAA);
-        gb_flash_write_address_byte(0x2AA, 0x55);
-        gb_flash_write_address_byte(0x555, 0x10);
+    // Check file size
+    if (fileSize > 0x200000) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 2 MByte\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    }
 
-        // Wait for first byte to be 0xFF
-        wait_for_flash_chip_erase_ff(1);
-        xmas_setup((romBanks * 16384) / 28);
+    currAddr = 0x0000;
+    endAddr = 0x7FFF;
+
+    // Calculate banks needed from ROM file size
+    romBanks = fileSize / 16384;
+
+    // Flash Setup
+    set_mode(GB_CART_MODE);                   // Gameboy mode
+    set_mode(GB_FLASH_BANK_1_COMMAND_WRITES); // Set bank 1 before issuing
+                                              // flash commands
+    gb_flash_pin_setup(WE_AS_AUDIO_PIN);      // WR pin
+    gb_flash_program_setup(
+        GB_FLASH_PROGRAM_5555); // Flash program byte method
+    gb_check_change_flash_id(GB_FLASH_PROGRAM_5555);
+    xmas_setup((romBanks * 16384) / 28);
+
+    printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    uint8_t currentBankSize = romBanks;
+    uint8_t romBanksRemaining = romBanks;
+    uint8_t chipNo = 1;
+
+    // Calculate ROM banks remaining if more than 0x20 (one flash chip)
+    if (romBanks > 0x20) {
+      currentBankSize = 0x20;
+    }
 
-        printf("\n\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
-
-        // Write ROM
-        currAddr = 0x0000;
-        for (uint16_t bank = 1; bank < romBanks; bank++) {
-          if (bank > 1) {
-            currAddr = 0x4000;
-          }
+    while (romBanksRemaining >= 1) {
+      // Set bank 1 before issuing flash commands
+      set_bank(0x2100, 1);
+      delay_ms(5);
 
-          // Set start address
-          set_number(currAddr, SET_START_ADDRESS);
-          delay_ms(5);
+      // Set address 0
+      currAddr = 0x00;
+      set_number(currAddr, SET_START_ADDRESS);
+      delay_ms(5);
 
-          // Read data
-          while (currAddr < endAddr) {
-            if (currAddr == 0x4000) { // Switch banks here just before the next
-                                      // bank, not any time sooner
-              set_bank(0x2100, bank);
-            }
+      // Switch to the next flash chip
+      if (chipNo >= 2) {
+        set_bank(0x2000, 0x20 * (chipNo - 1));
+        delay_ms(5);
+        set_bank(0x1000, 0xA5);
+        delay_ms(5);
+        set_bank(0x7000, 0x00);
+        delay_ms(5);
+        set_bank(0x1000, 0x98);
+        delay_ms(5);
 
-            com_write_bytes_from_file(GB_FLASH_WRITE_64BYTE, romFile, 64);
-            com_wait_for_ack();
-            currAddr += 64;
-            readBytes += 64;
+        set_bank(0x2000, 0x20 * (chipNo - 1));
+        delay_ms(5);
+        set_bank(0x1000, 0xA5);
+        delay_ms(5);
+        set_bank(0x7000, 0x23);
+        delay_ms(5);
+        set_bank(0x1000, 0x98);
+        delay_ms(5);
+      }
 
-            // Print progress
-            print_progress_percent(readBytes, (romBanks * 16384) / 64);
-            led_progress_percent(readBytes, (romBanks * 16384) / 28);
-          }
+      // Erase flash chip
+      gb_flash_write_address_byte(0x5555, 0xAA);
+      gb_flash_write_address_byte(0x2AAA, 0x55);
+      gb_flash_write_address_byte(0x5555, 0x80);
+      gb_flash_write_address_byte(0x5555, 0xAA);
+      gb_flash_write_address_byte(0x2AAA, 0x55);
+      gb_flash_write_address_byte(0x5555, 0x10);
+      delay_ms(5);
+
+      // Wait for first byte to be 0xFF
+      wait_for_flash_chip_erase_ff(0);
+
+      // Write ROM
+      currAddr = 0x0000;
+      for (uint16_t bank = 1; bank < currentBankSize; bank++) {
+        if (bank > 1) {
+          currAddr = 0x4000;
         }
 
-        printf("]");
-        fclose(romFile);
-      }
+        // Set start address
+        set_number(currAddr, SET_START_ADDRESS);
+        delay_ms(5);
+
+        // Read data
+        while (currAddr < endAddr) {
+          if (currAddr == 0x4000) { // Switch banks here just before the
+                                    // next bank, not any time sooner
+            set_bank(0x2100, bank);
+          }
 
-      else if (flashCartType == 13) {
-        printf("2 MByte (GB Smart 16M) Gameboy Flash Cart\n");
-        printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+          rom_write_bytes(GB_FLASH_WRITE_64BYTE, 64);
+          com_wait_for_ack();
+          currAddr += 64;
+          readBytes += 64;
 
-        // PCB v1.3 - Set 5V
-        if (gbxcartPcbVersion == PCB_1_3 || gbxcartPcbVersion == GBXMAS) {
-          set_mode(VOLTAGE_5V);
-          delay_ms(500);
+          // Print progress
+          print_progress_percent(readBytes, (romBanks * 16384) / 64);
+          led_progress_percent(readBytes, (romBanks * 16384) / 28);
         }
+      }
 
-        // Check file size
-        if (fileSize > 0x200000) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 2 MByte\n",
-              argv[1]);
-          read_one_letter();
-          return 1;
-        }
+      // Increment the flash chip and calculate remaining banks
+      chipNo++;
+      romBanksRemaining -= currentBankSize;
+      if (romBanksRemaining > 0x20) {
+        currentBankSize = 0x20;
+      } else {
+        currentBankSize = romBanksRemaining; // Last banks to write
+      }
+    }
+    printf("]");
+  }
 
-        currAddr = 0x0000;
-        endAddr = 0x7FFF;
+  else if (flashCartType == 14 || flashCartType == 48) {
+    printf("4 MByte (M29W640 / 29DL32BF / GL032A10BAIR4 / S29AL016M9) "
+           "Gameboy Flash Cart\n");
+    printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
 
-        // Calculate banks needed from ROM file size
-        romBanks = fileSize / 16384;
+    // 5v override and set to default cart selections
+    if (flashCartType == 48) {
+      mode5vOverride = 1;
+    }
+    // PCB v1.1/1.2
+    if (gbxcartPcbVersion == PCB_1_1 && cartridgeMode == GB_MODE) {
+      printf("You must switch GBxCart RW to be powered by 3.3V.\n");
+      printf("Please unplug it, switch the voltage and re-connect.\n");
+      read_one_letter();
+      return 1;
+    } else if (gbxcartPcbVersion == PCB_1_3 ||
+               gbxcartPcbVersion == GBXMAS) { // PCB v1.3, Set 3.3V
+      if (mode5vOverride == 0) {
+        set_mode(VOLTAGE_3_3V);
+        delay_ms(500);
+      } else {
+        printf("Overriding voltage to 5V, use at your own risk.\n");
+        set_mode(VOLTAGE_5V);
+        delay_ms(500);
+      }
+    }
 
-        // Flash Setup
-        set_mode(GB_CART_MODE);                   // Gameboy mode
-        set_mode(GB_FLASH_BANK_1_COMMAND_WRITES); // Set bank 1 before issuing
-                                                  // flash commands
-        gb_flash_pin_setup(WE_AS_AUDIO_PIN);      // WR pin
-        gb_flash_program_setup(
-            GB_FLASH_PROGRAM_5555); // Flash program byte method
-        gb_check_change_flash_id(GB_FLASH_PROGRAM_5555);
-        xmas_setup((romBanks * 16384) / 28);
+    // Check file size
+    if (fileSize > 0x400000) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 4 MByte\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    }
 
-        printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
+    currAddr = 0x0000;
+    endAddr = 0x7FFF;
+
+    // Calculate banks needed from ROM file size
+    romBanks = fileSize / 16384;
+
+    // Flash Setup
+    set_mode(GB_CART_MODE);           // Gameboy mode
+    gb_flash_pin_setup(WE_AS_WR_PIN); // WR pin
+    gb_flash_program_setup(
+        GB_FLASH_PROGRAM_AAA_BIT01_SWAPPED); // Flash program byte method
+    gb_check_change_flash_id(GB_FLASH_PROGRAM_AAA_BIT01_SWAPPED);
+
+    // Chip erase (data byte's bit 0 & 1 are swapped for chip commands as
+    // BV5 D0 & D1 lines are swapped)
+    printf("\nErasing Flash");
+    xmas_chip_erase_animation();
+    gb_flash_write_address_byte(0xAAA, 0xA9);
+    gb_flash_write_address_byte(0x555, 0x56);
+    gb_flash_write_address_byte(0xAAA, 0x80);
+    gb_flash_write_address_byte(0xAAA, 0xA9);
+    gb_flash_write_address_byte(0x555, 0x56);
+    gb_flash_write_address_byte(0xAAA, 0x10);
+
+    // Wait for first byte to be 0xFF
+    wait_for_flash_chip_erase_ff(1);
+    xmas_setup((romBanks * 16384) / 28);
+
+    printf("\n\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    // Write ROM
+    currAddr = 0x0000;
+    for (uint16_t bank = 1; bank < romBanks; bank++) {
+      if (bank > 1) {
+        currAddr = 0x4000;
+      }
 
-        uint8_t currentBankSize = romBanks;
-        uint8_t romBanksRemaining = romBanks;
-        uint8_t chipNo = 1;
+      // Set start address
+      set_number(currAddr, SET_START_ADDRESS);
+      delay_ms(5);
 
-        // Calculate ROM banks remaining if more than 0x20 (one flash chip)
-        if (romBanks > 0x20) {
-          currentBankSize = 0x20;
+      // Read data
+      while (currAddr < endAddr) {
+        if (currAddr == 0x4000) { // Switch banks here just before the next
+                                  // bank, not any time sooner
+          set_bank(0x2100, bank);
         }
 
-        while (romBanksRemaining >= 1) {
-          // Set bank 1 before issuing flash commands
-          set_bank(0x2100, 1);
-          delay_ms(5);
-
-          // Set address 0
-          currAddr = 0x00;
-          set_number(currAddr, SET_START_ADDRESS);
-          delay_ms(5);
+        rom_write_bytes(GB_FLASH_WRITE_64BYTE, 64);
+        com_wait_for_ack();
+        currAddr += 64;
+        readBytes += 64;
 
-          // Switch to the next flash chip
-          if (chipNo >= 2) {
-            set_bank(0x2000, 0x20 * (chipNo - 1));
-            delay_ms(5);
-            set_bank(0x1000, 0xA5);
-            delay_ms(5);
-            set_bank(0x7000, 0x00);
-            delay_ms(5);
-            set_bank(0x1000, 0x98);
-            delay_ms(5);
+        // Print progress
+        print_progress_percent(readBytes, (romBanks * 16384) / 64);
+        led_progress_percent(readBytes, (romBanks * 16384) / 28);
+      }
+    }
 
-            set_bank(0x2000, 0x20 * (chipNo - 1));
-            delay_ms(5);
-            set_bank(0x1000, 0xA5);
-            delay_ms(5);
-            set_bank(0x7000, 0x23);
-            delay_ms(5);
-            set_bank(0x1000, 0x98);
-            delay_ms(5);
-          }
+    printf("]");
+  }
 
-          // Erase flash chip
-          gb_flash_write_address_byte(0x5555, 0xAA);
-          gb_flash_write_address_byte(0x2AAA, 0x55);
-          gb_flash_write_address_byte(0x5555, 0x80);
-          gb_flash_write_address_byte(0x5555, 0xAA);
-          gb_flash_write_address_byte(0x2AAA, 0x55);
-          gb_flash_write_address_byte(0x5555, 0x10);
-          delay_ms(5);
+  else if (flashCartType == 15 || flashCartType == 35) {
+    if (flashCartType == 15) {
+      printf("4 MByte MBC30 (AM29F032B / MBM29F033C) Gameboy Flash Cart\n");
+    } else if (flashCartType == 35) {
+      printf("insideGadgets 4 MByte 32KB FRAM MBC3 RTC Flash Cart\n");
+    }
+    printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
 
-          // Wait for first byte to be 0xFF
-          wait_for_flash_chip_erase_ff(0);
+    // PCB v1.3 - Set 5V
+    if (gbxcartPcbVersion == PCB_1_3 || gbxcartPcbVersion == GBXMAS) {
+      set_mode(VOLTAGE_5V);
+      delay_ms(500);
+    }
 
-          // Write ROM
-          currAddr = 0x0000;
-          for (uint16_t bank = 1; bank < currentBankSize; bank++) {
-            if (bank > 1) {
-              currAddr = 0x4000;
-            }
+    // Check file size
+    if (fileSize > 0x400000) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 4 MByte\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    }
 
-            // Set start address
-            set_number(currAddr, SET_START_ADDRESS);
-            delay_ms(5);
+    currAddr = 0x0000;
+    endAddr = 0x7FFF;
+
+    // Calculate banks needed from ROM file size
+    romBanks = fileSize / 16384;
+
+    // Flash Setup
+    set_mode(GB_CART_MODE);              // Gameboy mode
+    gb_flash_pin_setup(WE_AS_AUDIO_PIN); // Audio pin
+    gb_flash_program_setup(
+        GB_FLASH_PROGRAM_555); // Flash program byte method
+    gb_check_change_flash_id(GB_FLASH_PROGRAM_555);
+
+    // Chip erase
+    printf("\nErasing Flash");
+    xmas_chip_erase_animation();
+    gb_flash_write_address_byte(0x555, 0xAA);
+    gb_flash_write_address_byte(0x2AA, 0x55);
+    gb_flash_write_address_byte(0x555, 0x80);
+    gb_flash_write_address_byte(0x555, 0xAA);
+    gb_flash_write_address_byte(0x2AA, 0x55);
+    gb_flash_write_address_byte(0xAAA, 0x10);
+
+    // Wait for first byte to be 0xFF
+    wait_for_flash_chip_erase_ff(1);
+    xmas_setup((romBanks * 16384) / 28);
+
+    printf("\n\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    // Write ROM
+    currAddr = 0x0000;
+    for (uint16_t bank = 1; bank < romBanks; bank++) {
+      if (bank > 1) {
+        currAddr = 0x4000;
+      }
 
-            // Read data
-            while (currAddr < endAddr) {
-              if (currAddr == 0x4000) { // Switch banks here just before the
-                                        // next bank, not any time sooner
-                set_bank(0x2100, bank);
-              }
+      // Set start address
+      set_number(currAddr, SET_START_ADDRESS);
+      delay_ms(5);
 
-              com_write_bytes_from_file(GB_FLASH_WRITE_64BYTE, romFile, 64);
-              com_wait_for_ack();
-              currAddr += 64;
-              readBytes += 64;
+      // Read data
+      while (currAddr < endAddr) {
+        if (currAddr == 0x4000) { // Switch banks here just before the next
+                                  // bank, not any time sooner
+          set_bank(0x2100, bank);
+        }
 
-              // Print progress
-              print_progress_percent(readBytes, (romBanks * 16384) / 64);
-              led_progress_percent(readBytes, (romBanks * 16384) / 28);
-            }
-          }
+        rom_write_bytes(GB_FLASH_WRITE_64BYTE, 64);
+        com_wait_for_ack();
+        currAddr += 64;
+        readBytes += 64;
 
-          // Increment the flash chip and calculate remaining banks
-          chipNo++;
-          romBanksRemaining -= currentBankSize;
-          if (romBanksRemaining > 0x20) {
-            currentBankSize = 0x20;
-          } else {
-            currentBankSize = romBanksRemaining; // Last banks to write
-          }
-        }
-        printf("]");
-        fclose(romFile);
+        // Print progress
+        print_progress_percent(readBytes, (romBanks * 16384) / 64);
+        led_progress_percent(readBytes, (romBanks * 16384) / 28);
       }
+    }
 
-      else if (flashCartType == 14 || flashCartType == 48) {
-        printf("4 MByte (M29W640 / 29DL32BF / GL032A10BAIR4 / S29AL016M9) "
-               "Gameboy Flash Cart\n");
-        printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+    printf("]");
+  }
 
-        // 5v override and set to default cart selections
-        if (flashCartType == 48) {
-          mode5vOverride = 1;
-        }
-        // PCB v1.1/1.2
-        if (gbxcartPcbVersion == PCB_1_1 && cartridgeMode == GB_MODE) {
-          printf("You must switch GBxCart RW to be powered by 3.3V.\n");
-          printf("Please unplug it, switch the voltage and re-connect.\n");
-          read_one_letter();
-          return 1;
-        } else if (gbxcartPcbVersion == PCB_1_3 ||
-                   gbxcartPcbVersion == GBXMAS) { // PCB v1.3, Set 3.3V
-          if (mode5vOverride == 0) {
-            set_mode(VOLTAGE_3_3V);
-            delay_ms(500);
-          } else {
-            printf("Overriding voltage to 5V, use at your own risk.\n");
-            set_mode(VOLTAGE_5V);
-            delay_ms(500);
-          }
-        }
+  else if (flashCartType == 39 ||
+           flashCartType == 49) { // Thanks to lesserkuma for adding support
+    printf("4 MByte (S29GL032 with CPLD) Gameboy Flash Cart\n");
 
-        // Check file size
-        if (fileSize > 0x400000) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 4 MByte\n",
-              argv[1]);
-          read_one_letter();
-          return 1;
-        }
+    // 5v override
+    if (flashCartType == 49) {
+      mode5vOverride = 1;
+    }
+    // PCB v1.1/1.2
+    if (gbxcartPcbVersion == PCB_1_1 && cartridgeMode == GB_MODE) {
+      printf("You must switch GBxCart RW to be powered by 3.3V.\n");
+      printf("Please unplug it, switch the voltage and re-connect.\n");
+      read_one_letter();
+      return 1;
+    } else if (gbxcartPcbVersion == PCB_1_3 ||
+               gbxcartPcbVersion == GBXMAS) { // PCB v1.3, Set 3.3V
+      if (mode5vOverride == 0) {
+        set_mode(VOLTAGE_3_3V);
+        delay_ms(500);
+      } else {
+        printf("Overriding voltage to 5V, use at your own risk.\n");
+        set_mode(VOLTAGE_5V);
+        delay_ms(500);
+      }
+    }
 
-        currAddr = 0x0000;
-        endAddr = 0x7FFF;
+    // Check file size
+    if (fileSize > 0x400000) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 4 MByte\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    }
 
-        // Calculate banks needed from ROM file size
-        romBanks = fileSize / 16384;
+    currAddr = 0x0000;
+    endAddr = 0x7FFF;
+
+    // Calculate banks needed from ROM file size
+    romBanks = fileSize / 16384;
+
+    // Flash Setup
+    set_mode(GB_CART_MODE);           // Gameboy mode
+    gb_flash_pin_setup(WE_AS_WR_PIN); // WR pin
+    gb_flash_program_setup(
+        GB_FLASH_PROGRAM_7AAA_BIT01_SWAPPED); // Flash program byte method
+    gb_check_change_flash_id(GB_FLASH_PROGRAM_7AAA_BIT01_SWAPPED);
+
+    // Chip erase (data byte's bit 0 & 1 are swapped for chip commands as D0
+    // & D1 lines are swapped)
+    printf("\nErasing Flash");
+    xmas_chip_erase_animation();
+    gb_flash_write_address_byte(0x7AAA, 0xA9);
+    gb_flash_write_address_byte(0x7555, 0x56);
+    gb_flash_write_address_byte(0x7AAA, 0x80);
+    gb_flash_write_address_byte(0x7AAA, 0xA9);
+    gb_flash_write_address_byte(0x7555, 0x56);
+    gb_flash_write_address_byte(0x7AAA, 0x10);
+
+    // Wait for first byte to be 0xFF
+    wait_for_flash_chip_erase_ff(1);
+    xmas_setup((romBanks * 16384) / 28);
+
+    printf("\n\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    // Write ROM
+    for (uint16_t bank = 0; bank < romBanks; bank++) {
+      currAddr = 0x4000;
+
+      // Set start address
+      set_number(currAddr, SET_START_ADDRESS);
+      delay_ms(5);
+
+      if (bank >= 1) {
+        set_bank(0x2100, bank);
+      }
 
-        // Flash Setup
-        set_mode(GB_CART_MODE);           // Gameboy mode
-        gb_flash_pin_setup(WE_AS_WR_PIN); // WR pin
-        gb_flash_program_setup(
-            GB_FLASH_PROGRAM_AAA_BIT01_SWAPPED); // Flash program byte method
-        gb_check_change_flash_id(GB_FLASH_PROGRAM_AAA_BIT01_SWAPPED);
+      // Read data
+      while (currAddr < endAddr) {
+        rom_write_bytes(GB_FLASH_WRITE_64BYTE, 64);
+        com_wait_for_ack();
+        currAddr += 64;
+        readBytes += 64;
 
-        // Chip erase (data byte's bit 0 & 1 are swapped for chip commands as
-        // BV5 D0 & D1 lines are swapped)
-        printf("\nErasing Flash");
-        xmas_chip_erase_animation();
-        gb_flash_write_address_byte(0xAAA, 0xA9);
-        gb_flash_write_address_byte(0x555, 0x56);
-        gb_flash_write_address_byte(0xAAA, 0x80);
-        gb_flash_write_address_byte(0xAAA, 0xA9);
-        gb_flash_write_address_byte(0x555, 0x56);
-        gb_flash_write_address_byte(0xAAA, 0x10);
+        // Print progress
+        print_progress_percent(readBytes, (romBanks * 16384) / 64);
+        led_progress_percent(readBytes, (romBanks * 16384) / 28);
+      }
+    }
 
-        // Wait for first byte to be 0xFF
-        wait_for_flash_chip_erase_ff(1);
-        xmas_setup((romBanks * 16384) / 28);
+    printf("]");
+  }
 
-        printf("\n\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
-
-        // Write ROM
-        currAddr = 0x0000;
-        for (uint16_t bank = 1; bank < romBanks; bank++) {
-          if (bank > 1) {
-            currAddr = 0x4000;
-          }
+  else if (flashCartType == 38 ||
+           flashCartType == 40) { // Thanks to lesserkuma for adding support
+    if (flashCartType == 38) {
+      printf("8 MByte (BUNG Doctor GB Card 64M) (28F640J5) Gameboy Flash "
+             "Cart\n");
+
+      // Check file size
+      if (fileSize > 0x800000) {
+        printf("\n%s \nFile size is larger than the available Flash cart "
+               "space of 8 MByte\n",
+               romPath);
+        read_one_letter();
+        return 1;
+      }
+    } else {
+      printf("4 MByte (GB Smart 32M)\n");
 
-          // Set start address
-          set_number(currAddr, SET_START_ADDRESS);
-          delay_ms(5);
+      // Check file size
+      if (fileSize > 0x400000) {
+        printf("\n%s \nFile size is larger than the available Flash cart "
+               "space of 4 MByte\n",
+               romPath);
+        read_one_letter();
+        return 1;
+      }
+    }
 
-          // Read data
-          while (currAddr < endAddr) {
-            if (currAddr == 0x4000) { // Switch banks here just before the next
-                                      // bank, not any time sooner
-              set_bank(0x2100, bank);
-            }
+    printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+    if (gbxcartPcbVersion == MINI && gbxcartFirmwareVersion <= 16) {
+      printf(
+          "Firmware R17 or higher is required for this functionality.\n");
+      read_one_letter();
+      return 1;
+    } else if (gbxcartPcbVersion >= PCB_1_1 &&
+               gbxcartFirmwareVersion <= 17) {
+      printf(
+          "Firmware R18 or higher is required for this functionality.\n");
+      read_one_letter();
+      return 1;
+    }
 
-            com_write_bytes_from_file(GB_FLASH_WRITE_64BYTE, romFile, 64);
-            com_wait_for_ack();
-            currAddr += 64;
-            readBytes += 64;
+    // PCB v1.3 - Set 5V
+    if (gbxcartPcbVersion == PCB_1_3 || gbxcartPcbVersion == GBXMAS) {
+      set_mode(VOLTAGE_5V);
+      delay_ms(500);
+    }
 
-            // Print progress
-            print_progress_percent(readBytes, (romBanks * 16384) / 64);
-            led_progress_percent(readBytes, (romBanks * 16384) / 28);
-          }
-        }
+    currAddr = 0x0000;
+    endAddr = 0x7FFF;
 
-        printf("]");
-        fclose(romFile);
-      }
+    // Sector size is 128 KBytes
+    int sectorEraseAddress = 0x20000;
 
-      else if (flashCartType == 15 || flashCartType == 35) {
-        if (flashCartType == 15) {
-          printf("4 MByte MBC30 (AM29F032B / MBM29F033C) Gameboy Flash Cart\n");
-        } else if (flashCartType == 35) {
-          printf("insideGadgets 4 MByte 32KB FRAM MBC3 RTC Flash Cart\n");
-        }
-        printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+    // Calculate banks needed from ROM file size
+    romBanks = fileSize / 0x4000;
 
-        // PCB v1.3 - Set 5V
-        if (gbxcartPcbVersion == PCB_1_3 || gbxcartPcbVersion == GBXMAS) {
-          set_mode(VOLTAGE_5V);
-          delay_ms(500);
-        }
+    // Flash Setup
+    set_mode(GB_CART_MODE);                   // Gameboy mode
+    set_mode(GB_FLASH_BANK_1_COMMAND_WRITES); // Set bank 1 before issuing
+                                              // flash commands
+    gb_flash_pin_setup(WE_AS_AUDIO_PIN);      // WR pin
 
-        // Check file size
-        if (fileSize > 0x400000) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 4 MByte\n",
-              argv[1]);
-          read_one_letter();
-          return 1;
-        }
+    // Set first bank
+    set_bank(0x2100, 0);
+    set_bank(0x3000, 0);
 
-        currAddr = 0x0000;
-        endAddr = 0x7FFF;
+    printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
 
-        // Calculate banks needed from ROM file size
-        romBanks = fileSize / 16384;
+    // Write ROM
+    currAddr = 0x0000;
 
-        // Flash Setup
-        set_mode(GB_CART_MODE);              // Gameboy mode
-        gb_flash_pin_setup(WE_AS_AUDIO_PIN); // Audio pin
-        gb_flash_program_setup(
-            GB_FLASH_PROGRAM_555); // Flash program byte method
-        gb_check_change_flash_id(GB_FLASH_PROGRAM_555);
+    for (uint16_t bank = 1; bank < romBanks; bank++) {
+      if (bank > 1) {
+        currAddr = 0x4000;
+      }
 
-        // Chip erase
-        printf("\nErasing Flash");
-        xmas_chip_erase_animation();
-        gb_flash_write_address_byte(0x555, 0xAA);
-        gb_flash_write_address_byte(0x2AA, 0x55);
-        gb_flash_write_address_byte(0x555, 0x80);
-        gb_flash_write_address_byte(0x555, 0xAA);
-        gb_flash_write_address_byte(0x2AA, 0x55);
-        gb_flash_write_address_byte(0xAAA, 0x10);
+      // Set start address
+      set_number(currAddr, SET_START_ADDRESS);
+      delay_ms(5);
+
+      // Write data
+      while (currAddr < endAddr) {
+        if (currAddr == 0x4000) { // Switch banks here just before the next
+                                  // bank, not any time sooner
+          set_bank(0x2100, bank);
+          if (bank >= 256) {
+            set_bank(0x3000, 1); // High bit
+          } else {
+            set_bank(0x3000, 0); // High bit
+          }
+        }
+        if ((readBytes % sectorEraseAddress) == 0) { // Erase next sector
+          if (bank == 0) {
+            gb_flash_write_address_byte(0x0000, 0x20);
+            gb_flash_write_address_byte(0x0000, 0xD0);
+          } else {
+            gb_flash_write_address_byte(0x4000, 0x20);
+            gb_flash_write_address_byte(0x4000, 0xD0);
+          }
+          delay_ms(650);
 
-        // Wait for first byte to be 0xFF
-        wait_for_flash_chip_erase_ff(1);
-        xmas_setup((romBanks * 16384) / 28);
+          uint32_t timeout = 0;
+          uint8_t sr = 0;
+          while ((sr & 0x80) != 0x80) {
+            set_mode(READ_ROM_RAM);
+            com_read_bytes(READ_BUFFER, 64);
+            com_read_stop(); // End read
+            sr = readBuffer[0];
+            delay_ms(5);
 
-        printf("\n\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
-
-        // Write ROM
-        currAddr = 0x0000;
-        for (uint16_t bank = 1; bank < romBanks; bank++) {
-          if (bank > 1) {
-            currAddr = 0x4000;
+            timeout++;
+            if (timeout >= 200) {
+              printf("\n\nWaiting for sector erase has timed out. Please "
+                     "unplug "
+                     "GBxCart RW, re-seat the cartridge and try again.\n");
+              read_one_letter();
+              exit(1);
+            }
           }
 
           // Set start address
           set_number(currAddr, SET_START_ADDRESS);
           delay_ms(5);
+        }
 
-          // Read data
-          while (currAddr < endAddr) {
-            if (currAddr == 0x4000) { // Switch banks here just before the next
-                                      // bank, not any time sooner
-              set_bank(0x2100, bank);
-            }
-
-            com_write_bytes_from_file(GB_FLASH_WRITE_64BYTE, romFile, 64);
-            com_wait_for_ack();
-            currAddr += 64;
-            readBytes += 64;
+        // Write 32 bytes buffered in firmware
+        rom_write_bytes(GB_FLASH_WRITE_INTEL_BUFFERED_32BYTE, 32);
+        delay_ms(1);
+        com_wait_for_ack();
 
-            // Print progress
-            print_progress_percent(readBytes, (romBanks * 16384) / 64);
-            led_progress_percent(readBytes, (romBanks * 16384) / 28);
-          }
-        }
+        currAddr += 32;
+        readBytes += 32;
 
-        printf("]");
-        fclose(romFile);
+        // Print progress
+        print_progress_percent(readBytes, (romBanks * 16384) / 64);
+        led_progress_percent(readBytes, (romBanks * 16384) / 28);
       }
+    }
 
-      else if (flashCartType == 39 ||
-               flashCartType == 49) { // Thanks to lesserkuma for adding support
-        printf("4 MByte (S29GL032 with CPLD) Gameboy Flash Cart\n");
+    // Reset
+    set_bank(0x2100, 1);
+    set_bank(0x3000, 0);
+    gb_flash_write_address_byte(0x4000, 0xFF);
 
-        // 5v override
-        if (flashCartType == 49) {
-          mode5vOverride = 1;
-        }
-        // PCB v1.1/1.2
-        if (gbxcartPcbVersion == PCB_1_1 && cartridgeMode == GB_MODE) {
-          printf("You must switch GBxCart RW to be powered by 3.3V.\n");
-          printf("Please unplug it, switch the voltage and re-connect.\n");
-          read_one_letter();
-          return 1;
-        } else if (gbxcartPcbVersion == PCB_1_3 ||
-                   gbxcartPcbVersion == GBXMAS) { // PCB v1.3, Set 3.3V
-          if (mode5vOverride == 0) {
-            set_mode(VOLTAGE_3_3V);
-            delay_ms(500);
-          } else {
-            printf("Overriding voltage to 5V, use at your own risk.\n");
-            set_mode(VOLTAGE_5V);
-            delay_ms(500);
-          }
-        }
+    printf("]");
+  }
 
-        // Check file size
-        if (fileSize > 0x400000) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 4 MByte\n",
-              argv[1]);
-          read_one_letter();
-          return 1;
-        }
+  else if (flashCartType == 16 || flashCartType == 17 ||
+           flashCartType == 50 || flashCartType == 51) {
+    // 5v override and set to default cart selections
+    if (flashCartType == 50) {
+      flashCartType = 16;
+      mode5vOverride = 1;
+    } else if (flashCartType == 51) {
+      flashCartType = 17;
+      mode5vOverride = 1;
+    }
 
-        currAddr = 0x0000;
-        endAddr = 0x7FFF;
-
-        // Calculate banks needed from ROM file size
-        romBanks = fileSize / 16384;
-
-        // Flash Setup
-        set_mode(GB_CART_MODE);           // Gameboy mode
-        gb_flash_pin_setup(WE_AS_WR_PIN); // WR pin
-        gb_flash_program_setup(
-            GB_FLASH_PROGRAM_7AAA_BIT01_SWAPPED); // Flash program byte method
-        gb_check_change_flash_id(GB_FLASH_PROGRAM_7AAA_BIT01_SWAPPED);
-
-        // Chip erase (data byte's bit 0 & 1 are swapped for chip commands as D0
-        // & D1 lines are swapped)
-        printf("\nErasing Flash");
-        xmas_chip_erase_animation();
-        gb_flash_write_address_byte(0x7AAA, 0xA9);
-        gb_flash_write_address_byte(0x7555, 0x56);
-        gb_flash_write_address_byte(0x7AAA, 0x80);
-        gb_flash_write_address_byte(0x7AAA, 0xA9);
-        gb_flash_write_address_byte(0x7555, 0x56);
-        gb_flash_write_address_byte(0x7AAA, 0x10);
-
-        // Wait for first byte to be 0xFF
-        wait_for_flash_chip_erase_ff(1);
-        xmas_setup((romBanks * 16384) / 28);
-
-        printf("\n\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
+    if (flashCartType == 16) {
+      printf("32 MByte (4x 8MB Banks) (256M29) Gameboy Flash Cart\n");
+    } else {
+      printf("32 MByte (4x 8MB Banks) (M29W256 / MX29GL256 / MSP55LV100) "
+             "Gameboy Flash Cart\n");
+    }
+    printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+    if (fileSize <= SEGMENT_SIZE) {
+      printf("\n*** After writing is complete, you will need to power cycle "
+             "the device in order to write to the other 8MB banks ***\n\n");
+    }
 
-        // Write ROM
-        for (uint16_t bank = 0; bank < romBanks; bank++) {
-          currAddr = 0x4000;
+    // PCB v1.1/1.2
+    if (gbxcartPcbVersion == PCB_1_1 && cartridgeMode == GB_MODE) {
+      printf("You must switch GBxCart RW to be powered by 3.3V.\n");
+      printf("Please unplug it, switch the voltage and re-connect.\n");
+      read_one_letter();
+      return 1;
+    } else if (gbxcartPcbVersion == PCB_1_3 ||
+               gbxcartPcbVersion == GBXMAS) { // PCB v1.3, Set 3.3V
+      if (mode5vOverride == 0) {
+        set_mode(VOLTAGE_3_3V);
+        delay_ms(500);
+      } else {
+        printf("Overriding voltage to 5V, use at your own risk.\n");
+        set_mode(VOLTAGE_5V);
+        delay_ms(500);
+      }
+    }
 
-          // Set start address
-          set_number(currAddr, SET_START_ADDRESS);
-          delay_ms(5);
+    if (gbxcartFirmwareVersion <= 10) {
+      printf(
+          "Firmware R10 or higher is required for this functionality.\n");
+      read_one_letter();
+      return 1;
+    }
 
-          if (bank >= 1) {
-            set_bank(0x2100, bank);
-          }
+    // Check file size
+    if (fileSize > 4 * SEGMENT_SIZE) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 32 MByte\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    }
 
-          // Read data
-          while (currAddr < endAddr) {
-            com_write_bytes_from_file(GB_FLASH_WRITE_64BYTE, romFile, 64);
-            com_wait_for_ack();
-            currAddr += 64;
-            readBytes += 64;
+    currAddr = 0x0000;
+    endAddr = 0x7FFF;
 
-            // Print progress
-            print_progress_percent(readBytes, (romBanks * 16384) / 64);
-            led_progress_percent(readBytes, (romBanks * 16384) / 28);
-          }
-        }
+    // Calculate banks needed from ROM file size
+    romBanks = fileSize / 16384;
+
+    // Flash Setup
+    set_mode(GB_CART_MODE);           // Gameboy mode
+    gb_flash_pin_setup(WE_AS_WR_PIN); // WR pin
+    gb_flash_program_setup(
+        GB_FLASH_PROGRAM_AAA_BIT01_SWAPPED); // Flash program byte method
+    gb_check_change_flash_id(GB_FLASH_PROGRAM_AAA_BIT01_SWAPPED);
+
+    // A whole 32MB image is written 8MB at a time, one per power cycle
+    if (fileSize > SEGMENT_SIZE) {
+      return flash_next_segment();
+    }
 
-        printf("]");
-        fclose(romFile);
+    printf("Please enter which 8MB bank number we should write to (1-4):");
+    char bankString[5];
+    fgets(bankString, 5, stdin);
+    int bankNumber = atoi(bankString);
+
+    if (bankNumber == 1) {
+      // Chip erase
+      printf("\nErasing Flash (may take 1 minute)");
+      xmas_chip_erase_animation();
+      gb_flash_write_address_byte(0xAAA, 0xA9);
+      gb_flash_write_address_byte(0x555, 0x56);
+      gb_flash_write_address_byte(0xAAA, 0x80);
+      gb_flash_write_address_byte(0xAAA, 0xA9);
+      gb_flash_write_address_byte(0x555, 0x56);
+      gb_flash_write_address_byte(0xAAA, 0x10);
+
+      // Wait for first byte to be 0xFF
+      wait_for_flash_chip_erase_ff(1);
+
+      // Set first 8MB bank
+      gb_flash_write_address_byte(0x7000, 0x00);
+      gb_flash_write_address_byte(0x7001, 0x00);
+      gb_flash_write_address_byte(0x7002, 0x90);
+      delay_ms(1);
+    } else if (bankNumber == 2) {
+      gb_flash_write_address_byte(0x7000, 0x00);
+      gb_flash_write_address_byte(0x7001, 0x00);
+      gb_flash_write_address_byte(0x7002, 0x91);
+      delay_ms(1);
+    } else if (bankNumber == 3) {
+      gb_flash_write_address_byte(0x7000, 0x00);
+      gb_flash_write_address_byte(0x7001, 0x00);
+      gb_flash_write_address_byte(0x7002, 0x92);
+      delay_ms(1);
+    } else if (bankNumber == 4) {
+      gb_flash_write_address_byte(0x7000, 0x00);
+      gb_flash_write_address_byte(0x7001, 0x00);
+      gb_flash_write_address_byte(0x7002, 0x93);
+      delay_ms(1);
+    }
+    xmas_setup((romBanks * 16384) / 28);
+
+    printf("\n\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    // Write ROM
+    currAddr = 0x0000;
+    for (uint16_t bank = 1; bank < romBanks; bank++) {
+      if (bank > 1) {
+        currAddr = 0x4000;
       }
 
-      else if (flashCartType == 38 ||
-               flashCartType == 40) { // Thanks to lesserkuma for adding support
-        if (flashCartType == 38) {
-          printf("8 MByte (BUNG Doctor GB Card 64M) (28F640J5) Gameboy Flash "
-                 "Cart\n");
-
-          // Check file size
-          if (fileSize > 0x800000) {
-            fclose(romFile);
-            printf("\n%s \nFile size is larger than the available Flash cart "
-                   "space of 8 MByte\n",
-                   argv[1]);
-            read_one_letter();
-            return 1;
-          }
-        } else {
-          printf("4 MByte (GB Smart 32M)\n");
-
-          // Check file size
-          if (fileSize > 0x400000) {
-            fclose(romFile);
-            printf("\n%s \nFile size is larger than the available Flash cart "
-                   "space of 4 MByte\n",
-                   argv[1]);
-            read_one_letter();
-            return 1;
+      // Set start address
+      set_number(currAddr, SET_START_ADDRESS);
+      delay_ms(5);
+
+      // Read data
+      while (currAddr < endAddr) {
+        if (currAddr == 0x4000) { // Switch banks here just before the next
+                                  // bank, not any time sooner
+          set_bank(0x2100, bank);
+          if (bank >= 256) {
+            set_bank(0x3000, 1); // High bit
+          } else {
+            set_bank(0x3000, 0); // High bit
           }
         }
 
-        printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
-        if (gbxcartPcbVersion == MINI && gbxcartFirmwareVersion <= 16) {
-          printf(
-              "Firmware R17 or higher is required for this functionality.\n");
-          read_one_letter();
-          return 1;
-        } else if (gbxcartPcbVersion >= PCB_1_1 &&
-                   gbxcartFirmwareVersion <= 17) {
-          printf(
-              "Firmware R18 or higher is required for this functionality.\n");
-          read_one_letter();
-          return 1;
-        }
-
-        // PCB v1.3 - Set 5V
-        if (gbxcartPcbVersion == PCB_1_3 || gbxcartPcbVersion == GBXMAS) {
-          set_mode(VOLTAGE_5V);
-          delay_ms(500);
+        if (flashCartType == 15) { // Use buffered programming
+          rom_write_bytes(GB_FLASH_WRITE_256BYTE, 256);
+          com_wait_for_ack();
+          currAddr += 256;
+          readBytes += 256;
+        } else { // M29W256 doesn't seem to work with buffered programming,
+                 // write one byte at a time
+          rom_write_bytes(GB_FLASH_WRITE_64BYTE, 64);
+          com_wait_for_ack();
+          currAddr += 64;
+          readBytes += 64;
         }
 
-        currAddr = 0x0000;
-        endAddr = 0x7FFF;
-
-        // Sector size is 128 KBytes
-        int sectorEraseAddress = 0x20000;
-
-        // Calculate banks needed from ROM file size
-        romBanks = fileSize / 0x4000;
-
-        // Flash Setup
-        set_mode(GB_CART_MODE);                   // Gameboy mode
-        set_mode(GB_FLASH_BANK_1_COMMAND_WRITES); // Set bank 1 before issuing
-                                                  // flash commands
-        gb_flash_pin_setup(WE_AS_AUDIO_PIN);      // WR pin
+        // Print progress
+        print_progress_percent(readBytes, (romBanks * 16384) / 64);
+        led_progress_percent(readBytes, (romBanks * 16384) / 28);
+      }
+    }
 
-        // Set first bank
-        set_bank(0x2100, 0);
-        set_bank(0x3000, 0);
+    printf("]");
+  }
 
-        printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
+  else if (flashCartType == 5 || flashCartType == 6) {
+    if (flashCartType == 5) {
+      printf("64 MByte Mighty Flash Cart\n");
+    } else {
+      printf("64 MByte Mighty Flash Cart - Buffered (Experimental)\n");
+    }
+    printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
 
-        // Write ROM
-        currAddr = 0x0000;
+    // PCB v1.3 - Set 5V
+    if (gbxcartPcbVersion == PCB_1_3 || gbxcartPcbVersion == GBXMAS) {
+      set_mode(VOLTAGE_5V);
+      delay_ms(500);
+    }
 
-        for (uint16_t bank = 1; bank < romBanks; bank++) {
-          if (bank > 1) {
-            currAddr = 0x4000;
-          }
+    // Check file size
+    if (fileSize > 0x4000000) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 64 MByte\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    }
 
-          // Set start address
-          set_number(currAddr, SET_START_ADDRESS);
-          delay_ms(5);
+    currAddr = 0x0000;
+    endAddr = 0x7FFF;
 
-          // Write data
-          while (currAddr < endAddr) {
-            if (currAddr == 0x4000) { // Switch banks here just before the next
-                                      // bank, not any time sooner
-              set_bank(0x2100, bank);
-              if (bank >= 256) {
-                set_bank(0x3000, 1); // High bit
-              } else {
-                set_bank(0x3000, 0); // High bit
-              }
-            }
-            if ((readBytes % sectorEraseAddress) == 0) { // Erase next sector
-              if (bank == 0) {
-                gb_flash_write_address_byte(0x0000, 0x20);
-                gb_flash_write_address_byte(0x0000, 0xD0);
-              } else {
-                gb_flash_write_address_byte(0x4000, 0x20);
-                gb_flash_write_address_byte(0x4000, 0xD0);
-              }
-              delay_ms(650);
-
-              uint32_t timeout = 0;
-              uint8_t sr = 0;
-              while ((sr & 0x80) != 0x80) {
-                set_mode(READ_ROM_RAM);
-                com_read_bytes(READ_BUFFER, 64);
-                com_read_stop(); // End read
-                sr = readBuffer[0];
-                delay_ms(5);
-
-                timeout++;
-                if (timeout >= 200) {
-                  printf("\n\nWaiting for sector erase has timed out. Please "
-                         "unplug "
-                         "GBxCart RW, re-seat the cartridge and try again.\n");
-                  read_one_letter();
-                  exit(1);
-                }
-              }
+    // Calculate banks/8MB blocks needed from ROM file size
+    romBanks = fileSize / 16384;
+    uint8_t romBlocks = (romBanks / 512) + 1;
+    uint16_t romBanksCalc = fileSize / 16384;
+    uint16_t romBanksTotal = romBanksCalc;
+    if (romBlocks > 1) {
+      romBanks = 512;
+    }
+    if (romBlocks == 0) {
+      romBlocks = 1;
+    }
 
-              // Set start address
-              set_number(currAddr, SET_START_ADDRESS);
-              delay_ms(5);
-            }
+    // Detect if save slots are being used by
+    uint8_t saveSlotsDetected = 0;
+    uint32_t zeroCounter = 0;
 
-            // Write 32 bytes buffered in firmware
-            com_write_bytes_from_file(GB_FLASH_WRITE_INTEL_BUFFERED_32BYTE,
-                                      romFile, 32);
-            delay_ms(1);
-            com_wait_for_ack();
+    if (fileSize > 0x120000) { // File needs to be more than this for save
+                               // slots to be active
+      romPosition = 0x20000; // First save slot
 
-            currAddr += 32;
-            readBytes += 32;
+      for (uint16_t counter = 0; counter < 512; counter++) {
+        uint8_t buffer[256];
+        rom_read(buffer, 256);
 
-            // Print progress
-            print_progress_percent(readBytes, (romBanks * 16384) / 64);
-            led_progress_percent(readBytes, (romBanks * 16384) / 28);
+        for (uint16_t z = 0; z < 256; z++) {
+          if (buffer[z] == 0) {
+            zeroCounter++;
           }
         }
-
-        // Reset
-        set_bank(0x2100, 1);
-        set_bank(0x3000, 0);
-        gb_flash_write_address_byte(0x4000, 0xFF);
-
-        printf("]");
-        fclose(romFile);
       }
 
-      else if (flashCartType == 16 || flashCartType == 17 ||
-               flashCartType == 50 || flashCartType == 51) {
-        // 5v override and set to default cart selections
-        if (flashCartType == 50) {
-          flashCartType = 16;
-          mode5vOverride = 1;
-        } else if (flashCartType == 51) {
-          flashCartType = 17;
-          mode5vOverride = 1;
-        }
-
-        if (flashCartType == 16) {
-          printf("32 MByte (4x 8MB Banks) (256M29) Gameboy Flash Cart\n");
-        } else {
-          printf("32 MByte (4x 8MB Banks) (M29W256 / MX29GL256 / MSP55LV100) "
-                 "Gameboy Flash Cart\n");
-        }
-        printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
-        printf("\n*** After writing is complete, you will need to power cycle "
-               "the device in order to write to the other 8MB banks ***\n\n");
-
-        // PCB v1.1/1.2
-        if (gbxcartPcbVersion == PCB_1_1 && cartridgeMode == GB_MODE) {
-          printf("You must switch GBxCart RW to be powered by 3.3V.\n");
-          printf("Please unplug it, switch the voltage and re-connect.\n");
-          read_one_letter();
-          return 1;
-        } else if (gbxcartPcbVersion == PCB_1_3 ||
-                   gbxcartPcbVersion == GBXMAS) { // PCB v1.3, Set 3.3V
-          if (mode5vOverride == 0) {
-            set_mode(VOLTAGE_3_3V);
-            delay_ms(500);
-          } else {
-            printf("Overriding voltage to 5V, use at your own risk.\n");
-            set_mode(VOLTAGE_5V);
-            delay_ms(500);
-          }
-        }
-
-        if (gbxcartFirmwareVersion <= 10) {
-          printf(
-              "Firmware R10 or higher is required for this functionality.\n");
-          read_one_letter();
-          return 1;
-        }
+      if (zeroCounter == 0x20000) { // 131072 bytes of all 0's
+        saveSlotsDetected = 1;
+        printf("Save slots detected in ROM file\n");
+      }
+      romPosition = 0x00;
+    }
 
-        // Check file size
-        if (fileSize > 0x800000) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 8 MByte\n",
-              argv[1]);
-          read_one_letter();
-          return 1;
+    // Flash Setup
+    set_mode(GB_CART_MODE);           // Gameboy mode
+    gb_flash_pin_setup(WE_AS_WR_PIN); // WR pin
+    gb_flash_program_setup(
+        GB_FLASH_PROGRAM_AAA); // Flash program byte method
+    gb_check_change_flash_id(GB_FLASH_PROGRAM_AAA);
+
+    printf("\n\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    // Set bank as 0
+    set_bank(0x2100, 0);
+    set_bank(0x3000, 0);
+
+    // Change to first 8MB block
+    set_bank(0x1000, 0xD9); // Unlock multi-game mode
+    set_bank(0x7000, 0xF0); // Set MBC5 mode and high 3 bits of bank value
+    set_bank(0x6000, 0x00); // Bank
+    set_bank(0x0000, 0xAA); // Turn off multi-game mode
+
+    xmas_setup((romBanks * 16384) / 28);
+
+    // Write ROM
+    currAddr = 0x0000;
+    for (uint8_t block = 0; block < romBlocks; block++) {
+      currAddr = 0x0000;
+      sector = 0;
+
+      for (uint16_t bank = 1; bank < romBanks; bank++) {
+        if (bank > 1) {
+          currAddr = 0x4000;
         }
 
-        currAddr = 0x0000;
-        endAddr = 0x7FFF;
-
-        // Calculate banks needed from ROM file size
-        romBanks = fileSize / 16384;
-
-        // Flash Setup
-        set_mode(GB_CART_MODE);           // Gameboy mode
-        gb_flash_pin_setup(WE_AS_WR_PIN); // WR pin
-        gb_flash_program_setup(
-            GB_FLASH_PROGRAM_AAA_BIT01_SWAPPED); // Flash program byte method
-        gb_check_change_flash_id(GB_FLASH_PROGRAM_AAA_BIT01_SWAPPED);
-
-        printf("Please enter which 8MB bank number we should write to (1-4):");
-        char bankString[5];
-        fgets(bankString, 5, stdin);
-        int bankNumber = atoi(bankString);
-
-        if (bankNumber == 1) {
-          // Chip erase
-          printf("\nErasing Flash (may take 1 minute)");
-          xmas_chip_erase_animation();
-          gb_flash_write_address_byte(0xAAA, 0xA9);
-          gb_flash_write_address_byte(0x555, 0x56);
-          gb_flash_write_address_byte(0xAAA, 0x80);
-          gb_flash_write_address_byte(0xAAA, 0xA9);
-          gb_flash_write_address_byte(0x555, 0x56);
-          gb_flash_write_address_byte(0xAAA, 0x10);
-
-          // Wait for first byte to be 0xFF
-          wait_for_flash_chip_erase_ff(1);
-
-          // Set first 8MB bank
-          gb_flash_write_address_byte(0x7000, 0x00);
-          gb_flash_write_address_byte(0x7001, 0x00);
-          gb_flash_write_address_byte(0x7002, 0x90);
-          delay_ms(1);
-        } else if (bankNumber == 2) {
-          gb_flash_write_address_byte(0x7000, 0x00);
-          gb_flash_write_address_byte(0x7001, 0x00);
-          gb_flash_write_address_byte(0x7002, 0x91);
-          delay_ms(1);
-        } else if (bankNumber == 3) {
-          gb_flash_write_address_byte(0x7000, 0x00);
-          gb_flash_write_address_byte(0x7001, 0x00);
-          gb_flash_write_address_byte(0x7002, 0x92);
-          delay_ms(1);
-        } else if (bankNumber == 4) {
-          gb_flash_write_address_byte(0x7000, 0x00);
-          gb_flash_write_address_byte(0x7001, 0x00);
-          gb_flash_write_address_byte(0x7002, 0x93);
-          delay_ms(1);
-        }
-        xmas_setup((romBanks * 16384) / 28);
+        // Set start address
+        set_number(currAddr, SET_START_ADDRESS);
+        delay_ms(5);
 
-        printf("\n\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
-
-        // Write ROM
-        currAddr = 0x0000;
-        for (uint16_t bank = 1; bank < romBanks; bank++) {
-          if (bank > 1) {
-            currAddr = 0x4000;
+        // Read data
+        while (currAddr < endAddr) {
+          if (currAddr ==
+              0x4000) { // Switch banks here just before the next bank
+            set_bank(0x2100, bank);
+            if (bank >= 256) {
+              set_bank(0x3000, 1); // High bit
+            }
           }
 
-          // Set start address
-          set_number(currAddr, SET_START_ADDRESS);
-          delay_ms(5);
+          // If save slots are present - Write the loader, skip writing to
+          // save slots and then write data after save slots
+          if (saveSlotsDetected == 0 ||
+              (saveSlotsDetected == 1 &&
+               (readBytes < 0x20000 || readBytes >= 0x120000))) {
+            if (readBytes % 0x20000 == 0) { // Erase sectors
+              gb_flash_write_address_byte(0xAAA, 0xAA);
+              gb_flash_write_address_byte(0x555, 0x55);
+              gb_flash_write_address_byte(0xAAA, 0x80);
+              gb_flash_write_address_byte(0xAAA, 0xAA);
+              gb_flash_write_address_byte(0x555, 0x55);
+              gb_flash_write_address_byte(0x4000, 0x30);
 
-          // Read data
-          while (currAddr < endAddr) {
-            if (currAddr == 0x4000) { // Switch banks here just before the next
-                                      // bank, not any time sooner
-              set_bank(0x2100, bank);
-              if (bank >= 256) {
-                set_bank(0x3000, 1); // High bit
-              } else {
-                set_bank(0x3000, 0); // High bit
-              }
+              wait_for_flash_sector_ff(currAddr);
+              sector++;
+
+              set_number(currAddr, SET_START_ADDRESS);
+              delay_ms(5);
             }
 
-            if (flashCartType == 15) { // Use buffered programming
-              com_write_bytes_from_file(GB_FLASH_WRITE_256BYTE, romFile, 256);
-              com_wait_for_ack();
-              currAddr += 256;
-              readBytes += 256;
-            } else { // M29W256 doesn't seem to work with buffered programming,
-                     // write one byte at a time
-              com_write_bytes_from_file(GB_FLASH_WRITE_64BYTE, romFile, 64);
+            // Regular writing
+            if (flashCartType == 9) {
+              rom_write_bytes(GB_FLASH_WRITE_64BYTE, 64);
               com_wait_for_ack();
               currAddr += 64;
               readBytes += 64;
+            } else {
+              // printf("addr 0x%X\n", currAddr);
+              rom_write_bytes(GB_FLASH_WRITE_BUFFERED_32BYTE, 32);
+              com_wait_for_ack();
+              currAddr += 32;
+              readBytes += 32;
             }
-
-            // Print progress
-            print_progress_percent(readBytes, (romBanks * 16384) / 64);
-            led_progress_percent(readBytes, (romBanks * 16384) / 28);
+          } else { // Skip ROM
+            romPosition += 64;
+            currAddr += 64;
+            readBytes += 64;
           }
-        }
 
-        printf("]");
-        fclose(romFile);
+          // Print progress
+          print_progress_percent(readBytes, (romBanksTotal * 16384) / 64);
+          led_progress_percent(readBytes, (romBanksTotal * 16384) / 28);
+        }
       }
 
-      else if (flashCartType == 5 || flashCartType == 6) {
-        if (flashCartType == 5) {
-          printf("64 MByte Mighty Flash Cart\n");
-        } else {
-          printf("64 MByte Mighty Flash Cart - Buffered (Experimental)\n");
+      // Calculate remaining rom banks
+      if (romBanksCalc > 512) {
+        romBanksCalc = romBanksCalc - 512;
+        if (romBanksCalc <= 512) {
+          romBanks = romBanksCalc;
         }
-        printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+      }
 
-        // PCB v1.3 - Set 5V
-        if (gbxcartPcbVersion == PCB_1_3 || gbxcartPcbVersion == GBXMAS) {
-          set_mode(VOLTAGE_5V);
-          delay_ms(500);
-        }
+      // Set bank as 0
+      set_bank(0x2100, 0);
+      set_bank(0x3000, 0);
+
+      // Change to next 8MB block
+      uint8_t nextBlock = 0xF2 + (block * 2);
+      set_bank(0x1000, 0xD9); // Unlock multi-game mode
+      set_bank(0x7000,
+               nextBlock);    // Set MBC5 mode and high 3 bits of bank value
+      set_bank(0x6000, 0x00); // Bank
+      set_bank(0x0000, 0xAA); // Turn off multi-game mode
+    }
 
-        // Check file size
-        if (fileSize > 0x4000000) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 64 MByte\n",
-              argv[1]);
-          read_one_letter();
-          return 1;
-        }
+    // Set bank as 0
+    set_bank(0x2100, 0);
+    set_bank(0x3000, 0);
 
-        currAddr = 0x0000;
-        endAddr = 0x7FFF;
+    // Change to first 8MB block
+    set_bank(0x1000, 0xD9); // Unlock multi-game mode
+    set_bank(0x7000, 0xF0); // Set MBC5 mode and high 3 bits of bank value
+    set_bank(0x6000, 0x00); // Bank
+    set_bank(0x0000, 0xAA); // Turn off multi-game mode
 
-        // Calculate banks/8MB blocks needed from ROM file size
-        romBanks = fileSize / 16384;
-        uint8_t romBlocks = (romBanks / 512) + 1;
-        uint16_t romBanksCalc = fileSize / 16384;
-        uint16_t romBanksTotal = romBanksCalc;
-        if (romBlocks > 1) {
-          romBanks = 512;
-        }
-        if (romBlocks == 0) {
-          romBlocks = 1;
-        }
+    printf("]");
+  }
+
+  else if (flashCartType == 4) {
+    printf("insideGadgets 4 MByte 128KB SRAM/FRAM Gameboy Flash Cart\n");
+    printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
 
-        // Detect if save slots are being used by
-        uint8_t saveSlotsDetected = 0;
-        uint32_t zeroCounter = 0;
+    // PCB v1.3 - Set 5V
+    if (gbxcartPcbVersion == PCB_1_3 || gbxcartPcbVersion == GBXMAS) {
+      set_mode(VOLTAGE_5V);
+      delay_ms(500);
+    }
+    currAddr = 0x0000;
+    endAddr = 0x7FFF;
+
+    // Check file size
+    if (fileSize > 0x400000) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 4 MByte\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    }
 
-        if (fileSize > 0x120000) { // File needs to be more than this for save
-                                   // slots to be active
-          fseek(romFile, 0x20000, SEEK_SET); // First save slot
+    // Calculate banks needed from ROM file size
+    romBanks = fileSize / 16384;
+
+    // Flash Setup
+    set_mode(GB_CART_MODE); // Gameboy mode
+    delay_ms(5);
+    gb_flash_pin_setup(WE_AS_WR_PIN); // WR pin
+    gb_flash_program_setup(
+        GB_FLASH_PROGRAM_AAA); // Flash program byte method
+    gb_check_change_flash_id(GB_FLASH_PROGRAM_AAA);
+
+    // Check if Flash ID matches
+    if (flashID[0] == 0x01 && flashID[1] == 0x01 && flashID[2] == 0x7E &&
+        flashID[3] == 0x7E) {
+    } else if (flashID[0] == 0xC2) {
+    } else {
+      printf(
+          "*** Flash ID doesn't match expected value of 0x01, 0x01, 0x7E, "
+          "0x7E or 0xC2 ***\n");
+      read_one_letter();
+    }
 
-          for (uint16_t counter = 0; counter < 512; counter++) {
-            uint8_t buffer[256];
-            fread(&buffer, 1, 256, romFile);
+    set_number(0, SET_START_ADDRESS);
+    delay_ms(5);
+
+    // Chip erase
+    //    printf("\nErasing Flash ");
+    //     xmas_chip_erase_animation();
+    //     gb_flash_write_address_byte(0xAAA, 0xAA);
+    //     gb_flash_write_address_byte(0x555, 0x55);
+    //     gb_flash_write_address_byte(0xAAA, 0x80);
+    //     gb_flash_write_address_byte(0xAAA, 0xAA);
+    //     gb_flash_write_address_byte(0x555, 0x55);
+    //     gb_flash_write_address_byte(0xAAA, 0x10);
+
+    // Wait for first byte to be 0xFF
+    //     wait_for_flash_chip_erase_ff(1);
+    xmas_setup((romBanks * 16384) / 28);
+
+    printf("\n\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    // Write ROM
+    currAddr = 0x0000;
+    for (uint16_t bank = 1; bank < romBanks; bank++) {
+      if (bank > 1) {
+        currAddr = 0x4000;
+      }
 
-            for (uint16_t z = 0; z < 256; z++) {
-              if (buffer[z] == 0) {
-                zeroCounter++;
-              }
-            }
-          }
+      // Set start address
+      set_number(currAddr, SET_START_ADDRESS);
+      delay_ms(5);
 
-          if (zeroCounter == 0x20000) { // 131072 bytes of all 0's
-            saveSlotsDetected = 1;
-            printf("Save slots detected in ROM file\n");
-          }
-          fseek(romFile, 0x00, SEEK_SET);
+      // Read data
+      while (currAddr < endAddr) {
+        if (currAddr == 0x4000) { // Switch banks here just before the next
+                                  // bank, not any time sooner
+          set_bank(0x2100, bank);
         }
 
-        // Flash Setup
-        set_mode(GB_CART_MODE);           // Gameboy mode
-        gb_flash_pin_setup(WE_AS_WR_PIN); // WR pin
-        gb_flash_program_setup(
-            GB_FLASH_PROGRAM_AAA); // Flash program byte method
-        gb_check_change_flash_id(GB_FLASH_PROGRAM_AAA);
+        rom_write_bytes(GB_FLASH_WRITE_64BYTE, 64);
+        com_wait_for_ack();
+        currAddr += 64;
+        readBytes += 64;
 
-        printf("\n\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
-
-        // Set bank as 0
-        set_bank(0x2100, 0);
-        set_bank(0x3000, 0);
-
-        // Change to first 8MB block
-        set_bank(0x1000, 0xD9); // Unlock multi-game mode
-        set_bank(0x7000, 0xF0); // Set MBC5 mode and high 3 bits of bank value
-        set_bank(0x6000, 0x00); // Bank
-        set_bank(0x0000, 0xAA); // Turn off multi-game mode
-
-        xmas_setup((romBanks * 16384) / 28);
-
-        // Write ROM
-        currAddr = 0x0000;
-        for (uint8_t block = 0; block < romBlocks; block++) {
-          currAddr = 0x0000;
-          sector = 0;
-
-          for (uint16_t bank = 1; bank < romBanks; bank++) {
-            if (bank > 1) {
-              currAddr = 0x4000;
-            }
+        // Print progress
+        print_progress_percent(readBytes, (romBanks * 16384) / 64);
+        led_progress_percent(readBytes, (romBanks * 16384) / 28);
+      }
+    }
 
-            // Set start address
-            set_number(currAddr, SET_START_ADDRESS);
-            delay_ms(5);
+    printf("]");
+  }
 
-            // Read data
-            while (currAddr < endAddr) {
-              if (currAddr ==
-                  0x4000) { // Switch banks here just before the next bank
-                set_bank(0x2100, bank);
-                if (bank >= 256) {
-                  set_bank(0x3000, 1); // High bit
-                }
-              }
+  else if (flashCartType == 30 || flashCartType == 31 ||
+           flashCartType == 42) {
+    if (flashCartType == 30) {
+      printf("insideGadgets 1 MByte 128KB SRAM Gameboy Flash Cart\n");
+      if (fileSize > 0x100000) {
+        printf("\n%s \nFile size is larger than the available Flash cart "
+               "space of 1 MByte\n",
+               romPath);
+        read_one_letter();
+        return 1;
+      }
+    } else if (flashCartType == 42) {
+      printf("insideGadgets 2 MByte 128KB SRAM Gameboy Flash Cart (ULP)\n");
+      if (fileSize > 0x200000) {
+        printf("\n%s \nFile size is larger than the available Flash cart "
+               "space of 2 MByte\n",
+               romPath);
+        read_one_letter();
+        return 1;
+      }
+    } else {
+      printf("insideGadgets 1 MByte 128KB SRAM Custom Logo Flash Cart\n");
+      if (fileSize > 0x100000) {
+        printf("\n%s \nFile size is larger than the available Flash cart "
+               "space of 1 MByte\n",
+               romPath);
+        read_one_letter();
+        return 1;
+      }
+    }
 
-              // If save slots are present - Write the loader, skip writing to
-              // save slots and then write data after save slots
-              if (saveSlotsDetected == 0 ||
-                  (saveSlotsDetected == 1 &&
-                   (readBytes < 0x20000 || readBytes >= 0x120000))) {
-                if (readBytes % 0x20000 == 0) { // Erase sectors
-                  gb_flash_write_address_byte(0xAAA, 0xAA);
-                  gb_flash_write_address_byte(0x555, 0x55);
-                  gb_flash_write_address_byte(0xAAA, 0x80);
-                  gb_flash_write_address_byte(0xAAA, 0xAA);
-                  gb_flash_write_address_byte(0x555, 0x55);
-                  gb_flash_write_address_byte(0x4000, 0x30);
-
-                  wait_for_flash_sector_ff(currAddr);
-                  sector++;
-
-                  set_number(currAddr, SET_START_ADDRESS);
-                  delay_ms(5);
-                }
+    printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
 
-                // Regular writing
-                if (flashCartType == 9) {
-                  com_write_bytes_from_file(GB_FLASH_WRITE_64BYTE, romFile, 64);
-                  com_wait_for_ack();
-                  currAddr += 64;
-                  readBytes += 64;
-                } else {
-                  // printf("addr 0x%X\n", currAddr);
-                  com_write_bytes_from_file(GB_FLASH_WRITE_BUFFERED_32BYTE,
-                                            romFile, 32);
-                  com_wait_for_ack();
-                  currAddr += 32;
-                  readBytes += 32;
-                }
-              } else { // Skip ROM
-                fread(writeBuffer, 1, 64, romFile);
-                currAddr += 64;
-                readBytes += 64;
-              }
+    // PCB v1.3 - Set 5V
+    if (gbxcartPcbVersion == PCB_1_3 || gbxcartPcbVersion == GBXMAS) {
+      set_mode(VOLTAGE_5V);
+      delay_ms(500);
+    }
+    currAddr = 0x0000;
+    endAddr = 0x7FFF;
 
-              // Print progress
-              print_progress_percent(readBytes, (romBanksTotal * 16384) / 64);
-              led_progress_percent(readBytes, (romBanksTotal * 16384) / 28);
-            }
-          }
+    // Calculate banks needed from ROM file size
+    romBanks = fileSize / 16384;
 
-          // Calculate remaining rom banks
-          if (romBanksCalc > 512) {
-            romBanksCalc = romBanksCalc - 512;
-            if (romBanksCalc <= 512) {
-              romBanks = romBanksCalc;
-            }
-          }
+    // Flash Setup
+    set_mode(GB_CART_MODE);           // Gameboy mode
+    gb_flash_pin_setup(WE_AS_WR_PIN); // WR pin
 
-          // Set bank as 0
-          set_bank(0x2100, 0);
-          set_bank(0x3000, 0);
-
-          // Change to next 8MB block
-          uint8_t nextBlock = 0xF2 + (block * 2);
-          set_bank(0x1000, 0xD9); // Unlock multi-game mode
-          set_bank(0x7000,
-                   nextBlock);    // Set MBC5 mode and high 3 bits of bank value
-          set_bank(0x6000, 0x00); // Bank
-          set_bank(0x0000, 0xAA); // Turn off multi-game mode
-        }
+    // Disable Nintendo logo detection for logo cart
+    if (flashCartType == 31) {
+      set_bank(0x31, 0x2D); // For original logo cart
+      delay_ms(5);
 
-        // Set bank as 0
-        set_bank(0x2100, 0);
-        set_bank(0x3000, 0);
+      set_bank(0x2100, 1); // For ultra low power logo cart
+      delay_ms(5);
+    }
 
-        // Change to first 8MB block
-        set_bank(0x1000, 0xD9); // Unlock multi-game mode
-        set_bank(0x7000, 0xF0); // Set MBC5 mode and high 3 bits of bank value
-        set_bank(0x6000, 0x00); // Bank
-        set_bank(0x0000, 0xAA); // Turn off multi-game mode
-
-        printf("]");
-        fclose(romFile);
+    gb_flash_program_setup(
+        GB_FLASH_PROGRAM_AAA); // Flash program byte method
+    gb_check_change_flash_id(GB_FLASH_PROGRAM_AAA);
+
+    // Chip erase
+    //     printf("\nErasing Flash");
+    //     xmas_chip_erase_animation();
+    //     gb_flash_write_address_byte(0xAAA, 0xAA);
+    //     gb_flash_write_address_byte(0x555, 0x55);
+    //     gb_flash_write_address_byte(0xAAA, 0x80);
+    //     gb_flash_write_address_byte(0xAAA, 0xAA);
+    //     gb_flash_write_address_byte(0x555, 0x55);
+    //     gb_flash_write_address_byte(0xAAA, 0x10);
+
+    // Wait for first byte to be 0xFF
+    //     wait_for_flash_chip_erase_ff(1);
+    xmas_setup((romBanks * 16384) / 28);
+
+    printf("\n\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    // Write ROM
+    currAddr = 0x0000;
+    for (uint16_t bank = 1; bank < romBanks; bank++) {
+      if (bank > 1) {
+        currAddr = 0x4000;
       }
 
-      else if (flashCartType == 4) {
-        printf("insideGadgets 4 MByte 128KB SRAM/FRAM Gameboy Flash Cart\n");
-        printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+      // Set start address
+      set_number(currAddr, SET_START_ADDRESS);
+      delay_ms(5);
 
-        // PCB v1.3 - Set 5V
-        if (gbxcartPcbVersion == PCB_1_3 || gbxcartPcbVersion == GBXMAS) {
-          set_mode(VOLTAGE_5V);
-          delay_ms(500);
+      // Read data
+      while (currAddr < endAddr) {
+        if (currAddr == 0x4000) { // Switch banks here just before the next
+                                  // bank, not any time sooner
+          set_bank(0x2100, bank);
         }
-        currAddr = 0x0000;
-        endAddr = 0x7FFF;
 
-        // Check file size
-        if (fileSize > 0x400000) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 4 MByte\n",
-              argv[1]);
-          read_one_letter();
-          return 1;
-        }
+        rom_write_bytes(GB_FLASH_WRITE_64BYTE, 64);
+        com_wait_for_ack();
+        currAddr += 64;
+        readBytes += 64;
 
-        // Calculate banks needed from ROM file size
-        romBanks = fileSize / 16384;
+        // Print progress
+        print_progress_percent(readBytes, (romBanks * 16384) / 64);
+        led_progress_percent(readBytes, (romBanks * 16384) / 28);
+      }
+    }
 
-        // Flash Setup
-        set_mode(GB_CART_MODE); // Gameboy mode
-        delay_ms(5);
-        gb_flash_pin_setup(WE_AS_WR_PIN); // WR pin
-        gb_flash_program_setup(
-            GB_FLASH_PROGRAM_AAA); // Flash program byte method
-        gb_check_change_flash_id(GB_FLASH_PROGRAM_AAA);
-
-        // Check if Flash ID matches
-        if (flashID[0] == 0x01 && flashID[1] == 0x01 && flashID[2] == 0x7E &&
-            flashID[3] == 0x7E) {
-        } else if (flashID[0] == 0xC2) {
-        } else {
-          printf(
-              "*** Flash ID doesn't match expected value of 0x01, 0x01, 0x7E, "
-              "0x7E or 0xC2 ***\n");
-          read_one_letter();
-        }
+    printf("]");
+  }
 
-        set_number(0, SET_START_ADDRESS);
-        delay_ms(5);
+  else if (flashCartType == 52 || flashCartType == 53) {
+    if (flashCartType == 52) {
+      printf("Generic 5v Flash Cart (Auto detect)\n");
 
-        // Chip erase
-        //    printf("\nErasing Flash ");
-        //     xmas_chip_erase_animation();
-        //     gb_flash_write_address_byte(0xAAA, 0xAA);
-        //     gb_flash_write_address_byte(0x555, 0x55);
-        //     gb_flash_write_address_byte(0xAAA, 0x80);
-        //     gb_flash_write_address_byte(0xAAA, 0xAA);
-        //     gb_flash_write_address_byte(0x555, 0x55);
-        //     gb_flash_write_address_byte(0xAAA, 0x10);
-
-        // Wait for first byte to be 0xFF
-        //     wait_for_flash_chip_erase_ff(1);
-        xmas_setup((romBanks * 16384) / 28);
-
-        printf("\n\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
-
-        // Write ROM
-        currAddr = 0x0000;
-        for (uint16_t bank = 1; bank < romBanks; bank++) {
-          if (bank > 1) {
-            currAddr = 0x4000;
-          }
+      // PCB v1.3 - Set 5V
+      if (gbxcartPcbVersion == PCB_1_3 || gbxcartPcbVersion == GBXMAS) {
+        set_mode(VOLTAGE_5V);
+        delay_ms(500);
+      }
+    } else {
+      printf("Generic 3.3v Flash Cart (Auto detect)\n");
 
-          // Set start address
-          set_number(currAddr, SET_START_ADDRESS);
-          delay_ms(5);
+      // PCB v1.1/1.2
+      if (gbxcartPcbVersion == PCB_1_1 && cartridgeMode == GB_MODE) {
+        printf("You must switch GBxCart RW to be powered by 3.3V.\n");
+        printf("Please unplug it, switch the voltage and re-connect.\n");
+        read_one_letter();
+        return 1;
+      } else if (gbxcartPcbVersion == PCB_1_3 ||
+                 gbxcartPcbVersion == GBXMAS) { // PCB v1.3, Set 3.3V
+        set_mode(VOLTAGE_3_3V);
+        delay_ms(500);
+      }
+    }
+    printf("\nGoing to write to ROM (Flash cart) from %s\n\n",
+           filenameOnly);
+
+    // Check file size
+    if (fileSize > 0x400000) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 4 MByte\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    }
 
-          // Read data
-          while (currAddr < endAddr) {
-            if (currAddr == 0x4000) { // Switch banks here just before the next
-                                      // bank, not any time sooner
-              set_bank(0x2100, bank);
-            }
+    currAddr = 0x0000;
+    endAddr = 0x7FFF;
 
-            com_write_bytes_from_file(GB_FLASH_WRITE_64BYTE, romFile, 64);
-            com_wait_for_ack();
-            currAddr += 64;
-            readBytes += 64;
+    // Calculate banks needed from ROM file size
+    romBanks = fileSize / 16384;
 
-            // Print progress
-            print_progress_percent(readBytes, (romBanks * 16384) / 64);
-            led_progress_percent(readBytes, (romBanks * 16384) / 28);
-          }
-        }
+    // Flash Setup
+    set_mode(GB_CART_MODE); // Gameboy mode
+    detectedFlashWritingMethod = gb_check_flash_id();
+    if (detectedFlashWritingMethod >= 0) {
+      gb_flash_program_setup(detectedFlashWritingMethod);
+      gb_check_change_flash_id(detectedFlashWritingMethod);
 
-        printf("]");
-        fclose(romFile);
+      // Chip erase
+      printf("\nErasing Flash");
+      xmas_chip_erase_animation();
+      if (detectedFlashWritingMethod == GB_FLASH_PROGRAM_555) {
+        gb_flash_write_address_byte(0x555, 0xAA);
+        gb_flash_write_address_byte(0xAAA, 0x55);
+        gb_flash_write_address_byte(0x555, 0x80);
+        gb_flash_write_address_byte(0x555, 0xAA);
+        gb_flash_write_address_byte(0xAAA, 0x55);
+        gb_flash_write_address_byte(0x555, 0x10);
+      } else if (detectedFlashWritingMethod == GB_FLASH_PROGRAM_AAA) {
+        gb_flash_write_address_byte(0xAAA, 0xAA);
+        gb_flash_write_address_byte(0x555, 0x55);
+        gb_flash_write_address_byte(0xAAA, 0x80);
+        gb_flash_write_address_byte(0xAAA, 0xAA);
+        gb_flash_write_address_byte(0x555, 0x55);
+        gb_flash_write_address_byte(0xAAA, 0x10);
+      } else if (detectedFlashWritingMethod ==
+                 GB_FLASH_PROGRAM_555_BIT01_SWAPPED) {
+        gb_flash_write_address_byte(0x555, 0xA9);
+        gb_flash_write_address_byte(0x2AA, 0x56);
+        gb_flash_write_address_byte(0x555, 0x80);
+        gb_flash_write_address_byte(0x555, 0xA9);
+        gb_flash_write_address_byte(0x2AA, 0x56);
+        gb_flash_write_address_byte(0x555, 0x10);
+      } else if (detectedFlashWritingMethod ==
+                 GB_FLASH_PROGRAM_AAA_BIT01_SWAPPED) {
+        gb_flash_write_address_byte(0xAAA, 0xA9);
+        gb_flash_write_address_byte(0x555, 0x56);
+        gb_flash_write_address_byte(0xAAA, 0x80);
+        gb_flash_write_address_byte(0xAAA, 0xA9);
+        gb_flash_write_address_byte(0x555, 0x56);
+        gb_flash_write_address_byte(0xAAA, 0x10);
       }
 
-      else if (flashCartType == 30 || flashCartType == 31 ||
-               flashCartType == 42) {
-        if (flashCartType == 30) {
-          printf("insideGadgets 1 MByte 128KB SRAM Gameboy Flash Cart\n");
-          if (fileSize > 0x100000) {
-            fclose(romFile);
-            printf("\n%s \nFile size is larger than the available Flash cart "
-                   "space of 1 MByte\n",
-                   argv[1]);
-            read_one_letter();
-            return 1;
-          }
-        } else if (flashCartType == 42) {
-          printf("insideGadgets 2 MByte 128KB SRAM Gameboy Flash Cart (ULP)\n");
-          if (fileSize > 0x200000) {
-            fclose(romFile);
-            printf("\n%s \nFile size is larger than the available Flash cart "
-                   "space of 2 MByte\n",
-                   argv[1]);
-            read_one_letter();
-            return 1;
-          }
-        } else {
-          printf("insideGadgets 1 MByte 128KB SRAM Custom Logo Flash Cart\n");
-          if (fileSize > 0x100000) {
-            fclose(romFile);
-            printf("\n%s \nFile size is larger than the available Flash cart "
-                   "space of 1 MByte\n",
-                   argv[1]);
-            read_one_letter();
-            return 1;
-          }
-        }
+      // Wait for first byte to be 0xFF
+      wait_for_flash_chip_erase_ff(1);
+      xmas_setup((romBanks * 16384) / 28);
 
-        printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+      printf("\n\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+      printf(
+          "[             25%%             50%%             75%%           "
+          " 100%%]\n[");
 
-        // PCB v1.3 - Set 5V
-        if (gbxcartPcbVersion == PCB_1_3 || gbxcartPcbVersion == GBXMAS) {
-          set_mode(VOLTAGE_5V);
-          delay_ms(500);
+      // Write ROM
+      currAddr = 0x0000;
+      for (uint16_t bank = 1; bank < romBanks; bank++) {
+        if (bank > 1) {
+          currAddr = 0x4000;
         }
-        currAddr = 0x0000;
-        endAddr = 0x7FFF;
-
-        // Calculate banks needed from ROM file size
-        romBanks = fileSize / 16384;
-
-        // Flash Setup
-        set_mode(GB_CART_MODE);           // Gameboy mode
-        gb_flash_pin_setup(WE_AS_WR_PIN); // WR pin
 
-        // Disable Nintendo logo detection for logo cart
-        if (flashCartType == 31) {
-          set_bank(0x31, 0x2D); // For original logo cart
-          delay_ms(5);
-
-          set_bank(0x2100, 1); // For ultra low power logo cart
-          delay_ms(5);
-        }
+        // Set start address
+        set_number(currAddr, SET_START_ADDRESS);
+        delay_ms(5);
 
-        gb_flash_program_setup(
-            GB_FLASH_PROGRAM_AAA); // Flash program byte method
-        gb_check_change_flash_id(GB_FLASH_PROGRAM_AAA);
-
-        // Chip erase
-        //     printf("\nErasing Flash");
-        //     xmas_chip_erase_animation();
-        //     gb_flash_write_address_byte(0xAAA, 0xAA);
-        //     gb_flash_write_address_byte(0x555, 0x55);
-        //     gb_flash_write_address_byte(0xAAA, 0x80);
-        //     gb_flash_write_address_byte(0xAAA, 0xAA);
-        //     gb_flash_write_address_byte(0x555, 0x55);
-        //     gb_flash_write_address_byte(0xAAA, 0x10);
-
-        // Wait for first byte to be 0xFF
-        //     wait_for_flash_chip_erase_ff(1);
-        xmas_setup((romBanks * 16384) / 28);
-
-        printf("\n\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
-
-        // Write ROM
-        currAddr = 0x0000;
-        for (uint16_t bank = 1; bank < romBanks; bank++) {
-          if (bank > 1) {
-            currAddr = 0x4000;
+        // Read data
+        while (currAddr < endAddr) {
+          if (currAddr == 0x4000) { // Switch banks here just before the
+                                    // next bank, not any time sooner
+            set_bank(0x2100, bank);
           }
 
-          // Set start address
-          set_number(currAddr, SET_START_ADDRESS);
-          delay_ms(5);
-
-          // Read data
-          while (currAddr < endAddr) {
-            if (currAddr == 0x4000) { // Switch banks here just before the next
-                                      // bank, not any time sooner
-              set_bank(0x2100, bank);
-            }
-
-            com_write_bytes_from_file(GB_FLASH_WRITE_64BYTE, romFile, 64);
-            com_wait_for_ack();
-            currAddr += 64;
-            readBytes += 64;
+          rom_write_bytes(GB_FLASH_WRITE_64BYTE, 64);
+          com_wait_for_ack();
+          currAddr += 64;
+          readBytes += 64;
 
-            // Print progress
-            print_progress_percent(readBytes, (romBanks * 16384) / 64);
-            led_progress_percent(readBytes, (romBanks * 16384) / 28);
-          }
+          // Print progress
+          print_progress_percent(readBytes, (romBanks * 16384) / 64);
+          led_progress_percent(readBytes, (romBanks * 16384) / 28);
         }
-
-        printf("]");
-        fclose(romFile);
       }
 
-      else if (flashCartType == 52 || flashCartType == 53) {
-        if (flashCartType == 52) {
-          printf("Generic 5v Flash Cart (Auto detect)\n");
-
-          // PCB v1.3 - Set 5V
-          if (gbxcartPcbVersion == PCB_1_3 || gbxcartPcbVersion == GBXMAS) {
-            set_mode(VOLTAGE_5V);
-            delay_ms(500);
-          }
-        } else {
-          printf("Generic 3.3v Flash Cart (Auto detect)\n");
-
-          // PCB v1.1/1.2
-          if (gbxcartPcbVersion == PCB_1_1 && cartridgeMode == GB_MODE) {
-            printf("You must switch GBxCart RW to be powered by 3.3V.\n");
-            printf("Please unplug it, switch the voltage and re-connect.\n");
-            read_one_letter();
-            return 1;
-          } else if (gbxcartPcbVersion == PCB_1_3 ||
-                     gbxcartPcbVersion == GBXMAS) { // PCB v1.3, Set 3.3V
-            set_mode(VOLTAGE_3_3V);
-            delay_ms(500);
-          }
-        }
-        printf("\nGoing to write to ROM (Flash cart) from %s\n\n",
-               filenameOnly);
-
-        // Check file size
-        if (fileSize > 0x400000) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 4 MByte\n",
-              argv[1]);
-          read_one_letter();
-          return 1;
-        }
-
-        currAddr = 0x0000;
-        endAddr = 0x7FFF;
-
-        // Calculate banks needed from ROM file size
-        romBanks = fileSize / 16384;
-
-        // Flash Setup
-        set_mode(GB_CART_MODE); // Gameboy mode
-        detectedFlashWritingMethod = gb_check_flash_id();
-        if (detectedFlashWritingMethod >= 0) {
-          gb_flash_program_setup(detectedFlashWritingMethod);
-          gb_check_change_flash_id(detectedFlashWritingMethod);
-
-          // Chip erase
-          printf("\nErasing Flash");
-          xmas_chip_erase_animation();
-          if (detectedFlashWritingMethod == GB_FLASH_PROGRAM_555) {
-            gb_flash_write_address_byte(0x555, 0xAA);
-            gb_flash_write_address_byte(0xAAA, 0x55);
-            gb_flash_write_address_byte(0x555, 0x80);
-            gb_flash_write_address_byte(0x555, 0xAA);
-            gb_flash_write_address_byte(0xAAA, 0x55);
-            gb_flash_write_address_byte(0x555, 0x10);
-          } else if (detectedFlashWritingMethod == GB_FLASH_PROGRAM_AAA) {
-            gb_flash_write_address_byte(0xAAA, 0xAA);
-            gb_flash_write_address_byte(0x555, 0x55);
-            gb_flash_write_address_byte(0xAAA, 0x80);
-            gb_flash_write_address_byte(0xAAA, 0xAA);
-            gb_flash_write_address_byte(0x555, 0x55);
-            gb_flash_write_address_byte(0xAAA, 0x10);
-          } else if (detectedFlashWritingMethod ==
-                     GB_FLASH_PROGRAM_555_BIT01_SWAPPED) {
-            gb_flash_write_address_byte(0x555, 0xA9);
-            gb_flash_write_address_byte(0x2AA, 0x56);
-            gb_flash_write_address_byte(0x555, 0x80);
-            gb_flash_write_address_byte(0x555, 0xA9);
-            gb_flash_write_address_byte(0x2AA, 0x56);
-            gb_flash_write_address_byte(0x555, 0x10);
-          } else if (detectedFlashWritingMethod ==
-                     GB_FLASH_PROGRAM_AAA_BIT01_SWAPPED) {
-            gb_flash_write_address_byte(0xAAA, 0xA9);
-            gb_flash_write_address_byte(0x555, 0x56);
-            gb_flash_write_address_byte(0xAAA, 0x80);
-            gb_flash_write_address_byte(0xAAA, 0xA9);
-            gb_flash_write_address_byte(0x555, 0x56);
-            gb_flash_write_address_byte(0xAAA, 0x10);
-          }
-
-          // Wait for first byte to be 0xFF
-          wait_for_flash_chip_erase_ff(1);
-          xmas_setup((romBanks * 16384) / 28);
-
-          printf("\n\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-          printf(
-              "[             25%%             50%%             75%%           "
-              " 100%%]\n[");
-
-          // Write ROM
-          currAddr = 0x0000;
-          for (uint16_t bank = 1; bank < romBanks; bank++) {
-            if (bank > 1) {
-              currAddr = 0x4000;
-            }
-
-            // Set start address
-            set_number(currAddr, SET_START_ADDRESS);
-            delay_ms(5);
+      printf("]");
+    } else {
+      printf("\n*** Flash chip doesn't appear to be responding. Please "
+             "re-seat the cart and power cycle GBxCart ***\n");
+      read_one_letter();
+    }
+  }
 
-            // Read data
-            while (currAddr < endAddr) {
-              if (currAddr == 0x4000) { // Switch banks here just before the
-                                        // next bank, not any time sooner
-                set_bank(0x2100, bank);
-              }
+  // ****** GBA Flash Carts ******
+  else if (flashCartType == 20) {
+    printf("insideGadgets GBA 32MB (512Kbit/1Mbit Flash Save) or (256Kbit "
+           "FRAM) Flash Cart\n");
+    printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+
+    // Check file size
+    if (fileSize > 0x2000000) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 32 MBytes\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    }
 
-              com_write_bytes_from_file(GB_FLASH_WRITE_64BYTE, romFile, 64);
-              com_wait_for_ack();
-              currAddr += 64;
-              readBytes += 64;
+    // Read rom a tiny bit before writing
+    currAddr = 0x0000;
+    set_number(currAddr, SET_START_ADDRESS);
+    delay_ms(5);
+    set_mode(GBA_READ_ROM);
+    delay_ms(5);
+    com_read_bytes(READ_BUFFER, 64);
+    com_read_stop();
+
+    // Set end address as file size
+    endAddr = fileSize;
+    uint32_t endAddrAligned = fileSize;
+    while ((endAddrAligned / 64) % 64 !=
+           0) { // Align to 64 for printing progress
+      endAddrAligned--;
+    }
 
-              // Print progress
-              print_progress_percent(readBytes, (romBanks * 16384) / 64);
-              led_progress_percent(readBytes, (romBanks * 16384) / 28);
-            }
-          }
+    // Verify chip ID
+    gba_flash_write_address_byte(0xAAA, 0xAA);
+    gba_flash_write_address_byte(0x555, 0x55);
+    gba_flash_write_address_byte(0xAAA, 0x90);
+
+    currAddr = 0x0000;
+    set_number(currAddr, SET_START_ADDRESS);
+    delay_ms(5);
+    set_mode(GBA_READ_ROM);
+    delay_ms(5);
+    com_read_bytes(READ_BUFFER, 64);
+    com_read_stop();
+    gba_flash_write_address_byte(0x000, 0xF0);
+
+    printf("\nFlash ID: 0x%X,0x%X,0x%X,0x%X\n", readBuffer[0],
+           readBuffer[1], readBuffer[2], readBuffer[3]);
+    if ((readBuffer[0] != 0x1 && readBuffer[0] != 0x89) ||
+        readBuffer[1] != 0x0 || readBuffer[2] != 0x7E ||
+        readBuffer[3] != 0x22) {
+      printf("\n\nChip ID doesn't match 0x1/0x89 0x0 0x7E 0x22. Please "
+             "re-seat the cartridge or press enter to continue anyway.\n");
+      read_one_letter();
+    }
 
-          printf("]");
-          fclose(romFile);
-        } else {
-          printf("\n*** Flash chip doesn't appear to be responding. Please "
-                 "re-seat the cart and power cycle GBxCart ***\n");
-          read_one_letter();
-        }
+    // Check if file is more than 16MB or using 32MB chip, if so, do a chip
+    // erase instead of sector by sector erase (sector by sector erase won't
+    // seem to work properly after 16MB because A24 is at GND)
+    uint8_t sectorEraseEnabled = 1;
+    if (fileSize > 0x1000000 ||
+        (readBuffer[0] == 0x89 && readBuffer[1] == 0x0 &&
+         readBuffer[2] == 0x7E && readBuffer[3] == 0x22)) {
+      sectorEraseEnabled = 0;
+      currAddr = 0x0000;
+      set_number(currAddr, SET_START_ADDRESS);
+      delay_ms(5);
+
+      if (fileSize > 0x1000000) {
+        printf(
+            "Chip erase as ROM file is more than 16MB, this can take 3-4 "
+            "minutes");
+      } else {
+        printf(
+            "Chip erase as ROM file is more than 8MB and using 32MB chip, "
+            "this can take 1-2 minutes");
       }
+      gba_flash_write_address_byte(0xAAA, 0xAA);
+      gba_flash_write_address_byte(0x555, 0x55);
+      gba_flash_write_address_byte(0xAAA, 0x80);
+      gba_flash_write_address_byte(0xAAA, 0xAA);
+      gba_flash_write_address_byte(0x555, 0x55);
+      gba_flash_write_address_byte(0xAAA, 0x10);
+
+      // Wait for first 2 bytes to be 0xFF
+      wait_for_gba_flash_erase_ff(currAddr);
+      printf("\n");
+    }
 
-      // ****** GBA Flash Carts ******
-      else if (flashCartType == 20) {
-        printf("insideGadgets GBA 32MB (512Kbit/1Mbit Flash Save) or (256Kbit "
-               "FRAM) Flash Cart\n");
-        printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
-
-        // Check file size
-        if (fileSize > 0x2000000) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 32 MBytes\n",
-              argv[1]);
-          read_one_letter();
-          return 1;
-        }
-
-        // Read rom a tiny bit before writing
-        currAddr = 0x0000;
-        set_number(currAddr, SET_START_ADDRESS);
-        delay_ms(5);
-        set_mode(GBA_READ_ROM);
-        delay_ms(5);
-        com_read_bytes(READ_BUFFER, 64);
-        com_read_stop();
-
-        // Set end address as file size
-        endAddr = fileSize;
-        uint32_t endAddrAligned = fileSize;
-        while ((endAddrAligned / 64) % 64 !=
-               0) { // Align to 64 for printing progress
-          endAddrAligned--;
-        }
-
-        // Verify chip ID
+    xmas_setup(endAddrAligned / 28);
+
+    printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    // Write ROM
+    currAddr = 0x0000;
+    set_number(currAddr, SET_START_ADDRESS);
+    delay_ms(5);
+    uint8_t addressMoved = 0; // Blank blocks skipped since the last write
+    while (currAddr < endAddr) {
+      // Sector erase only performed for under 16MB files
+      if (sectorEraseEnabled == 1 &&
+          currAddr % 0x10000 == 0) { // Erase next sector
+        gba_flash_write_address_byte(0xAAA, 0xAA);
+        gba_flash_write_address_byte(0x555, 0x55);
+        gba_flash_write_address_byte(0xAAA, 0x80);
         gba_flash_write_address_byte(0xAAA, 0xAA);
         gba_flash_write_address_byte(0x555, 0x55);
-        gba_flash_write_address_byte(0xAAA, 0x90);
+        gba_flash_write_address_byte((uint32_t)sector << 17, 0x30);
+        sector++;
 
-        currAddr = 0x0000;
-        set_number(currAddr, SET_START_ADDRESS);
-        delay_ms(5);
-        set_mode(GBA_READ_ROM);
+        // Wait for first 2 bytes to be 0xFF
+        wait_for_gba_flash_sector_ff(currAddr, 0xFF, 0xFF);
+
+        set_number(currAddr / 2, SET_START_ADDRESS); // Divide address by 2
         delay_ms(5);
-        com_read_bytes(READ_BUFFER, 64);
-        com_read_stop();
-        gba_flash_write_address_byte(0x000, 0xF0);
-
-        printf("\nFlash ID: 0x%X,0x%X,0x%X,0x%X\n", readBuffer[0],
-               readBuffer[1], readBuffer[2], readBuffer[3]);
-        if ((readBuffer[0] != 0x1 && readBuffer[0] != 0x89) ||
-            readBuffer[1] != 0x0 || readBuffer[2] != 0x7E ||
-            readBuffer[3] != 0x22) {
-          printf("\n\nChip ID doesn't match 0x1/0x89 0x0 0x7E 0x22. Please "
-                 "re-seat the cartridge or press enter to continue anyway.\n");
-          read_one_letter();
-        }
+      }
 
-        // Check if file is more than 16MB or using 32MB chip, if so, do a chip
-        // erase instead of sector by sector erase (sector by sector erase won't
-        // seem to work properly after 16MB because A24 is at GND)
-        uint8_t sectorEraseEnabled = 1;
-        if (fileSize > 0x1000000 ||
-            (readBuffer[0] == 0x89 && readBuffer[1] == 0x0 &&
-             readBuffer[2] == 0x7E && readBuffer[3] == 0x22)) {
-          sectorEraseEnabled = 0;
-          currAddr = 0x0000;
-          set_number(currAddr, SET_START_ADDRESS);
+      if (skip_blank_block(256) == 1) {
+        addressMoved = 1;
+      } else {
+        if (addressMoved == 1) {
+          set_number(currAddr / 2, SET_START_ADDRESS); // Divide address by 2
           delay_ms(5);
-
-          if (fileSize > 0x1000000) {
-            printf(
-                "Chip erase as ROM file is more than 16MB, this can take 3-4 "
-                "minutes");
-          } else {
-            printf(
-                "Chip erase as ROM file is more than 8MB and using 32MB chip, "
-                "this can take 1-2 minutes");
-          }
-          gba_flash_write_address_byte(0xAAA, 0xAA);
-          gba_flash_write_address_byte(0x555, 0x55);
-          gba_flash_write_address_byte(0xAAA, 0x80);
-          gba_flash_write_address_byte(0xAAA, 0xAA);
-          gba_flash_write_address_byte(0x555, 0x55);
-          gba_flash_write_address_byte(0xAAA, 0x10);
-
-          // Wait for first 2 bytes to be 0xFF
-          wait_for_gba_flash_erase_ff(currAddr);
-          printf("\n");
+          addressMoved = 0;
         }
+        rom_write_bytes(GBA_FLASH_WRITE_256BYTE, 256);
+        com_wait_for_ack();
+      }
+      currAddr += 256;
+      readBytes += 256;
 
-        xmas_setup(endAddrAligned / 28);
-
-        printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
-
-        // Write ROM
-        currAddr = 0x0000;
-        set_number(currAddr, SET_START_ADDRESS);
-        delay_ms(5);
-        while (currAddr < endAddr) {
-          // Sector erase only performed for under 16MB files
-          if (sectorEraseEnabled == 1 &&
-              currAddr % 0x10000 == 0) { // Erase next sector
-            gba_flash_write_address_byte(0xAAA, 0xAA);
-            gba_flash_write_address_byte(0x555, 0x55);
-            gba_flash_write_address_byte(0xAAA, 0x80);
-            gba_flash_write_address_byte(0xAAA, 0xAA);
-            gba_flash_write_address_byte(0x555, 0x55);
-            gba_flash_write_address_byte((uint32_t)sector << 17, 0x30);
-            sector++;
-
-            // Wait for first 2 bytes to be 0xFF
-            wait_for_gba_flash_sector_ff(currAddr, 0xFF, 0xFF);
-
-            set_number(currAddr / 2, SET_START_ADDRESS); // Divide address by 2
-            delay_ms(5);
-          }
-
-          com_write_bytes_from_file(GBA_FLASH_WRITE_256BYTE, romFile, 256);
-          com_wait_for_ack();
-          currAddr += 256;
-          readBytes += 256;
+      print_progress_percent(readBytes, endAddr / 64);
+      led_progress_percent(readBytes, endAddr / 28);
+    }
+  } else if (flashCartType == 27) {
+    printf("insideGadgets GBA 32MB 4K/64K EEPROM Flash Cart\n");
+    printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+
+    // Check file size
+    if (fileSize > 0x2000000) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 32 MBytes\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    }
 
-          print_progress_percent(readBytes, endAddr / 64);
-          led_progress_percent(readBytes, endAddr / 28);
-        }
-      } else if (flashCartType == 27) {
-        printf("insideGadgets GBA 32MB 4K/64K EEPROM Flash Cart\n");
-        printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+    // Read rom a tiny bit before writing
+    currAddr = 0x0000;
+    set_number(currAddr, SET_START_ADDRESS);
+    delay_ms(5);
+    set_mode(GBA_READ_ROM);
+    delay_ms(5);
+    com_read_bytes(READ_BUFFER, 64);
+    com_read_stop();
+
+    // Set end address as file size
+    endAddr = fileSize;
+    uint32_t endAddrAligned = fileSize;
+    while ((endAddrAligned / 64) % 64 !=
+           0) { // Align to 64 for printing progress
+      endAddrAligned--;
+    }
 
-        // Check file size
-        if (fileSize > 0x2000000) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 32 MBytes\n",
-              argv[1]);
-          read_one_letter();
-          return 1;
-        }
+    // Verify chip ID
+    gba_flash_write_address_byte(0xAAA, 0xAA);
+    gba_flash_write_address_byte(0x555, 0x55);
+    gba_flash_write_address_byte(0xAAA, 0x90);
+
+    currAddr = 0x0000;
+    set_number(currAddr, SET_START_ADDRESS);
+    delay_ms(5);
+    set_mode(GBA_READ_ROM);
+    delay_ms(5);
+    com_read_bytes(READ_BUFFER, 64);
+    com_read_stop();
+    gba_flash_write_address_byte(0x000, 0xF0);
+
+    printf("\nFlash ID: 0x%X,0x%X,0x%X,0x%X\n", readBuffer[0],
+           readBuffer[1], readBuffer[2], readBuffer[3]);
+    if ((readBuffer[0] != 0x1 && readBuffer[0] != 0x89) ||
+        readBuffer[1] != 0x0 || readBuffer[2] != 0x7E ||
+        readBuffer[3] != 0x22) {
+      printf("\n\nChip ID doesn't match 0x1/0x89 0x0 0x7E 0x22. Please "
+             "re-seat the cartridge or press enter to continue anyway.\n");
+      read_one_letter();
+    }
 
-        // Read rom a tiny bit before writing
-        currAddr = 0x0000;
-        set_number(currAddr, SET_START_ADDRESS);
-        delay_ms(5);
-        set_mode(GBA_READ_ROM);
-        delay_ms(5);
-        com_read_bytes(READ_BUFFER, 64);
-        com_read_stop();
-
-        // Set end address as file size
-        endAddr = fileSize;
-        uint32_t endAddrAligned = fileSize;
-        while ((endAddrAligned / 64) % 64 !=
-               0) { // Align to 64 for printing progress
-          endAddrAligned--;
-        }
+    // Check if file is more than 16MB or using 32MB chip, if so, do a chip
+    // erase instead of sector by sector erase (sector by sector erase won't
+    // seem to work properly after 16MB because A24 is at GND)
+    uint8_t sectorEraseEnabled = 1;
+    if (fileSize > 0x1000000 ||
+        (readBuffer[0] == 0x89 && readBuffer[1] == 0x0 &&
+         readBuffer[2] == 0x7E && readBuffer[3] == 0x22)) {
+      sectorEraseEnabled = 0;
+      currAddr = 0x0000;
+      set_number(currAddr, SET_START_ADDRESS);
+      delay_ms(5);
+
+      if (fileSize > 0x1000000) {
+        printf(
+            "Chip erase as ROM file is more than 16MB, this can take 3-4 "
+            "minutes");
+      } else {
+        printf(
+            "Chip erase as ROM file is more than 8MB and using 32MB chip, "
+            "this can take 1-2 minutes");
+      }
+      gba_flash_write_address_byte(0xAAA, 0xAA);
+      gba_flash_write_address_byte(0x555, 0x55);
+      gba_flash_write_address_byte(0xAAA, 0x80);
+      gba_flash_write_address_byte(0xAAA, 0xAA);
+      gba_flash_write_address_byte(0x555, 0x55);
+      gba_flash_write_address_byte(0xAAA, 0x10);
+
+      // Wait for first 2 bytes to be 0xFF
+      wait_for_gba_flash_erase_ff(currAddr);
+      printf("\n");
+    }
 
-        // Verify chip ID
+    xmas_setup(endAddrAligned / 28);
+
+    printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    // Write ROM
+    currAddr = 0x0000;
+    set_number(currAddr, SET_START_ADDRESS);
+    delay_ms(5);
+    uint8_t addressMoved = 0; // Blank blocks skipped since the last write
+    while (currAddr < endAddr) {
+      // Sector erase only performed for under 16MB files
+      if (sectorEraseEnabled == 1 &&
+          currAddr % 0x10000 == 0) { // Erase next sector
         gba_flash_write_address_byte(0xAAA, 0xAA);
         gba_flash_write_address_byte(0x555, 0x55);
-        gba_flash_write_address_byte(0xAAA, 0x90);
+        gba_flash_write_address_byte(0xAAA, 0x80);
+        gba_flash_write_address_byte(0xAAA, 0xAA);
+        gba_flash_write_address_byte(0x555, 0x55);
+        gba_flash_write_address_byte((uint32_t)sector << 17, 0x30);
+        sector++;
 
-        currAddr = 0x0000;
-        set_number(currAddr, SET_START_ADDRESS);
-        delay_ms(5);
-        set_mode(GBA_READ_ROM);
+        // Wait for first 2 bytes to be 0xFF
+        wait_for_gba_flash_sector_ff(currAddr, 0xFF, 0xFF);
+
+        set_number(currAddr / 2, SET_START_ADDRESS); // Divide address by 2
         delay_ms(5);
-        com_read_bytes(READ_BUFFER, 64);
-        com_read_stop();
-        gba_flash_write_address_byte(0x000, 0xF0);
-
-        printf("\nFlash ID: 0x%X,0x%X,0x%X,0x%X\n", readBuffer[0],
-               readBuffer[1], readBuffer[2], readBuffer[3]);
-        if ((readBuffer[0] != 0x1 && readBuffer[0] != 0x89) ||
-            readBuffer[1] != 0x0 || readBuffer[2] != 0x7E ||
-            readBuffer[3] != 0x22) {
-          printf("\n\nChip ID doesn't match 0x1/0x89 0x0 0x7E 0x22. Please "
-                 "re-seat the cartridge or press enter to continue anyway.\n");
-          read_one_letter();
-        }
+      }
 
-        // Check if file is more than 16MB or using 32MB chip, if so, do a chip
-        // erase instead of sector by sector erase (sector by sector erase won't
-        // seem to work properly after 16MB because A24 is at GND)
-        uint8_t sectorEraseEnabled = 1;
-        if (fileSize > 0x1000000 ||
-            (readBuffer[0] == 0x89 && readBuffer[1] == 0x0 &&
-             readBuffer[2] == 0x7E && readBuffer[3] == 0x22)) {
-          sectorEraseEnabled = 0;
-          currAddr = 0x0000;
-          set_number(currAddr, SET_START_ADDRESS);
+      if (skip_blank_block(256) == 1) {
+        addressMoved = 1;
+      } else {
+        if (addressMoved == 1) {
+          set_number(currAddr / 2, SET_START_ADDRESS); // Divide address by 2
           delay_ms(5);
-
-          if (fileSize > 0x1000000) {
-            printf(
-                "Chip erase as ROM file is more than 16MB, this can take 3-4 "
-                "minutes");
-          } else {
-            printf(
-                "Chip erase as ROM file is more than 8MB and using 32MB chip, "
-                "this can take 1-2 minutes");
-          }
-          gba_flash_write_address_byte(0xAAA, 0xAA);
-          gba_flash_write_address_byte(0x555, 0x55);
-          gba_flash_write_address_byte(0xAAA, 0x80);
-          gba_flash_write_address_byte(0xAAA, 0xAA);
-          gba_flash_write_address_byte(0x555, 0x55);
-          gba_flash_write_address_byte(0xAAA, 0x10);
-
-          // Wait for first 2 bytes to be 0xFF
-          wait_for_gba_flash_erase_ff(currAddr);
-          printf("\n");
+          addressMoved = 0;
         }
+        rom_write_bytes(GBA_FLASH_WRITE_256BYTE, 256);
+        com_wait_for_ack();
+      }
+      currAddr += 256;
+      readBytes += 256;
 
-        xmas_setup(endAddrAligned / 28);
-
-        printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
-
-        // Write ROM
-        currAddr = 0x0000;
-        set_number(currAddr, SET_START_ADDRESS);
-        delay_ms(5);
-        while (currAddr < endAddr) {
-          // Sector erase only performed for under 16MB files
-          if (sectorEraseEnabled == 1 &&
-              currAddr % 0x10000 == 0) { // Erase next sector
-            gba_flash_write_address_byte(0xAAA, 0xAA);
-            gba_flash_write_address_byte(0x555, 0x55);
-            gba_flash_write_address_byte(0xAAA, 0x80);
-            gba_flash_write_address_byte(0xAAA, 0xAA);
-            gba_flash_write_address_byte(0x555, 0x55);
-            gba_flash_write_address_byte((uint32_t)sector << 17, 0x30);
-            sector++;
-
-            // Wait for first 2 bytes to be 0xFF
-            wait_for_gba_flash_sector_ff(currAddr, 0xFF, 0xFF);
-
-            set_number(currAddr / 2, SET_START_ADDRESS); // Divide address by 2
-            delay_ms(5);
-          }
-
-          com_write_bytes_from_file(GBA_FLASH_WRITE_256BYTE, romFile, 256);
-          com_wait_for_ack();
-          currAddr += 256;
-          readBytes += 256;
+      print_progress_percent(readBytes, endAddr / 64);
+      led_progress_percent(readBytes, endAddrAligned / 28);
 
-          print_progress_percent(readBytes, endAddr / 64);
-          led_progress_percent(readBytes, endAddrAligned / 28);
+      // Break when reaching 0x1FFF00 as this is when the EEPROM is mapped
+      // to
+      if (currAddr == 0x1FFFF00) {
+        break;
+      }
+    }
+  } else if (flashCartType == 41) {
+    printf("insideGadgets GBA 32MB RTC 1Mbit Flash Save Flash Cart\n");
+    printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+
+    // Check file size
+    if (fileSize > 0x2000000) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 32 MBytes\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    }
 
-          // Break when reaching 0x1FFF00 as this is when the EEPROM is mapped
-          // to
-          if (currAddr == 0x1FFFF00) {
-            break;
-          }
-        }
-      } else if (flashCartType == 41) {
-        printf("insideGadgets GBA 32MB RTC 1Mbit Flash Save Flash Cart\n");
-        printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+    // Read rom a tiny bit before writing
+    currAddr = 0x0000;
+    set_number(currAddr, SET_START_ADDRESS);
+    delay_ms(5);
+    set_mode(GBA_READ_ROM);
+    delay_ms(5);
+    com_read_bytes(READ_BUFFER, 64);
+    com_read_stop();
+
+    // Set end address as file size
+    endAddr = fileSize;
+    uint32_t endAddrAligned = fileSize;
+    while ((endAddrAligned / 64) % 64 !=
+           0) { // Align to 64 for printing progress
+      endAddrAligned--;
+    }
 
-        // Check file size
-        if (fileSize > 0x2000000) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 32 MBytes\n",
-              argv[1]);
-          read_one_letter();
-          return 1;
-        }
+    // Verify chip ID
+    gba_flash_write_address_byte(0xAAA, 0xAA);
+    gba_flash_write_address_byte(0x555, 0x55);
+    gba_flash_write_address_byte(0xAAA, 0x90);
+
+    currAddr = 0x0000;
+    set_number(currAddr, SET_START_ADDRESS);
+    delay_ms(5);
+    set_mode(GBA_READ_ROM);
+    delay_ms(5);
+    com_read_bytes(READ_BUFFER, 64);
+    com_read_stop();
+    gba_flash_write_address_byte(0x000, 0xF0);
+
+    printf("\nFlash ID: 0x%X,0x%X,0x%X,0x%X\n", readBuffer[0],
+           readBuffer[1], readBuffer[2], readBuffer[3]);
+    if (readBuffer[0] != 0x89 || readBuffer[1] != 0x0 ||
+        readBuffer[2] != 0x7E || readBuffer[3] != 0x22) {
+      printf("\n\nChip ID doesn't match 0x89 0x0 0x7E 0x22. Please re-seat "
+             "the cartridge or press enter to continue anyway.\n");
+      read_one_letter();
+    }
 
-        // Read rom a tiny bit before writing
-        currAddr = 0x0000;
-        set_number(currAddr, SET_START_ADDRESS);
-        delay_ms(5);
-        set_mode(GBA_READ_ROM);
-        delay_ms(5);
-        com_read_bytes(READ_BUFFER, 64);
-        com_read_stop();
-
-        // Set end address as file size
-        endAddr = fileSize;
-        uint32_t endAddrAligned = fileSize;
-        while ((endAddrAligned / 64) % 64 !=
-               0) { // Align to 64 for printing progress
-          endAddrAligned--;
-        }
+    // Check if file is more than 16MB, if so, do a chip erase instead of
+    // sector by sector erase (sector by sector erase won't seem to work
+    // properly after 16MB because A24 is at GND)
+    if (fileSize > 0x1000000) {
+      currAddr = 0x0000;
+      set_number(currAddr, SET_START_ADDRESS);
+      delay_ms(5);
+
+      printf("Chip erase as ROM file is more than 16MB, this can take 3-4 "
+             "minutes");
+      gba_flash_write_address_byte(0xAAA, 0xAA);
+      gba_flash_write_address_byte(0x555, 0x55);
+      gba_flash_write_address_byte(0xAAA, 0x80);
+      gba_flash_write_address_byte(0xAAA, 0xAA);
+      gba_flash_write_address_byte(0x555, 0x55);
+      gba_flash_write_address_byte(0xAAA, 0x10);
+
+      // Wait for first 2 bytes to be 0xFF
+      wait_for_gba_flash_erase_ff(currAddr);
+      printf("\n");
+    }
 
-        // Verify chip ID
+    xmas_setup(endAddr / 28);
+
+    printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    // Write ROM
+    currAddr = 0x0000;
+    set_number(currAddr, SET_START_ADDRESS);
+    delay_ms(5);
+    while (currAddr < endAddr) {
+      // Sector erase only performed for under 16MB files
+      if (fileSize <= 0x1000000 &&
+          currAddr % 0x10000 == 0) { // Erase next sector
+        gba_flash_write_address_byte(0xAAA, 0xAA);
+        gba_flash_write_address_byte(0x555, 0x55);
+        gba_flash_write_address_byte(0xAAA, 0x80);
         gba_flash_write_address_byte(0xAAA, 0xAA);
         gba_flash_write_address_byte(0x555, 0x55);
-        gba_flash_write_address_byte(0xAAA, 0x90);
+        gba_flash_write_address_byte((uint32_t)sector << 17, 0x30);
+        sector++;
 
-        currAddr = 0x0000;
-        set_number(currAddr, SET_START_ADDRESS);
-        delay_ms(5);
-        set_mode(GBA_READ_ROM);
+        // Wait for first 2 bytes to be 0xFF
+        wait_for_gba_flash_sector_ff(currAddr, 0xFF, 0xFF);
+
+        set_number(currAddr / 2, SET_START_ADDRESS); // Divide address by 2
         delay_ms(5);
-        com_read_bytes(READ_BUFFER, 64);
-        com_read_stop();
-        gba_flash_write_address_byte(0x000, 0xF0);
-
-        printf("\nFlash ID: 0x%X,0x%X,0x%X,0x%X\n", readBuffer[0],
-               readBuffer[1], readBuffer[2], readBuffer[3]);
-        if (readBuffer[0] != 0x89 || readBuffer[1] != 0x0 ||
-            readBuffer[2] != 0x7E || readBuffer[3] != 0x22) {
-          printf("\n\nChip ID doesn't match 0x89 0x0 0x7E 0x22. Please re-seat "
-                 "the cartridge or press enter to continue anyway.\n");
-          read_one_letter();
-        }
+      }
 
-        // Check if file is more than 16MB, if so, do a chip erase instead of
-        // sector by sector erase (sector by sector erase won't seem to work
-        // properly after 16MB because A24 is at GND)
-        if (fileSize > 0x1000000) {
-          currAddr = 0x0000;
-          set_number(currAddr, SET_START_ADDRESS);
-          delay_ms(5);
+      // Skip C4, C6, C8
+      if (currAddr == 0) {
+        uint8_t localbuffer[256];
+        rom_read(localbuffer, 256);
 
-          printf("Chip erase as ROM file is more than 16MB, this can take 3-4 "
-                 "minutes");
+        for (uint16_t x = 0; x < 256; x += 2) {
+          uint16_t combinedBytes =
+              (uint16_t)localbuffer[x + 1] << 8 | (uint16_t)localbuffer[x];
           gba_flash_write_address_byte(0xAAA, 0xAA);
           gba_flash_write_address_byte(0x555, 0x55);
-          gba_flash_write_address_byte(0xAAA, 0x80);
-          gba_flash_write_address_byte(0xAAA, 0xAA);
-          gba_flash_write_address_byte(0x555, 0x55);
-          gba_flash_write_address_byte(0xAAA, 0x10);
-
-          // Wait for first 2 bytes to be 0xFF
-          wait_for_gba_flash_erase_ff(currAddr);
-          printf("\n");
+          gba_flash_write_address_byte(0xAAA, 0xA0);
+          gba_flash_write_address_byte(currAddr, combinedBytes);
+          currAddr += 2;
+          readBytes += 2;
         }
 
-        xmas_setup(endAddr / 28);
-
-        printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
-
-        // Write ROM
-        currAddr = 0x0000;
-        set_number(currAddr, SET_START_ADDRESS);
+        currAddr = 0x100;
+        readBytes = 0x100;
+        set_number(currAddr / 2, SET_START_ADDRESS); // Divide address by 2
         delay_ms(5);
-        while (currAddr < endAddr) {
-          // Sector erase only performed for under 16MB files
-          if (fileSize <= 0x1000000 &&
-              currAddr % 0x10000 == 0) { // Erase next sector
-            gba_flash_write_address_byte(0xAAA, 0xAA);
-            gba_flash_write_address_byte(0x555, 0x55);
-            gba_flash_write_address_byte(0xAAA, 0x80);
-            gba_flash_write_address_byte(0xAAA, 0xAA);
-            gba_flash_write_address_byte(0x555, 0x55);
-            gba_flash_write_address_byte((uint32_t)sector << 17, 0x30);
-            sector++;
-
-            // Wait for first 2 bytes to be 0xFF
-            wait_for_gba_flash_sector_ff(currAddr, 0xFF, 0xFF);
-
-            set_number(currAddr / 2, SET_START_ADDRESS); // Divide address by 2
-            delay_ms(5);
-          }
-
-          // Skip C4, C6, C8
-          if (currAddr == 0) {
-            uint8_t localbuffer[256];
-            fread(&localbuffer, 1, 256, romFile);
-
-            for (uint16_t x = 0; x < 256; x += 2) {
-              uint16_t combinedBytes =
-                  (uint16_t)localbuffer[x + 1] << 8 | (uint16_t)localbuffer[x];
-              gba_flash_write_address_byte(0xAAA, 0xAA);
-              gba_flash_write_address_byte(0x555, 0x55);
-              gba_flash_write_address_byte(0xAAA, 0xA0);
-              gba_flash_write_address_byte(currAddr, combinedBytes);
-              currAddr += 2;
-              readBytes += 2;
-            }
+      } else {
+        rom_write_bytes(GBA_FLASH_WRITE_256BYTE, 256);
+        com_wait_for_ack();
+        currAddr += 256;
+        readBytes += 256;
+      }
 
-            currAddr = 0x100;
-            readBytes = 0x100;
-            set_number(currAddr / 2, SET_START_ADDRESS); // Divide address by 2
-            delay_ms(5);
-          } else {
-            com_write_bytes_from_file(GBA_FLASH_WRITE_256BYTE, romFile, 256);
-            com_wait_for_ack();
-            currAddr += 256;
-            readBytes += 256;
-          }
+      print_progress_percent(readBytes, endAddrAligned / 64);
+      led_progress_percent(readBytes, endAddrAligned / 28);
+    }
+  } else if (flashCartType == 43) {
+    printf("insideGadgets GBA 16MB 64K EEPROM Solar+RTC Flash Cart\n");
+    printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+
+    // Check file size
+    if (fileSize > 0x1000000) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 16 MBytes\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    }
 
-          print_progress_percent(readBytes, endAddrAligned / 64);
-          led_progress_percent(readBytes, endAddrAligned / 28);
-        }
-      } else if (flashCartType == 43) {
-        printf("insideGadgets GBA 16MB 64K EEPROM Solar+RTC Flash Cart\n");
-        printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+    // Read rom a tiny bit before writing
+    currAddr = 0x0000;
+    set_number(currAddr, SET_START_ADDRESS);
+    delay_ms(5);
+    set_mode(GBA_READ_ROM);
+    delay_ms(5);
+    com_read_bytes(READ_BUFFER, 64);
+    com_read_stop();
+
+    // Set end address as file size
+    endAddr = fileSize;
+    uint32_t endAddrAligned = fileSize;
+    while ((endAddrAligned / 64) % 64 !=
+           0) { // Align to 64 for printing progress
+      endAddrAligned--;
+    }
 
-        // Check file size
-        if (fileSize > 0x1000000) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 16 MBytes\n",
-              argv[1]);
-          read_one_letter();
-          return 1;
-        }
+    // Verify chip ID
+    gba_flash_write_address_byte(0xAAA, 0xAA);
+    gba_flash_write_address_byte(0x555, 0x55);
+    gba_flash_write_address_byte(0xAAA, 0x90);
+
+    currAddr = 0x0000;
+    set_number(currAddr, SET_START_ADDRESS);
+    delay_ms(5);
+    set_mode(GBA_READ_ROM);
+    delay_ms(5);
+    com_read_bytes(READ_BUFFER, 64);
+    com_read_stop();
+    gba_flash_write_address_byte(0x000, 0xF0);
+
+    printf("\nFlash ID: 0x%X,0x%X,0x%X,0x%X\n", readBuffer[0],
+           readBuffer[1], readBuffer[2], readBuffer[3]);
+    if (readBuffer[0] != 0x89 || readBuffer[1] != 0x0 ||
+        readBuffer[2] != 0x7E || readBuffer[3] != 0x22) {
+      printf("\n\nChip ID doesn't match 0x89 0x0 0x7E 0x22. Please re-seat "
+             "the cartridge or press enter to continue anyway.\n");
+      read_one_letter();
+    }
 
-        // Read rom a tiny bit before writing
-        currAddr = 0x0000;
-        set_number(currAddr, SET_START_ADDRESS);
-        delay_ms(5);
-        set_mode(GBA_READ_ROM);
-        delay_ms(5);
-        com_read_bytes(READ_BUFFER, 64);
-        com_read_stop();
-
-        // Set end address as file size
-        endAddr = fileSize;
-        uint32_t endAddrAligned = fileSize;
-        while ((endAddrAligned / 64) % 64 !=
-               0) { // Align to 64 for printing progress
-          endAddrAligned--;
-        }
+    // Check if file is more than 8MB, if so, do a chip erase instead of
+    // sector by sector erase (sector by sector erase won't seem to work
+    // properly after 16MB because A23 triggers EEPROM)
+    if (fileSize > 0x800000) {
+      currAddr = 0x0000;
+      set_number(currAddr, SET_START_ADDRESS);
+      delay_ms(5);
+
+      printf("Chip erase as ROM file is more than 8MB, this can take 3-4 "
+             "minutes");
+      gba_flash_write_address_byte(0xAAA, 0xAA);
+      gba_flash_write_address_byte(0x555, 0x55);
+      gba_flash_write_address_byte(0xAAA, 0x80);
+      gba_flash_write_address_byte(0xAAA, 0xAA);
+      gba_flash_write_address_byte(0x555, 0x55);
+      gba_flash_write_address_byte(0xAAA, 0x10);
+
+      // Wait for first 2 bytes to be 0xFF
+      wait_for_gba_flash_erase_ff(currAddr);
+      printf("\n");
+    }
 
-        // Verify chip ID
+    xmas_setup(endAddr / 28);
+
+    printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    // Write ROM
+    currAddr = 0x0000;
+    set_number(currAddr, SET_START_ADDRESS);
+    delay_ms(5);
+    while (currAddr < endAddr) {
+      // Sector erase only performed for under 16MB files
+      if (fileSize <= 0x800000 &&
+          currAddr % 0x10000 == 0) { // Erase next sector
+        gba_flash_write_address_byte(0xAAA, 0xAA);
+        gba_flash_write_address_byte(0x555, 0x55);
+        gba_flash_write_address_byte(0xAAA, 0x80);
         gba_flash_write_address_byte(0xAAA, 0xAA);
         gba_flash_write_address_byte(0x555, 0x55);
-        gba_flash_write_address_byte(0xAAA, 0x90);
+        gba_flash_write_address_byte((uint32_t)sector << 17, 0x30);
+        sector++;
 
-        currAddr = 0x0000;
-        set_number(currAddr, SET_START_ADDRESS);
-        delay_ms(5);
-        set_mode(GBA_READ_ROM);
+        // Wait for first 2 bytes to be 0xFF
+        wait_for_gba_flash_sector_ff(currAddr, 0xFF, 0xFF);
+
+        set_number(currAddr / 2, SET_START_ADDRESS); // Divide address by 2
         delay_ms(5);
-        com_read_bytes(READ_BUFFER, 64);
-        com_read_stop();
-        gba_flash_write_address_byte(0x000, 0xF0);
-
-        printf("\nFlash ID: 0x%X,0x%X,0x%X,0x%X\n", readBuffer[0],
-               readBuffer[1], readBuffer[2], readBuffer[3]);
-        if (readBuffer[0] != 0x89 || readBuffer[1] != 0x0 ||
-            readBuffer[2] != 0x7E || readBuffer[3] != 0x22) {
-          printf("\n\nChip ID doesn't match 0x89 0x0 0x7E 0x22. Please re-seat "
-                 "the cartridge or press enter to continue anyway.\n");
-          read_one_letter();
-        }
+      }
 
-        // Check if file is more than 8MB, if so, do a chip erase instead of
-        // sector by sector erase (sector by sector erase won't seem to work
-        // properly after 16MB because A23 triggers EEPROM)
-        if (fileSize > 0x800000) {
-          currAddr = 0x0000;
-          set_number(currAddr, SET_START_ADDRESS);
-          delay_ms(5);
+      // Skip C4, C6, C8
+      if (currAddr == 0) {
+        uint8_t localbuffer[256];
+        rom_read(localbuffer, 256);
 
-          printf("Chip erase as ROM file is more than 8MB, this can take 3-4 "
-                 "minutes");
+        for (uint16_t x = 0; x < 256; x += 2) {
+          uint16_t combinedBytes =
+              (uint16_t)localbuffer[x + 1] << 8 | (uint16_t)localbuffer[x];
           gba_flash_write_address_byte(0xAAA, 0xAA);
           gba_flash_write_address_byte(0x555, 0x55);
-          gba_flash_write_address_byte(0xAAA, 0x80);
-          gba_flash_write_address_byte(0xAAA, 0xAA);
-          gba_flash_write_address_byte(0x555, 0x55);
-          gba_flash_write_address_byte(0xAAA, 0x10);
-
-          // Wait for first 2 bytes to be 0xFF
-          wait_for_gba_flash_erase_ff(currAddr);
-          printf("\n");
+          gba_flash_write_address_byte(0xAAA, 0xA0);
+          gba_flash_write_address_byte(currAddr, combinedBytes);
+          currAddr += 2;
+          readBytes += 2;
         }
 
-        xmas_setup(endAddr / 28);
-
-        printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
-
-        // Write ROM
-        currAddr = 0x0000;
-        set_number(currAddr, SET_START_ADDRESS);
-        delay_ms(5);
-        while (currAddr < endAddr) {
-          // Sector erase only performed for under 16MB files
-          if (fileSize <= 0x800000 &&
-              currAddr % 0x10000 == 0) { // Erase next sector
-            gba_flash_write_address_byte(0xAAA, 0xAA);
-            gba_flash_write_address_byte(0x555, 0x55);
-            gba_flash_write_address_byte(0xAAA, 0x80);
-            gba_flash_write_address_byte(0xAAA, 0xAA);
-            gba_flash_write_address_byte(0x555, 0x55);
-            gba_flash_write_address_byte((uint32_t)sector << 17, 0x30);
-            sector++;
-
-            // Wait for first 2 bytes to be 0xFF
-            wait_for_gba_flash_sector_ff(currAddr, 0xFF, 0xFF);
-
-            set_number(currAddr / 2, SET_START_ADDRESS); // Divide address by 2
-            delay_ms(5);
-          }
-
-          // Skip C4, C6, C8
-          if (currAddr == 0) {
-            uint8_t localbuffer[256];
-            fread(&localbuffer, 1, 256, romFile);
-
-            for (uint16_t x = 0; x < 256; x += 2) {
-              uint16_t combinedBytes =
-                  (uint16_t)localbuffer[x + 1] << 8 | (uint16_t)localbuffer[x];
-              gba_flash_write_address_byte(0xAAA, 0xAA);
-              gba_flash_write_address_byte(0x555, 0x55);
-              gba_flash_write_address_byte(0xAAA, 0xA0);
-              gba_flash_write_address_byte(currAddr, combinedBytes);
-              currAddr += 2;
-              readBytes += 2;
-            }
-
-            currAddr = 0x100;
-            readBytes = 0x100;
-            set_number(currAddr / 2, SET_START_ADDRESS); // Divide address by 2
-            delay_ms(5);
-          } else {
-            com_write_bytes_from_file(GBA_FLASH_WRITE_256BYTE, romFile, 256);
-            com_wait_for_ack();
-            currAddr += 256;
-            readBytes += 256;
-          }
-
-          print_progress_percent(readBytes, endAddrAligned / 64);
-          led_progress_percent(readBytes, endAddrAligned / 28);
-        }
-      } else if (flashCartType == 21) {
-        printf(
-            "16 MByte (MSP55LV128 / 29LV128DTMC) Gameboy Advance Flash Cart\n");
-        printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
-
-        // Check file size
-        if (fileSize > 0x1000000) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 16 MBytes\n",
-              argv[1]);
-          read_one_letter();
-          return 1;
-        }
-
-        printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
-
-        // Read rom a tiny bit before writing
-        currAddr = 0x0000;
-        set_number(currAddr, SET_START_ADDRESS);
+        currAddr = 0x100;
+        readBytes = 0x100;
+        set_number(currAddr / 2, SET_START_ADDRESS); // Divide address by 2
         delay_ms(5);
-        set_mode(GBA_READ_ROM);
-        delay_ms(5);
-        com_read_bytes(READ_BUFFER, 64);
-        com_read_stop();
-
-        // Set end address as file size
-        endAddr = fileSize;
-        uint32_t endAddrAligned = fileSize;
-        while ((endAddrAligned / 64) % 64 !=
-               0) { // Align to 64 for printing progress
-          endAddrAligned--;
-        }
-
-        xmas_setup(endAddrAligned / 28);
-
-        // Write ROM
-        currAddr = 0x0000;
-        set_number(currAddr, SET_START_ADDRESS);
-        delay_ms(5);
-        while (currAddr < endAddr) {
-          if (currAddr % 0x10000 == 0) { // Erase next sector
-            gba_flash_write_address_byte(0xAAA, 0xA9);
-            gba_flash_write_address_byte(0x555, 0x56);
-            gba_flash_write_address_byte(0xAAA, 0x80);
-            gba_flash_write_address_byte(0xAAA, 0xA9);
-            gba_flash_write_address_byte(0x555, 0x56);
-            gba_flash_write_address_byte((uint32_t)sector << 16, 0x30);
-            sector++;
-
-            // Wait for first 2 bytes to be 0xFF
-            wait_for_gba_flash_sector_ff(currAddr, 0xFF, 0xFF);
-
-            set_number(currAddr / 2, SET_START_ADDRESS); // Divide address by 2
-            delay_ms(5);
-          }
-
-          com_write_bytes_from_file(GBA_FLASH_WRITE_256BYTE_SWAPPED_D0D1,
-                                    romFile, 256);
-          com_wait_for_ack();
-          currAddr += 256;
-          readBytes += 256;
+      } else {
+        rom_write_bytes(GBA_FLASH_WRITE_256BYTE, 256);
+        com_wait_for_ack();
+        currAddr += 256;
+        readBytes += 256;
+      }
 
-          print_progress_percent(readBytes, endAddrAligned / 64);
-          led_progress_percent(readBytes, endAddrAligned / 28);
-        }
-      } else if (flashCartType == 22) {
-        printf("16 MByte (MSP55LV128M / 29GL128EHMC / MX29GL128ELT / M29W128 / "
-               "S29GL128) / 32MB (256M29EWH) Gameboy Advance Flash Cart\n");
-        printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
-
-        // Check file size
-        if (fileSize > 0x2000000) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 32 MBytes\n",
-              argv[1]);
-          read_one_letter();
-          return 1;
-        }
+      print_progress_percent(readBytes, endAddrAligned / 64);
+      led_progress_percent(readBytes, endAddrAligned / 28);
+    }
+  } else if (flashCartType == 21) {
+    printf(
+        "16 MByte (MSP55LV128 / 29LV128DTMC) Gameboy Advance Flash Cart\n");
+    printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+
+    // Check file size
+    if (fileSize > 0x1000000) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 16 MBytes\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    }
 
-        printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
+    printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    // Read rom a tiny bit before writing
+    currAddr = 0x0000;
+    set_number(currAddr, SET_START_ADDRESS);
+    delay_ms(5);
+    set_mode(GBA_READ_ROM);
+    delay_ms(5);
+    com_read_bytes(READ_BUFFER, 64);
+    com_read_stop();
+
+    // Set end address as file size
+    endAddr = fileSize;
+    uint32_t endAddrAligned = fileSize;
+    while ((endAddrAligned / 64) % 64 !=
+           0) { // Align to 64 for printing progress
+      endAddrAligned--;
+    }
 
-        // Read rom a tiny bit before writing
-        currAddr = 0x0000;
-        set_number(currAddr, SET_START_ADDRESS);
-        delay_ms(5);
-        set_mode(GBA_READ_ROM);
+    xmas_setup(endAddrAligned / 28);
+
+    // Write ROM
+    currAddr = 0x0000;
+    set_number(currAddr, SET_START_ADDRESS);
+    delay_ms(5);
+    while (currAddr < endAddr) {
+      if (currAddr % 0x10000 == 0) { // Erase next sector
+        gba_flash_write_address_byte(0xAAA, 0xA9);
+        gba_flash_write_address_byte(0x555, 0x56);
+        gba_flash_write_address_byte(0xAAA, 0x80);
+        gba_flash_write_address_byte(0xAAA, 0xA9);
+        gba_flash_write_address_byte(0x555, 0x56);
+        gba_flash_write_address_byte((uint32_t)sector << 16, 0x30);
+        sector++;
+
+        // Wait for first 2 bytes to be 0xFF
+        wait_for_gba_flash_sector_ff(currAddr, 0xFF, 0xFF);
+
+        set_number(currAddr / 2, SET_START_ADDRESS); // Divide address by 2
         delay_ms(5);
-        com_read_bytes(READ_BUFFER, 64);
-        com_read_stop();
-
-        // Set end address as file size
-        endAddr = fileSize;
-        uint32_t endAddrAligned = fileSize;
-        while ((endAddrAligned / 64) % 64 !=
-               0) { // Align to 64 for printing progress
-          endAddrAligned--;
-        }
+      }
 
-        xmas_setup(endAddrAligned / 28);
+      rom_write_bytes(GBA_FLASH_WRITE_256BYTE_SWAPPED_D0D1, 256);
+      com_wait_for_ack();
+      currAddr += 256;
+      readBytes += 256;
 
-        // Write ROM
-        currAddr = 0x0000;
-        set_number(currAddr, SET_START_ADDRESS);
+      print_progress_percent(readBytes, endAddrAligned / 64);
+      led_progress_percent(readBytes, endAddrAligned / 28);
+    }
+  } else if (flashCartType == 22) {
+    printf("16 MByte (MSP55LV128M / 29GL128EHMC / MX29GL128ELT / M29W128 / "
+           "S29GL128) / 32MB (256M29EWH) Gameboy Advance Flash Cart\n");
+    printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+
+    // Check file size
+    if (fileSize > 0x2000000) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 32 MBytes\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    }
+
+    printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    // Read rom a tiny bit before writing
+    currAddr = 0x0000;
+    set_number(currAddr, SET_START_ADDRESS);
+    delay_ms(5);
+    set_mode(GBA_READ_ROM);
+    delay_ms(5);
+    com_read_bytes(READ_BUFFER, 64);
+    com_read_stop();
+
+    // Set end address as file size
+    endAddr = fileSize;
+    uint32_t endAddrAligned = fileSize;
+    while ((endAddrAligned / 64) % 64 !=
+           0) { // Align to 64 for printing progress
+      endAddrAligned--;
+    }
+
+    xmas_setup(endAddrAligned / 28);
+
+    // Write ROM
+    currAddr = 0x0000;
+    set_number(currAddr, SET_START_ADDRESS);
+    delay_ms(5);
+    while (currAddr < endAddr) {
+      if (currAddr % 0x20000 == 0) { // Erase next sector
+        gba_flash_write_address_byte(0xAAA, 0xA9);
+        gba_flash_write_address_byte(0x555, 0x56);
+        gba_flash_write_address_byte(0xAAA, 0x80);
+        gba_flash_write_address_byte(0xAAA, 0xA9);
+        gba_flash_write_address_byte(0x555, 0x56);
+        gba_flash_write_address_byte((uint32_t)sector << 17, 0x30);
+        sector++;
+
+        // Wait for first 2 bytes to be 0xFF
+        wait_for_gba_flash_sector_ff(currAddr, 0xFF, 0xFF);
+
+        set_number(currAddr / 2, SET_START_ADDRESS); // Divide address by 2
         delay_ms(5);
-        while (currAddr < endAddr) {
-          if (currAddr % 0x20000 == 0) { // Erase next sector
-            gba_flash_write_address_byte(0xAAA, 0xA9);
-            gba_flash_write_address_byte(0x555, 0x56);
-            gba_flash_write_address_byte(0xAAA, 0x80);
-            gba_flash_write_address_byte(0xAAA, 0xA9);
-            gba_flash_write_address_byte(0x555, 0x56);
-            gba_flash_write_address_byte((uint32_t)sector << 17, 0x30);
-            sector++;
-
-            // Wait for first 2 bytes to be 0xFF
-            wait_for_gba_flash_sector_ff(currAddr, 0xFF, 0xFF);
-
-            set_number(currAddr / 2, SET_START_ADDRESS); // Divide address by 2
-            delay_ms(5);
-          }
+      }
 
-          com_write_bytes_from_file(GBA_FLASH_WRITE_256BYTE_SWAPPED_D0D1,
-                                    romFile, 256);
-          com_wait_for_ack();
-          currAddr += 256;
-          readBytes += 256;
+      rom_write_bytes(GBA_FLASH_WRITE_256BYTE_SWAPPED_D0D1, 256);
+      com_wait_for_ack();
+      currAddr += 256;
+      readBytes += 256;
 
-          print_progress_percent(readBytes, endAddrAligned / 64);
-          led_progress_percent(readBytes, endAddrAligned / 28);
-        }
-      } else if (flashCartType == 23 || flashCartType == 24) {
-        if (flashCartType == 23) {
-          printf("16 MByte M36L0R706 / 32 MByte 256L30B / 4455LLZBQO / "
-                 "4000L0YBQ0 Gameboy Advance Flash Cart\n");
-        } else {
-          printf(
-              "16 MByte M36L0R706 (2) / 32 MByte 256L30B (2) / 4455LLZBQO (2) "
-              "/ 4000L0YBQ0 (2) Gameboy Advance Flash Cart\n");
-        }
+      print_progress_percent(readBytes, endAddrAligned / 64);
+      led_progress_percent(readBytes, endAddrAligned / 28);
+    }
+  } else if (flashCartType == 23 || flashCartType == 24) {
+    if (flashCartType == 23) {
+      printf("16 MByte M36L0R706 / 32 MByte 256L30B / 4455LLZBQO / "
+             "4000L0YBQ0 Gameboy Advance Flash Cart\n");
+    } else {
+      printf(
+          "16 MByte M36L0R706 (2) / 32 MByte 256L30B (2) / 4455LLZBQO (2) "
+          "/ 4000L0YBQ0 (2) Gameboy Advance Flash Cart\n");
+    }
 
-        printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+    printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
 
-        // Check file size
-        if (fileSize > 0x2000000) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 32 MBytes\n",
-              argv[1]);
-          read_one_letter();
-          return 1;
-        }
+    // Check file size
+    if (fileSize > 0x2000000) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 32 MBytes\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    }
 
-        printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
+    printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    // Set to reading mode
+    currAddr = 0x0000;
+    gba_flash_write_address_byte(currAddr, 0xFF);
+    delay_ms(5);
+
+    // Read rom a tiny bit before writing
+    currAddr = 0x0000;
+    set_number(currAddr, SET_START_ADDRESS);
+    delay_ms(5);
+    set_mode(GBA_READ_ROM);
+    delay_ms(5);
+    com_read_bytes(READ_BUFFER, 64);
+    com_read_stop();
+
+    // Set end address as file size
+    endAddr = fileSize;
+    uint32_t endAddrAligned = fileSize;
+    while ((endAddrAligned / 64) % 64 !=
+           0) { // Align to 64 for printing progress
+      endAddrAligned--;
+    }
 
-        // Set to reading mode
-        currAddr = 0x0000;
-        gba_flash_write_address_byte(currAddr, 0xFF);
-        delay_ms(5);
+    // Flash ID command
+    gba_flash_write_address_byte(0x00, 0x90);
+    delay_ms(1);
+
+    // Read ID
+    set_number(0x00, SET_START_ADDRESS);
+    set_mode(GBA_READ_ROM);
+    com_read_bytes(READ_BUFFER, 64);
+    com_read_stop(); // End read
+
+    // For chips with 4x 16K sectors at the start
+    // 256L30B (0x8A, 0x0, 0x15, 0x88)
+    int sectorEraseAddress = 0x20000;
+    if (readBuffer[0] == 0x8A && readBuffer[1] == 0 &&
+        readBuffer[2] == 0x15 && readBuffer[3] == 0x88) {
+      sectorEraseAddress = 0x8000;
+    }
+    // 4000L0YBQ0 (0x8A, 0x0, 0x10, 0x88)
+    else if (readBuffer[0] == 0x8A && readBuffer[1] == 0 &&
+             readBuffer[2] == 0x10 && readBuffer[3] == 0x88) {
+      sectorEraseAddress = 0x8000;
+    }
 
-        // Read rom a tiny bit before writing
-        currAddr = 0x0000;
-        set_number(currAddr, SET_START_ADDRESS);
-        delay_ms(5);
-        set_mode(GBA_READ_ROM);
-        delay_ms(5);
-        com_read_bytes(READ_BUFFER, 64);
-        com_read_stop();
-
-        // Set end address as file size
-        endAddr = fileSize;
-        uint32_t endAddrAligned = fileSize;
-        while ((endAddrAligned / 64) % 64 !=
-               0) { // Align to 64 for printing progress
-          endAddrAligned--;
-        }
+    // Back to reading mode
+    gba_flash_write_address_byte(currAddr, 0xFF);
+    delay_ms(5);
 
-        // Flash ID command
-        gba_flash_write_address_byte(0x00, 0x90);
-        delay_ms(1);
+    xmas_setup(endAddrAligned / 28);
 
-        // Read ID
-        set_number(0x00, SET_START_ADDRESS);
-        set_mode(GBA_READ_ROM);
-        com_read_bytes(READ_BUFFER, 64);
-        com_read_stop(); // End read
+    // Write ROM
+    currAddr = 0x0000;
+    set_number(currAddr, SET_START_ADDRESS);
+    uint32_t addressForManualWrite = 0x7FC0;
 
-        // For chips with 4x 16K sectors at the start
-        // 256L30B (0x8A, 0x0, 0x15, 0x88)
-        int sectorEraseAddress = 0x20000;
-        if (readBuffer[0] == 0x8A && readBuffer[1] == 0 &&
-            readBuffer[2] == 0x15 && readBuffer[3] == 0x88) {
-          sectorEraseAddress = 0x8000;
-        }
-        // 4000L0YBQ0 (0x8A, 0x0, 0x10, 0x88)
-        else if (readBuffer[0] == 0x8A && readBuffer[1] == 0 &&
-                 readBuffer[2] == 0x10 && readBuffer[3] == 0x88) {
-          sectorEraseAddress = 0x8000;
+    while (currAddr < endAddr) {
+      if (currAddr % sectorEraseAddress == 0) { // Erase next sector
+        // For chips with 4x 16K sectors, after 64K, change to 0x20000
+        // sector size
+        if (currAddr >= 0x20000 && sectorEraseAddress == 0x8000) {
+          sectorEraseAddress = 0x20000;
         }
 
+        // Unlock
+        gba_flash_write_address_byte(currAddr, 0x60);
+        gba_flash_write_address_byte(currAddr, 0xD0);
+
+        // Erase
+        gba_flash_write_address_byte(currAddr, 0x20);
+        gba_flash_write_address_byte(currAddr, 0xD0);
+        delay_ms(50);
+
+        // Wait for first 2 bytes to be 0x80, 0xB0
+        wait_for_gba_flash_sector_ff(currAddr, 0x80, 0xB0);
+
         // Back to reading mode
         gba_flash_write_address_byte(currAddr, 0xFF);
         delay_ms(5);
 
-        xmas_setup(endAddrAligned / 28);
+        set_number(currAddr / 2, SET_START_ADDRESS); // Divide address by 2
+        delay_ms(5);
+      }
 
-        // Write ROM
-        currAddr = 0x0000;
-        set_number(currAddr, SET_START_ADDRESS);
-        uint32_t addressForManualWrite = 0x7FC0;
+      // Standard buffered writing
+      if (flashCartType == 23) {
+        rom_write_bytes(GBA_FLASH_WRITE_INTEL_64BYTE, 64);
+        com_wait_for_ack();
+        currAddr += 64;
+        readBytes += 64;
+      } else {
+        // It seems that some carts don't allow us to use the buffered 32
+        // byte programming mode for 0x7FC0 to 0x7FFF and it also happens at
+        // 0xFFC0 to 0xFFFF and so on. We just write each of the 32 bytes
+        // one byte at a time.
+        if (currAddr > 0 && currAddr == addressForManualWrite) {
+          uint8_t localbuffer[64];
+          rom_read(localbuffer, 64);
+
+          for (uint8_t x = 0; x < 64; x += 2) {
+            uint16_t combinedBytes = (uint16_t)localbuffer[x + 1] << 8 |
+                                     (uint16_t)localbuffer[x];
+            gba_flash_write_address_byte(currAddr, 0x40);
+            gba_flash_write_address_byte(currAddr, combinedBytes);
+            currAddr += 2;
+            readBytes += 2;
+          }
+          addressForManualWrite += 0x8000;
 
-        while (currAddr < endAddr) {
-          if (currAddr % sectorEraseAddress == 0) { // Erase next sector
-            // For chips with 4x 16K sectors, after 64K, change to 0x20000
-            // sector size
-            if (currAddr >= 0x20000 && sectorEraseAddress == 0x8000) {
-              sectorEraseAddress = 0x20000;
-            }
+          // Set address again (seems to be needed at and after 0x27C0)
+          set_number(currAddr / 2,
+                     SET_START_ADDRESS); // Divide address by 2
+          delay_ms(5);
+        } else {
+          rom_write_bytes(GBA_FLASH_WRITE_INTEL_64BYTE, 64);
+          com_wait_for_ack();
+          currAddr += 64;
+          readBytes += 64;
+        }
+      }
+      print_progress_percent(readBytes, endAddrAligned / 64);
+      led_progress_percent(readBytes, endAddrAligned / 28);
+    }
 
-            // Unlock
-            gba_flash_write_address_byte(currAddr, 0x60);
-            gba_flash_write_address_byte(currAddr, 0xD0);
+    // Back to reading mode
+    gba_flash_write_address_byte(currAddr, 0xFF);
+    delay_ms(5);
+  } else if (flashCartType == 25) {
+    printf("16 MByte GE28F128W30 Gameboy Advance Flash Cart\n");
+    printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+
+    // Check file size
+    if (fileSize > 0x1000000) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 16 MBytes\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    }
 
-            // Erase
-            gba_flash_write_address_byte(currAddr, 0x20);
-            gba_flash_write_address_byte(currAddr, 0xD0);
-            delay_ms(50);
+    if (gbxcartFirmwareVersion <= 14) {
+      printf(
+          "Firmware R15 or higher is required for this functionality.\n");
+      read_one_letter();
+      return 1;
+    }
 
-            // Wait for first 2 bytes to be 0x80, 0xB0
-            wait_for_gba_flash_sector_ff(currAddr, 0x80, 0xB0);
+    printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    // Set to reading mode
+    currAddr = 0x0000;
+    gba_flash_write_address_byte(currAddr, 0xFF);
+    delay_ms(5);
+
+    // Read rom a tiny bit before writing
+    currAddr = 0x0000;
+    set_number(currAddr, SET_START_ADDRESS);
+    delay_ms(5);
+    set_mode(GBA_READ_ROM);
+    delay_ms(5);
+    com_read_bytes(READ_BUFFER, 64);
+    com_read_stop();
+
+    // Set end address as file size
+    endAddr = fileSize;
+    uint32_t endAddrAligned = fileSize;
+    while ((endAddrAligned / 64) % 64 !=
+           0) { // Align to 64 for printing progress
+      endAddrAligned--;
+    }
 
-            // Back to reading mode
-            gba_flash_write_address_byte(currAddr, 0xFF);
-            delay_ms(5);
+    // Flash ID command
+    gba_flash_write_address_byte(0x00, 0x90);
+    delay_ms(1);
+
+    // Read ID
+    set_number(0x00, SET_START_ADDRESS);
+    delay_ms(5);
+    set_mode(GBA_READ_ROM);
+    delay_ms(5);
+    com_read_bytes(READ_BUFFER, 64);
+    com_read_stop(); // End read
+
+    // Sector erase length
+    uint8_t flashIDType = 0;
+    int sectorEraseAddress = 0x10000;
+
+    // 28F128W30 (0x8A, 0x0, 0x5x, 0x88)
+    if (readBuffer[0] == 0x8A && readBuffer[1] == 0 &&
+        (readBuffer[2] & 0xF8) == 0x50 && readBuffer[3] == 0x88) {
+      sectorEraseAddress = 0x2000; // 8K sectors at start
+    }
+    //  (0x8A, 0x0, 0x15, 0x88)
+    else if (readBuffer[0] == 0x8A && readBuffer[1] == 0 &&
+             readBuffer[2] == 0x15 && readBuffer[3] == 0x88) {
+      sectorEraseAddress = 0x2000; // 8K sectors at start
+      flashIDType = 1;
+    }
 
-            set_number(currAddr / 2, SET_START_ADDRESS); // Divide address by 2
-            delay_ms(5);
-          }
+    // Back to reading mode
+    gba_flash_write_address_byte(currAddr, 0xFF);
+    delay_ms(5);
 
-          // Standard buffered writing
-          if (flashCartType == 23) {
-            com_write_bytes_from_file(GBA_FLASH_WRITE_INTEL_64BYTE, romFile,
-                                      64);
-            com_wait_for_ack();
-            currAddr += 64;
-            readBytes += 64;
-          } else {
-            // It seems that some carts don't allow us to use the buffered 32
-            // byte programming mode for 0x7FC0 to 0x7FFF and it also happens at
-            // 0xFFC0 to 0xFFFF and so on. We just write each of the 32 bytes
-            // one byte at a time.
-            if (currAddr > 0 && currAddr == addressForManualWrite) {
-              uint8_t localbuffer[64];
-              fread(&localbuffer, 1, 64, romFile);
-
-              for (uint8_t x = 0; x < 64; x += 2) {
-                uint16_t combinedBytes = (uint16_t)localbuffer[x + 1] << 8 |
-                                         (uint16_t)localbuffer[x];
-                gba_flash_write_address_byte(currAddr, 0x40);
-                gba_flash_write_address_byte(currAddr, combinedBytes);
-                currAddr += 2;
-                readBytes += 2;
-              }
-              addressForManualWrite += 0x8000;
+    // Write ROM
+    currAddr = 0x0000;
+    set_number(currAddr, SET_START_ADDRESS);
+    delay_ms(5);
 
-              // Set address again (seems to be needed at and after 0x27C0)
-              set_number(currAddr / 2,
-                         SET_START_ADDRESS); // Divide address by 2
-              delay_ms(5);
-            } else {
-              com_write_bytes_from_file(GBA_FLASH_WRITE_INTEL_64BYTE, romFile,
-                                        64);
-              com_wait_for_ack();
-              currAddr += 64;
-              readBytes += 64;
-            }
-          }
-          print_progress_percent(readBytes, endAddrAligned / 64);
-          led_progress_percent(readBytes, endAddrAligned / 28);
+    while (currAddr < endAddr) {
+      if (currAddr % sectorEraseAddress == 0) { // Erase next sector
+        // For chips with 8x 8K sectors, after 64K, change to 0x10000 sector
+        // size
+        if (flashIDType == 0 && currAddr >= 0x10000 &&
+            sectorEraseAddress == 0x2000) {
+          sectorEraseAddress = 0x10000;
+        } else if (flashIDType == 1 && currAddr >= 0x20000) {
+          sectorEraseAddress = 0x10000;
         }
 
-        // Back to reading mode
-        gba_flash_write_address_byte(currAddr, 0xFF);
-        delay_ms(5);
-      } else if (flashCartType == 25) {
-        printf("16 MByte GE28F128W30 Gameboy Advance Flash Cart\n");
-        printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+        // Unlock
+        gba_flash_write_address_byte(currAddr, 0x60);
+        gba_flash_write_address_byte(currAddr, 0xD0);
+
+        // Erase
+        gba_flash_write_address_byte(currAddr, 0x20);
+        gba_flash_write_address_byte(currAddr, 0xD0);
+        delay_ms(50);
+
+        // printf("Sector at 0x%X\n", currAddr);
+
+        // Wait for byte to be 0x80 or 0xB0
+        uint16_t timeout = 0;
+        readBuffer[0] = 0;
+        readBuffer[1] = 0;
+        while (readBuffer[0] != 0x80 && readBuffer[0] != 0xB0) {
+          set_number(currAddr / 2, SET_START_ADDRESS);
+          delay_ms(5);
+          set_mode(GBA_READ_ROM);
+          delay_ms(5);
 
-        // Check file size
-        if (fileSize > 0x1000000) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 16 MBytes\n",
-              argv[1]);
-          read_one_letter();
-          return 1;
-        }
+          com_read_bytes(READ_BUFFER, 64);
+          com_read_stop(); // End read
+          delay_ms(50);
 
-        if (gbxcartFirmwareVersion <= 14) {
-          printf(
-              "Firmware R15 or higher is required for this functionality.\n");
-          read_one_letter();
-          return 1;
+          timeout++;
+          if (timeout >= 200) {
+            printf(
+                "\n\nWaiting for sector erase has timed out. Please unplug "
+                "GBxCart RW, re-seat the cartridge and try again.\n");
+            read_one_letter();
+            exit(1);
+          }
         }
 
-        printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
-
-        // Set to reading mode
-        currAddr = 0x0000;
+        // Back to reading mode
         gba_flash_write_address_byte(currAddr, 0xFF);
         delay_ms(5);
 
-        // Read rom a tiny bit before writing
-        currAddr = 0x0000;
-        set_number(currAddr, SET_START_ADDRESS);
+        set_number(currAddr / 2, SET_START_ADDRESS); // Divide address by 2
         delay_ms(5);
-        set_mode(GBA_READ_ROM);
-        delay_ms(5);
-        com_read_bytes(READ_BUFFER, 64);
-        com_read_stop();
-
-        // Set end address as file size
-        endAddr = fileSize;
-        uint32_t endAddrAligned = fileSize;
-        while ((endAddrAligned / 64) % 64 !=
-               0) { // Align to 64 for printing progress
-          endAddrAligned--;
-        }
+      }
 
-        // Flash ID command
-        gba_flash_write_address_byte(0x00, 0x90);
-        delay_ms(1);
+      // Word writing
+      rom_write_bytes(GBA_FLASH_WRITE_INTEL_64BYTE_WORD, 64);
+      com_wait_for_ack();
+      currAddr += 64;
+      readBytes += 64;
 
-        // Read ID
-        set_number(0x00, SET_START_ADDRESS);
-        delay_ms(5);
-        set_mode(GBA_READ_ROM);
-        delay_ms(5);
-        com_read_bytes(READ_BUFFER, 64);
-        com_read_stop(); // End read
+      print_progress_percent(readBytes, endAddrAligned / 64);
+      led_progress_percent(readBytes, endAddrAligned / 28);
+    }
 
-        // Sector erase length
-        uint8_t flashIDType = 0;
-        int sectorEraseAddress = 0x10000;
+    // Back to reading mode
+    gba_flash_write_address_byte(currAddr, 0xFF);
+    delay_ms(5);
+  } else if (flashCartType == 26) {
+    printf("4 MByte (MX29LV320) Gameboy Advance Flash Cart\n");
+    printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+
+    // Check file size
+    if (fileSize > 0x400000) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 4 MBytes\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    }
 
-        // 28F128W30 (0x8A, 0x0, 0x5x, 0x88)
-        if (readBuffer[0] == 0x8A && readBuffer[1] == 0 &&
-            (readBuffer[2] & 0xF8) == 0x50 && readBuffer[3] == 0x88) {
-          sectorEraseAddress = 0x2000; // 8K sectors at start
-        }
-        //  (0x8A, 0x0, 0x15, 0x88)
-        else if (readBuffer[0] == 0x8A && readBuffer[1] == 0 &&
-                 readBuffer[2] == 0x15 && readBuffer[3] == 0x88) {
-          sectorEraseAddress = 0x2000; // 8K sectors at start
-          flashIDType = 1;
-        }
+    printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    // Read rom a tiny bit before writing
+    currAddr = 0x0000;
+    set_number(currAddr, SET_START_ADDRESS);
+    delay_ms(5);
+    set_mode(GBA_READ_ROM);
+    delay_ms(5);
+    com_read_bytes(READ_BUFFER, 64);
+    com_read_stop();
+
+    // Set end address as file size
+    endAddr = fileSize;
+    uint32_t endAddrAligned = fileSize;
+    while ((endAddrAligned / 64) % 64 !=
+           0) { // Align to 64 for printing progress
+      endAddrAligned--;
+    }
+    xmas_setup(endAddrAligned / 28);
+
+    // Write ROM
+    currAddr = 0x0000;
+    set_number(currAddr, SET_START_ADDRESS);
+    int sectorEraseAddress = 0x2000;
+    while (currAddr < endAddr) {
+      if (currAddr >= 0x10000) {
+        sectorEraseAddress = 0x10000;
+      }
+      if (currAddr % sectorEraseAddress == 0) { // Erase next sector
+        gba_flash_write_address_byte(0xAAA, 0xAA);
+        gba_flash_write_address_byte(0x555, 0x55);
+        gba_flash_write_address_byte(0xAAA, 0x80);
+        gba_flash_write_address_byte(0xAAA, 0xAA);
+        gba_flash_write_address_byte(0x555, 0x55);
+        gba_flash_write_address_byte((uint32_t)sector << 13, 0x30);
+        sector++;
 
-        // Back to reading mode
-        gba_flash_write_address_byte(currAddr, 0xFF);
-        delay_ms(5);
+        // Wait for first 2 bytes to be 0xFF
+        wait_for_gba_flash_sector_ff(currAddr, 0xFF, 0xFF);
 
-        // Write ROM
-        currAddr = 0x0000;
-        set_number(currAddr, SET_START_ADDRESS);
+        set_number(currAddr / 2, SET_START_ADDRESS); // Divide address by 2
         delay_ms(5);
+      }
 
-        while (currAddr < endAddr) {
-          if (currAddr % sectorEraseAddress == 0) { // Erase next sector
-            // For chips with 8x 8K sectors, after 64K, change to 0x10000 sector
-            // size
-            if (flashIDType == 0 && currAddr >= 0x10000 &&
-                sectorEraseAddress == 0x2000) {
-              sectorEraseAddress = 0x10000;
-            } else if (flashIDType == 1 && currAddr >= 0x20000) {
-              sectorEraseAddress = 0x10000;
-            }
+      rom_write_bytes(GBA_FLASH_WRITE_256BYTE, 256);
+      com_wait_for_ack();
+      currAddr += 256;
+      readBytes += 256;
 
-            // Unlock
-            gba_flash_write_address_byte(currAddr, 0x60);
-            gba_flash_write_address_byte(currAddr, 0xD0);
+      print_progress_percent(readBytes, endAddrAligned / 64);
+      led_progress_percent(readBytes, endAddrAligned / 28);
+    }
+  } else if (flashCartType ==
+             36) { // Thanks to lesserkuma for adding support
+    printf("32 MByte (Flash2Advance 256M)\n");
+    printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+
+    if (gbxcartFirmwareVersion <= 17) {
+      printf(
+          "Firmware R18 or higher is required for this functionality.\n");
+      read_one_letter();
+      return 1;
+    }
 
-            // Erase
-            gba_flash_write_address_byte(currAddr, 0x20);
-            gba_flash_write_address_byte(currAddr, 0xD0);
-            delay_ms(50);
+    // Check file size
+    if (fileSize > 0x2000000) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 32 MBytes\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    }
 
-            // printf("Sector at 0x%X\n", currAddr);
+    // Read rom a tiny bit before writing
+    currAddr = 0x0000;
+    set_number(currAddr, SET_START_ADDRESS);
+    delay_ms(5);
+    set_mode(GBA_READ_ROM);
+    delay_ms(5);
+    com_read_bytes(READ_BUFFER, 64);
+    com_read_stop();
+
+    // Set end address as file size
+    endAddr = fileSize;
+    uint32_t endAddrAligned = fileSize;
+    while ((endAddrAligned / 64) % 64 !=
+           0) { // Align to 64 for printing progress
+      endAddrAligned--;
+    }
+    xmas_setup(endAddrAligned / 28);
 
-            // Wait for byte to be 0x80 or 0xB0
-            uint16_t timeout = 0;
-            readBuffer[0] = 0;
-            readBuffer[1] = 0;
-            while (readBuffer[0] != 0x80 && readBuffer[0] != 0xB0) {
-              set_number(currAddr / 2, SET_START_ADDRESS);
-              delay_ms(5);
-              set_mode(GBA_READ_ROM);
-              delay_ms(5);
+    // Reset Cartridge
+    gba_flash_write_address_byte(0, 0xFF);
+    gba_flash_write_address_byte(2, 0xFF);
 
-              com_read_bytes(READ_BUFFER, 64);
-              com_read_stop(); // End read
-              delay_ms(50);
-
-              timeout++;
-              if (timeout >= 200) {
-                printf(
-                    "\n\nWaiting for sector erase has timed out. Please unplug "
-                    "GBxCart RW, re-seat the cartridge and try again.\n");
-                read_one_letter();
-                exit(1);
-              }
-            }
+    // Unlock
+    printf("\nNow unlocking the cartridge...");
+    gba_flash_write_address_byte(0x987654 * 2, 0x5354);
 
-            // Back to reading mode
-            gba_flash_write_address_byte(currAddr, 0xFF);
-            delay_ms(5);
+    for (uint16_t x = 0; x < 500; x++) {
+      gba_flash_write_address_byte(0x012345 * 2, 0x1234);
+    }
+    gba_flash_write_address_byte(0x007654 * 2, 0x5354);
+    gba_flash_write_address_byte(0x012345 * 2, 0x5354);
 
-            set_number(currAddr / 2, SET_START_ADDRESS); // Divide address by 2
-            delay_ms(5);
-          }
+    for (uint16_t x = 0; x < 500; x++) {
+      gba_flash_write_address_byte(0x012345 * 2, 0x5678);
+    }
+    gba_flash_write_address_byte(0x987654 * 2, 0x5354);
+    gba_flash_write_address_byte(0x012345 * 2, 0x5354);
+    gba_flash_write_address_byte(0x765400 * 2, 0x5678);
+    gba_flash_write_address_byte(0x013450 * 2, 0x1234);
 
-          // Word writing
-          com_write_bytes_from_file(GBA_FLASH_WRITE_INTEL_64BYTE_WORD, romFile,
-                                    64);
-          com_wait_for_ack();
-          currAddr += 64;
-          readBytes += 64;
+    for (uint16_t x = 0; x < 500; x++) {
+      gba_flash_write_address_byte(0x012345 * 2, 0xABCD);
+    }
+    gba_flash_write_address_byte(0x987654 * 2, 0x5354);
+    gba_flash_write_address_byte(0xF12345 * 2, 0x9413);
+
+    printf("\n");
+    printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    int sectorEraseAddress = 0x20000 * 2;
+    uint32_t timeout = 0;
+    while (currAddr < endAddr) {
+      if (currAddr % sectorEraseAddress == 0) { // Erase next sector
+        // Erase Block Command
+        gba_flash_write_address_byte(currAddr, 0x20);
+        gba_flash_write_address_byte(currAddr + 2, 0x20);
+
+        // Erase Block Confirm Command
+        gba_flash_write_address_byte(currAddr, 0xD0);
+        gba_flash_write_address_byte(currAddr + 2, 0xD0);
+        delay_ms(50);
+
+        // Confirm Status Register
+        timeout = 0;
+        uint8_t sr1 = 0;
+        uint8_t sr2 = 0;
+        while (sr1 != 0x80 || sr2 != 0x80) {
+          // Chip 1
+          set_number(currAddr / 2, SET_START_ADDRESS);
+          delay_ms(5);
+          set_mode(GBA_READ_ROM);
+          delay_ms(5);
+          com_read_bytes(READ_BUFFER, 64);
+          com_read_stop(); // End read
+          delay_ms(50);
+          sr1 = readBuffer[0];
 
-          print_progress_percent(readBytes, endAddrAligned / 64);
-          led_progress_percent(readBytes, endAddrAligned / 28);
+          // Chip 2
+          set_number(currAddr / 2 + 1, SET_START_ADDRESS);
+          delay_ms(5);
+          set_mode(GBA_READ_ROM);
+          delay_ms(5);
+          com_read_bytes(READ_BUFFER, 64);
+          com_read_stop(); // End read
+          delay_ms(50);
+          sr2 = readBuffer[0];
+
+          timeout++;
+          if (timeout >= 200) {
+            printf(
+                "\n\nWaiting for sector erase has timed out. Please unplug "
+                "GBxCart RW, re-seat the cartridge and try again.\n");
+            read_one_letter();
+            exit(1);
+          }
         }
 
-        // Back to reading mode
-        gba_flash_write_address_byte(currAddr, 0xFF);
+        set_number(currAddr / 2, SET_START_ADDRESS);
         delay_ms(5);
-      } else if (flashCartType == 26) {
-        printf("4 MByte (MX29LV320) Gameboy Advance Flash Cart\n");
-        printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+      }
 
-        // Check file size
-        if (fileSize > 0x400000) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 4 MBytes\n",
-              argv[1]);
-          read_one_letter();
-          return 1;
-        }
+      // Buffered writing
+      rom_write_bytes(GBA_FLASH_WRITE_INTEL_INTERLEAVED_256BYTE, 256);
+      delay_ms(2);
+      com_wait_for_ack();
 
-        printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
+      currAddr += 256;
+      readBytes += 256;
 
-        // Read rom a tiny bit before writing
-        currAddr = 0x0000;
-        set_number(currAddr, SET_START_ADDRESS);
+      print_progress_percent(readBytes, endAddrAligned / 64);
+      led_progress_percent(readBytes, endAddrAligned / 28);
+    }
+
+    // Reset Cartridge
+    gba_flash_write_address_byte(0, 0xFF);
+    gba_flash_write_address_byte(2, 0xFF);
+    delay_ms(100);
+
+    printf("]");
+  } else if (flashCartType ==
+             37) { // Thanks to lesserkuma for adding support
+    printf("16 MByte (Nintendo Development AGB Cartridge 128M Flash S, "
+           "E201850)\n");
+    printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+
+    if (gbxcartFirmwareVersion <= 17) {
+      printf(
+          "Firmware R18 or higher is required for this functionality.\n");
+      read_one_letter();
+      return 1;
+    }
+
+    // Check file size
+    if (fileSize > 0x2000000) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 32 MBytes\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    }
+
+    // Read rom a tiny bit before writing
+    currAddr = 0x0000;
+    set_number(currAddr, SET_START_ADDRESS);
+    delay_ms(5);
+    set_mode(GBA_READ_ROM);
+    delay_ms(5);
+    com_read_bytes(READ_BUFFER, 64);
+    com_read_stop();
+
+    // Set end address as file size
+    endAddr = fileSize;
+    uint32_t endAddrAligned = fileSize;
+    while ((endAddrAligned / 64) % 64 !=
+           0) { // Align to 64 for printing progress
+      endAddrAligned--;
+    }
+    xmas_setup(endAddrAligned / 28);
+
+    // Erase as many 32M chunks as needed (runs in parallel)
+    printf("\nErasing Flash");
+    for (int i = 0; i < endAddr; i += 0x400000) {
+      gba_flash_write_address_byte(i, 0x30); // Erase Command
+      gba_flash_write_address_byte(i, 0xD0); // Confirm Erase
+    }
+    uint32_t timeout = 0;
+    uint8_t sr = 0;
+    for (int i = 0; i < endAddr; i += 0x400000) {
+      while (sr != 0x80) {
+        // do {
+        printf(".");
+        gba_flash_write_address_byte(i, 0x70); // Read Status Register
         delay_ms(5);
         set_mode(GBA_READ_ROM);
         delay_ms(5);
         com_read_bytes(READ_BUFFER, 64);
-        com_read_stop();
-
-        // Set end address as file size
-        endAddr = fileSize;
-        uint32_t endAddrAligned = fileSize;
-        while ((endAddrAligned / 64) % 64 !=
-               0) { // Align to 64 for printing progress
-          endAddrAligned--;
+        com_read_stop(); // End read
+        delay_ms(50);
+        sr = readBuffer[0];
+        delay_ms(500);
+
+        timeout++;
+        if (timeout >= 400) {
+          printf("\n\nWaiting for flash erase has timed out. Please unplug "
+                 "GBxCart RW, re-seat the cartridge and try again.\n");
+          read_one_letter();
+          exit(1);
         }
-        xmas_setup(endAddrAligned / 28);
+      }
+      //} while (sr != 0x80);
+    }
 
-        // Write ROM
-        currAddr = 0x0000;
-        set_number(currAddr, SET_START_ADDRESS);
-        int sectorEraseAddress = 0x2000;
-        while (currAddr < endAddr) {
-          if (currAddr >= 0x10000) {
-            sectorEraseAddress = 0x10000;
-          }
-          if (currAddr % sectorEraseAddress == 0) { // Erase next sector
-            gba_flash_write_address_byte(0xAAA, 0xAA);
-            gba_flash_write_address_byte(0x555, 0x55);
-            gba_flash_write_address_byte(0xAAA, 0x80);
-            gba_flash_write_address_byte(0xAAA, 0xAA);
-            gba_flash_write_address_byte(0x555, 0x55);
-            gba_flash_write_address_byte((uint32_t)sector << 13, 0x30);
-            sector++;
-
-            // Wait for first 2 bytes to be 0xFF
-            wait_for_gba_flash_sector_ff(currAddr, 0xFF, 0xFF);
-
-            set_number(currAddr / 2, SET_START_ADDRESS); // Divide address by 2
-            delay_ms(5);
-          }
+    printf("\n");
+    printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+    printf(
+        "[             25%%             50%%             75%%            "
+        "100%%]\n[");
+
+    set_number(currAddr, SET_START_ADDRESS);
+    delay_ms(5);
+    while (currAddr < endAddr) {
+      // Transfer 64 bytes and write one word at a time in firmware
+      rom_write_bytes(GBA_FLASH_WRITE_SHARP_64BYTE, 64);
+      delay_ms(2);
+      com_wait_for_ack();
+
+      currAddr += 64;
+      readBytes += 64;
+
+      print_progress_percent(readBytes, endAddrAligned / 64);
+      led_progress_percent(readBytes, endAddrAligned / 28);
+    }
 
-          com_write_bytes_from_file(GBA_FLASH_WRITE_256BYTE, romFile, 256);
-          com_wait_for_ack();
-          currAddr += 256;
-          readBytes += 256;
+    // Reset
+    for (int i = 0; i < endAddr; i += 0x400000) {
+      gba_flash_write_address_byte(i, 0xFF);
+    }
 
-          print_progress_percent(readBytes, endAddrAligned / 64);
-          led_progress_percent(readBytes, endAddrAligned / 28);
-        }
-      } else if (flashCartType ==
-                 36) { // Thanks to lesserkuma for adding support
-        printf("32 MByte (Flash2Advance 256M)\n");
-        printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+    printf("]");
+  } else if (flashCartType == 54) {
+    printf("Generic GBA Flash Cart (Auto detect)\n");
+    printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+
+    // Check file size
+    if (fileSize > 0x2000000) {
+      printf(
+          "\n%s \nFile size is larger than the available Flash cart space "
+          "of 32 MBytes\n",
+          romPath);
+      read_one_letter();
+      return 1;
+    }
 
-        if (gbxcartFirmwareVersion <= 17) {
-          printf(
-              "Firmware R18 or higher is required for this functionality.\n");
-          read_one_letter();
-          return 1;
-        }
+    // Read rom a tiny bit before writing
+    currAddr = 0x0000;
+    set_number(currAddr, SET_START_ADDRESS);
+    delay_ms(5);
+    set_mode(GBA_READ_ROM);
+    delay_ms(5);
+    com_read_bytes(READ_BUFFER, 64);
+    com_read_stop();
+
+    // Set end address as file size
+    endAddr = fileSize;
+    uint32_t endAddrAligned = fileSize;
+    while ((endAddrAligned / 64) % 64 !=
+           0) { // Align to 64 for printing progress
+      endAddrAligned--;
+    }
+    xmas_setup(endAddrAligned / 28);
+
+    // Check Flash ID
+    detectedFlashWritingMethod = gba_check_flash_id();
+    if (detectedFlashWritingMethod >= 0) {
+      currAddr = 0x0000;
+      set_number(currAddr, SET_START_ADDRESS);
+      delay_ms(5);
+      set_mode(GBA_READ_ROM);
+      delay_ms(5);
+      com_read_bytes(READ_BUFFER, 64);
+      com_read_stop();
+      gba_flash_write_address_byte(0x000, 0xF0);
+
+      // Chip erase
+      currAddr = 0x0000;
+      set_number(currAddr, SET_START_ADDRESS);
+      delay_ms(5);
+
+      printf("\nChip erase, this can take 3-4 minutes");
+      if (detectedFlashWritingMethod == GBA_FLASH_PROGRAM_AAA) {
+        gba_flash_write_address_byte(0xAAA, 0xAA);
+        gba_flash_write_address_byte(0x555, 0x55);
+        gba_flash_write_address_byte(0xAAA, 0x80);
+        gba_flash_write_address_byte(0xAAA, 0xAA);
+        gba_flash_write_address_byte(0x555, 0x55);
+        gba_flash_write_address_byte(0xAAA, 0x10);
+      } else {
+        gba_flash_write_address_byte(0xAAA, 0xA9);
+        gba_flash_write_address_byte(0x555, 0x56);
+        gba_flash_write_address_byte(0xAAA, 0x80);
+        gba_flash_write_address_byte(0xAAA, 0xA9);
+        gba_flash_write_address_byte(0x555, 0x56);
+        gba_flash_write_address_byte(0xAAA, 0x10);
+      }
 
-        // Check file size
-        if (fileSize > 0x2000000) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 32 MBytes\n",
-              argv[1]);
-          read_one_letter();
-          return 1;
+      // Wait for first 2 bytes to be 0xFF
+      wait_for_gba_flash_erase_ff(currAddr);
+      printf("\n");
+
+      printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
+      printf(
+          "[             25%%             50%%             75%%           "
+          " 100%%]\n[");
+
+      // Write ROM
+      currAddr = 0x0000;
+      set_number(currAddr, SET_START_ADDRESS);
+      delay_ms(5);
+      while (currAddr < endAddr) {
+        if (detectedFlashWritingMethod == GBA_FLASH_PROGRAM_AAA) {
+          rom_write_bytes(GBA_FLASH_WRITE_256BYTE, 256);
+        } else {
+          rom_write_bytes(GBA_FLASH_WRITE_256BYTE_SWAPPED_D0D1, 256);
         }
+        com_wait_for_ack();
+        currAddr += 256;
+        readBytes += 256;
 
-        // Read rom a tiny bit before writing
-        currAddr = 0x0000;
-        set_number(currAddr, SET_START_ADDRESS);
-        delay_ms(5);
-        set_mode(GBA_READ_ROM);
-        delay_ms(5);
-        com_read_bytes(READ_BUFFER, 64);
-        com_read_stop();
-
-        // Set end address as file size
-        endAddr = fileSize;
-        uint32_t endAddrAligned = fileSize;
-        while ((endAddrAligned / 64) % 64 !=
-               0) { // Align to 64 for printing progress
-          endAddrAligned--;
-        }
-        xmas_setup(endAddrAligned / 28);
+        print_progress_percent(readBytes, endAddr / 64);
+        led_progress_percent(readBytes, endAddr / 28);
+      }
+    }
+    if (detectedFlashWritingMethod < 0) {
+      return 1; // Nothing was written
+    }
+  }
+
+  else {
+    printf("No Flash Cart selected, please run this program by itself.");
+    read_one_letter();
+    return 1;
+  }
+  return 0;
+}
 
-        // Reset Cartridge
-        gba_flash_write_address_byte(0, 0xFF);
-        gba_flash_write_address_byte(2, 0xFF);
+// Write a save file back to the cart, with the voltage already set for the
+// cartridge mode. Returns 1 if it couldn't be written.
+int restore_save(const char *savPath) {
+  printf("\n--- Restore save from PC to Cartridge ---\n");
+
+  if (cartridgeMode == GB_MODE) {
+    read_gb_header();
+    // Does cartridge have RAM
+    if (ramEndAddress > 0 && headerCheckSumOk == 1) {
+      //char titleFilename[30];
+      //if (gameTitle[0] != '\0') {
+      //  strncpy(titleFilename, gameTitle, 20);
+      //} else {
+      //  strncpy(titleFilename, "untitled", 9);
+      //}
+      //strncat(titleFilename, ".sav", 4);
+
+      // Open file
+      FILE *ramFile = fopen(savPath, "rb");
+      if (ramFile != NULL) {
+        printf("Going to write save from %s...", savPath);
+        //printf("\n\n*** This will erase the save game from your Gameboy "
+        //       "Cartridge ***");
+        //printf("\nPress y to continue or any other key to abort.\n");
+
+        char confirmWrite = 'y';
+        if (confirmWrite == 'y') {
+          printf("\nRestoring save from %s\n", savPath);
+
+          uint32_t ramLength = ramBanks * (ramEndAddress - 0xA000 + 1);
+          uint8_t *ramData = (uint8_t *)malloc(ramLength);
+          if (ramData == NULL) {
+            printf("Not enough memory\n");
+            fclose(ramFile);
+            return 1;
+          }
+          uint32_t dataLength = fread(ramData, 1, ramLength, ramFile);
+          xmas_setup(ramLength / 28);
 
-        // Unlock
-        printf("\nNow unlocking the cartridge...");
-        gba_flash_write_address_byte(0x987654 * 2, 0x5354);
+          // Only the blocks that differ from the cart get written
+          printf("Reading the cart's save\n");
+          printf(
+              "[             25%%             50%%             75%%       "
+              "     100%%]\n[");
+          uint32_t changedBlocks = 0;
+          uint32_t badBlocks =
+              gb_write_ram_delta(ramData, dataLength, &changedBlocks);
+          free(ramData);
+          if (badBlocks > 0) {
+            printf("%u blocks didn't verify, please re-seat the cartridge "
+                   "and try again\n",
+                   (unsigned int)badBlocks);
+            fclose(ramFile);
+            read_one_letter();
+            return 1;
+          }
+          printf("Wrote and verified %u blocks",
+                 (unsigned int)changedBlocks);
+
+          fclose(ramFile);
+          printf("\nFinished\n");
+        } else {
+          printf("Aborted\n");
+          return 1;
+        }
+      } else {
+        printf("%s File not found\n", savPath);
+        return 1;
+      }
+    } else {
+      printf("Cartridge has no RAM\n");
+      return 1;
+    }
+  } else { // GBA mode
+    read_gba_header();
+    // Does cartridge have RAM
+    if (ramEndAddress > 0 || eepromEndAddress > 0) {
+      // Open file
+      FILE *ramFile = fopen(savPath, "rb");
+      if (ramFile != NULL) {
+        // SRAM/Flash or EEPROM
+        if (eepromSize == EEPROM_NONE) {
+          // Check if it's SRAM or Flash (if we haven't checked before)
+          if (hasFlashSave == NOT_CHECKED) {
+            hasFlashSave = gba_test_sram_flash_write();
+          }
 
-        for (uint16_t x = 0; x < 500; x++) {
-          gba_flash_write_address_byte(0x012345 * 2, 0x1234);
+          if (hasFlashSave >= FLASH_FOUND) {
+            printf("Going to write save to Flash from %s", savPath);
+          } else {
+            printf("Going to write save to SRAM from %s", savPath);
+          }
+        } else {
+          printf("Going to write save to EEPROM from %s", savPath);
         }
-        gba_flash_write_address_byte(0x007654 * 2, 0x5354);
-        gba_flash_write_address_byte(0x012345 * 2, 0x5354);
 
-        for (uint16_t x = 0; x < 500; x++) {
-          gba_flash_write_address_byte(0x012345 * 2, 0x5678);
-        }
-        gba_flash_write_address_byte(0x987654 * 2, 0x5354);
-        gba_flash_write_address_byte(0x012345 * 2, 0x5354);
-        gba_flash_write_address_byte(0x765400 * 2, 0x5678);
-        gba_flash_write_address_byte(0x013450 * 2, 0x1234);
+        //printf("\n\n*** This will erase the save game from your Gameboy "
+        //       "Advance Cartridge ***");
+        //printf("\nPress y to continue or any other key to abort.\n");
 
-        for (uint16_t x = 0; x < 500; x++) {
-          gba_flash_write_address_byte(0x012345 * 2, 0xABCD);
-        }
-        gba_flash_write_address_byte(0x987654 * 2, 0x5354);
-        gba_flash_write_address_byte(0xF12345 * 2, 0x9413);
+        char confirmWrite = 'y';
+        if (confirmWrite == 'y') {
+          if (eepromSize == EEPROM_NONE) {
+            if (hasFlashSave >= FLASH_FOUND) {
+              printf("\nWriting Save to Flash from %s", savPath);
+            } else {
+              printf("\nWriting Save to SRAM from %s", savPath);
+            }
+          } else {
+            printf("\nWriting Save to EEPROM from %s", savPath);
+          }
+          printf(
+              "\n[             25%%             50%%             75%%     "
+              "       100%%]\n[");
+
+          uint16_t skippedSectors = 0;
+          uint16_t erasedSectors = 0;
+          uint32_t eepromChangedBlocks = 0;
+          uint32_t eepromBadBlocks = 0;
+
+          // SRAM
+          if (hasFlashSave == NO_FLASH && eepromSize == EEPROM_NONE) {
+            xmas_setup((ramEndAddress * ramBanks) / 28);
+
+            uint32_t readBytes = 0;
+            for (uint8_t bank = 0; bank < ramBanks; bank++) {
+              if (bank == 1) { // 1Mbit SRAM
+                gba_flash_write_address_byte(0x1000000, 0x1);
+              }
 
-        printf("\n");
-        printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
+              // Set start and end address
+              currAddr = 0x0000;
+              endAddr = ramEndAddress;
+              set_number(currAddr, SET_START_ADDRESS);
 
-        int sectorEraseAddress = 0x20000 * 2;
-        uint32_t timeout = 0;
-        while (currAddr < endAddr) {
-          if (currAddr % sectorEraseAddress == 0) { // Erase next sector
-            // Erase Block Command
-            gba_flash_write_address_byte(currAddr, 0x20);
-            gba_flash_write_address_byte(currAddr + 2, 0x20);
-
-            // Erase Block Confirm Command
-            gba_flash_write_address_byte(currAddr, 0xD0);
-            gba_flash_write_address_byte(currAddr + 2, 0xD0);
-            delay_ms(50);
-
-            // Confirm Status Register
-            timeout = 0;
-            uint8_t sr1 = 0;
-            uint8_t sr2 = 0;
-            while (sr1 != 0x80 || sr2 != 0x80) {
-              // Chip 1
-              set_number(currAddr / 2, SET_START_ADDRESS);
-              delay_ms(5);
-              set_mode(GBA_READ_ROM);
-              delay_ms(5);
-              com_read_bytes(READ_BUFFER, 64);
-              com_read_stop(); // End read
-              delay_ms(50);
-              sr1 = readBuffer[0];
+              // Write
+              while (currAddr < endAddr) {
+                com_write_bytes_from_file(GBA_WRITE_SRAM, ramFile, 64);
+                currAddr += 64;
+                readBytes += 64;
+                com_wait_for_ack();
 
-              // Chip 2
-              set_number(currAddr / 2 + 1, SET_START_ADDRESS);
-              delay_ms(5);
-              set_mode(GBA_READ_ROM);
-              delay_ms(5);
-              com_read_bytes(READ_BUFFER, 64);
-              com_read_stop(); // End read
-              delay_ms(50);
-              sr2 = readBuffer[0];
-
-              timeout++;
-              if (timeout >= 200) {
-                printf(
-                    "\n\nWaiting for sector erase has timed out. Please unplug "
-                    "GBxCart RW, re-seat the cartridge and try again.\n");
-                read_one_letter();
-                exit(1);
+                print_progress_percent(readBytes,
+                                       ramEndAddress * ramBanks / 64);
+                led_progress_percent(readBytes,
+                                     ramEndAddress * ramBanks / 28);
               }
-            }
 
-            set_number(currAddr / 2, SET_START_ADDRESS);
-            delay_ms(5);
+              // SRAM 1Mbit, switch back to bank 0
+              if (bank == 1) {
+                gba_flash_write_address_byte(0x1000000, 0x0);
+              }
+            }
           }
 
-          // Buffered writing
-          com_write_bytes_from_file(GBA_FLASH_WRITE_INTEL_INTERLEAVED_256BYTE,
-                                    romFile, 256);
-          delay_ms(2);
-          com_wait_for_ack();
-
-          currAddr += 256;
-          readBytes += 256;
+          // EEPROM, the progress is the EEPROM being read first as only
+          // the blocks that differ from the save get written
+          else if (eepromSize != EEPROM_NONE) {
+            xmas_setup(eepromEndAddress / 28);
 
-          print_progress_percent(readBytes, endAddrAligned / 64);
-          led_progress_percent(readBytes, endAddrAligned / 28);
-        }
+            uint8_t eepromFileData[0x2000];
+            uint32_t dataLength =
+                fread(eepromFileData, 1, eepromEndAddress, ramFile);
+            eepromBadBlocks = gba_write_eeprom_delta(
+                eepromFileData, dataLength, &eepromChangedBlocks);
+          }
 
-        // Reset Cartridge
-        gba_flash_write_address_byte(0, 0xFF);
-        gba_flash_write_address_byte(2, 0xFF);
-        delay_ms(100);
+          // Flash, a 4KB sector at a time. Sectors that already hold the
+          // save are skipped, only blocks/pages that differ are written
+          // and sectors are only erased if a bit has to go from 0 to 1.
+          else if (hasFlashSave != NO_FLASH) {
+            xmas_setup((ramBanks * ramEndAddress) / 28);
+
+            uint8_t sectorData[4096];
+            uint8_t fileData[4096];
+            uint32_t readBytes = 0;
+            for (uint8_t bank = 0; bank < ramBanks; bank++) {
+              // Set start and end address
+              currAddr = 0x0000;
+              endAddr = ramEndAddress;
+              if (bank == 1) {
+                set_number(1, GBA_FLASH_SET_BANK); // Set bank 1
+              }
 
-        printf("]");
-        fclose(romFile);
-      } else if (flashCartType ==
-                 37) { // Thanks to lesserkuma for adding support
-        printf("16 MByte (Nintendo Development AGB Cartridge 128M Flash S, "
-               "E201850)\n");
-        printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+              while (currAddr < endAddr) {
+                gba_read_save(currAddr, sectorData, 4096);
+                size_t fileLength = fread(fileData, 1, 4096, ramFile);
+                if (fileLength < 4096) { // Leave the rest as it is
+                  memcpy(&fileData[fileLength], &sectorData[fileLength],
+                         4096 - fileLength);
+                }
 
-        if (gbxcartFirmwareVersion <= 17) {
-          printf(
-              "Firmware R18 or higher is required for this functionality.\n");
-          read_one_letter();
-          return 1;
-        }
+                if (memcmp(sectorData, fileData, 4096) == 0) {
+                  skippedSectors++;
+                }
 
-        // Check file size
-        if (fileSize > 0x2000000) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 32 MBytes\n",
-              argv[1]);
-          read_one_letter();
-          return 1;
-        }
+                // Program flash in 128 bytes at a time
+                else if (hasFlashSave == FLASH_FOUND_ATMEL) {
+                  uint32_t nextAddr = 0xFFFFFFFF;
+                  for (uint16_t page = 0; page < 4096; page += 128) {
+                    if (memcmp(&sectorData[page], &fileData[page], 128) ==
+                        0) {
+                      continue;
+                    }
+                    if (currAddr + page != nextAddr) {
+                      set_number(currAddr + page, SET_START_ADDRESS);
+                    }
+                    memcpy(writeBuffer, &fileData[page], 128);
+                    com_write_bytes_from_file(GBA_FLASH_WRITE_ATMEL, NULL,
+                                              128);
+                    com_wait_for_ack(); // Wait for write complete
+                    nextAddr = currAddr + page + 128;
+                  }
+                }
 
-        // Read rom a tiny bit before writing
-        currAddr = 0x0000;
-        set_number(currAddr, SET_START_ADDRESS);
-        delay_ms(5);
-        set_mode(GBA_READ_ROM);
-        delay_ms(5);
-        com_read_bytes(READ_BUFFER, 64);
-        com_read_stop();
-
-        // Set end address as file size
-        endAddr = fileSize;
-        uint32_t endAddrAligned = fileSize;
-        while ((endAddrAligned / 64) % 64 !=
-               0) { // Align to 64 for printing progress
-          endAddrAligned--;
-        }
-        xmas_setup(endAddrAligned / 28);
+                // Program flash in 1 byte at a time
+                else {
+                  uint8_t eraseNeeded = 0;
+                  for (uint16_t x = 0; x < 4096; x++) {
+                    if ((sectorData[x] & fileData[x]) != fileData[x]) {
+                      eraseNeeded = 1;
+                      break;
+                    }
+                  }
 
-        // Erase as many 32M chunks as needed (runs in parallel)
-        printf("\nErasing Flash");
-        for (int i = 0; i < endAddr; i += 0x400000) {
-          gba_flash_write_address_byte(i, 0x30); // Erase Command
-          gba_flash_write_address_byte(i, 0xD0); // Confirm Erase
-        }
-        uint32_t timeout = 0;
-        uint8_t sr = 0;
-        for (int i = 0; i < endAddr; i += 0x400000) {
-          while (sr != 0x80) {
-            // do {
-            printf(".");
-            gba_flash_write_address_byte(i, 0x70); // Read Status Register
-            delay_ms(5);
-            set_mode(GBA_READ_ROM);
-            delay_ms(5);
-            com_read_bytes(READ_BUFFER, 64);
-            com_read_stop(); // End read
-            delay_ms(50);
-            sr = readBuffer[0];
-            delay_ms(500);
+                  if (eraseNeeded == 1) {
+                    flash_4k_sector_erase(currAddr / 4096);
+                    com_wait_for_ack(); // Wait 25ms for sector erase
+                    erasedSectors++;
 
-            timeout++;
-            if (timeout >= 400) {
-              printf("\n\nWaiting for flash erase has timed out. Please unplug "
-                     "GBxCart RW, re-seat the cartridge and try again.\n");
-              read_one_letter();
-              exit(1);
-            }
-          }
-          //} while (sr != 0x80);
-        }
+                    // Wait for first byte to be 0xFF, that's when we know
+                    // the sector has been erased
+                    readBuffer[0] = 0;
+                    while (readBuffer[0] != 0xFF) {
+                      set_number(currAddr, SET_START_ADDRESS);
+                      set_mode(GBA_READ_SRAM);
 
-        printf("\n");
-        printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-        printf(
-            "[             25%%             50%%             75%%            "
-            "100%%]\n[");
+                      com_read_bytes(READ_BUFFER, 64);
+                      com_read_stop();
 
-        set_number(currAddr, SET_START_ADDRESS);
-        delay_ms(5);
-        while (currAddr < endAddr) {
-          // Transfer 64 bytes and write one word at a time in firmware
-          com_write_bytes_from_file(GBA_FLASH_WRITE_SHARP_64BYTE, romFile, 64);
-          delay_ms(2);
-          com_wait_for_ack();
+                      if (readBuffer[0] != 0xFF) {
+                        delay_ms(5);
+                      }
+                    }
 
-          currAddr += 64;
-          readBytes += 64;
+                    delay_ms(5); // Wait a little bit as hardware might not
+                                 // be ready
+                    memset(sectorData, 0xFF, 4096);
+                  }
 
-          print_progress_percent(readBytes, endAddrAligned / 64);
-          led_progress_percent(readBytes, endAddrAligned / 28);
-        }
+                  uint32_t nextAddr = 0xFFFFFFFF;
+                  for (uint16_t block = 0; block < 4096; block += 64) {
+                    if (memcmp(&sectorData[block], &fileData[block], 64) ==
+                        0) {
+                      continue;
+                    }
+                    if (currAddr + block != nextAddr) {
+                      set_number(currAddr + block, SET_START_ADDRESS);
+                    }
+                    memcpy(writeBuffer, &fileData[block], 64);
+                    com_write_bytes_from_file(GBA_FLASH_WRITE_BYTE, NULL,
+                                              64);
+                    com_wait_for_ack(); // Wait for write complete
+                    nextAddr = currAddr + block + 64;
+                  }
+                }
 
-        // Reset
-        for (int i = 0; i < endAddr; i += 0x400000) {
-          gba_flash_write_address_byte(i, 0xFF);
-        }
+                currAddr += 4096;
+                for (uint16_t x = 0; x < 4096; x += 64) {
+                  readBytes += 64;
+                  print_progress_percent(readBytes,
+                                         (ramBanks * endAddr) / 64);
+                  led_progress_percent(readBytes,
+                                       (ramBanks * endAddr) / 28);
+                }
+              }
 
-        printf("]");
-        fclose(romFile);
-      } else if (flashCartType == 54) {
-        printf("Generic GBA Flash Cart (Auto detect)\n");
-        printf("\nGoing to write to ROM (Flash cart) from %s\n", filenameOnly);
+              if (bank == 1) {
+                set_number(0, GBA_FLASH_SET_BANK); // Set bank 0 again
+              }
+            }
+          }
+          printf("]");
+          if (hasFlashSave != NO_FLASH && eepromSize == EEPROM_NONE) {
+            printf("\n%i sectors already matched, %i erased",
+                   skippedSectors, erasedSectors);
+          }
+          if (eepromSize != EEPROM_NONE) {
+            printf("\n%u of %u blocks differed",
+                   (unsigned int)eepromChangedBlocks,
+                   (unsigned int)(eepromEndAddress / 8));
+            if (eepromBadBlocks > 0) {
+              printf("\n%u blocks didn't verify, please re-seat the "
+                     "cartridge and try again\n",
+                     (unsigned int)eepromBadBlocks);
+              fclose(ramFile);
+              read_one_letter();
+              return 1;
+            }
+          }
 
-        // Check file size
-        if (fileSize > 0x2000000) {
-          fclose(romFile);
-          printf(
-              "\n%s \nFile size is larger than the available Flash cart space "
-              "of 32 MBytes\n",
-              argv[1]);
-          read_one_letter();
+          fclose(ramFile);
+          printf("\nFinished\n");
+        } else {
+          printf("Aborted\n");
           return 1;
         }
+      } else {
+        printf("%s File not found\n", savPath);
+        return 1;
+      }
+    } else {
+      printf("Cartridge has no RAM\n");
+      return 1;
+    }
+  }
+  return 0;
+}
 
-        // Read rom a tiny bit before writing
-        currAddr = 0x0000;
-        set_number(currAddr, SET_START_ADDRESS);
-        delay_ms(5);
-        set_mode(GBA_READ_ROM);
-        delay_ms(5);
-        com_read_bytes(READ_BUFFER, 64);
-        com_read_stop();
-
-        // Set end address as file size
-        endAddr = fileSize;
-        uint32_t endAddrAligned = fileSize;
-        while ((endAddrAligned / 64) % 64 !=
-               0) { // Align to 64 for printing progress
-          endAddrAligned--;
-        }
-        xmas_setup(endAddrAligned / 28);
-
-        // Check Flash ID
-        detectedFlashWritingMethod = gba_check_flash_id();
-        if (detectedFlashWritingMethod >= 0) {
-          currAddr = 0x0000;
-          set_number(currAddr, SET_START_ADDRESS);
-          delay_ms(5);
-          set_mode(GBA_READ_ROM);
-          delay_ms(5);
-          com_read_bytes(READ_BUFFER, 64);
-          com_read_stop();
-          gba_flash_write_address_byte(0x000, 0xF0);
+// cart-daemon links this file for flash_rom() and restore_save() and has its
+// own main
+#ifndef FLASH_CART_NO_MAIN
+int main(int argc, char **argv) {
 
-          // Chip erase
-          currAddr = 0x0000;
-          set_number(currAddr, SET_START_ADDRESS);
-          delay_ms(5);
+  printf("GBxCart RW Flasher v1.37 by insideGadgets\n");
+  printf("#########################################\n");
 
-          printf("\nChip erase, this can take 3-4 minutes");
-          if (detectedFlashWritingMethod == GBA_FLASH_PROGRAM_AAA) {
-            gba_flash_write_address_byte(0xAAA, 0xAA);
-            gba_flash_write_address_byte(0x555, 0x55);
-            gba_flash_write_address_byte(0xAAA, 0x80);
-            gba_flash_write_address_byte(0xAAA, 0xAA);
-            gba_flash_write_address_byte(0x555, 0x55);
-            gba_flash_write_address_byte(0xAAA, 0x10);
-          } else {
-            gba_flash_write_address_byte(0xAAA, 0xA9);
-            gba_flash_write_address_byte(0x555, 0x56);
-            gba_flash_write_address_byte(0xAAA, 0x80);
-            gba_flash_write_address_byte(0xAAA, 0xA9);
-            gba_flash_write_address_byte(0x555, 0x56);
-            gba_flash_write_address_byte(0xAAA, 0x10);
-          }
+  if (argc >= 3 && strcmp(argv[1], "batch") == 0) {
+    return batch_run(argv[2], argc >= 4 && strcmp(argv[3], "key") == 0);
+  }
+  if (argc >= 2) {
+    char filenameOnly[100];
+    char filename[254];
+    strncpy(filename, argv[1], 253);
+    char filetype[4];
 
-          // Wait for first 2 bytes to be 0xFF
-          wait_for_gba_flash_erase_ff(currAddr);
-          printf("\n");
+#ifdef _WIN32
+    char *token = strtok(filename, "\\");
+    while (token != NULL) {
+      strncpy(filenameOnly, token, 99);
+      token = strtok(NULL, "\\");
+    }
+#else
+    char *token = strtok(filename, "/");
+    while (token != NULL) {
+      strncpy(filenameOnly, token, 99);
+      token = strtok(NULL, "/");
+    }
+#endif
+    // check if filename ends with '.gb'
+    token = strtok(filenameOnly, ".");
+    while (token != NULL) {
+      strncpy(filetype, token, 4);
+      token = strtok(NULL, ".");
+    }
+    if (strncmp(filetype, "gb", 2) == 0) {
+      read_config();
+      // Check arguments
 
-          printf("\nWriting to ROM (Flash cart) from %s\n", filenameOnly);
-          printf(
-              "[             25%%             50%%             75%%           "
-              " 100%%]\n[");
+      // Open COM port
+      if (com_test_port() == 0) {
+        printf(
+            "Device not connected and couldn't be auto detected. Please make "
+            "sure the COM port isn't open elsewhere. If you are using "
+            "Linux/Mac, make sure you use \"sudo\".\n");
+        read_one_letter();
+        return 1;
+      }
+      printf("Connected on COM port: %i\n", cport_nr + 1);
 
-          // Write ROM
-          currAddr = 0x0000;
-          set_number(currAddr, SET_START_ADDRESS);
-          delay_ms(5);
-          while (currAddr < endAddr) {
-            if (detectedFlashWritingMethod == GBA_FLASH_PROGRAM_AAA) {
-              com_write_bytes_from_file(GBA_FLASH_WRITE_256BYTE, romFile, 256);
-            } else {
-              com_write_bytes_from_file(GBA_FLASH_WRITE_256BYTE_SWAPPED_D0D1,
-                                        romFile, 256);
-            }
-            com_wait_for_ack();
-            currAddr += 256;
-            readBytes += 256;
+      // Break out of any existing functions on ATmega, get the cartridge mode,
+      // firmware version and PCB version
+      if (request_device_info() == 0) {
+        printf("Device didn't respond, please unplug GBxCart RW and try "
+               "again\n");
+        read_one_letter();
+        return 1;
+      }
+      xmas_wake_up();
 
-            print_progress_percent(readBytes, endAddr / 64);
-            led_progress_percent(readBytes, endAddr / 28);
-          }
-        }
+      if (gbxcartPcbVersion == PCB_1_0) {
+        printf("\nPCB v1.0 is not supported for this function.");
+        read_one_letter();
+        return 1;
       }
 
-      else {
-        printf("No Flash Cart selected, please run this program by itself.");
+      if (gbxcartFirmwareVersion <= 8) {
+        printf("Firmware R9 or higher is required for this functionality.\n");
         read_one_letter();
         return 1;
       }
+
+      // Read flash config file and match to a cart type
+      if (argc == 2) {
+        read_config_flash();
+      } else if (argc == 3) {
+        flashCartType = atoi(argv[2]);
+      } else if (argc == 4) {
+        flashCartType = atoi(argv[2]);
+        mode5vOverride = atoi(argv[3]);
+      }
+
+      int result = flash_rom(argv[1]);
+      if (result == 1 || result == FLASH_ROM_POWER_CYCLE) {
+        return result;
+      }
     } else if (strncmp(filetype, "sav", 2) == 0) {
       read_config();
       // Open COM port
@@ -3698,15 +4335,15 @@ int main(int argc, char **argv) {
       }
       printf("Connected on COM port: %i\n", cport_nr + 1);
 
-      // Break out of any existing functions on ATmega
-      set_mode('0');
-
-      // Get firmware version
-      gbxcartFirmwareVersion = request_value(READ_FIRMWARE_VERSION);
+      // Break out of any existing functions on ATmega, get the cartridge mode,
+      // firmware version and PCB version
+      if (request_device_info() == 0) {
+        printf("Device didn't respond, please unplug GBxCart RW and try "
+               "again\n");
+        read_one_letter();
+        return 1;
+      }
       printf("Firmware version: %i\n", gbxcartFirmwareVersion);
-
-      // Get PCB version
-      gbxcartPcbVersion = request_value(READ_PCB_VERSION);
       xmas_wake_up();
 
       // Check if OS can support fast COM port reading
@@ -3736,295 +4373,9 @@ int main(int argc, char **argv) {
           set_mode(VOLTAGE_3_3V);
         }
       }
-      printf("\n--- Restore save from PC to Cartridge ---\n");
-
-      if (cartridgeMode == GB_MODE) {
-        read_gb_header();
-        // Does cartridge have RAM
-        if (ramEndAddress > 0 && headerCheckSumOk == 1) {
-          //char titleFilename[30];
-          //if (gameTitle[0] != '\0') {
-          //  strncpy(titleFilename, gameTitle, 20);
-          //} else {
-          //  strncpy(titleFilename, "untitled", 9);
-          //}
-          //strncat(titleFilename, ".sav", 4);
-
-          // Open file
-          FILE *ramFile = fopen(argv[1], "rb");
-          if (ramFile != NULL) {
-            printf("Going to write save from %s...", argv[1]);
-            //printf("\n\n*** This will erase the save game from your Gameboy "
-            //       "Cartridge ***");
-            //printf("\nPress y to continue or any other key to abort.\n");
-
-            char confirmWrite = 'y';
-            if (confirmWrite == 'y') {
-              printf("\nRestoring save from %s\n", argv[1]);
-              printf(
-                  "[             25%%             50%%             75%%       "
-                  "     100%%]\n[");
-
-              mbc2_fix();
-              if (cartridgeType <= 4) { // MBC1
-                set_bank(0x6000, 1);    // Set RAM Mode
-              }
-              set_bank(0x0000, 0x0A); // Initialise MBC
-
-              if (ramEndAddress == 0xA1FF) {
-                xmas_setup(ramEndAddress / 28);
-              } else if (ramEndAddress == 0xA7FF) {
-                xmas_setup(ramEndAddress / 4 / 28);
-              } else {
-                xmas_setup((ramBanks * (ramEndAddress - 0xA000 + 1)) / 28);
-              }
-
-              // Write RAM
-              uint32_t readBytes = 0;
-              for (uint8_t bank = 0; bank < ramBanks; bank++) {
-                uint16_t ramAddress = 0xA000;
-                set_bank(0x4000, bank);
-                set_number(0xA000,
-                           SET_START_ADDRESS); // Set start address again
-
-                while (ramAddress < ramEndAddress) {
-                  com_write_bytes_from_file(WRITE_RAM, ramFile, 64);
-                  ramAddress += 64;
-                  readBytes += 64;
-                  com_wait_for_ack();
-
-                  // Print progress
-                  if (ramEndAddress == 0xA1FF) {
-                    print_progress_percent(readBytes, 64);
-                    led_progress_percent(readBytes, 28);
-                  } else if (ramEndAddress == 0xA7FF) {
-                    print_progress_percent(readBytes / 4, 64);
-                    led_progress_percent(readBytes / 4, 28);
-                  } else {
-                    print_progress_percent(
-                        readBytes,
-                        (ramBanks * (ramEndAddress - 0xA000 + 1)) / 64);
-                    led_progress_percent(
-                        readBytes,
-                        (ramBanks * (ramEndAddress - 0xA000 + 1)) / 28);
-                  }
-                }
-              }
-              printf("]");
-              set_bank(0x0000, 0x00); // Disable RAM
-
-              fclose(ramFile);
-              printf("\nFinished\n");
-            } else {
-              printf("Aborted\n");
-            }
-          } else {
-            printf("%s.sav File not found\n", filenameOnly);
-          }
-        } else {
-          printf("Cartridge has no RAM\n");
-        }
-      } else { // GBA mode
-        read_gba_header();
-        // Does cartridge have RAM
-        if (ramEndAddress > 0 || eepromEndAddress > 0) {
-          char titleFilename[30];
-          if (gameTitle[0] != '\0') {
-            strncpy(titleFilename, gameTitle, 20);
-          } else {
-            strncpy(titleFilename, "untitled", 9);
-          }
-          strncat(titleFilename, ".sav", 4);
-
-          // Open file
-          FILE *ramFile = fopen(titleFilename, "rb");
-          if (ramFile != NULL) {
-            // SRAM/Flash or EEPROM
-            if (eepromSize == EEPROM_NONE) {
-              // Check if it's SRAM or Flash (if we haven't checked before)
-              if (hasFlashSave == NOT_CHECKED) {
-                hasFlashSave = gba_test_sram_flash_write();
-              }
-
-              if (hasFlashSave >= FLASH_FOUND) {
-                printf("Going to write save to Flash from %s", titleFilename);
-              } else {
-                printf("Going to write save to SRAM from %s", titleFilename);
-              }
-            } else {
-              printf("Going to write save to EEPROM from %s", titleFilename);
-            }
-
-            printf("\n\n*** This will erase the save game from your Gameboy "
-                   "Advance Cartridge ***");
-            printf("\nPress y to continue or any other key to abort.\n");
-
-            char confirmWrite = read_one_letter();
-            if (confirmWrite == 'y') {
-              if (eepromSize == EEPROM_NONE) {
-                if (hasFlashSave >= FLASH_FOUND) {
-                  printf("\nWriting Save to Flash from %s", titleFilename);
-                } else {
-                  printf("\nWriting Save to SRAM from %s", titleFilename);
-                }
-              } else {
-                printf("\nWriting Save to EEPROM from %s", titleFilename);
-              }
-              printf(
-                  "\n[             25%%             50%%             75%%     "
-                  "       100%%]\n[");
-
-              // SRAM
-              if (hasFlashSave == NO_FLASH && eepromSize == EEPROM_NONE) {
-                xmas_setup((ramEndAddress * ramBanks) / 28);
-
-                uint32_t readBytes = 0;
-                for (uint8_t bank = 0; bank < ramBanks; bank++) {
-                  if (bank == 1) { // 1Mbit SRAM
-                    gba_flash_write_address_byte(0x1000000, 0x1);
-                  }
-
-                  // Set start and end address
-                  currAddr = 0x0000;
-                  endAddr = ramEndAddress;
-                  set_number(currAddr, SET_START_ADDRESS);
-
-                  // Write
-                  while (currAddr < endAddr) {
-                    com_write_bytes_from_file(GBA_WRITE_SRAM, ramFile, 64);
-                    currAddr += 64;
-                    readBytes += 64;
-                    com_wait_for_ack();
-
-                    print_progress_percent(readBytes,
-                                           ramEndAddress * ramBanks / 64);
-                    led_progress_percent(readBytes,
-                                         ramEndAddress * ramBanks / 28);
-                  }
-
-                  // SRAM 1Mbit, switch back to bank 0
-                  if (bank == 1) {
-                    gba_flash_write_address_byte(0x1000000, 0x0);
-                  }
-                }
-              }
-
-              // EEPROM
-              else if (eepromSize != EEPROM_NONE) {
-                xmas_setup(eepromEndAddress / 28);
-                set_number(eepromSize, GBA_SET_EEPROM_SIZE);
-
-                // Set start and end address
-                currAddr = 0x000;
-                endAddr = eepromEndAddress;
-                set_number(currAddr, SET_START_ADDRESS);
-
-                // Write
-                uint32_t readBytes = 0;
-                while (currAddr < endAddr) {
-                  com_write_bytes_from_file(GBA_WRITE_EEPROM, ramFile, 8);
-                  currAddr += 8;
-                  readBytes += 8;
-
-                  // Wait for ATmega to process write (~320us) and for EEPROM to
-                  // write data (6ms)
-                  com_wait_for_ack();
-
-                  print_progress_percent(readBytes, endAddr / 64);
-                  led_progress_percent(readBytes, endAddr / 28);
-                }
-              }
-
-              // Flash
-              else if (hasFlashSave != NO_FLASH) {
-                xmas_setup((ramBanks * endAddr) / 28);
-
-                uint32_t readBytes = 0;
-                for (uint8_t bank = 0; bank < ramBanks; bank++) {
-                  // Set start and end address
-                  currAddr = 0x0000;
-                  endAddr = ramEndAddress;
-                  set_number(currAddr, SET_START_ADDRESS);
-
-                  // Program flash in 128 bytes at a time
-                  if (hasFlashSave == FLASH_FOUND_ATMEL) {
-                    while (currAddr < endAddr) {
-                      com_write_bytes_from_file(GBA_FLASH_WRITE_ATMEL, ramFile,
-                                                128);
-                      currAddr += 128;
-                      readBytes += 128;
-                      com_wait_for_ack(); // Wait for write complete
-
-                      print_progress_percent(readBytes,
-                                             (ramBanks * endAddr) / 64);
-                      led_progress_percent(readBytes,
-                                           (ramBanks * endAddr) / 28);
-                    }
-                  } else { // Program flash in 1 byte at a time
-                    if (bank == 1) {
-                      set_number(1, GBA_FLASH_SET_BANK); // Set bank 1
-                    }
-
-                    uint8_t sector = 0;
-                    while (currAddr < endAddr) {
-                      if (currAddr % 4096 == 0) {
-                        flash_4k_sector_erase(sector);
-                        sector++;
-                        com_wait_for_ack(); // Wait 25ms for sector erase
-
-                        // Wait for first byte to be 0xFF, that's when we know
-                        // the sector has been erased
-                        readBuffer[0] = 0;
-                        while (readBuffer[0] != 0xFF) {
-                          set_number(currAddr, SET_START_ADDRESS);
-                          set_mode(GBA_READ_SRAM);
-
-                          com_read_bytes(READ_BUFFER, 64);
-                          com_read_stop();
-
-                          if (readBuffer[0] != 0xFF) {
-                            delay_ms(5);
-                          }
-                        }
-
-                        // Set start address again
-                        set_number(currAddr, SET_START_ADDRESS);
-
-                        delay_ms(5); // Wait a little bit as hardware might not
-                                     // be ready
-                      }
-
-                      com_write_bytes_from_file(GBA_FLASH_WRITE_BYTE, ramFile,
-                                                64);
-                      currAddr += 64;
-                      readBytes += 64;
-                      com_wait_for_ack(); // Wait for write complete
 
-                      print_progress_percent(readBytes,
-                                             (ramBanks * endAddr) / 64);
-                      led_progress_percent(readBytes,
-                                           (ramBanks * endAddr) / 28);
-                    }
-                  }
-
-                  if (bank == 1) {
-                    set_number(0, GBA_FLASH_SET_BANK); // Set bank 0 again
-                  }
-                }
-              }
-              printf("]");
-
-              fclose(ramFile);
-              printf("\nFinished\n");
-            } else {
-              printf("Aborted\n");
-            }
-          } else {
-            printf("%s File not found\n", titleFilename);
-          }
-        } else {
-          printf("Cartridge has no RAM\n");
-        }
+      if (restore_save(argv[1]) != 0) {
+        return 1;
       }
     }
   } else {
@@ -4175,3 +4526,4 @@ int main(int argc, char **argv) {
 
   return 0;
 }
+#endif
@@ -0,0 +1,523 @@
+/*
+ libgbxcart by DEFENSE MECHANISM
+
+ See gbxcart.h. Each call runs with gbx_fatal() jumping back out of it, so a
+ device that stops answering fails the call rather than ending the program,
+ and the cart is identified again on the next one. Saves are read whole (at
+ most 128KB) and the blocks asked for taken from them, the GB RAM and EEPROM
+ writers work on the whole save too.
+
+ */
+
+#ifndef _WIN32
+#define _XOPEN_SOURCE 600 // Must come before the first system header
+#endif
+
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GBX_NO_DEFAULT_DEVICE
+#include "batch.h" // flash_rom()
+#include "gbxcart.h"
+#include "setup.h" // See defines, variables, constants, functions here
+
+#define GBXCART_SECTOR_SIZE 4096 // Flash saves are erased a sector at a time
+#define GBXCART_ERASE_WAIT_MAX 200
+
+struct gbxcart {
+  struct gbx_device device;
+  struct cart_identity identity;
+  uint8_t identified;
+};
+
+// One call's arguments
+struct gbxcart_call {
+  uint8_t region;
+  uint32_t address;
+  uint32_t length;
+  uint8_t *data;           // Read into
+  const uint8_t *expected; // Written, or compared with
+  uint32_t firstDiff;
+  const char *romPath;
+  int cartType;
+  uint8_t passProgress; // Pass on the progress print_progress_percent() gets
+  uint8_t *saveData;    // The whole save, freed here if gbx_fatal() jumps out
+  gbxcart_progress progress;
+  void *context;
+};
+
+static jmp_buf *callJump = NULL;
+static struct gbxcart_call *currentCall = NULL;
+
+// The default device while a cart is lent to flash_rom()
+static struct gbx_device lentDefault;
+static struct gbxcart *lentCart = NULL;
+
+// Outside a call gbx_fatal() carries on and exits as it does in the tools
+static void gbxcart_fatal(void) {
+  if (callJump != NULL) {
+    longjmp(*callJump, 1);
+  }
+}
+
+static void gbxcart_progress_hook(uint32_t bytesDone, uint32_t bytesTotal) {
+  if (currentCall != NULL && currentCall->passProgress == 1 &&
+      currentCall->progress != NULL) {
+    currentCall->progress(currentCall->context, bytesDone, bytesTotal);
+  }
+}
+
+static void gbxcart_lend(struct gbxcart *cart) {
+  lentDefault = gbxDefaultDevice;
+  gbxDefaultDevice = cart->device;
+  lentCart = cart;
+}
+
+static void gbxcart_give_back(void) {
+  if (lentCart != NULL) {
+    lentCart->device = gbxDefaultDevice;
+    gbxDefaultDevice = lentDefault;
+    lentCart = NULL;
+  }
+}
+
+static int gbxcart_identify_cart(struct gbxcart *cart) {
+  cart->identified = 0;
+  if (gbx_request_device_info(&cart->device) == 0) {
+    return GBXCART_NO_DEVICE;
+  }
+  if (gbx_cart_read_identity(&cart->device, &cart->identity, 0) == 0) {
+    return GBXCART_NO_CART;
+  }
+  cart->identified = 1;
+  return GBXCART_OK;
+}
+
+// Run the operation (after identifying the cart if it hasn't been) with
+// gbx_fatal() and the progress coming back here
+static int gbxcart_run(struct gbxcart *cart,
+                       int (*operation)(struct gbxcart *,
+                                        struct gbxcart_call *),
+                       struct gbxcart_call *call) {
+  jmp_buf jump;
+  int result;
+  callJump = &jump;
+  currentCall = call;
+
+  if (setjmp(jump) == 0) {
+    result = GBXCART_OK;
+    if (cart->identified == 0) {
+      result = gbxcart_identify_cart(cart);
+    }
+    if (result == GBXCART_OK && operation != NULL) {
+      result = operation(cart, call);
+    }
+  } else {
+    // Whatever the device was doing is abandoned, the next call starts again
+    // from the device info
+    free(call->saveData);
+    call->saveData = NULL;
+    gbxcart_give_back();
+    cart->identified = 0;
+    result = GBXCART_NO_DEVICE;
+  }
+
+  callJump = NULL;
+  currentCall = NULL;
+  return result;
+}
+
+static int gbxcart_check_range(struct gbxcart *cart,
+                               struct gbxcart_call *call) {
+  uint32_t size = cart->identity.saveLength;
+  if (call->region == GBXCART_ROM) {
+    size = (cart->device.cartridgeMode == GB_MODE) ? GBXCART_GB_ROM_MAX
+                                                   : GBXCART_GBA_ROM_MAX;
+  }
+  if (call->address % 64 != 0 || call->length % 64 != 0 ||
+      call->address > size || call->length > size - call->address) {
+    return GBXCART_BAD_RANGE;
+  }
+  return GBXCART_OK;
+}
+
+// Take the 64 byte block read from offset, returns 0 once it differs from what
+// it's compared with
+static uint8_t gbxcart_block(struct gbxcart_call *call, uint32_t offset,
+                             const uint8_t *block) {
+  uint32_t index = offset - call->address;
+  if (call->expected != NULL) {
+    int32_t diff = compare_first_diff(block, &call->expected[index], 64);
+    if (diff >= 0) {
+      call->firstDiff = offset + diff;
+      return 0;
+    }
+  } else {
+    memcpy(&call->data[index], block, 64);
+  }
+  if (call->progress != NULL) {
+    call->progress(call->context, index + 64, call->length);
+  }
+  return 1;
+}
+
+// Take each block gbx_read_rom() reads 64 bytes at a time
+static uint8_t gbxcart_rom_block(void *context, uint32_t romOffset,
+                                 const uint8_t *data, uint16_t length) {
+  for (uint16_t x = 0; x < length; x += 64) {
+    if (gbxcart_block((struct gbxcart_call *)context, romOffset + x,
+                      &data[x]) == 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// Switch to the second 64KB of a 1Mbit GBA save and back
+static void gbxcart_gba_save_bank(struct gbx_device *device, uint8_t bank) {
+  if (device->hasFlashSave >= FLASH_FOUND) {
+    gbx_set_number(device, bank, GBA_FLASH_SET_BANK);
+  } else if (device->hasFlashSave == NO_FLASH) {
+    gbx_gba_flash_write_address_byte(device, 0x1000000, bank);
+  }
+}
+
+// Read the whole save into saveData (identity.saveLength bytes)
+static void gbxcart_read_save(struct gbxcart *cart, uint8_t *saveData) {
+  struct gbx_device *device = &cart->device;
+  if (device->cartridgeMode == GB_MODE) {
+    gbx_gb_read_ram(device, saveData);
+  } else if (device->eepromSize != EEPROM_NONE) {
+    gbx_gba_read_eeprom(device, saveData);
+  } else {
+    for (uint8_t bank = 0; bank < device->ramBanks; bank++) {
+      if (bank == 1) {
+        gbxcart_gba_save_bank(device, 1);
+      }
+      gbx_gba_read_save(device, 0, &saveData[bank * device->ramEndAddress],
+                        device->ramEndAddress);
+      if (bank == 1) {
+        gbxcart_gba_save_bank(device, 0);
+      }
+    }
+  }
+}
+
+static int gbxcart_read_op(struct gbxcart *cart, struct gbxcart_call *call) {
+  int result = gbxcart_check_range(cart, call);
+  if (result != GBXCART_OK) {
+    return result;
+  }
+  call->firstDiff = 0xFFFFFFFF;
+
+  if (call->region == GBXCART_ROM) {
+    gbx_read_rom(&cart->device, call->address, call->length,
+                 gbxcart_rom_block, call);
+  } else {
+    call->saveData = (uint8_t *)malloc(cart->identity.saveLength + 64);
+    if (call->saveData == NULL) {
+      return GBXCART_FAILED;
+    }
+    gbxcart_read_save(cart, call->saveData);
+    for (uint32_t offset = call->address; offset < call->address + call->length;
+         offset += 64) {
+      if (gbxcart_block(call, offset, &call->saveData[offset]) == 0) {
+        break;
+      }
+    }
+    free(call->saveData);
+    call->saveData = NULL;
+  }
+  return (call->firstDiff != 0xFFFFFFFF) ? GBXCART_MISMATCH : GBXCART_OK;
+}
+
+// Erase the 4KB Flash save sector and wait for it to read back as 0xFF
+static void gbxcart_erase_sector(struct gbx_device *device,
+                                 uint32_t bankAddress) {
+  gbx_flash_4k_sector_erase(device, bankAddress / GBXCART_SECTOR_SIZE);
+  gbx_com_wait_for_ack(device); // Wait 25ms for sector erase
+
+  uint16_t waits = 0;
+  device->readBuffer[0] = 0;
+  while (device->readBuffer[0] != 0xFF) {
+    if (++waits > GBXCART_ERASE_WAIT_MAX) {
+      gbx_fatal(device);
+    }
+    gbx_set_number(device, bankAddress, SET_START_ADDRESS);
+    gbx_set_mode(device, GBA_READ_SRAM);
+    gbx_com_read_bytes(device, READ_BUFFER, 64);
+    gbx_com_read_stop(device);
+    if (device->readBuffer[0] != 0xFF) {
+      delay_ms(5);
+    }
+  }
+  delay_ms(5); // Wait a little bit as hardware might not be ready
+}
+
+// Write to a GBA SRAM or Flash save a 4KB sector at a time. Sectors that
+// already hold the data are skipped, only the blocks (pages on Atmel) that
+// differ are written and a Flash sector is only erased if a bit has to go
+// from 0 to 1. Each sector written is read back and fails the call if it
+// doesn't match.
+static int gbxcart_write_gba_save(struct gbxcart *cart,
+                                  struct gbxcart_call *call) {
+  struct gbx_device *device = &cart->device;
+  if (device->hasFlashSave == NOT_CHECKED) {
+    device->hasFlashSave = gbx_gba_test_sram_flash_write(device);
+  }
+  uint8_t command = GBA_WRITE_SRAM;
+  uint16_t blockSize = 64;
+  if (device->hasFlashSave == FLASH_FOUND_ATMEL) {
+    command = GBA_FLASH_WRITE_ATMEL;
+    blockSize = 128;
+  } else if (device->hasFlashSave >= FLASH_FOUND) {
+    command = GBA_FLASH_WRITE_BYTE;
+  }
+
+  uint8_t sectorData[GBXCART_SECTOR_SIZE];
+  uint8_t newData[GBXCART_SECTOR_SIZE];
+  uint32_t end = call->address + call->length;
+  uint8_t bank = 0;
+  uint32_t badSectors = 0;
+  for (uint32_t sector = call->address - call->address % GBXCART_SECTOR_SIZE;
+       sector < end; sector += GBXCART_SECTOR_SIZE) {
+    if (sector / device->ramEndAddress != bank) {
+      bank = sector / device->ramEndAddress;
+      gbxcart_gba_save_bank(device, bank);
+    }
+    uint32_t bankAddress = sector % device->ramEndAddress;
+    gbx_gba_read_save(device, bankAddress, sectorData, GBXCART_SECTOR_SIZE);
+
+    // The part of the sector being written, the rest stays as it is
+    uint32_t first = (call->address > sector) ? call->address : sector;
+    uint32_t last = (end < sector + GBXCART_SECTOR_SIZE)
+                        ? end
+                        : sector + GBXCART_SECTOR_SIZE;
+    memcpy(newData, sectorData, GBXCART_SECTOR_SIZE);
+    memcpy(&newData[first - sector], &call->expected[first - call->address],
+           last - first);
+
+    if (memcmp(sectorData, newData, GBXCART_SECTOR_SIZE) != 0) {
+      if (command == GBA_FLASH_WRITE_BYTE) {
+        for (uint16_t x = 0; x < GBXCART_SECTOR_SIZE; x++) {
+          if ((sectorData[x] & newData[x]) != newData[x]) {
+            gbxcart_erase_sector(device, bankAddress);
+            memset(sectorData, 0xFF, GBXCART_SECTOR_SIZE);
+            break;
+          }
+        }
+      }
+
+      uint32_t nextAddr = 0xFFFFFFFF;
+      for (uint16_t block = 0; block < GBXCART_SECTOR_SIZE;
+           block += blockSize) {
+        if (memcmp(&sectorData[block], &newData[block], blockSize) == 0) {
+          continue;
+        }
+        if (bankAddress + block != nextAddr) {
+          gbx_set_number(device, bankAddress + block, SET_START_ADDRESS);
+        }
+        memcpy(device->writeBuffer, &newData[block], blockSize);
+        gbx_com_write_bytes_from_file(device, command, NULL, blockSize);
+        gbx_com_wait_for_ack(device); // Wait for write complete
+        nextAddr = bankAddress + block + blockSize;
+      }
+
+      gbx_gba_read_save(device, bankAddress, sectorData, GBXCART_SECTOR_SIZE);
+      if (memcmp(sectorData, newData, GBXCART_SECTOR_SIZE) != 0) {
+        badSectors++;
+      }
+    }
+
+    if (call->progress != NULL) {
+      call->progress(call->context, last - call->address, call->length);
+    }
+  }
+  if (bank != 0) {
+    gbxcart_gba_save_bank(device, 0);
+  }
+  return (badSectors > 0) ? GBXCART_FAILED : GBXCART_OK;
+}
+
+static int gbxcart_write_op(struct gbxcart *cart, struct gbxcart_call *call) {
+  if (call->region != GBXCART_SAVE) {
+    return GBXCART_UNSUPPORTED;
+  }
+  int result = gbxcart_check_range(cart, call);
+  if (result != GBXCART_OK || call->length == 0) {
+    return result;
+  }
+  struct gbx_device *device = &cart->device;
+  if (device->cartridgeMode == GBA_MODE && device->eepromSize == EEPROM_NONE) {
+    return gbxcart_write_gba_save(cart, call);
+  }
+
+  // The GB RAM and EEPROM writers take the whole save and write the blocks
+  // that differ, progress is them reading the cart first
+  uint32_t saveLength = cart->identity.saveLength;
+  uint8_t *saveData = (uint8_t *)malloc(saveLength);
+  if (saveData == NULL) {
+    return GBXCART_FAILED;
+  }
+  call->saveData = saveData;
+  gbxcart_read_save(cart, saveData);
+  memcpy(&saveData[call->address], call->expected, call->length);
+
+  call->passProgress = 1;
+  uint32_t changedBlocks = 0;
+  uint32_t badBlocks;
+  if (device->cartridgeMode == GB_MODE) {
+    badBlocks =
+        gbx_gb_write_ram_delta(device, saveData, saveLength, &changedBlocks);
+  } else {
+    badBlocks = gbx_gba_write_eeprom_delta(device, saveData, saveLength,
+                                           &changedBlocks);
+  }
+  call->passProgress = 0;
+  free(saveData);
+  call->saveData = NULL;
+  return (badBlocks > 0) ? GBXCART_FAILED : GBXCART_OK;
+}
+
+static int gbxcart_flash_rom_op(struct gbxcart *cart,
+                                struct gbxcart_call *call) {
+  if (call->cartType > 0) {
+    cart->device.flashCartType = call->cartType;
+  } else {
+    gbx_read_config_flash(&cart->device);
+  }
+  cart->device.mode5vOverride = 0;
+
+  // flash_rom() is written for the default device, lend it this one
+  gbxcart_lend(cart);
+  call->passProgress = 1;
+  int flashResult = flash_rom(call->romPath);
+  call->passProgress = 0;
+  gbxcart_give_back();
+
+  // The header is read again for what's been written
+  cart->identified = 0;
+  if (flashResult == FLASH_ROM_POWER_CYCLE) {
+    return GBXCART_POWER_CYCLE;
+  }
+  return (flashResult == 0 || flashResult == FLASH_ROM_VERIFIED)
+             ? GBXCART_OK
+             : GBXCART_FAILED;
+}
+
+struct gbxcart *gbxcart_open(int port) {
+  struct gbxcart *cart = (struct gbxcart *)calloc(1, sizeof(struct gbxcart));
+  if (cart == NULL) {
+    return NULL;
+  }
+  gbx_device_init(&cart->device, 1, gbxcart_fatal, gbxcart_progress_hook);
+  gbx_read_config(&cart->device);
+  if (port > 0) {
+    cart->device.cport_nr = port - 1;
+    cart->device.cportFixed = 1;
+  }
+  if (gbx_com_test_port(&cart->device) == 0) {
+    free(cart);
+    return NULL;
+  }
+  return cart;
+}
+
+void gbxcart_close(struct gbxcart *cart) {
+  if (cart != NULL) {
+    RS232_CloseComport(cart->device.cport_nr);
+    free(cart);
+  }
+}
+
+int gbxcart_port(const struct gbxcart *cart) {
+  return cart->device.cport_nr + 1;
+}
+
+int gbxcart_identify(struct gbxcart *cart, struct gbxcart_info *info) {
+  struct gbxcart_call call = {0};
+  cart->identified = 0;
+  int result = gbxcart_run(cart, NULL, &call);
+  if (result == GBXCART_OK && info != NULL) {
+    info->firmwareVersion = cart->identity.firmwareVersion;
+    info->pcbVersion = cart->identity.pcbVersion;
+    info->mode = cart->identity.mode;
+    memcpy(info->title, cart->identity.title, sizeof(info->title));
+    info->romLength = cart->identity.romLength;
+    info->saveLength = cart->identity.saveLength;
+    info->headerOk = cart->identity.headerOk;
+  }
+  return result;
+}
+
+int gbxcart_read(struct gbxcart *cart, uint8_t region, uint32_t address,
+                 uint8_t *data, uint32_t length, gbxcart_progress progress,
+                 void *context) {
+  struct gbxcart_call call = {0};
+  call.region = region;
+  call.address = address;
+  call.length = length;
+  call.data = data;
+  call.progress = progress;
+  call.context = context;
+  return gbxcart_run(cart, gbxcart_read_op, &call);
+}
+
+int gbxcart_write(struct gbxcart *cart, uint8_t region, uint32_t address,
+                  const uint8_t *data, uint32_t length,
+                  gbxcart_progress progress, void *context) {
+  struct gbxcart_call call = {0};
+  call.region = region;
+  call.address = address;
+  call.length = length;
+  call.expected = data;
+  call.progress = progress;
+  call.context = context;
+  return gbxcart_run(cart, gbxcart_write_op, &call);
+}
+
+int gbxcart_erase(struct gbxcart *cart, uint8_t region, uint32_t address,
+                  uint32_t length, gbxcart_progress progress, void *context) {
+  if (region != GBXCART_SAVE) {
+    return GBXCART_UNSUPPORTED;
+  }
+  uint8_t *blank = (uint8_t *)malloc(length + 1);
+  if (blank == NULL) {
+    return GBXCART_FAILED;
+  }
+  memset(blank, 0xFF, length);
+  int result =
+      gbxcart_write(cart, region, address, blank, length, progress, context);
+  free(blank);
+  return result;
+}
+
+int gbxcart_verify(struct gbxcart *cart, uint8_t region, uint32_t address,
+                   const uint8_t *data, uint32_t length, uint32_t *firstDiff,
+                   gbxcart_progress progress, void *context) {
+  struct gbxcart_call call = {0};
+  call.region = region;
+  call.address = address;
+  call.length = length;
+  call.expected = data;
+  call.progress = progress;
+  call.context = context;
+  int result = gbxcart_run(cart, gbxcart_read_op, &call);
+  if (result == GBXCART_MISMATCH && firstDiff != NULL) {
+    *firstDiff = call.firstDiff;
+  }
+  return result;
+}
+
+int gbxcart_flash_rom(struct gbxcart *cart, const char *romPath, int cartType,
+                      gbxcart_progress progress, void *context) {
+  struct gbxcart_call call = {0};
+  call.romPath = romPath;
+  call.cartType = cartType;
+  call.progress = progress;
+  call.context = context;
+  return gbxcart_run(cart, gbxcart_flash_rom_op, &call);
+}
@@ -0,0 +1,87 @@
+/*
+ libgbxcart by DEFENSE MECHANISM
+
+ The GBxCart RW as a library, for programs that keep a device open and run
+ one operation after another on it (a daemon, tests, benchmarks) rather than
+ starting a tool and connecting again each time. Link build/libgbxcart.a or
+ build/libgbxcart.so and include this file only.
+
+ Addresses and lengths are in bytes from the start of the ROM or save and
+ have to be multiples of 64, the size the device reads and writes. Progress
+ goes to the callback given (NULL for none) as bytes done out of the total.
+
+ Calls aren't thread safe, use one thread (or a process per device). The
+ messages the tools print still go to stdout, but nothing waits on stdin.
+
+ */
+
+#include <stdint.h>
+
+// What the calls return
+#define GBXCART_OK 0
+#define GBXCART_POWER_CYCLE 1 // One segment of a 32MB image is written, power cycle the cart and flash it again
+#define GBXCART_NO_DEVICE -1  // The device didn't answer, or stopped answering part way through
+#define GBXCART_NO_CART -2    // The device doesn't know which mode the cart is in
+#define GBXCART_BAD_RANGE -3  // Not 64 byte aligned, or past the end of the ROM or save
+#define GBXCART_UNSUPPORTED -4
+#define GBXCART_MISMATCH -5 // The cart doesn't hold what it was verified against
+#define GBXCART_FAILED -6   // Out of memory, the ROM couldn't be written or blocks didn't read back
+
+// What to read, write, erase or verify
+#define GBXCART_ROM 0
+#define GBXCART_SAVE 1 // SRAM, Flash or EEPROM on GBA, the cart RAM on GB
+
+// Up to 32MB of ROM on GBA, 512 banks on GB
+#define GBXCART_GB_ROM_MAX 0x800000
+#define GBXCART_GBA_ROM_MAX 0x2000000
+
+struct gbxcart;
+
+struct gbxcart_info {
+  uint8_t firmwareVersion;
+  uint8_t pcbVersion;
+  uint8_t mode; // 1 for GB, 2 for GBA
+  char title[17];
+  uint32_t romLength;  // Bytes, from the header
+  uint32_t saveLength; // Bytes, 0 if none
+  uint8_t headerOk;
+};
+
+typedef void (*gbxcart_progress)(void *context, uint32_t done, uint32_t total);
+
+// Connect to the device on the port (numbered as in config.ini), or for 0 the one in config.ini or GBXCART_PORT,
+// looking on the other ports if it isn't there. Returns NULL if no device answered.
+struct gbxcart *gbxcart_open(int port);
+
+// Close the port and free the cart
+void gbxcart_close(struct gbxcart *cart);
+
+// The port the device is on, numbered as in config.ini
+int gbxcart_port(const struct gbxcart *cart);
+
+// Ask the device for its versions and mode, set the voltage and read the cart's header. Call it again after
+// changing carts, the other calls identify the cart first if it hasn't been.
+int gbxcart_identify(struct gbxcart *cart, struct gbxcart_info *info);
+
+// Read length bytes of the ROM or save at address into data
+int gbxcart_read(struct gbxcart *cart, uint8_t region, uint32_t address, uint8_t *data, uint32_t length,
+                 gbxcart_progress progress, void *context);
+
+// Write length bytes of data to the save at address, leaving the rest of it as it is. Only the 64 byte blocks
+// (4KB sectors on Flash) that differ get written. The ROM is written with gbxcart_flash_rom().
+int gbxcart_write(struct gbxcart *cart, uint8_t region, uint32_t address, const uint8_t *data, uint32_t length,
+                  gbxcart_progress progress, void *context);
+
+// Set length bytes of the save at address to 0xFF. The ROM is erased by gbxcart_flash_rom().
+int gbxcart_erase(struct gbxcart *cart, uint8_t region, uint32_t address, uint32_t length, gbxcart_progress progress,
+                  void *context);
+
+// Compare length bytes of the ROM or save at address with data, stopping at the first difference. Returns
+// GBXCART_MISMATCH with its address in firstDiff (if not NULL) when they differ.
+int gbxcart_verify(struct gbxcart *cart, uint8_t region, uint32_t address, const uint8_t *data, uint32_t length,
+                   uint32_t *firstDiff, gbxcart_progress progress, void *context);
+
+// Erase and write the ROM image at romPath as flash-cart does, for the cart type flash-cart takes (0 for the one
+// in config-flash.ini). Returns GBXCART_POWER_CYCLE while a 32MB image has segments left to write.
+int gbxcart_flash_rom(struct gbxcart *cart, const char *romPath, int cartType, gbxcart_progress progress,
+                      void *context);
@@ -0,0 +1,85 @@
+/*
+ Device hot-plugging by DEFENSE MECHANISM
+
+ See hotplug.h. The whole of /dev is watched rather than the port's node, a
+ node that isn't there can't be watched and udev makes it again each time.
+
+ */
+
+#ifndef _WIN32
+#define _XOPEN_SOURCE 600 // Must come before the first system header
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "hotplug.h"
+#include "setup.h" // See defines, variables, constants, functions here
+
+int hotplug_watch(void) {
+#ifdef __linux__
+  int watchFd = inotify_init();
+  if (watchFd < 0) {
+    return -1;
+  }
+  uint32_t events = IN_CREATE | IN_DELETE | IN_MOVE | IN_ATTRIB;
+  if (inotify_add_watch(watchFd, "/dev", events) < 0) {
+    close(watchFd);
+    return -1;
+  }
+  return watchFd;
+#else
+  return -1;
+#endif
+}
+
+void hotplug_drain(int watchFd) {
+#ifdef __linux__
+  if (watchFd < 0) {
+    return;
+  }
+  char events[4096];
+  struct pollfd pollFd = {watchFd, POLLIN, 0};
+  while (poll(&pollFd, 1, 0) > 0 &&
+         read(watchFd, events, sizeof(events)) > 0) {
+  }
+#endif
+}
+
+uint8_t hotplug_present(int port) {
+#ifdef _WIN32
+  return 1;
+#else
+  const char *portName = RS232_GetPortName(port - 1);
+  struct stat nodeStat;
+  if (portName == NULL) {
+    return 1; // Nothing to watch, leave it to the port timing out
+  }
+  return (stat(portName, &nodeStat) == 0) ? 1 : 0;
+#endif
+}
+
+void hotplug_wait(int watchFd, int port, uint8_t present) {
+  while (hotplug_present(port) != present) {
+#ifdef __linux__
+    if (watchFd >= 0) {
+      struct pollfd pollFd = {watchFd, POLLIN, 0};
+      poll(&pollFd, 1, HOTPLUG_POLL_MS);
+      hotplug_drain(watchFd);
+      continue;
+    }
+#endif
+    delay_ms(HOTPLUG_POLL_MS);
+  }
+  if (present == 1) {
+    delay_ms(HOTPLUG_SETTLE_MS);
+  }
+}
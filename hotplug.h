@@ -0,0 +1,28 @@
+/*
+ Device hot-plugging by DEFENSE MECHANISM
+
+ Notices GBxCart RW devices being unplugged and plugged back in (to power
+ cycle a cart, or after a hang) by their serial port's device node coming and
+ going. On Linux /dev is watched with inotify so a change is seen straight
+ away, elsewhere the node is looked for every HOTPLUG_POLL_MS. On Windows a
+ port is always taken to be there.
+
+ */
+
+#include <stdint.h>
+
+#define HOTPLUG_POLL_MS 1000
+#define HOTPLUG_SETTLE_MS 1500 // From the node showing up to the device answering (udev, the firmware starting)
+
+// Start watching for ports coming and going. Returns an fd that's readable when something in /dev changed, or -1
+// if that can't be watched (look every HOTPLUG_POLL_MS instead).
+int hotplug_watch(void);
+
+// Read the changes waiting on the fd so it only wakes up for new ones
+void hotplug_drain(int watchFd);
+
+// Returns 1 if the port (numbered as in config.ini) has its device node
+uint8_t hotplug_present(int port);
+
+// Wait for the port's device node to be there and for the device to settle, or for it to go if present is 0
+void hotplug_wait(int watchFd, int port, uint8_t present);
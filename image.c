@@ -0,0 +1,184 @@
+/*
+ Image cache by DEFENSE MECHANISM
+
+ See image.h. Without mmap (Windows) the image is read into memory instead,
+ which still saves reading it again for every job.
+
+ */
+
+#ifndef _WIN32
+#define _XOPEN_SOURCE 600 // Must come before the first system header
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "image.h"
+#include "setup.h" // See defines, variables, constants, functions here
+
+struct image images[IMAGE_CACHE_SIZE];
+uint32_t imageUses = 0;
+
+static void image_unmap(struct image *image) {
+  if (image->data != NULL && image->length > 0) {
+#ifdef _WIN32
+    free((void *)image->data);
+#else
+    munmap((void *)image->data, image->length);
+#endif
+  }
+  free(image->blankBlocks);
+  free(image->sectorHashes);
+  memset(image, 0, sizeof(struct image));
+}
+
+static const uint8_t *image_map(const char *path, uint32_t length) {
+  static const uint8_t empty = 0;
+  if (length == 0) {
+    return &empty;
+  }
+#ifdef _WIN32
+  FILE *imageFile = fopen(path, "rb");
+  if (imageFile == NULL) {
+    return NULL;
+  }
+  uint8_t *data = (uint8_t *)malloc(length);
+  if (data == NULL || fread(data, 1, length, imageFile) != length) {
+    free(data);
+    data = NULL;
+  }
+  fclose(imageFile);
+  return data;
+#else
+  int imageFd = open(path, O_RDONLY);
+  if (imageFd < 0) {
+    return NULL;
+  }
+  void *data = mmap(NULL, length, PROT_READ, MAP_SHARED, imageFd, 0);
+  close(imageFd); // The mapping keeps the file
+  return (data == MAP_FAILED) ? NULL : (const uint8_t *)data;
+#endif
+}
+
+// Find the blank blocks and hash the sectors
+static uint8_t image_plan(struct image *image) {
+  uint32_t blockCount = image->length / IMAGE_BLOCK_SIZE;
+  image->blankBlocks = (uint8_t *)calloc(blockCount / 8 + 1, 1);
+  image->sectorCount =
+      (image->length + IMAGE_SECTOR_SIZE - 1) / IMAGE_SECTOR_SIZE;
+  image->sectorHashes =
+      (uint64_t *)malloc((image->sectorCount + 1) * sizeof(uint64_t));
+  if (image->blankBlocks == NULL || image->sectorHashes == NULL) {
+    return 0;
+  }
+
+  // A short last block isn't blank, the rest of it would be written from
+  // whatever is past the end of the file
+  for (uint32_t block = 0; (block + 1) * IMAGE_BLOCK_SIZE <= image->length;
+       block++) {
+    const uint8_t *data = &image->data[block * IMAGE_BLOCK_SIZE];
+    uint8_t blank = 1;
+    for (uint8_t x = 0; x < IMAGE_BLOCK_SIZE && blank == 1; x++) {
+      if (data[x] != 0xFF) {
+        blank = 0;
+      }
+    }
+    if (blank == 1) {
+      image->blankBlocks[block / 8] |= (uint8_t)(1 << (block % 8));
+    }
+  }
+
+  for (uint32_t sector = 0; sector < image->sectorCount; sector++) {
+    uint32_t offset = sector * IMAGE_SECTOR_SIZE;
+    uint32_t length = image->length - offset;
+    if (length > IMAGE_SECTOR_SIZE) {
+      length = IMAGE_SECTOR_SIZE;
+    }
+    image->sectorHashes[sector] =
+        hash64_update(HASH64_START, &image->data[offset], length);
+  }
+  image->hash = hash64_update(HASH64_START, (uint8_t *)image->sectorHashes,
+                              image->sectorCount * sizeof(uint64_t));
+  return 1;
+}
+
+const struct image *image_open(const char *path) {
+  struct stat fileStat;
+  if (stat(path, &fileStat) != 0 || fileStat.st_size > 0xFFFFFFFFL) {
+    return NULL;
+  }
+  imageUses++;
+
+  struct image *image = NULL;
+  for (uint8_t x = 0; x < IMAGE_CACHE_SIZE; x++) {
+    if (images[x].data != NULL && strcmp(images[x].path, path) == 0) {
+      if (images[x].length == (uint32_t)fileStat.st_size &&
+          images[x].modified == fileStat.st_mtime) {
+        images[x].lastUsed = imageUses;
+        return &images[x];
+      }
+      image = &images[x]; // Changed since it was mapped
+    }
+  }
+
+  // Take a free slot, or the one used longest ago
+  if (image == NULL) {
+    image = &images[0];
+    for (uint8_t x = 0; x < IMAGE_CACHE_SIZE; x++) {
+      if (images[x].data == NULL) {
+        image = &images[x];
+        break;
+      }
+      if (images[x].lastUsed < image->lastUsed) {
+        image = &images[x];
+      }
+    }
+  }
+  image_unmap(image);
+
+  image->length = (uint32_t)fileStat.st_size;
+  image->data = image_map(path, image->length);
+  if (image->data == NULL) {
+    image->length = 0;
+    return NULL;
+  }
+  strncpy(image->path, path, sizeof(image->path) - 1);
+  image->modified = fileStat.st_mtime;
+  image->lastUsed = imageUses;
+  if (image_plan(image) == 0) {
+    image_unmap(image);
+    return NULL;
+  }
+  return image;
+}
+
+uint8_t image_blank(const struct image *image, uint32_t offset,
+                    uint32_t length) {
+  if (image == NULL || offset + length > image->length) {
+    return 0;
+  }
+  for (uint32_t block = offset / IMAGE_BLOCK_SIZE;
+       block < (offset + length) / IMAGE_BLOCK_SIZE; block++) {
+    if ((image->blankBlocks[block / 8] & (1 << (block % 8))) == 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+void image_close_all(void) {
+  for (uint8_t x = 0; x < IMAGE_CACHE_SIZE; x++) {
+    image_unmap(&images[x]);
+  }
+}
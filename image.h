@@ -0,0 +1,44 @@
+/*
+ Image cache by DEFENSE MECHANISM
+
+ Keeps the ROM images being written and verified memory mapped read only, so
+ running the same image on cart after cart (in a batch or on the daemon's
+ workers) maps it once instead of reading it into memory for every step of
+ every job. An image is found again by its path, size and modification time,
+ a changed file is mapped again. Each image has its block plan: which 64 byte
+ blocks are all 0xFF (already there after an erase, so they needn't be
+ written) and a hash of each sector for checking what a cart holds.
+
+ The mapping is shared, so the daemon's workers all read the same pages of
+ the page cache.
+
+ */
+
+#include <stdint.h>
+#include <time.h>
+
+#define IMAGE_CACHE_SIZE 8
+#define IMAGE_BLOCK_SIZE 64
+#define IMAGE_SECTOR_SIZE 0x8000
+
+struct image {
+  char path[256];
+  uint32_t length;
+  time_t modified;
+  const uint8_t *data;
+  uint8_t *blankBlocks;   // One bit per block, set if it's all 0xFF
+  uint64_t *sectorHashes; // hash64 of each sector, the last one can be short
+  uint32_t sectorCount;
+  uint64_t hash; // Of the sector hashes, tells images apart wherever they are
+  uint32_t lastUsed;
+};
+
+// The image of the file at path from the cache, mapped and planned if it's new or has changed. Returns NULL if it
+// can't be read. The image stays valid until IMAGE_CACHE_SIZE other images have been opened after it.
+const struct image *image_open(const char *path);
+
+// Returns 1 if the length bytes at offset are all 0xFF (offset and length a multiple of IMAGE_BLOCK_SIZE)
+uint8_t image_blank(const struct image *image, uint32_t offset, uint32_t length);
+
+// Unmap every image
+void image_close_all(void);
@@ -0,0 +1,370 @@
+/*
+ LSDj save helpers by DEFENSE MECHANISM
+
+ Incremental LSDj save archive, see lsdj.h. Snapshot files are plain text:
+
+   LSDJ-SNAPSHOT 1
+   working <hash>                      32KB working song
+   header <1024 hex digits>            0x8000-0x81FF as is
+   song <slot> <hash> <block list>     the song's blocks in block order
+   block <block> <hash>                a block no song owns
+
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+#include "lsdj.h"
+#include "setup.h"
+
+#define LSDJ_LINE_LENGTH 2048
+
+uint8_t songData[LSDJ_BLOCK_COUNT * LSDJ_BLOCK_SIZE];
+
+static void archive_path(char *path, const char *name) {
+  snprintf(path, 256, "%s/%s", LSDJ_ARCHIVE_DIR, name);
+}
+
+static void object_path(char *path, uint64_t hash) {
+  char name[20];
+  snprintf(name, sizeof(name), "%016llX", (unsigned long long)hash);
+  archive_path(path, name);
+}
+
+// Store the data under its hash unless it's already there. Returns the number
+// of bytes written (0 if it was already stored) or -1 if it couldn't be written.
+static long store_object(const uint8_t *data, uint32_t length, uint64_t *hash) {
+  *hash = hash64_update(HASH64_START, data, length);
+
+  char path[256];
+  object_path(path, *hash);
+  FILE *objectFile = fopen(path, "rb");
+  if (objectFile != NULL) {
+    fclose(objectFile);
+    return 0;
+  }
+
+  objectFile = fopen(path, "wb");
+  if (objectFile == NULL) {
+    return -1;
+  }
+  size_t written = fwrite(data, 1, length, objectFile);
+  if (fclose(objectFile) != 0 || written != length) {
+    remove(path);
+    return -1;
+  }
+  return length;
+}
+
+// Load exactly length bytes stored under the hash. Returns 0 if it worked.
+static int load_object(uint64_t hash, uint8_t *data, uint32_t length) {
+  char path[256];
+  object_path(path, hash);
+  FILE *objectFile = fopen(path, "rb");
+  if (objectFile == NULL) {
+    printf("Missing %s\n", path);
+    return 1;
+  }
+  size_t readLength = fread(data, 1, length, objectFile);
+  int extra = fgetc(objectFile);
+  fclose(objectFile);
+  if (readLength != length || extra != EOF ||
+      hash64_update(HASH64_START, data, length) != hash) {
+    printf("%s is damaged\n", path);
+    return 1;
+  }
+  return 0;
+}
+
+// Gather a song's blocks in block order into songData, returns the block count
+static uint8_t gather_song(const uint8_t *sram, uint8_t slot, char *blockList) {
+  uint8_t blockCount = 0;
+  blockList[0] = '\0';
+  for (uint8_t block = 0; block < LSDJ_BLOCK_COUNT; block++) {
+    if (sram[LSDJ_ALLOC_TABLE + block] == slot) {
+      memcpy(&songData[blockCount * LSDJ_BLOCK_SIZE],
+             &sram[LSDJ_BLOCKS_ADDRESS + (block * LSDJ_BLOCK_SIZE)],
+             LSDJ_BLOCK_SIZE);
+      sprintf(&blockList[blockCount * 2], "%02X", block);
+      blockCount++;
+    }
+  }
+  return blockCount;
+}
+
+// Song name as LSDj shows it, unused characters as spaces
+static void song_name(const uint8_t *sram, uint8_t slot, char *name) {
+  for (uint8_t x = 0; x < LSDJ_FILE_NAME_LENGTH; x++) {
+    char letter = sram[LSDJ_FILE_NAMES + (slot * LSDJ_FILE_NAME_LENGTH) + x];
+    if (letter < 0x20 || letter > 0x7E) {
+      letter = ' ';
+    }
+    name[x] = letter;
+  }
+  name[LSDJ_FILE_NAME_LENGTH] = '\0';
+}
+
+// Load the song hashes from a snapshot, songPresent is set for each slot found
+static void load_snapshot_songs(const char *snapshotPath, uint64_t *songHashes,
+                                uint8_t *songPresent) {
+  memset(songPresent, 0, LSDJ_FILE_COUNT);
+
+  FILE *snapshotFile = fopen(snapshotPath, "rt");
+  if (snapshotFile == NULL) {
+    return;
+  }
+  char line[LSDJ_LINE_LENGTH];
+  while (fgets(line, sizeof(line), snapshotFile) != NULL) {
+    unsigned int slot = 0;
+    unsigned long long hash = 0;
+    if (sscanf(line, "song %x %llx", &slot, &hash) == 2 &&
+        slot < LSDJ_FILE_COUNT) {
+      songHashes[slot] = hash;
+      songPresent[slot] = 1;
+    }
+  }
+  fclose(snapshotFile);
+}
+
+// <title>.last holds the path of the last snapshot written for the title
+static void last_path(char *path, const char *title) {
+  char name[256];
+  snprintf(name, sizeof(name), "%s.last", title);
+  archive_path(path, name);
+}
+
+uint8_t lsdj_archive_last(const char *title, char *snapshotPath) {
+  char lastPath[256];
+  last_path(lastPath, title);
+  FILE *lastFile = fopen(lastPath, "rt");
+  if (lastFile == NULL) {
+    return 0;
+  }
+  uint8_t found = 0;
+  if (fgets(snapshotPath, 256, lastFile) != NULL) {
+    snapshotPath[strcspn(snapshotPath, "\r\n")] = '\0';
+    found = (snapshotPath[0] != '\0') ? 1 : 0;
+  }
+  fclose(lastFile);
+  return found;
+}
+
+uint8_t lsdj_sram_valid(const uint8_t *sram) {
+  return sram[LSDJ_JK_ADDRESS] == 'j' && sram[LSDJ_JK_ADDRESS + 1] == 'k';
+}
+
+int lsdj_archive_backup(const uint8_t *sram, const char *title,
+                        const char *timestamp, char *snapshotPath) {
+#ifdef _WIN32
+  _mkdir(LSDJ_ARCHIVE_DIR);
+#else
+  mkdir(LSDJ_ARCHIVE_DIR, 0755);
+#endif
+
+  // The last snapshot for this title is what songs are compared against
+  uint64_t previousHashes[LSDJ_FILE_COUNT];
+  uint8_t previousPresent[LSDJ_FILE_COUNT];
+  memset(previousPresent, 0, sizeof(previousPresent));
+  char previousPath[256];
+  if (lsdj_archive_last(title, previousPath) == 1) {
+    load_snapshot_songs(previousPath, previousHashes, previousPresent);
+  }
+
+  char name[256];
+  snprintf(name, sizeof(name), "%s-%s.lsdj", title, timestamp);
+  archive_path(snapshotPath, name);
+  FILE *snapshotFile = fopen(snapshotPath, "wt");
+  if (snapshotFile == NULL) {
+    printf("Couldn't create %s\n", snapshotPath);
+    return 1;
+  }
+  fprintf(snapshotFile, "%s\n", LSDJ_SNAPSHOT_HEADER);
+
+  long storedBytes = 0;
+  long objectBytes = 0;
+  uint64_t hash = 0;
+
+  // Working song
+  objectBytes = store_object(sram, LSDJ_WORKING_SONG_SIZE, &hash);
+  if (objectBytes < 0) {
+    fclose(snapshotFile);
+    remove(snapshotPath);
+    printf("Couldn't write to %s\n", LSDJ_ARCHIVE_DIR);
+    return 1;
+  }
+  storedBytes += objectBytes;
+  fprintf(snapshotFile, "working %016llX\n", (unsigned long long)hash);
+  printf("Working song: %s\n", (objectBytes > 0) ? "changed" : "unchanged");
+
+  // Header and allocation table
+  fprintf(snapshotFile, "header ");
+  for (uint16_t x = 0; x < LSDJ_HEADER_SIZE; x++) {
+    fprintf(snapshotFile, "%02X", sram[LSDJ_HEADER_ADDRESS + x]);
+  }
+  fprintf(snapshotFile, "\n");
+
+  // Songs
+  uint8_t changedSongs = 0;
+  for (uint8_t slot = 0; slot < LSDJ_FILE_COUNT; slot++) {
+    char songLabel[LSDJ_FILE_NAME_LENGTH + 1];
+    song_name(sram, slot, songLabel);
+
+    char blockList[(LSDJ_BLOCK_COUNT * 2) + 1];
+    uint8_t blockCount = gather_song(sram, slot, blockList);
+    if (blockCount == 0) {
+      if (previousPresent[slot] == 1) {
+        printf("Song %02i: deleted\n", slot);
+        changedSongs++;
+      }
+      continue;
+    }
+
+    objectBytes =
+        store_object(songData, (uint32_t)blockCount * LSDJ_BLOCK_SIZE, &hash);
+    if (objectBytes < 0) {
+      fclose(snapshotFile);
+      remove(snapshotPath);
+      printf("Couldn't write to %s\n", LSDJ_ARCHIVE_DIR);
+      return 1;
+    }
+    storedBytes += objectBytes;
+    fprintf(snapshotFile, "song %02X %016llX %s\n", slot,
+            (unsigned long long)hash, blockList);
+
+    const char *status = "unchanged";
+    if (previousPresent[slot] == 0) {
+      status = "new";
+      changedSongs++;
+    } else if (previousHashes[slot] != hash) {
+      status = "changed";
+      changedSongs++;
+    }
+    printf("Song %02i %s v%02X: %s (%i blocks)\n", slot, songLabel,
+           sram[LSDJ_FILE_VERSIONS + slot], status, blockCount);
+  }
+
+  // Blocks no song owns still have to come back for a byte exact .sav
+  for (uint8_t block = 0; block < LSDJ_BLOCK_COUNT; block++) {
+    if (sram[LSDJ_ALLOC_TABLE + block] < LSDJ_FILE_COUNT) {
+      continue;
+    }
+    objectBytes = store_object(
+        &sram[LSDJ_BLOCKS_ADDRESS + (block * LSDJ_BLOCK_SIZE)], LSDJ_BLOCK_SIZE,
+        &hash);
+    if (objectBytes < 0) {
+      fclose(snapshotFile);
+      remove(snapshotPath);
+      printf("Couldn't write to %s\n", LSDJ_ARCHIVE_DIR);
+      return 1;
+    }
+    storedBytes += objectBytes;
+    fprintf(snapshotFile, "block %02X %016llX\n", block,
+            (unsigned long long)hash);
+  }
+
+  int writeFailed = ferror(snapshotFile); // A write that failed before the end
+  if (fclose(snapshotFile) != 0 || writeFailed != 0) {
+    remove(snapshotPath);
+    printf("Couldn't write %s\n", snapshotPath);
+    return 1;
+  }
+
+  char lastPath[256];
+  last_path(lastPath, title);
+  FILE *lastFile = fopen(lastPath, "wt");
+  if (lastFile != NULL) {
+    fprintf(lastFile, "%s\n", snapshotPath);
+    fclose(lastFile);
+  }
+
+  printf("%i songs changed, %li bytes stored\n", changedSongs, storedBytes);
+  return 0;
+}
+
+int lsdj_archive_rebuild(const char *snapshotPath, uint8_t *sram) {
+  FILE *snapshotFile = fopen(snapshotPath, "rt");
+  if (snapshotFile == NULL) {
+    printf("\n%s \nFile not found\n", snapshotPath);
+    return 1;
+  }
+
+  char line[LSDJ_LINE_LENGTH];
+  if (fgets(line, sizeof(line), snapshotFile) == NULL ||
+      strncmp(line, LSDJ_SNAPSHOT_HEADER, strlen(LSDJ_SNAPSHOT_HEADER)) != 0) {
+    fclose(snapshotFile);
+    printf("%s isn't an LSDj snapshot\n", snapshotPath);
+    return 1;
+  }
+
+  // Everything has to be filled in once, the working song, header and blocks
+  uint8_t filled[LSDJ_BLOCK_COUNT + 2];
+  memset(filled, 0, sizeof(filled));
+  int result = 0;
+
+  while (result == 0 && fgets(line, sizeof(line), snapshotFile) != NULL) {
+    unsigned int number = 0;
+    unsigned long long hash = 0;
+    char blockList[LSDJ_LINE_LENGTH];
+
+    if (sscanf(line, "working %llx", &hash) == 1) {
+      result = load_object(hash, sram, LSDJ_WORKING_SONG_SIZE);
+      filled[LSDJ_BLOCK_COUNT]++;
+    } else if (strncmp(line, "header ", 7) == 0) {
+      if (strlen(&line[7]) < LSDJ_HEADER_SIZE * 2) {
+        result = 1;
+        break;
+      }
+      for (uint16_t x = 0; x < LSDJ_HEADER_SIZE; x++) {
+        unsigned int hexByte = 0;
+        sscanf(&line[7 + (x * 2)], "%2x", &hexByte);
+        sram[LSDJ_HEADER_ADDRESS + x] = hexByte;
+      }
+      filled[LSDJ_BLOCK_COUNT + 1]++;
+    } else if (sscanf(line, "song %x %llx %2047s", &number, &hash,
+                      blockList) == 3) {
+      uint8_t blockCount = strlen(blockList) / 2;
+      result = load_object(hash, songData,
+                           (uint32_t)blockCount * LSDJ_BLOCK_SIZE);
+      for (uint8_t x = 0; x < blockCount && result == 0; x++) {
+        unsigned int block = 0;
+        sscanf(&blockList[x * 2], "%2x", &block);
+        if (block >= LSDJ_BLOCK_COUNT) {
+          result = 1;
+          break;
+        }
+        memcpy(&sram[LSDJ_BLOCKS_ADDRESS + (block * LSDJ_BLOCK_SIZE)],
+               &songData[x * LSDJ_BLOCK_SIZE], LSDJ_BLOCK_SIZE);
+        filled[block]++;
+      }
+    } else if (sscanf(line, "block %x %llx", &number, &hash) == 2) {
+      if (number >= LSDJ_BLOCK_COUNT) {
+        result = 1;
+        break;
+      }
+      result = load_object(
+          hash, &sram[LSDJ_BLOCKS_ADDRESS + (number * LSDJ_BLOCK_SIZE)],
+          LSDJ_BLOCK_SIZE);
+      filled[number]++;
+    }
+  }
+  fclose(snapshotFile);
+
+  for (uint8_t x = 0; x < LSDJ_BLOCK_COUNT + 2 && result == 0; x++) {
+    if (filled[x] != 1) {
+      result = 1;
+    }
+  }
+  if (result != 0) {
+    printf("%s is incomplete or damaged\n", snapshotPath);
+  }
+  return result;
+}
@@ -0,0 +1,44 @@
+/*
+ LSDj save helpers by DEFENSE MECHANISM
+
+ Knows the LSDj SRAM layout so saves can be backed up song by song. Each song,
+ the working song and every free block is stored once in lsdj-archive/ under
+ the hash of its data, and each backup is a small snapshot file listing which
+ data goes where, so a full .sav can be rebuilt byte for byte.
+
+ */
+
+#include <stdint.h>
+
+// SRAM layout (128KB)
+#define LSDJ_SRAM_SIZE 0x20000
+#define LSDJ_WORKING_SONG_SIZE 0x8000
+#define LSDJ_HEADER_ADDRESS 0x8000 // File names, versions, "jk", active file and allocation table
+#define LSDJ_HEADER_SIZE 0x200
+#define LSDJ_FILE_NAMES 0x8000
+#define LSDJ_FILE_NAME_LENGTH 8
+#define LSDJ_FILE_VERSIONS 0x8100
+#define LSDJ_JK_ADDRESS 0x813E
+#define LSDJ_ACTIVE_FILE 0x8140
+#define LSDJ_ALLOC_TABLE 0x8141
+#define LSDJ_FILE_COUNT 32
+#define LSDJ_BLOCK_COUNT 191
+#define LSDJ_BLOCK_SIZE 0x200
+#define LSDJ_BLOCKS_ADDRESS 0x8200
+#define LSDJ_BLOCK_FREE 0xFF
+
+#define LSDJ_ARCHIVE_DIR "lsdj-archive"
+#define LSDJ_SNAPSHOT_HEADER "LSDJ-SNAPSHOT 1"
+
+// Check for the "jk" LSDj writes once the SRAM has been initialised
+uint8_t lsdj_sram_valid(const uint8_t *sram);
+
+// Store the songs that changed since the last snapshot for this title and write a new snapshot.
+// The snapshot path is copied to snapshotPath. Returns 0 if it worked.
+int lsdj_archive_backup(const uint8_t *sram, const char *title, const char *timestamp, char *snapshotPath);
+
+// Copy the path of the last snapshot written for this title. Returns 1 if there is one.
+uint8_t lsdj_archive_last(const char *title, char *snapshotPath);
+
+// Rebuild the full 128KB SRAM from a snapshot into the buffer given. Returns 0 if it worked.
+int lsdj_archive_rebuild(const char *snapshotPath, uint8_t *sram);
@@ -0,0 +1,419 @@
+/*
+ Multi Cart by DEFENSE MECHANISM
+
+ Runs one of the tools on several GBxCart RW devices at once, one worker per
+ device, each working on its own port so N devices take about as long as one:
+
+   multi-cart <ports> <tool> [arguments]
+
+   multi-cart 17,18,19 backup-sav store
+   multi-cart 17,18 flash-cart lsdj.gb
+
+ Ports are numbered as in config.ini. Each device works in its own folder,
+ port<N>/, which gets a copy of the settings files the first time and holds
+ that device's backups and <tool>.log with everything the tool printed. On
+ Windows the settings come from the user folder and each worker is given
+ port<N>\ as its user folder, so workers never write the same cart cache. The
+ tools can't be answered while they run, so anything that would ask first
+ (like overwriting a save) is aborted. Files given as arguments are passed on
+ with their full path.
+
+ Each worker is a separate run of the tool rather than a thread here with its
+ own gbx_device. The tools are whole programs around the default device: they
+ read their settings and write their backups relative to the current folder
+ (or the user folder on Windows), print to stdout, and exit when a device
+ stops answering. A process per device gives each one its own folder, log and
+ exit code, and a device that fails only ends its own worker. Programs that
+ want several devices in one process can use libgbxcart, which keeps a
+ gbx_device per cart.
+
+ */
+
+#ifndef _WIN32
+#define _XOPEN_SOURCE 600 // Must come before the first system header
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <fcntl.h>
+#include <io.h>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "setup.h" // See defines, variables, constants, functions here
+
+#define MULTI_MAX_DEVICES 16
+#define MULTI_MAX_ARGUMENTS 16
+
+#ifdef _WIN32
+#define TOOL_EXT ".exe"
+#define PATH_SEPARATOR '\\'
+#else
+#define TOOL_EXT ""
+#define PATH_SEPARATOR '/'
+#endif
+
+// Settings files each device's folder starts with, from the current folder on
+// Linux/macOS and the user folder (named gbxcart-<file>) on Windows
+const char *settingsFiles[] = {"config.ini", "config-flash.ini",
+                               "cart-cache.ini", "lsdj-builds.ini"};
+
+#ifdef _WIN32
+char userProfile[4096]; // Ours, the workers get their folder instead
+#endif
+
+// test-sram isn't here as it always asks first
+const char *allowedTools[] = {"backup-rom", "backup-sav", "flash-cart",
+                              "verify-cart", "fingerprint-cart"};
+
+struct device_job {
+  int port;
+  char folder[32];
+  char logPath[64];
+  time_t started;
+  uint8_t running;
+  int exitCode;
+#ifdef _WIN32
+  intptr_t process;
+#else
+  pid_t process;
+#endif
+};
+
+// Get the full path of a file, returns 0 if it doesn't exist
+uint8_t full_path(const char *path, char *fullPath, size_t length) {
+#ifdef _WIN32
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return 0;
+  }
+  fclose(file);
+  return _fullpath(fullPath, path, length) != NULL;
+#else
+  char resolved[4096];
+  if (realpath(path, resolved) == NULL) {
+    return 0;
+  }
+  strncpy(fullPath, resolved, length - 1);
+  fullPath[length - 1] = '\0';
+  return 1;
+#endif
+}
+
+// Copy a settings file into the device's folder unless it already has one
+void copy_settings_file(const char *name, const char *folder) {
+  char sourcePath[4200];
+  char targetPath[96];
+#ifdef _WIN32
+  snprintf(sourcePath, sizeof(sourcePath), "%s\\gbxcart-%s", userProfile,
+           name);
+  snprintf(targetPath, sizeof(targetPath), "%s\\gbxcart-%s", folder, name);
+#else
+  snprintf(sourcePath, sizeof(sourcePath), "%s", name);
+  snprintf(targetPath, sizeof(targetPath), "%s/%s", folder, name);
+#endif
+  FILE *target = fopen(targetPath, "rb");
+  if (target != NULL) {
+    fclose(target);
+    return;
+  }
+  FILE *source = fopen(sourcePath, "rb");
+  if (source == NULL) {
+    return;
+  }
+  target = fopen(targetPath, "wb");
+  if (target != NULL) {
+    char buffer[4096];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), source)) > 0) {
+      fwrite(buffer, 1, length, target);
+    }
+    fclose(target);
+  }
+  fclose(source);
+}
+
+#ifdef _WIN32
+// _spawnv() joins the arguments with spaces, so each one is put in quotes the
+// way the C runtime splits them again: backslashes are only doubled before a
+// quote, and quotes in the argument are escaped
+void quote_argument(const char *argument, char *quoted, size_t length) {
+  size_t out = 0;
+  quoted[out++] = '"';
+  const char *c = argument;
+  while (*c != '\0') {
+    size_t backslashes = 0;
+    while (c[backslashes] == '\\') {
+      backslashes++;
+    }
+    size_t copies = (c[backslashes] == '"' || c[backslashes] == '\0')
+                        ? backslashes * 2
+                        : backslashes;
+    if (out + copies + 4 >= length) {
+      break;
+    }
+    for (size_t x = 0; x < copies; x++) {
+      quoted[out++] = '\\';
+    }
+    c += backslashes;
+    if (*c == '\0') {
+      break;
+    }
+    if (*c == '"') {
+      quoted[out++] = '\\';
+    }
+    quoted[out++] = *c++;
+  }
+  quoted[out++] = '"';
+  quoted[out] = '\0';
+}
+#endif
+
+// Start the tool for one device in its folder, with its output going to the
+// log and nothing to read from
+uint8_t start_job(struct device_job *job, char *toolPath, char **toolArgs) {
+  char portString[12];
+  snprintf(portString, sizeof(portString), "%i", job->port);
+  job->started = time(NULL);
+
+#ifdef _WIN32
+  static char quotedArgs[MULTI_MAX_ARGUMENTS + 1][8200];
+  char *spawnArgs[MULTI_MAX_ARGUMENTS + 2];
+  uint8_t argCount = 0;
+  for (; toolArgs[argCount] != NULL; argCount++) {
+    quote_argument(toolArgs[argCount], quotedArgs[argCount],
+                   sizeof(quotedArgs[argCount]));
+    spawnArgs[argCount] = quotedArgs[argCount];
+  }
+  spawnArgs[argCount] = NULL;
+
+  // The worker's settings and cart cache are the ones in its folder
+  char folderPath[4096];
+  if (_fullpath(folderPath, job->folder, sizeof(folderPath)) == NULL) {
+    return 0;
+  }
+
+  // The new process takes the folder, environment and handles we have now
+  _putenv_s(PORT_ENV_VARIABLE, portString);
+  _putenv_s("USERPROFILE", folderPath);
+  int savedOut = _dup(1);
+  int savedErr = _dup(2);
+  int savedIn = _dup(0);
+  int logFile = _open(job->logPath, _O_WRONLY | _O_CREAT | _O_TRUNC,
+                      _S_IREAD | _S_IWRITE);
+  int nullFile = _open("NUL", _O_RDONLY);
+  fflush(stdout);
+  _dup2(logFile, 1);
+  _dup2(logFile, 2);
+  _dup2(nullFile, 0);
+  _chdir(job->folder);
+  job->process = _spawnv(_P_NOWAIT, toolPath, (const char *const *)spawnArgs);
+  _chdir("..");
+  _putenv_s("USERPROFILE", userProfile);
+  _dup2(savedOut, 1);
+  _dup2(savedErr, 2);
+  _dup2(savedIn, 0);
+  _close(logFile);
+  _close(nullFile);
+  _close(savedOut);
+  _close(savedErr);
+  _close(savedIn);
+  return job->process != -1;
+#else
+  fflush(stdout);
+  job->process = fork();
+  if (job->process < 0) {
+    return 0;
+  }
+  if (job->process == 0) {
+    setenv(PORT_ENV_VARIABLE, portString, 1);
+    if (chdir(job->folder) != 0) {
+      _exit(127);
+    }
+    int logFile = open(job->logPath + strlen(job->folder) + 1,
+                       O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    int nullFile = open("/dev/null", O_RDONLY);
+    if (logFile >= 0) {
+      dup2(logFile, 1);
+      dup2(logFile, 2);
+      close(logFile);
+    }
+    if (nullFile >= 0) {
+      dup2(nullFile, 0);
+      close(nullFile);
+    }
+    if (strchr(toolPath, '/') != NULL) {
+      execv(toolPath, toolArgs);
+    } else {
+      execvp(toolPath, toolArgs);
+    }
+    _exit(127);
+  }
+  return 1;
+#endif
+}
+
+// Wait for the next job to end and keep its exit code. Windows waits in the
+// order the jobs were started, which only matters for the times shown.
+struct device_job *wait_for_next_job(struct device_job *jobs,
+                                     uint8_t jobCount) {
+  int status = 0;
+#ifdef _WIN32
+  for (uint8_t x = 0; x < jobCount; x++) {
+    if (jobs[x].running == 1) {
+      _cwait(&status, jobs[x].process, _WAIT_CHILD);
+      jobs[x].exitCode = status;
+      jobs[x].running = 0;
+      return &jobs[x];
+    }
+  }
+#else
+  while (1) {
+    pid_t process = waitpid(-1, &status, 0);
+    if (process < 0) {
+      break;
+    }
+    for (uint8_t x = 0; x < jobCount; x++) {
+      if (jobs[x].running == 1 && jobs[x].process == process) {
+        jobs[x].exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : 128;
+        jobs[x].running = 0;
+        return &jobs[x];
+      }
+    }
+  }
+#endif
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+
+  printf("Multi Cart by DEFENSE MECHANISM\n");
+  printf("based on GBxCart RW v1.24 by insideGadgets\n");
+  printf("################################\n");
+
+  if (argc < 3) {
+    printf("Usage: multi-cart <port,port,...> <tool> [arguments]\n");
+    return 1;
+  }
+
+  uint8_t toolAllowed = 0;
+  for (uint8_t x = 0; x < sizeof(allowedTools) / sizeof(allowedTools[0]);
+       x++) {
+    if (strcmp(argv[2], allowedTools[x]) == 0) {
+      toolAllowed = 1;
+    }
+  }
+  if (toolAllowed == 0) {
+    printf("Unknown tool %s\n", argv[2]);
+    return 1;
+  }
+  if (argc - 3 > MULTI_MAX_ARGUMENTS) {
+    printf("Too many arguments\n");
+    return 1;
+  }
+
+  // The tool is looked for next to multi-cart
+  char toolPath[4096];
+  char selfPath[4096];
+  if (full_path(argv[0], selfPath, sizeof(selfPath)) == 1 &&
+      strrchr(selfPath, PATH_SEPARATOR) != NULL) {
+    *(strrchr(selfPath, PATH_SEPARATOR) + 1) = '\0';
+    snprintf(toolPath, sizeof(toolPath), "%s%s%s", selfPath, argv[2],
+             TOOL_EXT);
+  } else {
+    snprintf(toolPath, sizeof(toolPath), "%s%s", argv[2], TOOL_EXT);
+  }
+
+  // Files named in the arguments still have to be found from the device's
+  // folder
+  char fullArgs[MULTI_MAX_ARGUMENTS][4096];
+  char *toolArgs[MULTI_MAX_ARGUMENTS + 2];
+  toolArgs[0] = toolPath;
+  for (int x = 3; x < argc; x++) {
+    if (full_path(argv[x], fullArgs[x - 3], sizeof(fullArgs[x - 3])) == 1) {
+      toolArgs[x - 2] = fullArgs[x - 3];
+    } else {
+      toolArgs[x - 2] = argv[x];
+    }
+  }
+  toolArgs[argc - 2] = NULL;
+
+  // Ports
+  struct device_job jobs[MULTI_MAX_DEVICES];
+  uint8_t jobCount = 0;
+  char portList[256];
+  strncpy(portList, argv[1], sizeof(portList) - 1);
+  portList[sizeof(portList) - 1] = '\0';
+  for (char *token = strtok(portList, ","); token != NULL;
+       token = strtok(NULL, ",")) {
+    int port = atoi(token);
+    if (port <= 0 || jobCount >= MULTI_MAX_DEVICES) {
+      printf("Bad port list %s (up to %i ports, numbered as in config.ini)\n",
+             argv[1], MULTI_MAX_DEVICES);
+      return 1;
+    }
+    struct device_job *job = &jobs[jobCount++];
+    memset(job, 0, sizeof(struct device_job));
+    job->port = port;
+    snprintf(job->folder, sizeof(job->folder), "port%i", port);
+    snprintf(job->logPath, sizeof(job->logPath), "port%i%c%s.log", port,
+             PATH_SEPARATOR, argv[2]);
+  }
+
+  // Start a worker for each device
+#ifdef _WIN32
+  if (getenv("USERPROFILE") != NULL) {
+    strncpy(userProfile, getenv("USERPROFILE"), sizeof(userProfile) - 1);
+  }
+#endif
+  uint8_t startedCount = 0;
+  for (uint8_t x = 0; x < jobCount; x++) {
+#ifdef _WIN32
+    _mkdir(jobs[x].folder);
+#else
+    mkdir(jobs[x].folder, 0755);
+#endif
+    for (uint8_t f = 0; f < sizeof(settingsFiles) / sizeof(settingsFiles[0]);
+         f++) {
+      copy_settings_file(settingsFiles[f], jobs[x].folder);
+    }
+    if (start_job(&jobs[x], toolPath, toolArgs) == 0) {
+      printf("Port %i: couldn't start %s\n", jobs[x].port, toolPath);
+      continue;
+    }
+    jobs[x].running = 1;
+    printf("Port %i: running %s, output in %s\n", jobs[x].port, argv[2],
+           jobs[x].logPath);
+    startedCount++;
+  }
+
+  // Report each one as it ends
+  uint8_t failedCount = jobCount - startedCount;
+  for (uint8_t x = 0; x < startedCount; x++) {
+    struct device_job *job = wait_for_next_job(jobs, jobCount);
+    if (job == NULL) {
+      break;
+    }
+    printf("Port %i: %s after %.0fs\n", job->port,
+           (job->exitCode == 0) ? "finished" : "FAILED",
+           difftime(time(NULL), job->started));
+    if (job->exitCode != 0) {
+      failedCount++;
+    }
+  }
+
+  printf("\n%i of %i devices finished\n", jobCount - failedCount, jobCount);
+  return (failedCount > 0) ? 1 : 0;
+}
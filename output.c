@@ -0,0 +1,188 @@
+/*
+ Backup output files by DEFENSE MECHANISM
+
+ See output.h. The sidecar is one line of text:
+
+   <crc32> <hash64> <length> <file name>
+
+ */
+
+#ifndef _WIN32
+#define _XOPEN_SOURCE 600 // Must come before the first system header
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "output.h"
+#include "setup.h"
+
+// Flush the file all the way to the disk
+static int output_sync(FILE *file) {
+  if (fflush(file) != 0) {
+    return 1;
+  }
+#ifdef _WIN32
+  return _commit(_fileno(file));
+#else
+  return fsync(fileno(file));
+#endif
+}
+
+// Replace path with tempPath, then sync the directory so the rename sticks
+static int output_rename(const char *tempPath, const char *path) {
+#ifdef _WIN32
+  // rename() doesn't replace files on Windows, and removing the old one first
+  // would leave no backup at all if the move then failed
+  if (MoveFileExA(tempPath, path,
+                  MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) == 0) {
+    return 1;
+  }
+#else
+  if (rename(tempPath, path) != 0) {
+    return 1;
+  }
+
+  char directory[256];
+  strncpy(directory, path, sizeof(directory) - 1);
+  directory[sizeof(directory) - 1] = '\0';
+  char *slash = strrchr(directory, '/');
+  if (slash != NULL) {
+    *slash = '\0';
+  } else {
+    strncpy(directory, ".", 2);
+  }
+  int fd = open(directory, O_RDONLY);
+  if (fd >= 0) {
+    fsync(fd);
+    close(fd);
+  }
+#endif
+  return 0;
+}
+
+int output_open(struct output_file *output, const char *path,
+                uint32_t expectedLength) {
+  memset(output, 0, sizeof(struct output_file));
+  output->hash = HASH64_START;
+  strncpy(output->path, path, sizeof(output->path) - 1);
+  snprintf(output->tempPath, sizeof(output->tempPath), "%s%s", output->path,
+           OUTPUT_TEMP_SUFFIX);
+
+  output->file = fopen(output->tempPath, "wb");
+  if (output->file == NULL) {
+    printf("Couldn't create %s\n", output->tempPath);
+    return 1;
+  }
+
+  // Large sequential writes instead of one per block read
+  output->buffer = (char *)malloc(OUTPUT_BUFFER_SIZE);
+  if (output->buffer != NULL) {
+    setvbuf(output->file, output->buffer, _IOFBF, OUTPUT_BUFFER_SIZE);
+  }
+
+#if defined(__linux__) || defined(__FreeBSD__)
+  // Reserve the space up front so the file isn't grown a block at a time and
+  // a full disk shows up now rather than half way through
+  if (expectedLength > 0 &&
+      posix_fallocate(fileno(output->file), 0, expectedLength) != 0) {
+    printf("Couldn't reserve %u bytes for %s\n", (unsigned int)expectedLength,
+           output->tempPath);
+    output_abort(output);
+    return 1;
+  }
+#endif
+  return 0;
+}
+
+void output_write(struct output_file *output, const uint8_t *data,
+                  uint32_t length) {
+  if (output->failed == 1) {
+    return;
+  }
+  if (fwrite(data, 1, length, output->file) != length) {
+    output->failed = 1;
+    return;
+  }
+  output->crc = crc32_update(output->crc, data, length);
+  output->hash = hash64_update(output->hash, data, length);
+  output->length += length;
+}
+
+int output_finish(struct output_file *output) {
+#ifndef _WIN32
+  // Trim the preallocation if less came in than expected
+  if (output->failed == 0 &&
+      (fflush(output->file) != 0 ||
+       ftruncate(fileno(output->file), output->length) != 0)) {
+    output->failed = 1;
+  }
+#endif
+  if (output->failed == 1 || output_sync(output->file) != 0) {
+    printf("\nCouldn't write %s\n", output->tempPath);
+    output_abort(output);
+    return 1;
+  }
+  fclose(output->file);
+  output->file = NULL;
+  free(output->buffer);
+  output->buffer = NULL;
+
+  if (output_rename(output->tempPath, output->path) != 0) {
+    printf("\nCouldn't rename %s to %s\n", output->tempPath, output->path);
+    remove(output->tempPath);
+    return 1;
+  }
+
+  // The sidecar goes in the same way
+  char hashPath[272];
+  char hashTempPath[280];
+  snprintf(hashPath, sizeof(hashPath), "%s%s", output->path,
+           OUTPUT_HASH_SUFFIX);
+  snprintf(hashTempPath, sizeof(hashTempPath), "%s%s", hashPath,
+           OUTPUT_TEMP_SUFFIX);
+  const char *fileName = strrchr(output->path, '/');
+  fileName = (fileName != NULL) ? fileName + 1 : output->path;
+
+  FILE *hashFile = fopen(hashTempPath, "wt");
+  if (hashFile == NULL) {
+    printf("\nCouldn't create %s\n", hashTempPath);
+    return 1;
+  }
+  fprintf(hashFile, "%08X %016llX %u %s\n", (unsigned int)output->crc,
+          (unsigned long long)output->hash, (unsigned int)output->length,
+          fileName);
+  if (output_sync(hashFile) != 0) {
+    fclose(hashFile);
+    remove(hashTempPath);
+    printf("\nCouldn't write %s\n", hashTempPath);
+    return 1;
+  }
+  fclose(hashFile);
+  if (output_rename(hashTempPath, hashPath) != 0) {
+    remove(hashTempPath);
+    printf("\nCouldn't rename %s to %s\n", hashTempPath, hashPath);
+    return 1;
+  }
+  return 0;
+}
+
+void output_abort(struct output_file *output) {
+  if (output->file != NULL) {
+    fclose(output->file);
+    output->file = NULL;
+  }
+  free(output->buffer);
+  output->buffer = NULL;
+  remove(output->tempPath);
+}
@@ -0,0 +1,42 @@
+/*
+ Backup output files by DEFENSE MECHANISM
+
+ ROM dumps and saves are written to <file>.tmp (preallocated to the size
+ expected and written through a large buffer), synced and only then renamed
+ to <file>, so a dump that was stopped half way never looks like a backup.
+ Each finished file gets a <file>.hash sidecar with its CRC32, 64 bit hash
+ and length to check it against later.
+
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define OUTPUT_TEMP_SUFFIX ".tmp"
+#define OUTPUT_HASH_SUFFIX ".hash"
+#define OUTPUT_BUFFER_SIZE 0x100000 // Written out 1MB at a time
+
+// A backup file being written
+struct output_file {
+  char path[256];
+  char tempPath[264];
+  FILE *file;
+  char *buffer;
+  uint32_t length;
+  uint32_t crc;
+  uint64_t hash;
+  uint8_t failed;
+};
+
+// Create path.tmp with room for expectedLength bytes (0 if it isn't known). Returns 0 if it worked.
+int output_open(struct output_file *output, const char *path, uint32_t expectedLength);
+
+// Add data to the file, it's hashed on the way through
+void output_write(struct output_file *output, const uint8_t *data, uint32_t length);
+
+// Sync the file, rename it into place and write the hash sidecar. Returns 0 if it worked, the temporary file is
+// removed if it didn't.
+int output_finish(struct output_file *output);
+
+// Drop the file without touching any existing file at the path
+void output_abort(struct output_file *output);
@@ -527,12 +527,31 @@ void RS232_drain(int comport_number)
   }
 }
 
+/* waits in the kernel until there is something to read or timeout_ms has passed, */
+/* select() rather than poll() as poll() doesn't work on ttys on macOS */
+int RS232_WaitComport(int comport_number, int timeout_ms)
+{
+  fd_set read_fds;
+  struct timeval timeout;
+
+  FD_ZERO(&read_fds);
+  FD_SET(Cport[comport_number], &read_fds);
+  timeout.tv_sec = timeout_ms / 1000;
+  timeout.tv_usec = (timeout_ms % 1000) * 1000;
+
+  return(select(Cport[comport_number] + 1, &read_fds, NULL, NULL, &timeout) > 0);
+}
+
 #else  /* windows */
 
 #define RS232_PORTNR  30
 
 HANDLE Cport[RS232_PORTNR];
 
+/* a byte RS232_WaitComport() has read that RS232_PollComport() hasn't returned yet */
+unsigned char waited_byte[RS232_PORTNR];
+int has_waited_byte[RS232_PORTNR];
+
 
 char *comports[RS232_PORTNR]={"\\\\.\\COM1",  "\\\\.\\COM2",  "\\\\.\\COM3",  "\\\\.\\COM4",
                               "\\\\.\\COM5",  "\\\\.\\COM6",  "\\\\.\\COM7",  "\\\\.\\COM8",
@@ -694,20 +713,35 @@ http://technet.microsoft.com/en-us/library/cc732236.aspx
     return(1);
   }
 
+  has_waited_byte[comport_number] = 0;
+
   return(0);
 }
 
 
 int RS232_PollComport(int comport_number, unsigned char *buf, int size)
 {
-  int n;
+  int n = 0,
+      waited = 0;
+
+  if(has_waited_byte[comport_number] && (size > 0))
+  {
+    buf[0] = waited_byte[comport_number];
+    has_waited_byte[comport_number] = 0;
+    waited = 1;
+    buf++;
+    size--;
+  }
 
 /* added the void pointer cast, otherwise gcc will complain about */
 /* "warning: dereferencing type-punned pointer will break strict aliasing rules" */
 
-  ReadFile(Cport[comport_number], buf, size, (LPDWORD)((void *)&n), NULL);
+  if(size > 0)
+  {
+    ReadFile(Cport[comport_number], buf, size, (LPDWORD)((void *)&n), NULL);
+  }
 
-  return(n);
+  return(n + waited);
 }
 
 
@@ -738,6 +772,7 @@ int RS232_SendBuf(int comport_number, unsigned char *buf, int size)
 
 void RS232_CloseComport(int comport_number)
 {
+  has_waited_byte[comport_number] = 0;
   CloseHandle(Cport[comport_number]);
 }
 
@@ -807,6 +842,7 @@ https://msdn.microsoft.com/en-us/library/windows/desktop/aa363428%28v=vs.85%29.a
 
 void RS232_flushRX(int comport_number)
 {
+  has_waited_byte[comport_number] = 0;
   PurgeComm(Cport[comport_number], PURGE_RXCLEAR | PURGE_RXABORT);
 }
 
@@ -819,6 +855,7 @@ void RS232_flushTX(int comport_number)
 
 void RS232_flushRXTX(int comport_number)
 {
+  has_waited_byte[comport_number] = 0;
   PurgeComm(Cport[comport_number], PURGE_RXCLEAR | PURGE_RXABORT);
   PurgeComm(Cport[comport_number], PURGE_TXCLEAR | PURGE_TXABORT);
 }
@@ -828,6 +865,48 @@ void RS232_drain(int comport_number)
   FlushFileBuffers(Cport[comport_number]);
 }
 
+/* waits in the kernel until there is something to read or timeout_ms has passed. */
+/* With these timeouts ReadFile() returns as soon as a byte has come in, or after */
+/* timeout_ms if none has. The byte is kept for the next RS232_PollComport(), */
+/* then ReadFile() is put back to returning straight away. */
+/* http://msdn.microsoft.com/en-us/library/windows/desktop/aa363190%28v=vs.85%29.aspx */
+int RS232_WaitComport(int comport_number, int timeout_ms)
+{
+  int n = 0;
+
+  COMMTIMEOUTS Cptimeouts;
+
+  if(has_waited_byte[comport_number])  return(1);
+
+  if(timeout_ms <= 0)  return(0);
+
+  Cptimeouts.ReadIntervalTimeout         = MAXDWORD;
+  Cptimeouts.ReadTotalTimeoutMultiplier  = MAXDWORD;
+  Cptimeouts.ReadTotalTimeoutConstant    = timeout_ms;
+  Cptimeouts.WriteTotalTimeoutMultiplier = 0;
+  Cptimeouts.WriteTotalTimeoutConstant   = 0;
+
+  if(!SetCommTimeouts(Cport[comport_number], &Cptimeouts))
+  {
+    Sleep(1);  /* don't spin if the port has gone */
+    return(0);
+  }
+
+  ReadFile(Cport[comport_number], waited_byte + comport_number, 1, (LPDWORD)((void *)&n), NULL);
+
+  Cptimeouts.ReadTotalTimeoutMultiplier  = 0;
+  Cptimeouts.ReadTotalTimeoutConstant    = 0;
+  SetCommTimeouts(Cport[comport_number], &Cptimeouts);
+
+  if(n == 1)
+  {
+    has_waited_byte[comport_number] = 1;
+    return(1);
+  }
+
+  return(0);
+}
+
 #endif
 
 
@@ -862,3 +941,15 @@ int RS232_GetPortnr(const char *devname)
 
   return -1;  /* device not found */
 }
+
+
+/* return the device name for index in comports or NULL if out of range */
+const char *RS232_GetPortName(int comport_number)
+{
+  if((comport_number>=RS232_PORTNR)||(comport_number<0))
+  {
+    return NULL;
+  }
+
+  return comports[comport_number];
+}
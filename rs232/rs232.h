@@ -53,6 +53,7 @@ extern "C" {
 #include <limits.h>
 #include <sys/file.h>
 #include <errno.h>
+#include <sys/select.h>
 
 #else
 
@@ -77,7 +78,9 @@ void RS232_flushRX(int);
 void RS232_flushTX(int);
 void RS232_flushRXTX(int);
 void RS232_drain(int);
+int RS232_WaitComport(int, int);
 int RS232_GetPortnr(const char *);
+const char *RS232_GetPortName(int);
 
 #ifdef __cplusplus
 } /* extern "C" */
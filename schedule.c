@@ -0,0 +1,223 @@
+/*
+ Job scheduling by DEFENSE MECHANISM
+
+ See schedule.h. cart-rates.ini has one line per port and kind of work:
+
+   <port> <profile> <erase ms> <bytes per ms> <samples>
+
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "schedule.h"
+
+struct schedule_rate rates[SCHEDULE_MAX_RATES];
+int rateCount = 0;
+
+void schedule_load_rates(void) {
+  rateCount = 0;
+  FILE *ratesFile = fopen(SCHEDULE_RATES_FILE, "rt");
+  if (ratesFile == NULL) {
+    return;
+  }
+  struct schedule_rate *rate = &rates[0];
+  while (rateCount < SCHEDULE_MAX_RATES &&
+         fscanf(ratesFile, "%d %d %u %lf %u", &rate->port, &rate->profile,
+                &rate->eraseMs, &rate->bytesPerMs, &rate->samples) == 5) {
+    if (rate->bytesPerMs > 0) {
+      rate = &rates[++rateCount];
+    }
+  }
+  fclose(ratesFile);
+}
+
+static void schedule_save_rates(void) {
+  FILE *ratesFile = fopen(SCHEDULE_RATES_FILE, "wt");
+  if (ratesFile == NULL) {
+    return;
+  }
+  for (int x = 0; x < rateCount; x++) {
+    fprintf(ratesFile, "%d %d %u %.3f %u\n", rates[x].port, rates[x].profile,
+            (unsigned int)rates[x].eraseMs, rates[x].bytesPerMs,
+            (unsigned int)rates[x].samples);
+  }
+  fclose(ratesFile);
+}
+
+void schedule_measure(int port, int profile, uint32_t eraseMs, uint32_t length,
+                      uint32_t ms) {
+  if (length == 0 || ms == 0) {
+    return;
+  }
+  double bytesPerMs = (double)length / ms;
+
+  struct schedule_rate *rate = NULL;
+  for (int x = 0; x < rateCount; x++) {
+    if (rates[x].port == port && rates[x].profile == profile) {
+      rate = &rates[x];
+    }
+  }
+  if (rate == NULL) {
+    if (rateCount >= SCHEDULE_MAX_RATES) {
+      return;
+    }
+    rate = &rates[rateCount++];
+    rate->port = port;
+    rate->profile = profile;
+    rate->eraseMs = eraseMs;
+    rate->bytesPerMs = bytesPerMs;
+    rate->samples = 1;
+  } else {
+    // Follow the device as it warms up or a cart type's chips change
+    rate->eraseMs += (int32_t)((eraseMs - (double)rate->eraseMs) *
+                               SCHEDULE_SMOOTHING);
+    rate->bytesPerMs += (bytesPerMs - rate->bytesPerMs) * SCHEDULE_SMOOTHING;
+    rate->samples++;
+  }
+  schedule_save_rates();
+}
+
+// The device's own rate for the profile, or the average of the other devices'
+// if it hasn't done that work yet, or the defaults if none have
+static void schedule_rate(int port, int profile, uint32_t *eraseMs,
+                          double *bytesPerMs) {
+  double otherErase = 0;
+  double otherRate = 0;
+  int otherCount = 0;
+  for (int x = 0; x < rateCount; x++) {
+    if (rates[x].profile != profile) {
+      continue;
+    }
+    if (rates[x].port == port) {
+      *eraseMs = rates[x].eraseMs;
+      *bytesPerMs = rates[x].bytesPerMs;
+      return;
+    }
+    otherErase += rates[x].eraseMs;
+    otherRate += rates[x].bytesPerMs;
+    otherCount++;
+  }
+
+  if (otherCount > 0) {
+    *eraseMs = (uint32_t)(otherErase / otherCount);
+    *bytesPerMs = otherRate / otherCount;
+  } else if (profile == SCHEDULE_PROFILE_READ) {
+    *eraseMs = 0;
+    *bytesPerMs = SCHEDULE_DEFAULT_READ_RATE;
+  } else if (profile == SCHEDULE_PROFILE_SAVE) {
+    *eraseMs = 0;
+    *bytesPerMs = SCHEDULE_DEFAULT_SAVE_RATE;
+  } else {
+    *eraseMs = SCHEDULE_DEFAULT_ERASE_MS;
+    *bytesPerMs = SCHEDULE_DEFAULT_PROGRAM_RATE;
+  }
+}
+
+uint32_t schedule_estimate(int port, const struct schedule_work *work) {
+  uint32_t eraseMs;
+  double bytesPerMs;
+  double ms = SCHEDULE_JOB_OVERHEAD_MS;
+
+  if (work->programLength > 0) {
+    schedule_rate(port, work->profile, &eraseMs, &bytesPerMs);
+    ms += eraseMs + work->programLength / bytesPerMs;
+  }
+  if (work->readLength > 0) {
+    schedule_rate(port, SCHEDULE_PROFILE_READ, &eraseMs, &bytesPerMs);
+    ms += work->readLength / bytesPerMs;
+  }
+  if (work->saveLength > 0) {
+    schedule_rate(port, SCHEDULE_PROFILE_SAVE, &eraseMs, &bytesPerMs);
+    ms += work->saveLength / bytesPerMs;
+  }
+  return (uint32_t)ms;
+}
+
+void schedule_plan(const int *ports, const uint32_t *busyMs, int deviceCount,
+                   struct schedule_job *jobs, int jobCount) {
+  if (deviceCount <= 0 || jobCount <= 0) {
+    return;
+  }
+  uint32_t freeAt[SCHEDULE_MAX_DEVICES];
+  for (int d = 0; d < deviceCount && d < SCHEDULE_MAX_DEVICES; d++) {
+    freeAt[d] = busyMs[d];
+  }
+  if (deviceCount > SCHEDULE_MAX_DEVICES) {
+    deviceCount = SCHEDULE_MAX_DEVICES;
+  }
+
+  // Order the jobs for a port by when they came in and the ones for any
+  // device longest first (by their average estimate)
+  int *sorted = (int *)malloc(jobCount * sizeof(int));
+  uint32_t *keys = (uint32_t *)malloc(jobCount * sizeof(uint32_t));
+  if (sorted == NULL || keys == NULL) {
+    free(sorted);
+    free(keys);
+    return;
+  }
+  for (int x = 0; x < jobCount; x++) {
+    if (jobs[x].port != 0) {
+      keys[x] = jobs[x].order;
+    } else {
+      uint64_t total = 0;
+      for (int d = 0; d < deviceCount; d++) {
+        total += schedule_estimate(ports[d], &jobs[x].work);
+      }
+      keys[x] = UINT32_MAX - (uint32_t)(total / deviceCount);
+    }
+    int y = x;
+    while (y > 0 && keys[sorted[y - 1]] > keys[x]) {
+      sorted[y] = sorted[y - 1];
+      y--;
+    }
+    sorted[y] = x;
+  }
+
+  // Jobs sent to a port go after what that port is already doing
+  for (int x = 0; x < jobCount; x++) {
+    struct schedule_job *job = &jobs[sorted[x]];
+    if (job->port == 0) {
+      continue;
+    }
+    job->plannedPort = job->port;
+    job->startMs = SCHEDULE_DEVICE_DOWN_MS;
+    job->finishMs = SCHEDULE_DEVICE_DOWN_MS;
+    for (int d = 0; d < deviceCount; d++) {
+      if (ports[d] == job->port) {
+        job->startMs = freeAt[d];
+        freeAt[d] += schedule_estimate(ports[d], &job->work);
+        job->finishMs = freeAt[d];
+      }
+    }
+  }
+
+  // The rest to whichever device would finish each one first
+  for (int x = 0; x < jobCount; x++) {
+    struct schedule_job *job = &jobs[sorted[x]];
+    if (job->port != 0) {
+      continue;
+    }
+    int best = -1;
+    uint32_t bestFinish = 0;
+    for (int d = 0; d < deviceCount; d++) {
+      uint32_t finish = freeAt[d] + schedule_estimate(ports[d], &job->work);
+      if (best < 0 || finish < bestFinish) {
+        best = d;
+        bestFinish = finish;
+      }
+    }
+    if (best < 0) {
+      continue;
+    }
+    job->plannedPort = ports[best];
+    job->startMs = freeAt[best];
+    job->finishMs = bestFinish;
+    freeAt[best] = bestFinish;
+  }
+
+  free(keys);
+  free(sorted);
+}
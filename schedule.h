@@ -0,0 +1,76 @@
+/*
+ Job scheduling by DEFENSE MECHANISM
+
+ Keeps how fast each device has erased, programmed and read carts in
+ cart-rates.ini (per port, and per flash cart type for erasing and
+ programming) and estimates from that how long a job would take on each
+ device. The queue is planned from those estimates: jobs sent to a port run
+ there in the order they came, jobs for any device go longest first to the
+ device that would finish them soonest. The plan is made again whenever a job
+ comes in or ends, so a device that frees up early takes work that was
+ planned for a slower or busier one.
+
+ */
+
+#include <stdint.h>
+
+#define SCHEDULE_RATES_FILE "cart-rates.ini"
+#define SCHEDULE_MAX_RATES 256
+#define SCHEDULE_MAX_DEVICES 16
+#define SCHEDULE_SMOOTHING 0.3 // Weight of the newest measurement
+
+#define SCHEDULE_PROFILE_READ -1 // Reading ROM (verify, backup-rom)
+#define SCHEDULE_PROFILE_SAVE -2 // Reading or writing saves
+
+// Until a device (or any device) has done some work like it
+#define SCHEDULE_DEFAULT_ERASE_MS 20000
+#define SCHEDULE_DEFAULT_PROGRAM_RATE 16.0 // Bytes per ms
+#define SCHEDULE_DEFAULT_READ_RATE 64.0
+#define SCHEDULE_DEFAULT_SAVE_RATE 16.0
+#define SCHEDULE_JOB_OVERHEAD_MS 500 // Identifying the cart, opening files
+#define SCHEDULE_UNKNOWN_ROM_LENGTH 0x100000 // Backing up a cart not seen yet
+#define SCHEDULE_UNKNOWN_SAVE_LENGTH 0x8000
+#define SCHEDULE_DEVICE_DOWN_MS 3600000 // How far off a device that's down is
+
+// How fast one device does one kind of work
+struct schedule_rate {
+  int port;
+  int profile; // Flash cart type, or SCHEDULE_PROFILE_READ/SAVE
+  uint32_t eraseMs;
+  double bytesPerMs;
+  uint32_t samples;
+};
+
+// The work in a job, as far as timing goes
+struct schedule_work {
+  int profile; // Flash cart type
+  uint32_t programLength;
+  uint32_t readLength; // Verified or backed up
+  uint32_t saveLength; // Written or backed up
+};
+
+// A job waiting to run
+struct schedule_job {
+  int port;       // 0 for any device
+  uint32_t order; // Jobs sent to one port run in this order
+  struct schedule_work work;
+
+  // Filled in by schedule_plan(), the times are ms from now
+  int plannedPort;
+  uint32_t startMs;
+  uint32_t finishMs;
+};
+
+// Read cart-rates.ini, if there is one
+void schedule_load_rates(void);
+
+// Add a measurement (length bytes in ms, after eraseMs for flash cart types) and write cart-rates.ini
+void schedule_measure(int port, int profile, uint32_t eraseMs, uint32_t length, uint32_t ms);
+
+// Estimated ms for the work on the device at port
+uint32_t schedule_estimate(int port, const struct schedule_work *work);
+
+// Plan when and where each job runs. busyMs is how long until each device is free (SCHEDULE_DEVICE_DOWN_MS for
+// the ones that are down).
+void schedule_plan(const int *ports, const uint32_t *busyMs, int deviceCount, struct schedule_job *jobs,
+                   int jobCount);
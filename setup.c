@@ -8,6 +8,10 @@
 
  */
 
+#ifndef _WIN32
+#define _XOPEN_SOURCE 600 // Must come before the first system header
+#endif
+
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -17,7 +21,6 @@
 #ifdef _WIN32
 #include <windows.h>
 #else
-#define _XOPEN_SOURCE 600
 #include <time.h>
 #endif
 
@@ -27,47 +30,28 @@
 #define RS232_PORTNR 30
 #endif
 
+#define GBX_NO_DEFAULT_DEVICE // This file only uses the gbx_ functions
 #include "setup.h"
 #include <stdio.h>
 
-// COM Port settings (default)
-#include "rs232/rs232.h"
-int cport_nr = 7;     // /dev/ttyS7 (COM8 on windows)
-int bdrate = 1000000; // 1,000,000 baud
-
-// Common vars
-uint8_t gbxcartFirmwareVersion = 0;
-uint8_t gbxcartPcbVersion = 0;
-uint8_t readBuffer[257];
-uint8_t writeBuffer[257];
-
-char gameTitle[17];
-uint16_t cartridgeType = 0;
-uint32_t currAddr = 0x0000;
-uint32_t endAddr = 0x7FFF;
-uint16_t romSize = 0;
-uint32_t romEndAddr = 0;
-uint16_t romBanks = 0;
-int ramSize = 0;
-uint16_t ramBanks = 0;
-uint32_t ramEndAddress = 0;
-int eepromSize = 0;
-uint16_t eepromEndAddress = 0;
-int hasFlashSave = 0;
-uint8_t cartridgeMode = GB_MODE;
-int flashCartType = 0;
-uint8_t flashID[10];
-uint32_t bytesReadPrevious = 0;
-uint32_t ledStatus = 0;
-uint32_t ledCountLeft = 0;
-uint32_t ledCountRight = 0;
-uint8_t ledSegment = 0;
-uint8_t ledProgress = 0;
-uint8_t ledBlinking = 0;
-uint8_t mode5vOverride = 0;
-int8_t detectedFlashWritingMethod = 0;
-uint8_t headerCheckSumOk = 0;
-uint8_t fastReadEnabled = 0;
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// The device the old variable and function names work on
+struct gbx_device gbxDefaultDevice = GBX_DEVICE_DEFAULTS;
+
+void gbx_device_init(struct gbx_device *device, uint8_t nonInteractive,
+                     void (*fatalHandler)(void),
+                     void (*progressHandler)(uint32_t bytesDone,
+                                             uint32_t bytesTotal)) {
+  struct gbx_device defaults = GBX_DEVICE_DEFAULTS;
+  *device = defaults;
+  device->nonInteractive = nonInteractive;
+  device->fatalHandler = fatalHandler;
+  device->progressHandler = progressHandler;
+}
+
 uint8_t nintendoLogo[] = {
     0xCE, 0xED, 0x66, 0x66, 0xCC, 0x0D, 0x00, 0x0B, 0x03, 0x73, 0x00, 0x83,
     0x00, 0x0C, 0x00, 0x0D, 0x00, 0x08, 0x11, 0x1F, 0x88, 0x89, 0x00, 0x0E,
@@ -97,7 +81,7 @@ uint8_t flashCartList[] = {
     0,  0,  0,  0,  0,  0,  44, 45, 46, 47, 48, 49, 50, 51};
 
 // Read the config.ini file for the COM port to use and baud rate
-void read_config(void) {
+void gbx_read_config(struct gbx_device *device) {
   char configFilePath[253];
 
 #if defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__)
@@ -109,19 +93,27 @@ void read_config(void) {
 
   FILE *configfile = fopen(configFilePath, "rt");
   if (configfile != NULL) {
-    if (fscanf(configfile, "%d\n%d", &cport_nr, &bdrate) != 2) {
+    if (fscanf(configfile, "%d\n%d", &device->cport_nr, &device->bdrate) != 2) {
       fprintf(stderr, "Config file is corrupt\n");
     } else {
-      cport_nr--;
+      device->cport_nr--;
     }
     fclose(configfile);
   } else {
     fprintf(stderr, "Config file not found\n");
   }
+
+  // A port given in the environment (as multi-cart does for each device) wins
+  // and is the only one tried
+  char *portVariable = getenv(PORT_ENV_VARIABLE);
+  if (portVariable != NULL && atoi(portVariable) > 0) {
+    device->cport_nr = atoi(portVariable) - 1;
+    device->cportFixed = 1;
+  }
 }
 
 // Write the config.ini file for the COM port to use and baud rate
-void write_config(void) {
+void gbx_write_config(struct gbx_device *device) {
   char configFilePath[253];
 
 #if defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__)
@@ -133,23 +125,23 @@ void write_config(void) {
 
   FILE *configfile = fopen(configFilePath, "wt");
   if (configfile != NULL) {
-    fprintf(configfile, "%d\n%d\n", cport_nr + 1, bdrate);
+    fprintf(configfile, "%d\n%d\n", device->cport_nr + 1, device->bdrate);
     fclose(configfile);
   }
 }
 
 // Load a file which contains the cartridge RAM settings (only needed if Erase
 // RAM option was used, only applies to GBA games)
-void load_cart_ram_info(void) {
+void gbx_load_cart_ram_info(struct gbx_device *device) {
   char titleFilename[30];
-  strncpy(titleFilename, gameTitle, 20);
+  strncpy(titleFilename, device->gameTitle, 20);
   strncat(titleFilename, ".si", 4);
 
   // Create a new file
   FILE *infoFile = fopen(titleFilename, "rt");
   if (infoFile != NULL) {
-    if (fscanf(infoFile, "%d,%d,%d,", &ramSize, &eepromSize, &hasFlashSave) !=
-        3) {
+    if (fscanf(infoFile, "%d,%d,%d,", &device->ramSize, &device->eepromSize,
+               &device->hasFlashSave) != 3) {
       fprintf(stderr, "Cart RAM info %s is corrupt\n", titleFilename);
     }
     fclose(infoFile);
@@ -158,9 +150,9 @@ void load_cart_ram_info(void) {
 
 // Write a file which contains the cartridge RAM settings before it's wiped
 // using Erase RAM (Only applies to GBA games)
-void write_cart_ram_info(void) {
+void gbx_write_cart_ram_info(struct gbx_device *device) {
   char titleFilename[30];
-  strncpy(titleFilename, gameTitle, 20);
+  strncpy(titleFilename, device->gameTitle, 20);
   strncat(titleFilename, ".si", 4);
 
   // Check if file exists, if not, write the ram info
@@ -170,7 +162,8 @@ void write_cart_ram_info(void) {
     // Create a new file
     FILE *infoFile = fopen(titleFilename, "wt");
     if (infoFile != NULL) {
-      fprintf(infoFile, "%d,%d,%d,", ramSize, eepromSize, hasFlashSave);
+      fprintf(infoFile, "%d,%d,%d,", device->ramSize, device->eepromSize,
+              device->hasFlashSave);
       fclose(infoFile);
     }
   } else {
@@ -178,16 +171,16 @@ void write_cart_ram_info(void) {
   }
 }
 // Check if OS can support fast COM port reading
-void fast_reading_check(void) {
-  set_mode(FAST_READ_CHECK);
+void gbx_fast_reading_check(struct gbx_device *device) {
+  gbx_set_mode(device, FAST_READ_CHECK);
 
   uint16_t timeOutCounter = 0;
   uint16_t readCounter = 0;
-  fastReadEnabled = 1;
+  device->fastReadEnabled = 1;
   uint8_t buffer[257];
 
   while (readCounter != 32768) {
-    uint8_t rxBytes = RS232_PollComport(cport_nr, buffer, 64);
+    uint8_t rxBytes = RS232_PollComport(device->cport_nr, buffer, 64);
     if (rxBytes > 0) {
       readCounter += rxBytes;
     }
@@ -195,7 +188,7 @@ void fast_reading_check(void) {
     delay_ms(1);
 
     if (timeOutCounter >= 750) { // Taking too long, exit
-      fastReadEnabled = 0;
+      device->fastReadEnabled = 0;
       break;
     }
   }
@@ -212,16 +205,78 @@ void delay_ms(uint16_t ms) {
 }
 
 // Read one letter from stdin
-char read_one_letter(void) {
+char gbx_read_one_letter(struct gbx_device *device) {
+  if (device->nonInteractive == 1) {
+    return '\n'; // Nobody to press a key
+  }
   char c = getchar();
   while (getchar() != '\n' && getchar() != EOF)
     ;
   return c;
 }
 
+// The device stopped answering part way through, the tools wait for enter and
+// give up
+void gbx_fatal(struct gbx_device *device) {
+  if (device->fatalHandler != NULL) {
+    device->fatalHandler();
+  }
+  gbx_read_one_letter(device);
+  exit(1);
+}
+
+// Compare two buffers and return the offset of the first byte that differs,
+// or -1 if they match. Uses SSE2 16 bytes at a time where available.
+int32_t compare_first_diff(const uint8_t *first, const uint8_t *second,
+                           uint32_t length) {
+  uint32_t offset = 0;
+
+#if defined(__SSE2__)
+  while (offset + 16 <= length) {
+    __m128i a = _mm_loadu_si128((const __m128i *)&first[offset]);
+    __m128i b = _mm_loadu_si128((const __m128i *)&second[offset]);
+    int equalMask = _mm_movemask_epi8(_mm_cmpeq_epi8(a, b));
+    if (equalMask != 0xFFFF) {
+      for (uint8_t x = 0; x < 16; x++) {
+        if ((equalMask & (1 << x)) == 0) {
+          return offset + x;
+        }
+      }
+    }
+    offset += 16;
+  }
+#else
+  while (offset + 8 <= length) {
+    uint64_t a;
+    uint64_t b;
+    memcpy(&a, &first[offset], 8);
+    memcpy(&b, &second[offset], 8);
+    if (a != b) {
+      break;
+    }
+    offset += 8;
+  }
+#endif
+
+  while (offset < length) {
+    if (first[offset] != second[offset]) {
+      return offset;
+    }
+    offset++;
+  }
+  return -1;
+}
+
 // Print progress
-void print_progress_percent(uint32_t bytesRead, uint32_t hashNumber) {
+void gbx_print_progress_percent(struct gbx_device *device, uint32_t bytesRead,
+                                uint32_t hashNumber) {
   // printf("%i, %i\n", bytesRead, hashNumber);
+  if (device->progressHandler != NULL) {
+    // 64 prints eight hashes a block, for a 512 byte RAM
+    device->progressHandler(bytesRead,
+                            (hashNumber == 64) ? 512 : hashNumber * 64);
+    return;
+  }
 
   if ((bytesRead % hashNumber == 0) && bytesRead != 0) {
     if (hashNumber == 64) {
@@ -235,172 +290,179 @@ void print_progress_percent(uint32_t bytesRead, uint32_t hashNumber) {
 }
 
 // LED progress
-void led_progress_percent(uint32_t bytesRead, uint32_t divideNumber) {
-  if (gbxcartPcbVersion == GBXMAS) {
-    if (bytesRead >= bytesReadPrevious) {
-      bytesReadPrevious += divideNumber;
-
-      if (ledSegment == 0) {
-        ledStatus |= (1 << ledCountLeft);
-        ledSegment = 1;
-        ledCountLeft++;
+void gbx_led_progress_percent(struct gbx_device *device, uint32_t bytesRead,
+                              uint32_t divideNumber) {
+  if (device->gbxcartPcbVersion == GBXMAS) {
+    if (bytesRead >= device->bytesReadPrevious) {
+      device->bytesReadPrevious += divideNumber;
+
+      if (device->ledSegment == 0) {
+        device->ledStatus |= (1 << device->ledCountLeft);
+        device->ledSegment = 1;
+        device->ledCountLeft++;
       } else {
-        ledSegment = 0;
-        ledStatus |= (1 << (ledCountRight + 14));
-        ledCountRight++;
+        device->ledSegment = 0;
+        device->ledStatus |= (1 << (device->ledCountRight + 14));
+        device->ledCountRight++;
       }
-      xmas_set_leds(ledStatus);
+      gbx_xmas_set_leds(device, device->ledStatus);
 
-      if (ledBlinking <= 14) {
-        ledBlinking = ledBlinking + 14;
+      if (device->ledBlinking <= 14) {
+        device->ledBlinking = device->ledBlinking + 14;
       } else {
-        ledBlinking = ledBlinking - 13;
+        device->ledBlinking = device->ledBlinking - 13;
       }
 
-      if (ledProgress < 27) {
-        xmas_blink_led(ledBlinking);
+      if (device->ledProgress < 27) {
+        gbx_xmas_blink_led(device, device->ledBlinking);
       }
-      ledProgress++;
+      device->ledProgress++;
     }
   }
 }
 
-void xmas_set_leds(uint32_t value) {
-  set_mode('0');
+void gbx_xmas_set_leds(struct gbx_device *device, uint32_t value) {
+  gbx_set_mode(device, '0');
   delay_ms(5);
-  set_number(XMAS_VALUE, XMAS_LEDS);
+  gbx_set_number(device, XMAS_VALUE, XMAS_LEDS);
   delay_ms(5);
-  set_number(value, 'L');
+  gbx_set_number(device, value, 'L');
   delay_ms(5);
 }
 
-void xmas_blink_led(uint8_t value) {
-  set_mode('0');
+void gbx_xmas_blink_led(struct gbx_device *device, uint8_t value) {
+  gbx_set_mode(device, '0');
   delay_ms(5);
-  set_number(XMAS_VALUE, XMAS_LEDS);
+  gbx_set_number(device, XMAS_VALUE, XMAS_LEDS);
   delay_ms(5);
-  set_mode('B');
-  set_mode(value);
+  gbx_set_mode(device, 'B');
+  gbx_set_mode(device, value);
   delay_ms(5);
 }
 
-void xmas_reset_values(void) {
-  ledStatus = 0;
-  ledCountLeft = 0;
-  ledCountRight = 0;
-  ledSegment = 0;
-  ledProgress = 0;
-  ledBlinking = 0;
-  bytesReadPrevious = 0;
+void gbx_xmas_reset_values(struct gbx_device *device) {
+  device->ledStatus = 0;
+  device->ledCountLeft = 0;
+  device->ledCountRight = 0;
+  device->ledSegment = 0;
+  device->ledProgress = 0;
+  device->ledBlinking = 0;
+  device->bytesReadPrevious = 0;
 }
 
 // Turn on idle timer
-void xmas_idle_on(void) {
-  if (gbxcartPcbVersion == GBXMAS) {
-    set_mode('0'); // Only send when writing
+void gbx_xmas_idle_on(struct gbx_device *device) {
+  if (device->gbxcartPcbVersion == GBXMAS) {
+    gbx_set_mode(device, '0'); // Only send when writing
     delay_ms(5);
-    set_number(XMAS_VALUE, XMAS_LEDS);
+    gbx_set_number(device, XMAS_VALUE, XMAS_LEDS);
     delay_ms(5);
-    set_mode('I');
+    gbx_set_mode(device, 'I');
     delay_ms(5);
   }
 }
 
 // Turn off idle timer
-void xmas_idle_off(void) {
-  set_mode('0'); // Only send when writing
+void gbx_xmas_idle_off(struct gbx_device *device) {
+  gbx_set_mode(device, '0'); // Only send when writing
   delay_ms(5);
-  set_number(XMAS_VALUE, XMAS_LEDS);
+  gbx_set_number(device, XMAS_VALUE, XMAS_LEDS);
   delay_ms(5);
-  set_mode('O');
+  gbx_set_mode(device, 'O');
   delay_ms(5);
 }
 
-void xmas_chip_erase_animation(void) {
-  if (gbxcartPcbVersion == GBXMAS) {
-    set_mode('0');
+void gbx_xmas_chip_erase_animation(struct gbx_device *device) {
+  if (device->gbxcartPcbVersion == GBXMAS) {
+    gbx_set_mode(device, '0');
     delay_ms(5);
-    set_number(XMAS_VALUE, XMAS_LEDS);
+    gbx_set_number(device, XMAS_VALUE, XMAS_LEDS);
     delay_ms(5);
-    set_mode('E');
+    gbx_set_mode(device, 'E');
     delay_ms(5);
   }
 }
 
-void xmas_wake_up(void) {
-  if (gbxcartPcbVersion == GBXMAS) {
-    set_mode('!');
+void gbx_xmas_wake_up(struct gbx_device *device) {
+  if (device->gbxcartPcbVersion == GBXMAS) {
+    gbx_set_mode(device, '!');
     delay_ms(50); // Wait for ATmega169 to WDT reset if in idle mode
   }
 }
 
-void xmas_setup(uint32_t progressNumber) {
-  if (gbxcartPcbVersion == GBXMAS) {
-    xmas_wake_up();
-    xmas_reset_values();
-    xmas_idle_off();
-    xmas_set_leds(0);
-    ledBlinking = 1;
-    xmas_blink_led(ledBlinking);
-    bytesReadPrevious = progressNumber;
+void gbx_xmas_setup(struct gbx_device *device, uint32_t progressNumber) {
+  if (device->gbxcartPcbVersion == GBXMAS) {
+    gbx_xmas_wake_up(device);
+    gbx_xmas_reset_values(device);
+    gbx_xmas_idle_off(device);
+    gbx_xmas_set_leds(device, 0);
+    device->ledBlinking = 1;
+    gbx_xmas_blink_led(device, device->ledBlinking);
+    device->bytesReadPrevious = progressNumber;
   }
 }
 
-// Wait for a "1" acknowledgement from the ATmega
-void com_wait_for_ack(void) {
-  uint8_t buffer[2];
-  uint8_t rxBytes = 0;
-  uint32_t timeout = 0;
-
-  while (rxBytes < 1) {
-    rxBytes = RS232_PollComport(cport_nr, buffer, 1);
+// Milliseconds from a clock that doesn't jump, for the read deadlines
+static uint32_t com_ms(void) {
+#if defined(_WIN32)
+  return GetTickCount();
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+#endif
+}
 
+// Read up to size bytes of whatever has come in. If nothing has, sleep until
+// something does or the deadline passes instead of polling in a loop. Returns
+// the number of bytes read, 0 if the deadline passed.
+static int com_poll_until(struct gbx_device *device, uint8_t *buffer, int size,
+                          uint32_t deadline) {
+  while (1) {
+    int rxBytes = RS232_PollComport(device->cport_nr, buffer, size);
     if (rxBytes > 0) {
-      if (buffer[0] == '1') {
-        break;
-      }
-      rxBytes = 0;
+      return rxBytes;
     }
-#if defined(__APPLE__)
-    else {
-      delay_ms(5);
-      timeout++;
-      if (timeout >= 250) {
-        printf("\n\nWriting has timed out. Please unplug GBxCart RW, re-seat "
-               "the cartridge and try again.\n");
-        read_one_letter();
-        exit(1);
-      }
+    int32_t remaining = (int32_t)(deadline - com_ms());
+    if (remaining <= 0) {
+      return 0;
     }
-#else
-    else {
-      timeout++;
-      if (timeout >= 200000) {
-        printf("\n\nWriting has timed out. Please unplug GBxCart RW, re-seat "
-               "the cartridge and try again.\n");
-        read_one_letter();
-        exit(1);
-      }
+    RS232_WaitComport(device->cport_nr, remaining);
+  }
+}
+
+// Wait for a "1" acknowledgement from the ATmega
+void gbx_com_wait_for_ack(struct gbx_device *device) {
+  uint8_t buffer[2];
+  uint32_t deadline = com_ms() + COM_ACK_TIMEOUT_MS;
+
+  while (1) {
+    if (com_poll_until(device, buffer, 1, deadline) == 0) {
+      printf("\n\nWriting has timed out. Please unplug GBxCart RW, re-seat "
+             "the cartridge and try again.\n");
+      gbx_fatal(device);
+    }
+    if (buffer[0] == '1') {
+      break;
     }
-#endif
   }
 }
 
 // Stop reading blocks of data
-void com_read_stop(void) {
-  RS232_cputs(cport_nr, "0"); // Stop read
-  RS232_drain(cport_nr);
-  if (gbxcartPcbVersion ==
+void gbx_com_read_stop(struct gbx_device *device) {
+  RS232_cputs(device->cport_nr, "0"); // Stop read
+  RS232_drain(device->cport_nr);
+  if (device->gbxcartPcbVersion ==
       GBXMAS) { // Small delay as GBXMAS intercepts these commands
     delay_ms(1);
   }
 }
 
 // Continue reading the next block of data
-void com_read_cont(void) {
-  RS232_cputs(cport_nr, "1"); // Continue read
-  RS232_drain(cport_nr);
-  if (gbxcartPcbVersion ==
+void gbx_com_read_cont(struct gbx_device *device) {
+  RS232_cputs(device->cport_nr, "1"); // Continue read
+  RS232_drain(device->cport_nr);
+  if (device->gbxcartPcbVersion ==
       GBXMAS) { // Small delay as GBXMAS intercepts these commands
     delay_ms(1);
   }
@@ -408,11 +470,12 @@ void com_read_cont(void) {
 
 // Test opening the COM port,if can't be open, try autodetecting device on other
 // COM ports
-uint8_t com_test_port(void) {
+uint8_t gbx_com_test_port(struct gbx_device *device) {
   // Check if COM port responds correctly
-  if (RS232_OpenComport(cport_nr, bdrate, "8N1") == 0) { // Port opened
-    set_mode('0');
-    uint8_t cartridgeMode = request_value(CART_MODE);
+  if (RS232_OpenComport(device->cport_nr, device->bdrate, "8N1") ==
+      0) { // Port opened
+    gbx_set_mode(device, '0');
+    uint8_t cartridgeMode = gbx_request_value(device, CART_MODE);
 
     // Responded ok
     if (cartridgeMode == GB_MODE || cartridgeMode == GBA_MODE) {
@@ -421,17 +484,20 @@ uint8_t com_test_port(void) {
   }
 
   // If port didn't get opened or responded wrong
+  if (device->cportFixed == 1) {
+    return 0;
+  }
   for (uint8_t x = 0; x <= RS232_PORTNR; x++) {
-    if (RS232_OpenComport(x, bdrate, "8N1") == 0) { // Port opened
-      cport_nr = x;
+    if (RS232_OpenComport(x, device->bdrate, "8N1") == 0) { // Port opened
+      device->cport_nr = x;
 
       // See if device responds correctly
-      set_mode('0');
-      uint8_t cartridgeMode = request_value(CART_MODE);
+      gbx_set_mode(device, '0');
+      uint8_t cartridgeMode = gbx_request_value(device, CART_MODE);
 
       // Responded ok, save the new port number
       if (cartridgeMode == GB_MODE || cartridgeMode == GBA_MODE) {
-        write_config();
+        gbx_write_config(device);
         return 1;
       } else {
         RS232_CloseComport(x);
@@ -446,75 +512,153 @@ uint8_t com_test_port(void) {
 // or to a file if specified. When polling the com port it return less than the
 // bytes we want, keep polling and wait until we have all bytes requested. We
 // expect no more than 256 bytes.
-uint8_t com_read_bytes(FILE *file, int count) {
+uint16_t gbx_com_read_bytes(struct gbx_device *device, FILE *file, int count) {
   uint8_t buffer[257];
-  uint16_t rxBytes = 0;
   uint16_t readBytes = 0;
 
-#if defined(__APPLE__)
-  uint8_t timeout = 0;
-#else
-  uint16_t timeout = 0;
-#endif
-
   while (readBytes < count) {
-    rxBytes = RS232_PollComport(cport_nr, buffer, 64);
+    // The time allowed starts again with each part of the block
+    int rxBytes = com_poll_until(device, buffer, 64,
+                                 com_ms() + COM_READ_TIMEOUT_MS);
+    if (rxBytes == 0) {
+      return readBytes;
+    }
 
-    if (rxBytes > 0) {
-      buffer[rxBytes] = 0;
+    if (file == NULL) {
+      memcpy(&device->readBuffer[readBytes], buffer, rxBytes);
+    } else {
+      fwrite(buffer, 1, rxBytes, file);
+    }
+    readBytes += rxBytes;
+  }
 
-      if (file == NULL) {
-        memcpy(&readBuffer[readBytes], buffer, rxBytes);
-      } else {
-        fwrite(buffer, 1, rxBytes, file);
+  return readBytes;
+}
+
+// Stop the current read, discard anything still arriving and start reading
+// again from the start number given (already divided by 2 for GBA ROM)
+static void com_read_restart(struct gbx_device *device, uint32_t startNumber,
+                             char readMode) {
+  uint8_t buffer[257];
+  gbx_com_read_stop(device);
+  while (RS232_PollComport(device->cport_nr, buffer, 256) > 0)
+    ;
+
+  gbx_set_number(device, startNumber, SET_START_ADDRESS);
+  gbx_set_mode(device, readMode);
+}
+
+// Read a block that has already been requested (by set_mode or com_read_cont)
+// into the read buffer, checking it before it's used. A short block is read
+// again on its own. A block where every byte is the same (what a loose contact
+// or floating data bus gives) is read a second time and only accepted if both
+// reads agree; the rest of a run of the same fill isn't re-checked. Each retry
+// waits a little longer than the last, starting at 1ms and capped at 256ms.
+// The ATmega is left just after the block, as with com_read_bytes, so
+// com_read_cont() can follow.
+uint16_t gbx_com_read_block_checked(struct gbx_device *device,
+                                    uint32_t startNumber, char readMode,
+                                    int count) {
+  uint8_t verifyBuffer[257];
+  uint16_t backoffMs = READ_RETRY_BACKOFF_MIN_MS;
+  uint8_t attempts = 0;
+
+  uint16_t rxBytes = gbx_com_read_bytes(device, READ_BUFFER, count);
+  while (1) {
+    if (rxBytes == count) {
+      // Check for a uniform block
+      int16_t fill = device->readBuffer[0];
+      for (uint16_t x = 1; x < count; x++) {
+        if (device->readBuffer[x] != fill) {
+          fill = -1;
+          break;
+        }
       }
 
-      readBytes += rxBytes;
-    }
-#if defined(__APPLE__)
-    else {
-      delay_ms(5);
-      timeout++;
-      if (timeout >= 50) {
-        return readBytes;
+      if (fill == -1 || fill == device->retryLastVerifiedFill) {
+        device->retryLastVerifiedFill = fill;
+        return rxBytes;
       }
-    }
-#else
-    else {
-      timeout++;
-      if (timeout >= 20000) {
-        return readBytes;
+
+      // Read it again and compare
+      memcpy(verifyBuffer, device->readBuffer, count);
+      com_read_restart(device, startNumber, readMode);
+      if (gbx_com_read_bytes(device, READ_BUFFER, count) == count &&
+          memcmp(verifyBuffer, device->readBuffer, count) == 0) {
+        device->retryLastVerifiedFill = fill;
+        return rxBytes;
       }
+      device->retryMismatchedReads++;
+    } else {
+      device->retryShortReads++;
     }
-#endif
+    device->retryLastVerifiedFill = -1;
+
+    attempts++;
+    if (attempts >= READ_RETRY_MAX_ATTEMPTS) {
+      printf("\n\nReading has failed after %i retries. Please unplug GBxCart "
+             "RW, re-seat the cartridge and try again.\n",
+             attempts);
+      gbx_fatal(device);
+    }
+
+    // Back off and read only this block again
+    device->retryCount++;
+    delay_ms(backoffMs);
+    device->retryBackoffMs += backoffMs;
+    if (backoffMs < READ_RETRY_BACKOFF_MAX_MS) {
+      backoffMs *= 2;
+    }
+
+    com_read_restart(device, startNumber, readMode);
+    rxBytes = gbx_com_read_bytes(device, READ_BUFFER, count);
   }
+}
 
-  return readBytes;
+// Clear the retry statistics before a new read
+void gbx_reset_retry_stats(struct gbx_device *device) {
+  device->retryShortReads = 0;
+  device->retryMismatchedReads = 0;
+  device->retryCount = 0;
+  device->retryBackoffMs = 0;
+  device->retryLastVerifiedFill = -1;
+}
+
+// Print the retry statistics if any blocks had to be read again
+void gbx_print_retry_stats(struct gbx_device *device) {
+  if (device->retryCount > 0 || device->retryMismatchedReads > 0) {
+    printf("\nRetries: %u (%u short, %u mismatched, %ums waiting)",
+           (unsigned int)device->retryCount,
+           (unsigned int)device->retryShortReads,
+           (unsigned int)device->retryMismatchedReads,
+           (unsigned int)device->retryBackoffMs);
+  }
 }
 
 // Read 1-256 bytes from the file (or buffer) and write it the COM port with the
 // command given
-void com_write_bytes_from_file(uint8_t command, FILE *file, int count) {
+void gbx_com_write_bytes_from_file(struct gbx_device *device, uint8_t command,
+                                   FILE *file, int count) {
   uint8_t buffer[257];
   buffer[0] = command;
 
   if (file == NULL) {
-    memcpy(&buffer[1], writeBuffer, count);
+    memcpy(&buffer[1], device->writeBuffer, count);
   } else {
     fread(&buffer[1], 1, count, file);
   }
 
-  RS232_SendBuf(cport_nr, buffer, (count + 1)); // command + 1-256 bytes
-  RS232_drain(cport_nr);
+  RS232_SendBuf(device->cport_nr, buffer, (count + 1)); // command + 1-256 bytes
+  RS232_drain(device->cport_nr);
 }
 
 // Send a single command byte
-void set_mode(char command) {
+void gbx_set_mode(struct gbx_device *device, char command) {
   char modeString[5];
   sprintf(modeString, "%c", command);
 
-  RS232_cputs(cport_nr, modeString);
-  RS232_drain(cport_nr);
+  RS232_cputs(device->cport_nr, modeString);
+  RS232_drain(device->cport_nr);
 
 #if defined(__APPLE__)
   delay_ms(5);
@@ -522,13 +666,14 @@ void set_mode(char command) {
 }
 
 // Send a command with a hex number and a null terminator byte
-void set_number(uint32_t number, uint8_t command) {
+void gbx_set_number(struct gbx_device *device, uint32_t number,
+                    uint8_t command) {
   char numberString[20];
   sprintf(numberString, "%c%x", command, number);
 
-  RS232_cputs(cport_nr, numberString);
-  RS232_SendByte(cport_nr, 0);
-  RS232_drain(cport_nr);
+  RS232_cputs(device->cport_nr, numberString);
+  RS232_SendByte(device->cport_nr, 0);
+  RS232_drain(device->cport_nr);
 
 #if defined(__APPLE__)
   delay_ms(5);
@@ -536,24 +681,24 @@ void set_number(uint32_t number, uint8_t command) {
 }
 
 // Send a single hex byte and wait for ACK back
-void send_hex_wait_ack(uint16_t hex) {
+static void send_hex_wait_ack(struct gbx_device *device, uint16_t hex) {
   char tempString[15];
   sprintf(tempString, "%x", hex);
-  RS232_cputs(cport_nr, tempString);
-  RS232_SendByte(cport_nr, 0);
-  RS232_drain(cport_nr);
+  RS232_cputs(device->cport_nr, tempString);
+  RS232_SendByte(device->cport_nr, 0);
+  RS232_drain(device->cport_nr);
   delay_ms(5);
-  com_wait_for_ack();
+  gbx_com_wait_for_ack(device);
 }
 
 // Read the cartridge mode
-uint8_t read_cartridge_mode(void) {
-  set_mode(CART_MODE);
+uint8_t gbx_read_cartridge_mode(struct gbx_device *device) {
+  gbx_set_mode(device, CART_MODE);
 
   uint8_t buffer[2];
   uint8_t rxBytes = 0;
   while (rxBytes < 1) {
-    rxBytes = RS232_PollComport(cport_nr, buffer, 1);
+    rxBytes = RS232_PollComport(device->cport_nr, buffer, 1);
 
     if (rxBytes > 0) {
       return buffer[0];
@@ -564,91 +709,543 @@ uint8_t read_cartridge_mode(void) {
 }
 
 // Send 1 byte and read 1 byte
-uint8_t request_value(uint8_t command) {
-  set_mode(command);
+uint8_t gbx_request_value(struct gbx_device *device, uint8_t command) {
+  gbx_set_mode(device, command);
 
   uint8_t buffer[2];
+  if (com_poll_until(device, buffer, 1, com_ms() + COM_REQUEST_TIMEOUT_MS) ==
+      0) {
+    return 0;
+  }
+  return buffer[0];
+}
+
+// Break out of any running function and get the firmware version, PCB version
+// and cartridge mode. The four requests go out in one write and the three
+// answers are read back together. Returns 0 if the device didn't answer.
+uint8_t gbx_request_device_info(struct gbx_device *device) {
+#if defined(__APPLE__) // Keep the separate requests, see gbx_set_mode()
+  gbx_set_mode(device, '0');
+  device->gbxcartFirmwareVersion =
+      gbx_request_value(device, READ_FIRMWARE_VERSION);
+  device->gbxcartPcbVersion = gbx_request_value(device, READ_PCB_VERSION);
+  device->cartridgeMode = gbx_request_value(device, CART_MODE);
+#else
+  char query[5] = {'0', READ_FIRMWARE_VERSION, READ_PCB_VERSION, CART_MODE,
+                   '\0'};
+  RS232_cputs(device->cport_nr, query);
+  RS232_drain(device->cport_nr);
+
+  uint8_t answers[3];
   uint8_t rxBytes = 0;
-  uint8_t timeoutCounter = 0;
+  uint32_t deadline = com_ms() + COM_REQUEST_TIMEOUT_MS;
+  while (rxBytes < 3) {
+    int polledBytes =
+        com_poll_until(device, &answers[rxBytes], 3 - rxBytes, deadline);
+    if (polledBytes == 0) {
+      return 0;
+    }
+    rxBytes += polledBytes;
+  }
+  device->gbxcartFirmwareVersion = answers[0];
+  device->gbxcartPcbVersion = answers[1];
+  device->cartridgeMode = answers[2];
+#endif
 
-  while (rxBytes < 1) {
-    rxBytes = RS232_PollComport(cport_nr, buffer, 1);
+  return 1;
+}
 
-    if (rxBytes > 0) {
-      return buffer[0];
+// Identify the device and cart with as few round trips as possible. On PCB
+// v1.3 the voltage (0 picks it from the cartridge mode) is queued without
+// waiting so it goes out with the first header request. Returns 0 if the
+// device didn't answer.
+uint8_t gbx_cart_identify(struct gbx_device *device,
+                          struct cart_identity *identity, char voltage) {
+  if (gbx_request_device_info(device) == 0) {
+    return 0;
+  }
+  return gbx_cart_read_identity(device, identity, voltage);
+}
+
+// Same as cart_identify() for a cart inserted after the device info was
+// requested, only the voltage and header are sent again
+uint8_t gbx_cart_read_identity(struct gbx_device *device,
+                               struct cart_identity *identity, char voltage) {
+  if (device->cartridgeMode != GB_MODE && device->cartridgeMode != GBA_MODE) {
+    return 0;
+  }
+
+  if (device->gbxcartPcbVersion == PCB_1_3) {
+    if (voltage == 0) {
+      voltage = (device->cartridgeMode == GBA_MODE) ? VOLTAGE_3_3V : VOLTAGE_5V;
     }
+    char voltageString[2] = {voltage, '\0'};
+    RS232_cputs(device->cport_nr, voltageString);
+  }
 
-    delay_ms(10);
-    timeoutCounter++;
-    if (timeoutCounter >= 25) { // After 250ms, timeout
-      return 0;
+  memset(identity, 0, sizeof(struct cart_identity));
+  identity->firmwareVersion = device->gbxcartFirmwareVersion;
+  identity->pcbVersion = device->gbxcartPcbVersion;
+  identity->mode = device->cartridgeMode;
+
+  if (device->cartridgeMode == GB_MODE) {
+    gbx_read_gb_header(device);
+    identity->romLength = (uint32_t)device->romBanks * 0x4000;
+    if (device->ramEndAddress > 0) {
+      identity->saveLength = (uint32_t)device->ramBanks *
+                             (device->ramEndAddress - 0xA000 + 1);
     }
+    identity->headerOk = device->headerCheckSumOk;
+  } else {
+    gbx_read_gba_header(device);
+    identity->romLength = device->romEndAddr;
+    if (device->eepromSize == EEPROM_4KBIT) {
+      identity->saveLength = 512;
+    } else if (device->eepromSize == EEPROM_64KBIT) {
+      identity->saveLength = 8192;
+    } else {
+      identity->saveLength = (uint32_t)device->ramBanks * device->ramEndAddress;
+    }
+    identity->headerOk = 1;
   }
+  strncpy(identity->title, device->gameTitle, 16);
 
-  return 0;
+  return 1;
+}
+
+// Check for a cart by reading the logo from the header, 64 bytes in one
+// request. Without a cart the logo doesn't read back. A short read is dropped
+// and asked for again so a slow answer can't leave bytes behind for the next
+// command. Returns 1 if there's a cart.
+uint8_t gbx_cart_present(struct gbx_device *device) {
+  uint32_t startNumber = 0x0100;
+  char readMode = READ_ROM_RAM;
+  const uint8_t *logo = nintendoLogo;
+  uint8_t logoLength = sizeof(nintendoLogo);
+  if (device->cartridgeMode == GBA_MODE) {
+    startNumber = 0x0000;
+    readMode = GBA_READ_ROM;
+    logo = nintendoLogoGBA;
+    logoLength = 60; // The rest of the logo is past the first 64 bytes
+  }
+
+  uint16_t rxBytes = 0;
+  uint16_t backoffMs = READ_RETRY_BACKOFF_MIN_MS;
+  for (uint8_t attempts = 0; attempts < READ_RETRY_MAX_ATTEMPTS; attempts++) {
+    gbx_set_number(device, startNumber, SET_START_ADDRESS);
+    gbx_set_mode(device, readMode);
+    rxBytes = gbx_com_read_bytes(device, READ_BUFFER, 64);
+    gbx_com_read_stop(device);
+    if (rxBytes == 64) {
+      break;
+    }
+
+    uint8_t buffer[257];
+    delay_ms(backoffMs);
+    while (RS232_PollComport(device->cport_nr, buffer, 256) > 0)
+      ;
+    if (backoffMs < READ_RETRY_BACKOFF_MAX_MS) {
+      backoffMs *= 2;
+    }
+  }
+
+  if (rxBytes < 64 ||
+      memcmp(&device->readBuffer[0x04], logo, logoLength) != 0) {
+    return 0;
+  }
+  return 1;
+}
+
+// ****** Cartridge identity cache ******
+
+// CRC32 (reflected, poly 0xEDB88320), pass 0 to start a new checksum
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, uint32_t length) {
+  crc = ~crc;
+  for (uint32_t x = 0; x < length; x++) {
+    crc ^= data[x];
+    for (uint8_t b = 0; b < 8; b++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+// FNV-1a 64 bit, pass HASH64_START to start a new hash
+uint64_t hash64_update(uint64_t hash, const uint8_t *data, uint32_t length) {
+  for (uint32_t x = 0; x < length; x++) {
+    hash ^= data[x];
+    hash *= 0x100000001B3ULL;
+  }
+  return hash;
+}
+
+// Read one 64 byte block of ROM from the address given into the read buffer
+void gbx_read_rom_sample(struct gbx_device *device, uint8_t mode,
+                         uint32_t address) {
+  if (mode == GBA_MODE) {
+    gbx_set_number(device, address / 2, SET_START_ADDRESS);
+    gbx_set_mode(device, GBA_READ_ROM);
+    gbx_com_read_block_checked(device, address / 2, GBA_READ_ROM, 64);
+  } else {
+    gbx_set_number(device, address, SET_START_ADDRESS);
+    gbx_set_mode(device, READ_ROM_RAM);
+    gbx_com_read_block_checked(device, address, READ_ROM_RAM, 64);
+  }
+  gbx_com_read_stop(device);
+}
+
+// Hash a few sparse 64 byte windows of ROM. Carts reflashed with a different
+// build that happens to keep the same header won't produce the same hash.
+uint32_t gbx_cart_fingerprint(struct gbx_device *device, uint8_t mode) {
+  uint32_t gbWindows[] = {0x1000, 0x2800, 0x3FC0};
+  uint32_t gbaWindows[] = {0x0000C0, 0x010000, 0x100000};
+  uint32_t *windows = gbWindows;
+  if (mode == GBA_MODE) {
+    windows = gbaWindows;
+  }
+
+  uint32_t fingerprint = 0;
+  for (uint8_t x = 0; x < 3; x++) {
+    gbx_read_rom_sample(device, mode, windows[x]);
+    fingerprint = crc32_update(fingerprint, device->readBuffer, 64);
+  }
+  return fingerprint;
+}
+
+static void cart_cache_path(char *cacheFilePath) {
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__)
+  strncpy(cacheFilePath, "cart-cache.ini", 15);
+#else
+  strncpy(cacheFilePath, getenv("USERPROFILE"), 200);
+  strncat(cacheFilePath, "\\gbxcart-cart-cache.ini", 24);
+#endif
+}
+
+// Look for a cache entry matching the mode, header checksum and fingerprint.
+// The rest of the line (after the fingerprint) is copied to entryData.
+// Returns 1 if found.
+uint8_t gbx_cart_cache_lookup(struct gbx_device *device, uint8_t mode,
+                              uint32_t checkSum, uint32_t fingerprint,
+                              char *entryData, int entryLength) {
+  if (device->cartCacheEnabled == 0) {
+    return 0;
+  }
+
+  char cacheFilePath[253];
+  cart_cache_path(cacheFilePath);
+
+  FILE *cacheFile = fopen(cacheFilePath, "rt");
+  if (cacheFile == NULL) {
+    return 0;
+  }
+
+  char line[CART_CACHE_LINE_LENGTH];
+  uint8_t found = 0;
+  while (fgets(line, sizeof(line), cacheFile) != NULL) {
+    int entryMode = 0;
+    unsigned int entryCheckSum = 0;
+    unsigned int entryFingerprint = 0;
+    int dataOffset = 0;
+    if (sscanf(line, "%d,%x,%x,%n", &entryMode, &entryCheckSum,
+               &entryFingerprint, &dataOffset) != 3) {
+      continue;
+    }
+    if (entryMode == mode && entryCheckSum == checkSum &&
+        entryFingerprint == fingerprint) {
+      strncpy(entryData, &line[dataOffset], entryLength - 1);
+      entryData[entryLength - 1] = '\0';
+      entryData[strcspn(entryData, "\r\n")] = '\0';
+      found = 1;
+      break;
+    }
+  }
+  fclose(cacheFile);
+
+  return found;
+}
+
+// Store a cache entry, replacing any older entry for the same mode and header
+// checksum (its fingerprint no longer matches the cart, so it's stale)
+void gbx_cart_cache_store(struct gbx_device *device, uint8_t mode,
+                          uint32_t checkSum, uint32_t fingerprint,
+                          const char *entryData) {
+  if (device->cartCacheEnabled == 0) {
+    return;
+  }
+
+  char cacheFilePath[253];
+  cart_cache_path(cacheFilePath);
+
+  // Keep the other entries, oldest ones are dropped once the cache is full
+  char(*lines)[CART_CACHE_LINE_LENGTH] =
+      malloc(CART_CACHE_MAX_ENTRIES * CART_CACHE_LINE_LENGTH);
+  if (lines == NULL) {
+    return;
+  }
+  uint16_t lineCount = 0;
+  FILE *cacheFile = fopen(cacheFilePath, "rt");
+  if (cacheFile != NULL) {
+    char line[CART_CACHE_LINE_LENGTH];
+    while (fgets(line, sizeof(line), cacheFile) != NULL) {
+      int entryMode = 0;
+      unsigned int entryCheckSum = 0;
+      if (sscanf(line, "%d,%x,", &entryMode, &entryCheckSum) != 2) {
+        continue;
+      }
+      if (entryMode == mode && entryCheckSum == checkSum) {
+        continue;
+      }
+      if (lineCount == CART_CACHE_MAX_ENTRIES - 1) {
+        memmove(lines[0], lines[1],
+                (CART_CACHE_MAX_ENTRIES - 2) * CART_CACHE_LINE_LENGTH);
+        lineCount--;
+      }
+      strncpy(lines[lineCount], line, CART_CACHE_LINE_LENGTH);
+      lineCount++;
+    }
+    fclose(cacheFile);
+  }
+
+  cacheFile = fopen(cacheFilePath, "wt");
+  if (cacheFile != NULL) {
+    for (uint16_t x = 0; x < lineCount; x++) {
+      fputs(lines[x], cacheFile);
+    }
+    fprintf(cacheFile, "%d,%X,%08X,%s\n", mode, checkSum, fingerprint,
+            entryData);
+    fclose(cacheFile);
+  }
+  free(lines);
+}
+
+// ****** ROM read and compare ******
+
+// Progress for each 64 bytes of the block, as print_progress_percent() expects
+static void read_rom_progress(struct gbx_device *device, uint32_t *doneBytes,
+                              uint16_t length, uint32_t hashNumber) {
+  for (uint16_t x = 0; x < length; x += 64) {
+    *doneBytes += (length - x < 64) ? length - x : 64;
+    gbx_print_progress_percent(device, *doneBytes, hashNumber);
+  }
+}
+
+// Stream the ROM from offset, a GB bank at a time (bank 1 also covers bank 0)
+// or straight through on GBA. Blocks are always read whole, the last one is
+// passed on up to the end of the range. Only blocks that are passed on are
+// asked for, the ATmega sends the next one as soon as it's asked.
+uint32_t gbx_read_rom(struct gbx_device *device, uint32_t offset,
+                      uint32_t length, gbx_rom_block_handler onBlock,
+                      void *context) {
+  uint32_t start = offset;
+  uint32_t end = offset + length;
+  uint32_t doneBytes = 0;
+  uint32_t hashNumber = (length >= 64) ? length / 64 : 1;
+  uint8_t reading = 1;
+
+  if (device->cartridgeMode == GB_MODE) {
+    device->endAddr = 0x7FFF;
+    while (offset < end && reading == 1) {
+      uint16_t bank = 1;
+      device->currAddr = offset;
+      uint32_t bankEnd = 0x8000;
+      if (offset >= 0x8000) {
+        bank = offset / 0x4000;
+        device->currAddr = 0x4000 + (offset % 0x4000);
+        bankEnd = ((uint32_t)bank + 1) * 0x4000;
+      }
+      if (bankEnd > end) {
+        bankEnd = end;
+      }
+      gbx_gb_set_rom_bank(device, bank);
+      gbx_set_number(device, device->currAddr, SET_START_ADDRESS);
+      gbx_set_mode(device, READ_ROM_RAM);
+
+      while (offset < bankEnd) {
+        uint16_t blockLength = (bankEnd - offset < 64) ? bankEnd - offset : 64;
+        gbx_com_read_block_checked(device, device->currAddr, READ_ROM_RAM, 64);
+        reading = onBlock(context, offset, device->readBuffer, blockLength);
+        if (reading == 0) {
+          break;
+        }
+        device->currAddr += 64;
+        offset += blockLength;
+
+        // Request 64 bytes more
+        if (offset < bankEnd) {
+          gbx_com_read_cont(device);
+        }
+        read_rom_progress(device, &doneBytes, blockLength, hashNumber);
+      }
+      gbx_com_read_stop(device); // Stop reading ROM (as we will bank switch)
+    }
+    gbx_gb_set_rom_bank(device, 1);
+  } else { // GBA mode, addressed in 16 bit words
+    device->currAddr = offset;
+    device->endAddr = end;
+    gbx_set_number(device, device->currAddr / 2, SET_START_ADDRESS);
+
+    uint16_t readLength = 64;
+    char readMode = GBA_READ_ROM;
+#if !defined(__APPLE__) // Apple only seems to like reading 64 bytes
+    if (device->gbxcartPcbVersion != PCB_1_0) {
+      readMode = GBA_READ_ROM_256BYTE;
+      readLength = 256;
+    }
+#endif
+    gbx_set_mode(device, readMode);
+
+    while (device->currAddr < device->endAddr) {
+      uint16_t blockLength = (device->endAddr - device->currAddr < readLength)
+                                 ? device->endAddr - device->currAddr
+                                 : readLength;
+      gbx_com_read_block_checked(device, device->currAddr / 2, readMode,
+                                 readLength);
+      reading = onBlock(context, device->currAddr, device->readBuffer,
+                        blockLength);
+      if (reading == 0) {
+        break;
+      }
+      device->currAddr += blockLength;
+
+      // Request more bytes
+      if (device->currAddr < device->endAddr) {
+        gbx_com_read_cont(device);
+      }
+      read_rom_progress(device, &doneBytes, blockLength, hashNumber);
+    }
+    gbx_com_read_stop(device);
+    offset = device->currAddr;
+  }
+
+  return offset - start;
+}
+
+struct compare_rom_state {
+  uint8_t mode;
+  const uint8_t *romData;
+  gbx_rom_diff_handler onDiff;
+  void *context;
+  uint32_t diffBlocks;
+};
+
+// Compare a block read with the data at the same ROM offset and pass it to
+// the diff handler if it differs
+static uint8_t compare_rom_block(void *context, uint32_t romOffset,
+                                 const uint8_t *data, uint16_t length) {
+  struct compare_rom_state *state = (struct compare_rom_state *)context;
+  const uint8_t *romData = &state->romData[romOffset];
+  int32_t diffOffset = compare_first_diff(data, romData, length);
+  if (diffOffset < 0) {
+    return 1;
+  }
+  state->diffBlocks++;
+  if (state->onDiff == NULL) {
+    return 0;
+  }
+  uint16_t bank = romOffset >> 22; // GBA 4MB bank
+  if (state->mode == GB_MODE) {
+    bank = (romOffset < 0x8000) ? 1 : romOffset / 0x4000;
+  }
+  return state->onDiff(state->context, bank, romOffset, data, romData, length,
+                       diffOffset);
+}
+
+uint32_t gbx_compare_rom(struct gbx_device *device, const uint8_t *romData,
+                         uint32_t compareLength, gbx_rom_diff_handler onDiff,
+                         void *context) {
+  struct compare_rom_state state = {device->cartridgeMode, romData, onDiff,
+                                    context, 0};
+  gbx_read_rom(device, 0, compareLength, compare_rom_block, &state);
+  return state.diffBlocks;
 }
 
 // ****** Gameboy / Gameboy Colour functions ******
 
 // Set bank for ROM/RAM switching, send address first and then bank number
-void set_bank(uint16_t address, uint8_t bank) {
+void gbx_set_bank(struct gbx_device *device, uint16_t address, uint8_t bank) {
   char AddrString[15];
   sprintf(AddrString, "%c%x", SET_BANK, address);
-  RS232_cputs(cport_nr, AddrString);
-  RS232_SendByte(cport_nr, 0);
-  RS232_drain(cport_nr);
+  RS232_cputs(device->cport_nr, AddrString);
+  RS232_SendByte(device->cport_nr, 0);
+  RS232_drain(device->cport_nr);
   delay_ms(5);
 
   char bankString[15];
   sprintf(bankString, "%c%d", SET_BANK, bank);
-  RS232_cputs(cport_nr, bankString);
-  RS232_SendByte(cport_nr, 0);
-  RS232_drain(cport_nr);
+  RS232_cputs(device->cport_nr, bankString);
+  RS232_SendByte(device->cport_nr, 0);
+  RS232_drain(device->cport_nr);
   delay_ms(5);
 }
 
+// Switch the ROM bank mapped at 0x4000-0x7FFF using the cart's MBC (from the
+// header's cartridge type and title)
+void gbx_gb_set_rom_bank(struct gbx_device *device, uint16_t bank) {
+  if (device->cartridgeType >= 5) { // MBC2 and above
+    gbx_set_bank(device, 0x2100, bank & 0xFF);
+    // High bit, cleared too so a bank below 256 doesn't keep the last one's
+    gbx_set_bank(device, 0x3000, bank >> 8);
+  } else { // MBC1
+    if ((strncmp(device->gameTitle, "MOMOCOL", 7) == 0) ||
+        (strncmp(device->gameTitle, "BOMCOL", 6) == 0)) { // MBC1 Hudson
+      gbx_set_bank(device, 0x4000, bank >> 4);
+      if (bank < 10) {
+        gbx_set_bank(device, 0x2000, bank & 0x1F);
+      } else {
+        gbx_set_bank(device, 0x2000, 0x10 | (bank & 0x1F));
+      }
+    } else {                       // Regular MBC1
+      gbx_set_bank(device, 0x6000, 0);         // Set ROM Mode
+      gbx_set_bank(device, 0x4000,
+                   bank >> 5); // Set bits 5 & 6 (01100000) of ROM bank
+      gbx_set_bank(device, 0x2000,
+                   bank & 0x1F); // Set bits 0 & 4 (00011111) of ROM bank
+    }
+  }
+}
+
 // MBC2 Fix (unknown why this fixes reading the ram, maybe has to read ROM
 // before RAM?) Read 64 bytes of ROM, (really only 1 byte is required)
-void mbc2_fix(void) {
-  set_number(0x0000, SET_START_ADDRESS);
-  set_mode(READ_ROM_RAM);
+void gbx_mbc2_fix(struct gbx_device *device) {
+  gbx_set_number(device, 0x0000, SET_START_ADDRESS);
+  gbx_set_mode(device, READ_ROM_RAM);
 
   uint16_t rxBytes = 0;
   uint8_t byteCount = 0;
   uint8_t tempBuffer[64];
   while (byteCount < 64) {
-    rxBytes = RS232_PollComport(cport_nr, tempBuffer, 64);
+    rxBytes = RS232_PollComport(device->cport_nr, tempBuffer, 64);
 
     if (rxBytes > 0) {
       byteCount += rxBytes;
     }
   }
-  com_read_stop();
+  gbx_com_read_stop(device);
 }
 
 // Read the first 384 bytes of ROM and process the Gameboy header information
-void read_gb_header(void) {
-  currAddr = 0x0000;
-  endAddr = 0x0180;
+void gbx_read_gb_header(struct gbx_device *device) {
+  device->currAddr = 0x0000;
+  device->endAddr = 0x0180;
 
-  set_number(currAddr, SET_START_ADDRESS);
-  set_mode(READ_ROM_RAM);
+  gbx_set_number(device, device->currAddr, SET_START_ADDRESS);
+  gbx_set_mode(device, READ_ROM_RAM);
 
   uint8_t startRomBuffer[385];
-  while (currAddr < endAddr) {
-    com_read_bytes(READ_BUFFER, 64);
-    memcpy(&startRomBuffer[currAddr], readBuffer, 64);
-    currAddr += 64;
+  while (device->currAddr < device->endAddr) {
+    gbx_com_read_block_checked(device, device->currAddr, READ_ROM_RAM, 64);
+    memcpy(&startRomBuffer[device->currAddr], device->readBuffer, 64);
+    device->currAddr += 64;
 
-    if (currAddr < endAddr) {
-      com_read_cont();
+    if (device->currAddr < device->endAddr) {
+      gbx_com_read_cont(device);
     }
   }
-  com_read_stop();
+  gbx_com_read_stop(device);
 
   // Blank out game title
   for (uint8_t b = 0; b < 16; b++) {
-    gameTitle[b] = 0;
+    device->gameTitle[b] = 0;
   }
   // Read cartridge title and check for non-printable text
   for (uint16_t titleAddress = 0x0134; titleAddress <= 0x143; titleAddress++) {
@@ -659,55 +1256,55 @@ void read_gb_header(void) {
         (headerChar == 0x2E) ||                       // .
         (headerChar == 0x5F) ||                       // _
         (headerChar == 0x20)) {                       // Space
-      gameTitle[(titleAddress - 0x0134)] = headerChar;
+      device->gameTitle[(titleAddress - 0x0134)] = headerChar;
     } else {
-      gameTitle[(titleAddress - 0x0134)] = '\0';
+      device->gameTitle[(titleAddress - 0x0134)] = '\0';
       break;
     }
   }
-  printf("Game title: %s\n", gameTitle);
+  printf("Game title: %s\n", device->gameTitle);
 
-  cartridgeType = startRomBuffer[0x0147];
-  romSize = startRomBuffer[0x0148];
-  ramSize = startRomBuffer[0x0149];
+  device->cartridgeType = startRomBuffer[0x0147];
+  device->romSize = startRomBuffer[0x0148];
+  device->ramSize = startRomBuffer[0x0149];
 
   // ROM banks
-  romBanks = 2;       // Default 32K
-  if (romSize >= 1) { // Calculate rom size
-    romBanks = 2 << romSize;
+  device->romBanks = 2;       // Default 32K
+  if (device->romSize >= 1) { // Calculate rom size
+    device->romBanks = 2 << device->romSize;
   }
 
   // RAM banks
-  ramBanks = 0; // Default 0K RAM
-  if (cartridgeType == 6) {
-    ramBanks = 1;
+  device->ramBanks = 0; // Default 0K RAM
+  if (device->cartridgeType == 6) {
+    device->ramBanks = 1;
   }
-  if (ramSize == 2) {
-    ramBanks = 1;
+  if (device->ramSize == 2) {
+    device->ramBanks = 1;
   }
-  if (ramSize == 3) {
-    ramBanks = 4;
+  if (device->ramSize == 3) {
+    device->ramBanks = 4;
   }
-  if (ramSize == 4) {
-    ramBanks = 16;
+  if (device->ramSize == 4) {
+    device->ramBanks = 16;
   }
-  if (ramSize == 5) {
-    ramBanks = 8;
+  if (device->ramSize == 5) {
+    device->ramBanks = 8;
   }
 
   // RAM end address
-  if (cartridgeType == 6) {
-    ramEndAddress = 0xA1FF;
+  if (device->cartridgeType == 6) {
+    device->ramEndAddress = 0xA1FF;
   } // MBC2 512bytes (nibbles)
-  if (ramSize == 1) {
-    ramEndAddress = 0xA7FF;
+  if (device->ramSize == 1) {
+    device->ramEndAddress = 0xA7FF;
   } // 2K RAM
-  if (ramSize > 1) {
-    ramEndAddress = 0xBFFF;
+  if (device->ramSize > 1) {
+    device->ramEndAddress = 0xBFFF;
   } // 8K RAM
 
   printf("MBC type: ");
-  switch (cartridgeType) {
+  switch (device->cartridgeType) {
   case 0:
     printf("ROM ONLY\n");
     break;
@@ -791,7 +1388,7 @@ void read_gb_header(void) {
   }
 
   printf("ROM size: ");
-  switch (romSize) {
+  switch (device->romSize) {
   case 0:
     printf("32KByte (no ROM banking)\n");
     break;
@@ -808,14 +1405,16 @@ void read_gb_header(void) {
     printf("512KByte (32 banks)\n");
     break;
   case 5:
-    if (cartridgeType == 1 || cartridgeType == 2 || cartridgeType == 3) {
+    if (device->cartridgeType == 1 || device->cartridgeType == 2
+        || device->cartridgeType == 3) {
       printf("1MByte (63 banks)\n");
     } else {
       printf("1MByte (64 banks)\n");
     }
     break;
   case 6:
-    if (cartridgeType == 1 || cartridgeType == 2 || cartridgeType == 3) {
+    if (device->cartridgeType == 1 || device->cartridgeType == 2
+        || device->cartridgeType == 3) {
       printf("2MByte (125 banks)\n");
     } else {
       printf("2MByte (128 banks)\n");
@@ -838,9 +1437,9 @@ void read_gb_header(void) {
   }
 
   printf("RAM size: ");
-  switch (ramSize) {
+  switch (device->ramSize) {
   case 0:
-    if (cartridgeType == 6) {
+    if (device->cartridgeType == 6) {
       printf("512 bytes (nibbles)\n");
     } else {
       printf("None\n");
@@ -884,11 +1483,223 @@ void read_gb_header(void) {
   printf("Header Checksum: ");
   if (romCheckSum == startRomBuffer[0x14D]) {
     printf("OK\n");
-    headerCheckSumOk = 1;
+    device->headerCheckSumOk = 1;
   } else {
     printf("Failed\n");
-    headerCheckSumOk = 0;
+    device->headerCheckSumOk = 0;
+  }
+}
+
+// Get the MBC ready for reading or writing the cart RAM
+void gbx_gb_ram_enable(struct gbx_device *device) {
+  gbx_mbc2_fix(device);
+  if (device->cartridgeType <= 4) { // MBC1
+    gbx_set_bank(device, 0x6000, 1);    // Set RAM Mode
+  }
+  gbx_set_bank(device, 0x0000, 0x0A); // Initialise MBC
+  device->ramSampleBank = 0xFFFF;
+}
+
+// Read 64 bytes of cart RAM into the read buffer, the offset counts from the
+// start of RAM bank 0. The RAM bank is only switched when it changes.
+void gbx_gb_read_ram_sample(struct gbx_device *device, uint32_t offset) {
+  uint32_t bankSize = device->ramEndAddress - 0xA000 + 1;
+  uint16_t bank = offset / bankSize;
+  if (bank != device->ramSampleBank) {
+    gbx_set_bank(device, 0x4000, bank);
+    device->ramSampleBank = bank;
+  }
+
+  uint16_t ramAddress = 0xA000 + (offset % bankSize);
+  gbx_set_number(device, ramAddress, SET_START_ADDRESS);
+  gbx_set_mode(device, READ_ROM_RAM);
+  gbx_com_read_block_checked(device, ramAddress, READ_ROM_RAM, 64);
+  gbx_com_read_stop(device);
+}
+
+// Stop reading the RAM bank before (if there was one) and start reading the
+// next bank from 0xA000 in a single write: the stop, both halves of the bank
+// switch, the start address and the read mode go out together instead of as
+// five drained commands with 10ms of pauses
+static void gb_ram_stream_bank(struct gbx_device *device, uint8_t bank,
+                               uint8_t stopPrevious) {
+  char batch[48];
+  int length = 0;
+  if (stopPrevious == 1) {
+    batch[length++] = '0';
+  }
+  length += sprintf(&batch[length], "%c%x", SET_BANK, 0x4000) + 1;
+  length += sprintf(&batch[length], "%c%d", SET_BANK, bank) + 1;
+  length += sprintf(&batch[length], "%c%x", SET_START_ADDRESS, 0xA000) + 1;
+  batch[length++] = READ_ROM_RAM;
+
+  RS232_SendBuf(device->cport_nr, (unsigned char *)batch, length);
+  RS232_drain(device->cport_nr);
+}
+
+// Read the whole cart RAM (ramBanks of 0xA000 to ramEndAddress) into the
+// buffer given, printing progress as the backup loop always has. The banks
+// are streamed one after the other, see gb_ram_stream_bank().
+void gbx_gb_read_ram(struct gbx_device *device, uint8_t *ramData) {
+  gbx_gb_ram_enable(device);
+
+  // Apple and GBxMas need a pause between commands
+  uint8_t streamBanks = 1;
+#if defined(__APPLE__)
+  streamBanks = 0;
+#endif
+  if (device->gbxcartPcbVersion == GBXMAS) {
+    streamBanks = 0;
+  }
+
+  uint32_t readBytes = 0;
+  for (uint8_t bank = 0; bank < device->ramBanks; bank++) {
+    uint16_t ramAddress = 0xA000;
+    if (streamBanks == 1) {
+      gb_ram_stream_bank(device, bank, bank > 0);
+    } else {
+      gbx_set_bank(device, 0x4000, bank);
+      gbx_set_number(device, ramAddress,
+                     SET_START_ADDRESS); // Set start address again
+      gbx_set_mode(device, READ_ROM_RAM); // Set rom/ram reading mode
+    }
+    uint32_t retriesBefore = device->retryCount;
+
+    while (ramAddress < device->ramEndAddress) {
+      gbx_com_read_block_checked(device, ramAddress, READ_ROM_RAM, 64);
+
+      // If the first block had to be read again part of the batch may have
+      // been lost, so switch the bank again the slow way before trusting it
+      if (streamBanks == 1 && ramAddress == 0xA000 &&
+          device->retryCount != retriesBefore) {
+        gbx_com_read_stop(device);
+        gbx_set_bank(device, 0x4000, bank);
+        gbx_set_number(device, ramAddress, SET_START_ADDRESS);
+        gbx_set_mode(device, READ_ROM_RAM);
+        gbx_com_read_block_checked(device, ramAddress, READ_ROM_RAM, 64);
+      }
+
+      memcpy(&ramData[readBytes], device->readBuffer, 64);
+      ramAddress += 64;
+      readBytes += 64;
+
+      // Request 64 bytes more
+      if (ramAddress < device->ramEndAddress) {
+        gbx_com_read_cont(device);
+      }
+
+      // Print progress
+      if (device->ramEndAddress == 0xA1FF) {
+        gbx_print_progress_percent(device, readBytes, 64);
+      } else if (device->ramEndAddress == 0xA7FF) {
+        gbx_print_progress_percent(device, readBytes / 4, 64);
+      } else {
+        gbx_print_progress_percent(
+            device, readBytes,
+            (device->ramBanks * (device->ramEndAddress - 0xA000 + 1)) / 64);
+      }
+    }
+    if (streamBanks == 0) {
+      gbx_com_read_stop(device); // Stop reading RAM (as we will bank switch)
+    }
+  }
+  if (streamBanks == 1) {
+    // The stops between banks went out with the next bank
+    gbx_com_read_stop(device);
+  }
+
+  gbx_set_bank(device, 0x0000, 0x00); // Disable RAM
+}
+
+// Compare 64 byte blocks of cart RAM. MBC2 RAM is 4 bits wide, the top bits
+// read back as whatever is on the bus so only the bottom ones count.
+static uint8_t gb_ram_blocks_match(struct gbx_device *device,
+                                   const uint8_t *first,
+                                   const uint8_t *second) {
+  if (device->cartridgeType != 5 && device->cartridgeType != 6) {
+    return (memcmp(first, second, 64) == 0) ? 1 : 0;
+  }
+  for (uint8_t x = 0; x < 64; x++) {
+    if (((first[x] ^ second[x]) & 0x0F) != 0) {
+      return 0;
+    }
   }
+  return 1;
+}
+
+// Write a save to the cart RAM, only sending the 64 byte blocks that differ
+// from what the cart holds now (blocks past dataLength are left alone), then
+// read the written blocks back. The current RAM is read with progress first.
+// Returns the number of blocks that didn't read back right.
+uint32_t gbx_gb_write_ram_delta(struct gbx_device *device,
+                                const uint8_t *ramData, uint32_t dataLength,
+                                uint32_t *changedBlocks) {
+  uint32_t bankSize = device->ramEndAddress - 0xA000 + 1;
+  uint32_t ramLength = device->ramBanks * bankSize;
+  if (dataLength > ramLength) {
+    dataLength = ramLength;
+  }
+  uint8_t *cartData = (uint8_t *)malloc(ramLength);
+  uint8_t *changed = (uint8_t *)calloc(ramLength / 64, 1);
+  if (cartData == NULL || changed == NULL) {
+    printf("\nNot enough memory\n");
+    gbx_fatal(device);
+  }
+  gbx_gb_read_ram(device, cartData);
+  printf("]\n");
+
+  *changedBlocks = 0;
+  for (uint32_t offset = 0; offset + 64 <= dataLength; offset += 64) {
+    if (gb_ram_blocks_match(device, &cartData[offset], &ramData[offset]) ==
+        0) {
+      changed[offset / 64] = 1;
+      (*changedBlocks)++;
+    }
+  }
+  printf("%u of %u blocks differ\n", (unsigned int)*changedBlocks,
+         (unsigned int)(ramLength / 64));
+
+  gbx_gb_ram_enable(device);
+
+  // Consecutive blocks in a bank go out without setting the address again
+  uint32_t nextOffset = 0xFFFFFFFF;
+  for (uint32_t offset = 0; offset < ramLength; offset += 64) {
+    gbx_led_progress_percent(device, offset + 64, ramLength / 28);
+    if (changed[offset / 64] == 0) {
+      continue;
+    }
+    uint16_t bank = offset / bankSize;
+    if (bank != device->ramSampleBank) {
+      gbx_set_bank(device, 0x4000, bank);
+      device->ramSampleBank = bank;
+      nextOffset = 0xFFFFFFFF;
+    }
+    if (offset != nextOffset) {
+      gbx_set_number(device, 0xA000 + (offset % bankSize), SET_START_ADDRESS);
+    }
+
+    memcpy(device->writeBuffer, &ramData[offset], 64);
+    gbx_com_write_bytes_from_file(device, WRITE_RAM, NULL, 64);
+    gbx_com_wait_for_ack(device);
+    nextOffset = offset + 64;
+  }
+
+  uint32_t badBlocks = 0;
+  for (uint32_t offset = 0; offset < ramLength; offset += 64) {
+    if (changed[offset / 64] == 1) {
+      gbx_gb_read_ram_sample(device, offset);
+      if (gb_ram_blocks_match(device, device->readBuffer, &ramData[offset]) ==
+          0) {
+        printf("Block at 0x%05X didn't verify\n", (unsigned int)offset);
+        badBlocks++;
+      }
+    }
+  }
+  gbx_set_bank(device, 0x0000, 0x00); // Disable RAM
+
+  free(changed);
+  free(cartData);
+  return badBlocks;
 }
 
 // ****** Gameboy Advance functions ******
@@ -897,7 +1708,7 @@ void read_gb_header(void) {
 // if they are all 0x00. There can be some ROMs that do have valid 0x00 data, so
 // we check 32 different addresses in a 4MB chunk, if 30 or more are all 0x00
 // then we've reached the end.
-uint8_t gba_check_rom_size(void) {
+uint8_t gbx_gba_check_rom_size(struct gbx_device *device) {
   uint32_t fourMbBoundary = 0x3FFFC0;
   uint32_t currAddr = 0x1FFC0;
   uint8_t romZeroTotal = 0;
@@ -905,19 +1716,18 @@ uint8_t gba_check_rom_size(void) {
 
   // Loop until 32MB
   for (uint16_t x = 0; x < 512; x++) {
-    set_number(currAddr / 2,
-               SET_START_ADDRESS); // Divide current address by 2 as we only
-                                   // increment it by 1 after 2 bytes have been
-                                   // read on the ATmega side
-    set_mode(GBA_READ_ROM);
+    // Divide current address by 2 as we only increment it by 1 after 2 bytes
+    // have been read on the ATmega side
+    gbx_set_number(device, currAddr / 2, SET_START_ADDRESS);
+    gbx_set_mode(device, GBA_READ_ROM);
 
-    com_read_bytes(READ_BUFFER, 64);
-    com_read_stop();
+    gbx_com_read_bytes(device, READ_BUFFER, 64);
+    gbx_com_read_stop(device);
 
     // Check how many 0x00 are found in the 64 bytes
     uint8_t zeroCheck = 0;
     for (uint16_t c = 0; c < 64; c++) {
-      if (readBuffer[c] == 0) {
+      if (device->readBuffer[c] == 0) {
         zeroCheck++;
       }
     }
@@ -953,16 +1763,16 @@ uint8_t gba_check_rom_size(void) {
 // was. This can be a destructive process to the first byte, if anything goes
 // wrong the user could lose the first byte, so we only do this check when
 // writing a save back to the SRAM/Flash.
-uint8_t gba_test_sram_flash_write(void) {
+uint8_t gbx_gba_test_sram_flash_write(struct gbx_device *device) {
   printf("Testing for SRAM or Flash presence... ");
 
   // Save the 1 byte first to buffer
   uint8_t saveBuffer[65];
-  set_number(0x0000, SET_START_ADDRESS);
-  set_mode(GBA_READ_SRAM);
-  com_read_bytes(READ_BUFFER, 64);
-  memcpy(&saveBuffer, readBuffer, 64);
-  com_read_stop();
+  gbx_set_number(device, 0x0000, SET_START_ADDRESS);
+  gbx_set_mode(device, GBA_READ_SRAM);
+  gbx_com_read_bytes(device, READ_BUFFER, 64);
+  memcpy(&saveBuffer, device->readBuffer, 64);
+  gbx_com_read_stop(device);
 
   // Check to see if the first byte matches our test byte (1 in 255 chance), if
   // so, use the another test byte
@@ -972,43 +1782,44 @@ uint8_t gba_test_sram_flash_write(void) {
   }
 
   // Write 1 byte
-  set_number(0x0000, SET_START_ADDRESS);
+  gbx_set_number(device, 0x0000, SET_START_ADDRESS);
   uint8_t tempBuffer[3];
   tempBuffer[0] = GBA_WRITE_ONE_BYTE_SRAM; // Set write sram 1 byte mode
   tempBuffer[1] = testNumber;
-  RS232_SendBuf(cport_nr, tempBuffer, 2);
-  RS232_drain(cport_nr);
-  com_wait_for_ack();
+  RS232_SendBuf(device->cport_nr, tempBuffer, 2);
+  RS232_drain(device->cport_nr);
+  gbx_com_wait_for_ack(device);
 
   // Read back the 1 byte
   uint8_t readBackBuffer[65];
-  set_number(0x0000, SET_START_ADDRESS);
-  set_mode(GBA_READ_SRAM);
-  com_read_bytes(READ_BUFFER, 64);
-  memcpy(&readBackBuffer, readBuffer, 64);
-  com_read_stop();
+  gbx_set_number(device, 0x0000, SET_START_ADDRESS);
+  gbx_set_mode(device, GBA_READ_SRAM);
+  gbx_com_read_bytes(device, READ_BUFFER, 64);
+  memcpy(&readBackBuffer, device->readBuffer, 64);
+  gbx_com_read_stop(device);
 
   // Verify
   if (readBackBuffer[0] == testNumber) {
     printf("SRAM found\n");
 
     // Write the byte back to how it was
-    set_number(0x0000, SET_START_ADDRESS);
+    gbx_set_number(device, 0x0000, SET_START_ADDRESS);
     tempBuffer[0] = GBA_WRITE_ONE_BYTE_SRAM; // Set write sram 1 byte mode
     tempBuffer[1] = saveBuffer[0];
-    RS232_SendBuf(cport_nr, tempBuffer, 2);
-    RS232_drain(cport_nr);
-    com_wait_for_ack();
+    RS232_SendBuf(device->cport_nr, tempBuffer, 2);
+    RS232_drain(device->cport_nr);
+    gbx_com_wait_for_ack(device);
 
     return NO_FLASH;
   } else { // Flash likely present, test by reading the flash ID
     printf("Flash found\n");
 
-    set_mode(GBA_FLASH_READ_ID); // Read Flash ID and exit Flash ID mode
+    gbx_set_mode(device,
+                 GBA_FLASH_READ_ID); // Read Flash ID and exit Flash ID mode
 
     uint8_t idBuffer[2];
-    com_read_bytes(READ_BUFFER, 2);
-    memcpy(&idBuffer, readBuffer, 2);
+    gbx_com_read_bytes(device, READ_BUFFER, 2);
+    memcpy(&idBuffer, device->readBuffer, 2);
 
     // Some particular flash memories don't seem to exit the ID mode properly,
     // check if that's the case by reading the first byte from 0x00h to see if
@@ -1016,74 +1827,74 @@ uint8_t gba_test_sram_flash_write(void) {
     // slowly.
 
     // Read from 0x00
-    set_number(0x00, SET_START_ADDRESS);
-    set_mode(GBA_READ_SRAM);
-    com_read_bytes(READ_BUFFER, 64);
-    memcpy(&readBackBuffer, readBuffer, 64);
-    com_read_stop();
+    gbx_set_number(device, 0x00, SET_START_ADDRESS);
+    gbx_set_mode(device, GBA_READ_SRAM);
+    gbx_com_read_bytes(device, READ_BUFFER, 64);
+    memcpy(&readBackBuffer, device->readBuffer, 64);
+    gbx_com_read_stop(device);
 
     // Exit the ID mode a different way and slowly
     if (readBackBuffer[0] == 0x1F || readBackBuffer[0] == 0xBF ||
         readBackBuffer[0] == 0xC2 || readBackBuffer[0] == 0x32 ||
         readBackBuffer[0] == 0x62) {
 
-      RS232_cputs(cport_nr, "G"); // Set Gameboy mode
-      RS232_drain(cport_nr);
+      RS232_cputs(device->cport_nr, "G"); // Set Gameboy mode
+      RS232_drain(device->cport_nr);
       delay_ms(5);
 
       RS232_cputs(
-          cport_nr,
+          device->cport_nr,
           "M0"); // Disable CS/RD/WR/CS2-RST from going high after each command
-      RS232_drain(cport_nr);
+      RS232_drain(device->cport_nr);
       delay_ms(5);
 
-      RS232_cputs(cport_nr, "OC0xFF"); // Set output lines
-      RS232_SendByte(cport_nr, 0);
-      RS232_drain(cport_nr);
+      RS232_cputs(device->cport_nr, "OC0xFF"); // Set output lines
+      RS232_SendByte(device->cport_nr, 0);
+      RS232_drain(device->cport_nr);
       delay_ms(5);
 
-      RS232_cputs(cport_nr, "HC0xF0"); // Set byte
-      RS232_SendByte(cport_nr, 0);
-      RS232_drain(cport_nr);
+      RS232_cputs(device->cport_nr, "HC0xF0"); // Set byte
+      RS232_SendByte(device->cport_nr, 0);
+      RS232_drain(device->cport_nr);
       delay_ms(5);
 
       // V1.1 PCB
-      if (gbxcartPcbVersion == PCB_1_1) {
-        RS232_cputs(cport_nr, "LD0x40"); // WE low
-        RS232_SendByte(cport_nr, 0);
-        RS232_drain(cport_nr);
+      if (device->gbxcartPcbVersion == PCB_1_1) {
+        RS232_cputs(device->cport_nr, "LD0x40"); // WE low
+        RS232_SendByte(device->cport_nr, 0);
+        RS232_drain(device->cport_nr);
         delay_ms(5);
 
-        RS232_cputs(cport_nr, "LE0x04"); // CS2 low
-        RS232_SendByte(cport_nr, 0);
-        RS232_drain(cport_nr);
+        RS232_cputs(device->cport_nr, "LE0x04"); // CS2 low
+        RS232_SendByte(device->cport_nr, 0);
+        RS232_drain(device->cport_nr);
         delay_ms(5);
 
-        RS232_cputs(cport_nr, "HD0x40"); // WE high
-        RS232_SendByte(cport_nr, 0);
-        RS232_drain(cport_nr);
+        RS232_cputs(device->cport_nr, "HD0x40"); // WE high
+        RS232_SendByte(device->cport_nr, 0);
+        RS232_drain(device->cport_nr);
         delay_ms(5);
 
-        RS232_cputs(cport_nr, "HE0x04"); // CS2 high
-        RS232_SendByte(cport_nr, 0);
-        RS232_drain(cport_nr);
+        RS232_cputs(device->cport_nr, "HE0x04"); // CS2 high
+        RS232_SendByte(device->cport_nr, 0);
+        RS232_drain(device->cport_nr);
         delay_ms(5);
       } else {                           // V1.0 PCB
-        RS232_cputs(cport_nr, "LD0x90"); // WR, CS2 low
-        RS232_SendByte(cport_nr, 0);
-        RS232_drain(cport_nr);
+        RS232_cputs(device->cport_nr, "LD0x90"); // WR, CS2 low
+        RS232_SendByte(device->cport_nr, 0);
+        RS232_drain(device->cport_nr);
         delay_ms(5);
 
-        RS232_cputs(cport_nr, "HD0x90"); // WR, CS2 high
-        RS232_SendByte(cport_nr, 0);
-        RS232_drain(cport_nr);
+        RS232_cputs(device->cport_nr, "HD0x90"); // WR, CS2 high
+        RS232_SendByte(device->cport_nr, 0);
+        RS232_drain(device->cport_nr);
         delay_ms(5);
       }
 
       delay_ms(50);
-      RS232_cputs(cport_nr,
+      RS232_cputs(device->cport_nr,
                   "M1"); // Enable CS/RD/WR/CS2-RST goes high after each command
-      RS232_drain(cport_nr);
+      RS232_drain(device->cport_nr);
     }
 
     // Check if it's Atmel Flash
@@ -1104,35 +1915,35 @@ uint8_t gba_test_sram_flash_write(void) {
 // When a 256Kbit SRAM is read past 256Kbit, the address is loops around, there
 // are some times where the bytes don't all match up 100%, it's like 90% so be a
 // bit lenient. A cartridge that doesn't have an SRAM/Flash reads all 0x00's.
-uint8_t gba_check_sram_flash(void) {
+uint8_t gbx_gba_check_sram_flash(struct gbx_device *device) {
   uint16_t currAddr = 0x0000;
   uint16_t zeroTotal = 0;
-  hasFlashSave = NOT_CHECKED;
+  device->hasFlashSave = NOT_CHECKED;
 
   // Special check for certain games
-  if (strncmp(gameTitle, "CHUCHU ROCKE", 12) == 0 ||
-      strncmp(gameTitle, "CHUCHUROCKET", 12) == 0) { // Chu-Chu Rocket!
+  if (strncmp(device->gameTitle, "CHUCHU ROCKE", 12) == 0 ||
+      strncmp(device->gameTitle, "CHUCHUROCKET", 12) == 0) { // Chu-Chu Rocket!
     return SRAM_FLASH_512KBIT;
   }
 
   // Pre-read SRAM/Flash (if the cart has an EEPROM, sometimes D0-D7 come back
   // with random data in the first 64 bytes read)
-  set_number(currAddr, SET_START_ADDRESS);
-  set_mode(GBA_READ_SRAM);
-  com_read_bytes(READ_BUFFER, 64);
-  com_read_stop();
+  gbx_set_number(device, currAddr, SET_START_ADDRESS);
+  gbx_set_mode(device, GBA_READ_SRAM);
+  gbx_com_read_bytes(device, READ_BUFFER, 64);
+  gbx_com_read_stop(device);
 
   // Test if SRAM is present, read 32 sections of RAM (64 bytes each)
   for (uint8_t x = 0; x < 32; x++) {
-    set_number(currAddr, SET_START_ADDRESS);
-    set_mode(GBA_READ_SRAM);
+    gbx_set_number(device, currAddr, SET_START_ADDRESS);
+    gbx_set_mode(device, GBA_READ_SRAM);
 
-    com_read_bytes(READ_BUFFER, 64);
-    com_read_stop();
+    gbx_com_read_bytes(device, READ_BUFFER, 64);
+    gbx_com_read_stop(device);
 
     // Check for 0x00 byte
     for (uint8_t c = 0; c < 64; c++) {
-      if (readBuffer[c] == 0) {
+      if (device->readBuffer[c] == 0) {
         zeroTotal++;
       }
     }
@@ -1149,29 +1960,29 @@ uint8_t gba_check_sram_flash(void) {
                            // more thorough check
     // Set start and end address
     currAddr = 0x0000;
-    endAddr = 32768;
-    set_number(currAddr, SET_START_ADDRESS);
-    set_mode(GBA_READ_SRAM);
+    device->endAddr = 32768;
+    gbx_set_number(device, currAddr, SET_START_ADDRESS);
+    gbx_set_mode(device, GBA_READ_SRAM);
     zeroTotal = 0;
 
     // Read data
-    while (currAddr < endAddr) {
-      com_read_bytes(READ_BUFFER, 64);
+    while (currAddr < device->endAddr) {
+      gbx_com_read_bytes(device, READ_BUFFER, 64);
       currAddr += 64;
 
       // Check for 0x00 byte
       for (uint8_t c = 0; c < 64; c++) {
-        if (readBuffer[c] == 0) {
+        if (device->readBuffer[c] == 0) {
           zeroTotal++;
         }
       }
 
       // Request 64 bytes more
-      if (currAddr < endAddr) {
-        com_read_cont();
+      if (currAddr < device->endAddr) {
+        gbx_com_read_cont(device);
       }
     }
-    com_read_stop();
+    gbx_com_read_stop(device);
 
     if (zeroTotal == 32768) {
       return 0;
@@ -1183,17 +1994,17 @@ uint8_t gba_check_sram_flash(void) {
   char firstBuffer[65];
   char secondBuffer[65];
   for (uint8_t x = 0; x < 32; x++) {
-    set_number((uint32_t)(x * 0x400), SET_START_ADDRESS);
-    set_mode(GBA_READ_SRAM);
-    com_read_bytes(READ_BUFFER, 64);
-    memcpy(&firstBuffer, readBuffer, 64);
-    com_read_stop();
-
-    set_number((uint32_t)(x * 0x400) + 0x8000, SET_START_ADDRESS);
-    set_mode(GBA_READ_SRAM);
-    com_read_bytes(READ_BUFFER, 64);
-    memcpy(&secondBuffer, readBuffer, 64);
-    com_read_stop();
+    gbx_set_number(device, (uint32_t)(x * 0x400), SET_START_ADDRESS);
+    gbx_set_mode(device, GBA_READ_SRAM);
+    gbx_com_read_bytes(device, READ_BUFFER, 64);
+    memcpy(&firstBuffer, device->readBuffer, 64);
+    gbx_com_read_stop(device);
+
+    gbx_set_number(device, (uint32_t)(x * 0x400) + 0x8000, SET_START_ADDRESS);
+    gbx_set_mode(device, GBA_READ_SRAM);
+    gbx_com_read_bytes(device, READ_BUFFER, 64);
+    memcpy(&secondBuffer, device->readBuffer, 64);
+    gbx_com_read_stop(device);
 
     // Compare
     for (uint8_t x = 0; x < 64; x++) {
@@ -1213,8 +2024,8 @@ uint8_t gba_check_sram_flash(void) {
 
   // Check if it's SRAM or Flash at this stage, maximum for SRAM is 512Kbit
   printf("\n");
-  hasFlashSave = gba_test_sram_flash_write();
-  if (hasFlashSave == NO_FLASH) {
+  device->hasFlashSave = gbx_gba_test_sram_flash_write(device);
+  if (device->hasFlashSave == NO_FLASH) {
     return SRAM_FLASH_512KBIT;
   }
 
@@ -1226,22 +2037,22 @@ uint8_t gba_check_sram_flash(void) {
     printf("Testing for 512Kbit or 1Mbit Flash... ");
     for (uint8_t x = 0; x < 32; x++) {
       // Read bank 0
-      set_number((uint32_t)(x * 0x400), SET_START_ADDRESS);
-      set_mode(GBA_READ_SRAM);
-      com_read_bytes(READ_BUFFER, 64);
-      memcpy(&firstBuffer, readBuffer, 64);
-      com_read_stop();
+      gbx_set_number(device, (uint32_t)(x * 0x400), SET_START_ADDRESS);
+      gbx_set_mode(device, GBA_READ_SRAM);
+      gbx_com_read_bytes(device, READ_BUFFER, 64);
+      memcpy(&firstBuffer, device->readBuffer, 64);
+      gbx_com_read_stop(device);
 
       // Read bank 1
-      set_number(1, GBA_FLASH_SET_BANK); // Set bank 1
+      gbx_set_number(device, 1, GBA_FLASH_SET_BANK); // Set bank 1
 
-      set_number((uint32_t)(x * 0x400), SET_START_ADDRESS);
-      set_mode(GBA_READ_SRAM);
-      com_read_bytes(READ_BUFFER, 64);
-      memcpy(&secondBuffer, readBuffer, 64);
-      com_read_stop();
+      gbx_set_number(device, (uint32_t)(x * 0x400), SET_START_ADDRESS);
+      gbx_set_mode(device, GBA_READ_SRAM);
+      gbx_com_read_bytes(device, READ_BUFFER, 64);
+      memcpy(&secondBuffer, device->readBuffer, 64);
+      gbx_com_read_stop(device);
 
-      set_number(0, GBA_FLASH_SET_BANK); // Set back to bank 0
+      gbx_set_number(device, 0, GBA_FLASH_SET_BANK); // Set back to bank 0
 
       // Compare
       for (uint8_t x = 0; x < 64; x++) {
@@ -1263,35 +2074,52 @@ uint8_t gba_check_sram_flash(void) {
 }
 
 // Erase 4K sector on flash on sector address
-void flash_4k_sector_erase(uint8_t sector) {
-  set_number(sector, GBA_FLASH_4K_SECTOR_ERASE);
+void gbx_flash_4k_sector_erase(struct gbx_device *device, uint8_t sector) {
+  gbx_set_number(device, sector, GBA_FLASH_4K_SECTOR_ERASE);
+}
+
+// Read part of the SRAM/Flash save (in the flash bank already selected) into
+// the buffer given, length is a multiple of 64
+void gbx_gba_read_save(struct gbx_device *device, uint32_t address,
+                       uint8_t *data, uint32_t length) {
+  gbx_set_number(device, address, SET_START_ADDRESS);
+  gbx_set_mode(device, GBA_READ_SRAM);
+
+  for (uint32_t offset = 0; offset < length; offset += 64) {
+    gbx_com_read_block_checked(device, address + offset, GBA_READ_SRAM, 64);
+    memcpy(&data[offset], device->readBuffer, 64);
+    if (offset + 64 < length) {
+      gbx_com_read_cont(device);
+    }
+  }
+  gbx_com_read_stop(device);
 }
 
 // Check if an EEPROM is present and test the size. A 4Kbit EEPROM when accessed
 // like a 64Kbit EEPROM sends the first 8 bytes over and over again. A cartridge
 // that doesn't have an EEPROM reads all 0x00 or 0xFF.
-uint8_t gba_check_eeprom(void) {
-  set_number(EEPROM_64KBIT, GBA_SET_EEPROM_SIZE); // Set 64Kbit size
+uint8_t gbx_gba_check_eeprom(struct gbx_device *device) {
+  gbx_set_number(device, EEPROM_64KBIT, GBA_SET_EEPROM_SIZE); // Set 64Kbit size
 
   // Set start and end address
   uint16_t currAddr = 0x000;
   uint16_t endAddr = 0x200;
-  set_number(currAddr, SET_START_ADDRESS);
-  set_mode(GBA_READ_EEPROM);
+  gbx_set_number(device, currAddr, SET_START_ADDRESS);
+  gbx_set_mode(device, GBA_READ_EEPROM);
 
   // Read EEPROM
   uint16_t repeatedCount = 0;
   uint16_t zeroTotal = 0;
   uint8_t firstEightCheck[8];
   while (currAddr < endAddr) {
-    com_read_bytes(READ_BUFFER, 8);
+    gbx_com_read_bytes(device, READ_BUFFER, 8);
 
     if (currAddr ==
         0) { // Copy the first 8 bytes to check other readings against them
-      memcpy(&firstEightCheck, readBuffer, 8);
+      memcpy(&firstEightCheck, device->readBuffer, 8);
     } else { // Check the 8 bytes for repeats
       for (uint8_t x = 0; x < 8; x++) {
-        if (firstEightCheck[x] == readBuffer[x]) {
+        if (firstEightCheck[x] == device->readBuffer[x]) {
           repeatedCount++;
         }
       }
@@ -1299,7 +2127,7 @@ uint8_t gba_check_eeprom(void) {
 
     // Check for 0x00 or 0xFF bytes
     for (uint8_t x = 0; x < 8; x++) {
-      if (readBuffer[x] == 0 || readBuffer[x] == 0xFF) {
+      if (device->readBuffer[x] == 0 || device->readBuffer[x] == 0xFF) {
         zeroTotal++;
       }
     }
@@ -1308,10 +2136,10 @@ uint8_t gba_check_eeprom(void) {
 
     // Request 8 bytes more
     if (currAddr < endAddr) {
-      com_read_cont();
+      gbx_com_read_cont(device);
     }
   }
-  com_read_stop();
+  gbx_com_read_stop(device);
 
   if (zeroTotal >= 512) { // Blank, likely no EEPROM
     return EEPROM_NONE;
@@ -1326,36 +2154,36 @@ uint8_t gba_check_eeprom(void) {
     // Read first 512 bytes
     currAddr = 0x000;
     endAddr = 0x200;
-    set_number(currAddr, SET_START_ADDRESS);
-    set_mode(GBA_READ_EEPROM);
+    gbx_set_number(device, currAddr, SET_START_ADDRESS);
+    gbx_set_mode(device, GBA_READ_EEPROM);
 
     uint8_t eepromFirstBuffer[0x200];
     while (currAddr < endAddr) {
-      com_read_bytes(READ_BUFFER, 8);
-      memcpy(&eepromFirstBuffer[currAddr], readBuffer, 8);
+      gbx_com_read_bytes(device, READ_BUFFER, 8);
+      memcpy(&eepromFirstBuffer[currAddr], device->readBuffer, 8);
 
       currAddr += 8;
 
       // Request 8 bytes more
       if (currAddr < endAddr) {
-        com_read_cont();
+        gbx_com_read_cont(device);
       }
     }
 
     // Read second 512 bytes
     endAddr = 0x400;
-    com_read_cont();
+    gbx_com_read_cont(device);
 
     uint8_t eepromSecondBuffer[0x200];
     while (currAddr < endAddr) {
-      com_read_bytes(READ_BUFFER, 8);
-      memcpy(&eepromSecondBuffer[currAddr - 0x200], readBuffer, 8);
+      gbx_com_read_bytes(device, READ_BUFFER, 8);
+      memcpy(&eepromSecondBuffer[currAddr - 0x200], device->readBuffer, 8);
 
       currAddr += 8;
 
       // Request 8 bytes more
       if (currAddr < endAddr) {
-        com_read_cont();
+        gbx_com_read_cont(device);
       }
     }
 
@@ -1366,7 +2194,7 @@ uint8_t gba_check_eeprom(void) {
         repeatedCount++;
       }
     }
-    com_read_stop();
+    gbx_com_read_stop(device);
 
     if (repeatedCount >= 512) {
       return EEPROM_4KBIT;
@@ -1376,28 +2204,150 @@ uint8_t gba_check_eeprom(void) {
   }
 }
 
+// Read the whole EEPROM (eepromEndAddress bytes, using the 4Kbit or 64Kbit
+// addressing gba_check_eeprom found) into the buffer given, with progress.
+// The "continue" for the next blocks is sent while the current ones are still
+// coming in so the USB round trip isn't paid for every 8 bytes, but never more
+// than EEPROM_READ_AHEAD ahead as the ATmega only buffers a couple of bytes
+// while it's busy reading the EEPROM.
+void gbx_gba_read_eeprom(struct gbx_device *device, uint8_t *data) {
+  gbx_set_number(device, device->eepromSize, GBA_SET_EEPROM_SIZE);
+  gbx_set_number(device, 0, SET_START_ADDRESS);
+  gbx_set_mode(device, GBA_READ_EEPROM); // Sends the first block
+
+  uint16_t readAhead = EEPROM_READ_AHEAD;
+  if (device->gbxcartPcbVersion == GBXMAS) {
+    readAhead = 0; // Needs a pause between each command
+  }
+
+  uint16_t totalBlocks = device->eepromEndAddress / 8;
+  uint16_t requestedBlocks = 1;
+  uint16_t receivedBlocks = 0;
+  while (receivedBlocks < totalBlocks) {
+    uint16_t queueBlocks = 0;
+    while (readAhead > 0 && requestedBlocks < totalBlocks &&
+           requestedBlocks - receivedBlocks <= readAhead) {
+      queueBlocks++;
+      requestedBlocks++;
+    }
+    if (queueBlocks > 0) {
+      char contString[EEPROM_READ_AHEAD + 2];
+      memset(contString, '1', queueBlocks);
+      contString[queueBlocks] = 0;
+      RS232_cputs(device->cport_nr, contString);
+      RS232_drain(device->cport_nr);
+    }
+
+    // The blocks asked for can arrive together, only take what's owed
+    uint16_t waitingBlocks = requestedBlocks - receivedBlocks;
+    if (gbx_com_read_bytes(device, NULL, waitingBlocks * 8) <
+        waitingBlocks * 8) {
+      printf("\n\nEEPROM read has timed out. Please unplug GBxCart RW, re-seat "
+             "the cartridge and try again.\n");
+      gbx_fatal(device);
+    }
+    memcpy(&data[receivedBlocks * 8], device->readBuffer, waitingBlocks * 8);
+    for (uint16_t x = 0; x < waitingBlocks; x++) {
+      receivedBlocks++;
+      gbx_print_progress_percent(device, receivedBlocks * 8,
+                                 device->eepromEndAddress / 64);
+      gbx_led_progress_percent(device, receivedBlocks * 8,
+                               device->eepromEndAddress / 28);
+    }
+
+    // No pipelining on GBXMAS, ask for the next block as before
+    if (readAhead == 0 && receivedBlocks < totalBlocks) {
+      gbx_com_read_cont(device);
+      requestedBlocks++;
+    }
+  }
+  gbx_com_read_stop(device);
+}
+
+// Write a save to the EEPROM, only sending the 8 byte blocks that differ from
+// what the EEPROM holds now (read first, with progress), then read those
+// blocks back. Returns the number of written blocks that didn't read back right.
+uint32_t gbx_gba_write_eeprom_delta(struct gbx_device *device,
+                                    const uint8_t *data, uint32_t dataLength,
+                                    uint32_t *changedBlocks) {
+  if (dataLength > device->eepromEndAddress) {
+    dataLength = device->eepromEndAddress;
+  }
+  uint8_t eepromData[0x2000];
+  gbx_gba_read_eeprom(device, eepromData);
+
+  uint8_t changed[0x2000 / 8];
+  *changedBlocks = 0;
+  for (uint32_t offset = 0; offset < device->eepromEndAddress; offset += 8) {
+    changed[offset / 8] = 0;
+    if (offset + 8 <= dataLength &&
+        memcmp(&eepromData[offset], &data[offset], 8) != 0) {
+      changed[offset / 8] = 1;
+      (*changedBlocks)++;
+    }
+  }
+  if (*changedBlocks == 0) {
+    return 0;
+  }
+
+  // The EEPROM is addressed in 8 byte blocks, consecutive blocks go out
+  // without setting the address again
+  uint32_t nextOffset = 0xFFFFFFFF;
+  for (uint32_t offset = 0; offset < device->eepromEndAddress; offset += 8) {
+    if (changed[offset / 8] == 0) {
+      continue;
+    }
+    if (offset != nextOffset) {
+      gbx_set_number(device, offset / 8, SET_START_ADDRESS);
+    }
+    memcpy(device->writeBuffer, &data[offset], 8);
+    gbx_com_write_bytes_from_file(device, GBA_WRITE_EEPROM, NULL, 8);
+
+    // Wait for ATmega to process write (~320us) and for EEPROM to write data
+    // (6ms)
+    gbx_com_wait_for_ack(device);
+    nextOffset = offset + 8;
+  }
+
+  // Read the written blocks back
+  uint32_t badBlocks = 0;
+  for (uint32_t offset = 0; offset < device->eepromEndAddress; offset += 8) {
+    if (changed[offset / 8] == 0) {
+      continue;
+    }
+    gbx_set_number(device, offset / 8, SET_START_ADDRESS);
+    gbx_set_mode(device, GBA_READ_EEPROM);
+    gbx_com_read_bytes(device, NULL, 8);
+    gbx_com_read_stop(device);
+    if (memcmp(device->readBuffer, &data[offset], 8) != 0) {
+      badBlocks++;
+    }
+  }
+  return badBlocks;
+}
+
 // Read GBA game title (used for reading title when ROM mapping)
-void gba_read_gametitle(void) {
-  currAddr = 0x0000;
-  endAddr = 0x00BF;
-  set_number(currAddr, SET_START_ADDRESS);
-  set_mode(GBA_READ_ROM);
+void gbx_gba_read_gametitle(struct gbx_device *device) {
+  device->currAddr = 0x0000;
+  device->endAddr = 0x00BF;
+  gbx_set_number(device, device->currAddr, SET_START_ADDRESS);
+  gbx_set_mode(device, GBA_READ_ROM);
 
   uint8_t startRomBuffer[385];
-  while (currAddr < endAddr) {
-    com_read_bytes(READ_BUFFER, 64);
-    memcpy(&startRomBuffer[currAddr], readBuffer, 64);
-    currAddr += 64;
+  while (device->currAddr < device->endAddr) {
+    gbx_com_read_bytes(device, READ_BUFFER, 64);
+    memcpy(&startRomBuffer[device->currAddr], device->readBuffer, 64);
+    device->currAddr += 64;
 
-    if (currAddr < endAddr) {
-      com_read_cont();
+    if (device->currAddr < device->endAddr) {
+      gbx_com_read_cont(device);
     }
   }
-  com_read_stop();
+  gbx_com_read_stop(device);
 
   // Blank out game title
   for (uint8_t b = 0; b < 16; b++) {
-    gameTitle[b] = 0;
+    device->gameTitle[b] = 0;
   }
   // Read cartridge title and check for non-printable text
   for (uint16_t titleAddress = 0xA0; titleAddress <= 0xAB; titleAddress++) {
@@ -1408,9 +2358,9 @@ void gba_read_gametitle(void) {
         (headerChar == 0x2E) ||                       // .
         (headerChar == 0x5F) ||                       // _
         (headerChar == 0x20)) {                       // Space
-      gameTitle[(titleAddress - 0xA0)] = headerChar;
+      device->gameTitle[(titleAddress - 0xA0)] = headerChar;
     } else {
-      gameTitle[(titleAddress - 0xA0)] = '\0';
+      device->gameTitle[(titleAddress - 0xA0)] = '\0';
       break;
     }
   }
@@ -1418,27 +2368,27 @@ void gba_read_gametitle(void) {
 
 // Read the first 192 bytes of ROM, read the title, check and test for ROM,
 // SRAM, EEPROM and Flash
-void read_gba_header(void) {
-  currAddr = 0x0000;
-  endAddr = 0x00BF;
-  set_number(currAddr, SET_START_ADDRESS);
-  set_mode(GBA_READ_ROM);
+void gbx_read_gba_header(struct gbx_device *device) {
+  device->currAddr = 0x0000;
+  device->endAddr = 0x00BF;
+  gbx_set_number(device, device->currAddr, SET_START_ADDRESS);
+  gbx_set_mode(device, GBA_READ_ROM);
 
   uint8_t startRomBuffer[385];
-  while (currAddr < endAddr) {
-    com_read_bytes(READ_BUFFER, 64);
-    memcpy(&startRomBuffer[currAddr], readBuffer, 64);
-    currAddr += 64;
+  while (device->currAddr < device->endAddr) {
+    gbx_com_read_bytes(device, READ_BUFFER, 64);
+    memcpy(&startRomBuffer[device->currAddr], device->readBuffer, 64);
+    device->currAddr += 64;
 
-    if (currAddr < endAddr) {
-      com_read_cont();
+    if (device->currAddr < device->endAddr) {
+      gbx_com_read_cont(device);
     }
   }
-  com_read_stop();
+  gbx_com_read_stop(device);
 
   // Blank out game title
   for (uint8_t b = 0; b < 16; b++) {
-    gameTitle[b] = 0;
+    device->gameTitle[b] = 0;
   }
   // Read cartridge title and check for non-printable text
   for (uint16_t titleAddress = 0xA0; titleAddress <= 0xAB; titleAddress++) {
@@ -1449,13 +2399,13 @@ void read_gba_header(void) {
         (headerChar == 0x2E) ||                       // .
         (headerChar == 0x5F) ||                       // _
         (headerChar == 0x20)) {                       // Space
-      gameTitle[(titleAddress - 0xA0)] = headerChar;
+      device->gameTitle[(titleAddress - 0xA0)] = headerChar;
     } else {
-      gameTitle[(titleAddress - 0xA0)] = '\0';
+      device->gameTitle[(titleAddress - 0xA0)] = '\0';
       break;
     }
   }
-  printf("Game title: %s\n", gameTitle);
+  printf("Game title: %s\n", device->gameTitle);
 
   // Nintendo Logo Check
   uint8_t logoCheck = 1;
@@ -1472,64 +2422,95 @@ void read_gba_header(void) {
     printf("Failed\n");
   }
 
-  // ROM size
-  printf("Calculating ROM size");
-  romSize = gba_check_rom_size();
+  // A cart we've probed before can skip the ROM, EEPROM and SRAM/Flash checks
+  uint32_t headerKey = startRomBuffer[0xBD];
+  uint32_t fingerprint = 0;
+  uint8_t headerCached = 0;
+
+  char cacheEntry[CART_CACHE_LINE_LENGTH];
+  if (device->cartCacheEnabled == 1) {
+    fingerprint =
+        crc32_update(gbx_cart_fingerprint(device, GBA_MODE), startRomBuffer,
+                     0xC0);
+    if (gbx_cart_cache_lookup(device, GBA_MODE, headerKey, fingerprint,
+                              cacheEntry, sizeof(cacheEntry)) == 1) {
+      int cachedRomSize = 0;
+      if (sscanf(cacheEntry, "%d,%d,%d,%d", &cachedRomSize, &device->eepromSize,
+                 &device->ramSize, &device->hasFlashSave) == 4) {
+        device->romSize = cachedRomSize;
+        headerCached = 1;
+        printf("Header: cached");
+      }
+    }
+  }
 
-  // EEPROM check
-  printf("\nChecking for EEPROM");
-  eepromSize = gba_check_eeprom();
+  if (headerCached == 0) {
+    // ROM size
+    printf("Calculating ROM size");
+    device->romSize = gbx_gba_check_rom_size(device);
 
-  // SRAM/Flash check/size, if no EEPROM present
-  if (eepromSize == 0) {
-    printf("\nCalculating SRAM/Flash size");
-    ramSize = gba_check_sram_flash();
-  } else {
-    ramSize = 0;
+    // EEPROM check
+    printf("\nChecking for EEPROM");
+    device->eepromSize = gbx_gba_check_eeprom(device);
+
+    // SRAM/Flash check/size, if no EEPROM present
+    if (device->eepromSize == 0) {
+      printf("\nCalculating SRAM/Flash size");
+      device->ramSize = gbx_gba_check_sram_flash(device);
+    } else {
+      device->ramSize = 0;
+    }
+
+    if (device->cartCacheEnabled == 1) {
+      sprintf(cacheEntry, "%d,%d,%d,%d", device->romSize, device->eepromSize,
+              device->ramSize, device->hasFlashSave);
+      gbx_cart_cache_store(device, GBA_MODE, headerKey, fingerprint,
+                           cacheEntry);
+    }
   }
 
   // If file exists, we know the ram has been erased before, so read memory info
   // from this file
-  load_cart_ram_info();
+  gbx_load_cart_ram_info(device);
 
   // Print out
-  printf("\nROM size: %iMByte\n", romSize);
-  romEndAddr = ((1024 * 1024) * romSize);
+  printf("\nROM size: %iMByte\n", device->romSize);
+  device->romEndAddr = ((1024 * 1024) * device->romSize);
 
-  if (hasFlashSave >= 2) {
+  if (device->hasFlashSave >= 2) {
     printf("Flash size: ");
-  } else if (hasFlashSave == NO_FLASH) {
+  } else if (device->hasFlashSave == NO_FLASH) {
     printf("SRAM size: ");
   } else {
     printf("SRAM/Flash size: ");
   }
 
-  if (ramSize == 0) {
-    ramEndAddress = 0;
+  if (device->ramSize == 0) {
+    device->ramEndAddress = 0;
     printf("None\n");
-  } else if (ramSize == 1) {
-    ramEndAddress = 0x8000;
-    ramBanks = 1;
+  } else if (device->ramSize == 1) {
+    device->ramEndAddress = 0x8000;
+    device->ramBanks = 1;
     printf("256Kbit\n");
-  } else if (ramSize == 2) {
-    ramEndAddress = 0x10000;
-    ramBanks = 1;
+  } else if (device->ramSize == 2) {
+    device->ramEndAddress = 0x10000;
+    device->ramBanks = 1;
     printf("512Kbit\n");
-  } else if (ramSize == 3) {
-    ramEndAddress = 0x10000;
-    ramBanks = 2;
+  } else if (device->ramSize == 3) {
+    device->ramEndAddress = 0x10000;
+    device->ramBanks = 2;
     printf("1Mbit\n");
   }
 
   printf("EEPROM: ");
-  if (eepromSize == EEPROM_NONE) {
-    eepromEndAddress = 0;
+  if (device->eepromSize == EEPROM_NONE) {
+    device->eepromEndAddress = 0;
     printf("None\n");
-  } else if (eepromSize == EEPROM_4KBIT) {
-    eepromEndAddress = 0x200;
+  } else if (device->eepromSize == EEPROM_4KBIT) {
+    device->eepromEndAddress = 0x200;
     printf("4Kbit\n");
-  } else if (eepromSize == EEPROM_64KBIT) {
-    eepromEndAddress = 0x2000;
+  } else if (device->eepromSize == EEPROM_64KBIT) {
+    device->eepromEndAddress = 0x2000;
     printf("64Kbit\n");
   }
 }
@@ -1561,7 +2542,7 @@ void write_flash_config(int number) {
 }
 
 // Read the config-flash.ini file for the flash cart type
-void read_config_flash(void) {
+void gbx_read_config_flash(struct gbx_device *device) {
   char configFilePath[253];
 
 #if defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__)
@@ -1573,7 +2554,7 @@ void read_config_flash(void) {
 
   FILE *configfile = fopen(configFilePath, "rt");
   if (configfile != NULL) {
-    if (fscanf(configfile, "%d", &flashCartType) != 1) {
+    if (fscanf(configfile, "%d", &device->flashCartType) != 1) {
       fprintf(stderr, "Flash Config file is corrupt\n");
     }
     fclose(configfile);
@@ -1584,34 +2565,33 @@ void read_config_flash(void) {
 
 // Wait for first byte of chosen address to be 0xFF, that's when we know the
 // sector has been erased
-void wait_for_flash_sector_ff(uint16_t address) {
+void gbx_wait_for_flash_sector_ff(struct gbx_device *device, uint16_t address) {
   uint16_t timeout = 0;
-  readBuffer[0] = 0;
+  device->readBuffer[0] = 0;
 
-  while (readBuffer[0] != 0xFF) {
-    set_number(address, SET_START_ADDRESS);
-    set_mode(READ_ROM_RAM);
+  while (device->readBuffer[0] != 0xFF) {
+    gbx_set_number(device, address, SET_START_ADDRESS);
+    gbx_set_mode(device, READ_ROM_RAM);
 
-    uint8_t comReadBytes = com_read_bytes(READ_BUFFER, 64);
-    com_read_stop(); // End read
+    uint8_t comReadBytes = gbx_com_read_bytes(device, READ_BUFFER, 64);
+    gbx_com_read_stop(device); // End read
 
     if (comReadBytes != 64) {
       fflush(stdin);
       delay_ms(500);
 
       // Flush buffer
-      RS232_PollComport(cport_nr, readBuffer, 64);
+      RS232_PollComport(device->cport_nr, device->readBuffer, 64);
     }
 
-    if (readBuffer[0] != 0xFF) {
+    if (device->readBuffer[0] != 0xFF) {
       delay_ms(20);
 
       timeout++;
       if (timeout >= 200) {
         printf("\n\nWaiting for sector erase has timed out. Please unplug "
                "GBxCart RW, re-seat the cartridge and try again.\n");
-        read_one_letter();
-        exit(1);
+        gbx_fatal(device);
       }
     }
   }
@@ -1619,48 +2599,49 @@ void wait_for_flash_sector_ff(uint16_t address) {
 
 // Wait for 2 bytes of chosen address to be 0xFF, that's when we know the sector
 // has been erased
-void wait_for_gba_flash_sector_ff(uint32_t address, uint8_t byteOne,
-                                  uint8_t byteTwo) {
+void gbx_wait_for_gba_flash_sector_ff(struct gbx_device *device,
+                                      uint32_t address, uint8_t byteOne,
+                                      uint8_t byteTwo) {
   uint16_t timeout = 0;
 
   // Wait for first 2 bytes to be 0xFF
-  readBuffer[0] = 0;
-  readBuffer[1] = 0;
-  while (readBuffer[0] != byteOne && readBuffer[0] != byteTwo) {
-    set_number(address / 2, SET_START_ADDRESS);
+  device->readBuffer[0] = 0;
+  device->readBuffer[1] = 0;
+  while (device->readBuffer[0] != byteOne && device->readBuffer[0] != byteTwo) {
+    gbx_set_number(device, address / 2, SET_START_ADDRESS);
     delay_ms(5);
-    set_mode(GBA_READ_ROM);
+    gbx_set_mode(device, GBA_READ_ROM);
     delay_ms(5);
 
-    com_read_bytes(READ_BUFFER, 64);
-    com_read_stop(); // End read
+    gbx_com_read_bytes(device, READ_BUFFER, 64);
+    gbx_com_read_stop(device); // End read
     delay_ms(50);
 
     timeout++;
     if (timeout >= 200) {
       printf("\n\nWaiting for sector erase has timed out. Please unplug "
              "GBxCart RW, re-seat the cartridge and try again.\n");
-      read_one_letter();
-      exit(1);
+      gbx_fatal(device);
     }
   }
 }
 
 // Wait for first byte of Flash to be 0xFF, that's when we know the sector has
 // been erased
-void wait_for_gba_flash_erase_ff(uint32_t currAddr) {
+void gbx_wait_for_gba_flash_erase_ff(struct gbx_device *device,
+                                     uint32_t currAddr) {
   uint16_t timeout = 0;
-  readBuffer[0] = 0;
-  readBuffer[1] = 0;
+  device->readBuffer[0] = 0;
+  device->readBuffer[1] = 0;
 
-  while (readBuffer[0] != 0xFF && readBuffer[1] != 0xFF) {
-    set_number(currAddr / 2, SET_START_ADDRESS);
+  while (device->readBuffer[0] != 0xFF && device->readBuffer[1] != 0xFF) {
+    gbx_set_number(device, currAddr / 2, SET_START_ADDRESS);
     delay_ms(5);
-    set_mode(GBA_READ_ROM);
+    gbx_set_mode(device, GBA_READ_ROM);
     delay_ms(5);
 
-    com_read_bytes(READ_BUFFER, 64);
-    com_read_stop(); // End read
+    gbx_com_read_bytes(device, READ_BUFFER, 64);
+    gbx_com_read_stop(device); // End read
 
     printf(".");
     delay_ms(2000);
@@ -1669,31 +2650,31 @@ void wait_for_gba_flash_erase_ff(uint32_t currAddr) {
     if (timeout >= 200) {
       printf("\n\nWaiting for sector erase has timed out. Please unplug "
              "GBxCart RW, re-seat the cartridge and try again.\n");
-      read_one_letter();
-      exit(1);
+      gbx_fatal(device);
     }
   }
 }
 
 // Wait for first byte of Flash to be 0xFF, that's when we know the sector has
 // been erased
-void wait_for_flash_chip_erase_ff(uint8_t printProgress) {
+void gbx_wait_for_flash_chip_erase_ff(struct gbx_device *device,
+                                      uint8_t printProgress) {
   uint16_t timeout = 0;
-  readBuffer[0] = 0;
+  device->readBuffer[0] = 0;
 
-  while (readBuffer[0] != 0xFF) {
-    set_number(currAddr, SET_START_ADDRESS);
-    set_mode(READ_ROM_RAM);
+  while (device->readBuffer[0] != 0xFF) {
+    gbx_set_number(device, device->currAddr, SET_START_ADDRESS);
+    gbx_set_mode(device, READ_ROM_RAM);
 
-    uint8_t comReadBytes = com_read_bytes(READ_BUFFER, 64);
-    com_read_stop(); // End read
+    uint8_t comReadBytes = gbx_com_read_bytes(device, READ_BUFFER, 64);
+    gbx_com_read_stop(device); // End read
 
     if (comReadBytes != 64) {
       fflush(stdin);
       delay_ms(500);
 
       // Flush buffer
-      RS232_PollComport(cport_nr, readBuffer, 64);
+      RS232_PollComport(device->cport_nr, device->readBuffer, 64);
     }
 
     if (printProgress == 1) {
@@ -1702,23 +2683,21 @@ void wait_for_flash_chip_erase_ff(uint8_t printProgress) {
       fflush(stdout);
     }
 
-    if (readBuffer[0] != 0xFF) {
+    if (device->readBuffer[0] != 0xFF) {
       delay_ms(500);
 
       timeout++;
-      if (flashCartType == 16 || flashCartType == 17) {
+      if (device->flashCartType == 16 || device->flashCartType == 17) {
         if (timeout >= 600) {
           printf("\n\n Waiting for chip erase has timed out. Please unplug "
                  "GBxCart RW, re-seat the cartridge and try again.\n");
-          read_one_letter();
-          exit(1);
+          gbx_fatal(device);
         }
       } else {
         if (timeout >= 240) {
           printf("\n\n Waiting for chip erase has timed out. Please unplug "
                  "GBxCart RW, re-seat the cartridge and try again.\n");
-          read_one_letter();
-          exit(1);
+          gbx_fatal(device);
         }
       }
     }
@@ -1726,91 +2705,92 @@ void wait_for_flash_chip_erase_ff(uint8_t printProgress) {
 }
 
 // Select which pin need to pulse as WE (Audio or WR)
-void gb_flash_pin_setup(char pin) {
-  set_mode(GB_FLASH_WE_PIN);
-  set_mode(pin);
+void gbx_gb_flash_pin_setup(struct gbx_device *device, char pin) {
+  gbx_set_mode(device, GB_FLASH_WE_PIN);
+  gbx_set_mode(device, pin);
 }
 
 // Select which flash program method to use
-void gb_flash_program_setup(uint8_t method) {
-  set_mode(GB_FLASH_PROGRAM_METHOD);
+void gbx_gb_flash_program_setup(struct gbx_device *device, uint8_t method) {
+  gbx_set_mode(device, GB_FLASH_PROGRAM_METHOD);
 
   if (method == GB_FLASH_PROGRAM_555) {
-    send_hex_wait_ack(0x555);
-    send_hex_wait_ack(0xAA);
-    send_hex_wait_ack(0x2AA);
-    send_hex_wait_ack(0x55);
-    send_hex_wait_ack(0x555);
-    send_hex_wait_ack(0xA0);
+    send_hex_wait_ack(device, 0x555);
+    send_hex_wait_ack(device, 0xAA);
+    send_hex_wait_ack(device, 0x2AA);
+    send_hex_wait_ack(device, 0x55);
+    send_hex_wait_ack(device, 0x555);
+    send_hex_wait_ack(device, 0xA0);
   } else if (method == GB_FLASH_PROGRAM_AAA) {
-    send_hex_wait_ack(0xAAA);
-    send_hex_wait_ack(0xAA);
-    send_hex_wait_ack(0x555);
-    send_hex_wait_ack(0x55);
-    send_hex_wait_ack(0xAAA);
-    send_hex_wait_ack(0xA0);
+    send_hex_wait_ack(device, 0xAAA);
+    send_hex_wait_ack(device, 0xAA);
+    send_hex_wait_ack(device, 0x555);
+    send_hex_wait_ack(device, 0x55);
+    send_hex_wait_ack(device, 0xAAA);
+    send_hex_wait_ack(device, 0xA0);
   } else if (method == GB_FLASH_PROGRAM_555_BIT01_SWAPPED) {
-    send_hex_wait_ack(0x555);
-    send_hex_wait_ack(0xA9);
-    send_hex_wait_ack(0x2AA);
-    send_hex_wait_ack(0x56);
-    send_hex_wait_ack(0x555);
-    send_hex_wait_ack(0xA0);
+    send_hex_wait_ack(device, 0x555);
+    send_hex_wait_ack(device, 0xA9);
+    send_hex_wait_ack(device, 0x2AA);
+    send_hex_wait_ack(device, 0x56);
+    send_hex_wait_ack(device, 0x555);
+    send_hex_wait_ack(device, 0xA0);
   } else if (method == GB_FLASH_PROGRAM_AAA_BIT01_SWAPPED) {
-    send_hex_wait_ack(0xAAA);
-    send_hex_wait_ack(0xA9);
-    send_hex_wait_ack(0x555);
-    send_hex_wait_ack(0x56);
-    send_hex_wait_ack(0xAAA);
-    send_hex_wait_ack(0xA0);
+    send_hex_wait_ack(device, 0xAAA);
+    send_hex_wait_ack(device, 0xA9);
+    send_hex_wait_ack(device, 0x555);
+    send_hex_wait_ack(device, 0x56);
+    send_hex_wait_ack(device, 0xAAA);
+    send_hex_wait_ack(device, 0xA0);
   } else if (method == GB_FLASH_PROGRAM_7AAA_BIT01_SWAPPED) {
-    send_hex_wait_ack(0x7AAA);
-    send_hex_wait_ack(0xA9);
-    send_hex_wait_ack(0x7555);
-    send_hex_wait_ack(0x56);
-    send_hex_wait_ack(0x7AAA);
-    send_hex_wait_ack(0xA0);
+    send_hex_wait_ack(device, 0x7AAA);
+    send_hex_wait_ack(device, 0xA9);
+    send_hex_wait_ack(device, 0x7555);
+    send_hex_wait_ack(device, 0x56);
+    send_hex_wait_ack(device, 0x7AAA);
+    send_hex_wait_ack(device, 0xA0);
   } else if (method == GB_FLASH_PROGRAM_5555) {
-    send_hex_wait_ack(0x5555);
-    send_hex_wait_ack(0xAA);
-    send_hex_wait_ack(0x2AAA);
-    send_hex_wait_ack(0x55);
-    send_hex_wait_ack(0x5555);
-    send_hex_wait_ack(0xA0);
+    send_hex_wait_ack(device, 0x5555);
+    send_hex_wait_ack(device, 0xAA);
+    send_hex_wait_ack(device, 0x2AAA);
+    send_hex_wait_ack(device, 0x55);
+    send_hex_wait_ack(device, 0x5555);
+    send_hex_wait_ack(device, 0xA0);
   }
 }
 
 // Write address and byte to flash
-void gb_flash_write_address_byte(uint16_t address, uint8_t byte) {
+void gbx_gb_flash_write_address_byte(struct gbx_device *device,
+                                     uint16_t address, uint8_t byte) {
   char AddrString[15];
   sprintf(AddrString, "%c%x", 'F', address);
-  RS232_cputs(cport_nr, AddrString);
-  RS232_SendByte(cport_nr, 0);
-  RS232_drain(cport_nr);
+  RS232_cputs(device->cport_nr, AddrString);
+  RS232_SendByte(device->cport_nr, 0);
+  RS232_drain(device->cport_nr);
   delay_ms(5);
 
   char byteString[15];
   sprintf(byteString, "%x", byte);
-  RS232_cputs(cport_nr, byteString);
-  RS232_SendByte(cport_nr, 0);
-  RS232_drain(cport_nr);
+  RS232_cputs(device->cport_nr, byteString);
+  RS232_SendByte(device->cport_nr, 0);
+  RS232_drain(device->cport_nr);
   delay_ms(5);
 
-  com_wait_for_ack();
+  gbx_com_wait_for_ack(device);
 }
 
 // Read a bit of the ROM a few times to see if anything changes
-void gb_check_stable_cart_data(void) {
+void gbx_gb_check_stable_cart_data(struct gbx_device *device) {
   uint8_t readRomResult[10];
 
   // Read ROM a few times to see if anything changes
   for (uint8_t x = 0; x < 10; x++) {
-    set_number(0, SET_START_ADDRESS);
+    gbx_set_number(device, 0, SET_START_ADDRESS);
     delay_ms(5);
-    set_mode(READ_ROM_RAM);
+    gbx_set_mode(device, READ_ROM_RAM);
     delay_ms(5);
-    com_read_bytes(READ_BUFFER, 64);
-    com_read_stop(); // End read
+    gbx_com_read_bytes(device, READ_BUFFER, 64);
+    gbx_com_read_stop(device); // End read
     delay_ms(50);
 
     // printf("Read rom: 0x%X,0x%X,0x%X,0x%X\n", readBuffer[0], readBuffer[1],
@@ -1819,11 +2799,11 @@ void gb_check_stable_cart_data(void) {
     // Check if ROM read is different than last time
     if (x >= 1) {
       for (uint8_t r = 0; r < 8; r++) {
-        if (readBuffer[r] != readRomResult[r]) {
+        if (device->readBuffer[r] != readRomResult[r]) {
           printf(
               "\n*** The cartridge is changing it's data when being read "
               "back.\nPlease re-seat the cart and power cycle GBxCart. ***\n");
-          read_one_letter();
+          gbx_read_one_letter(device);
           break;
         }
       }
@@ -1832,17 +2812,18 @@ void gb_check_stable_cart_data(void) {
 }
 
 // Check if the ROM reads differently when issuing the Flash ID command
-void gb_check_change_flash_id(uint8_t flashMethod) {
+void gbx_gb_check_change_flash_id(struct gbx_device *device,
+                                  uint8_t flashMethod) {
   uint8_t readRomResult[10];
 
   // Read ROM a few times to see if anything changes
   for (uint8_t x = 0; x < 10; x++) {
-    set_number(0, SET_START_ADDRESS);
+    gbx_set_number(device, 0, SET_START_ADDRESS);
     delay_ms(5);
-    set_mode(READ_ROM_RAM);
+    gbx_set_mode(device, READ_ROM_RAM);
     delay_ms(5);
-    com_read_bytes(READ_BUFFER, 64);
-    com_read_stop(); // End read
+    gbx_com_read_bytes(device, READ_BUFFER, 64);
+    gbx_com_read_stop(device); // End read
     delay_ms(50);
 
     // printf("Read rom: 0x%X,0x%X,0x%X,0x%X\n", readBuffer[0], readBuffer[1],
@@ -1851,11 +2832,11 @@ void gb_check_change_flash_id(uint8_t flashMethod) {
     // Check if ROM read is different than last time
     if (x >= 1) {
       for (uint8_t r = 0; r < 8; r++) {
-        if (readBuffer[r] != readRomResult[r]) {
+        if (device->readBuffer[r] != readRomResult[r]) {
           printf(
               "\n*** The cartridge is changing it's data when being read "
               "back.\nPlease re-seat the cart and power cycle GBxCart. ***\n");
-          read_one_letter();
+          gbx_read_one_letter(device);
           break;
         }
       }
@@ -1863,111 +2844,111 @@ void gb_check_change_flash_id(uint8_t flashMethod) {
 
     // Store result
     for (uint8_t r = 0; r < 8; r++) {
-      readRomResult[r] = readBuffer[r];
+      readRomResult[r] = device->readBuffer[r];
     }
   }
 
   // Request Flash ID
   if (flashMethod == GB_FLASH_PROGRAM_555) {
-    gb_flash_write_address_byte(0x555, 0xAA);
-    gb_flash_write_address_byte(0x2AA, 0x55);
-    gb_flash_write_address_byte(0x555, 0x90);
+    gbx_gb_flash_write_address_byte(device, 0x555, 0xAA);
+    gbx_gb_flash_write_address_byte(device, 0x2AA, 0x55);
+    gbx_gb_flash_write_address_byte(device, 0x555, 0x90);
   } else if (flashMethod == GB_FLASH_PROGRAM_AAA) {
-    gb_flash_write_address_byte(0xAAA, 0xAA);
-    gb_flash_write_address_byte(0x555, 0x55);
-    gb_flash_write_address_byte(0xAAA, 0x90);
+    gbx_gb_flash_write_address_byte(device, 0xAAA, 0xAA);
+    gbx_gb_flash_write_address_byte(device, 0x555, 0x55);
+    gbx_gb_flash_write_address_byte(device, 0xAAA, 0x90);
   } else if (flashMethod == GB_FLASH_PROGRAM_555_BIT01_SWAPPED) {
-    gb_flash_write_address_byte(0x555, 0xA9);
-    gb_flash_write_address_byte(0x2AA, 0x56);
-    gb_flash_write_address_byte(0x555, 0x90);
+    gbx_gb_flash_write_address_byte(device, 0x555, 0xA9);
+    gbx_gb_flash_write_address_byte(device, 0x2AA, 0x56);
+    gbx_gb_flash_write_address_byte(device, 0x555, 0x90);
   } else if (flashMethod == GB_FLASH_PROGRAM_AAA_BIT01_SWAPPED) {
-    gb_flash_write_address_byte(0xAAA, 0xA9);
-    gb_flash_write_address_byte(0x555, 0x56);
-    gb_flash_write_address_byte(0xAAA, 0x90);
+    gbx_gb_flash_write_address_byte(device, 0xAAA, 0xA9);
+    gbx_gb_flash_write_address_byte(device, 0x555, 0x56);
+    gbx_gb_flash_write_address_byte(device, 0xAAA, 0x90);
   } else if (flashMethod == GB_FLASH_PROGRAM_5555) {
-    gb_flash_write_address_byte(0x5555, 0xAA);
-    gb_flash_write_address_byte(0x2AAA, 0x55);
-    gb_flash_write_address_byte(0x5555, 0x90);
+    gbx_gb_flash_write_address_byte(device, 0x5555, 0xAA);
+    gbx_gb_flash_write_address_byte(device, 0x2AAA, 0x55);
+    gbx_gb_flash_write_address_byte(device, 0x5555, 0x90);
   } else if (flashMethod == GB_FLASH_PROGRAM_7AAA_BIT01_SWAPPED) {
-    gb_flash_write_address_byte(0x7AAA, 0xA9);
-    gb_flash_write_address_byte(0x7555, 0x56);
-    gb_flash_write_address_byte(0x7AAA, 0x90);
+    gbx_gb_flash_write_address_byte(device, 0x7AAA, 0xA9);
+    gbx_gb_flash_write_address_byte(device, 0x7555, 0x56);
+    gbx_gb_flash_write_address_byte(device, 0x7AAA, 0x90);
   }
   delay_ms(50);
 
   // Read ID
-  set_number(0, SET_START_ADDRESS);
+  gbx_set_number(device, 0, SET_START_ADDRESS);
   delay_ms(5);
-  set_mode(READ_ROM_RAM);
+  gbx_set_mode(device, READ_ROM_RAM);
   delay_ms(5);
-  com_read_bytes(READ_BUFFER, 64);
-  com_read_stop(); // End read
+  gbx_com_read_bytes(device, READ_BUFFER, 64);
+  gbx_com_read_stop(device); // End read
 
-  printf("Flash ID: 0x%X,0x%X,0x%X,0x%X\n", readBuffer[0], readBuffer[1],
-         readBuffer[2], readBuffer[3]);
+  printf("Flash ID: 0x%X,0x%X,0x%X,0x%X\n", device->readBuffer[0],
+         device->readBuffer[1], device->readBuffer[2], device->readBuffer[3]);
 
   // Check if ROM read is different to Flash ID
   uint8_t resultChanged = 0;
   for (uint8_t r = 0; r < 8; r++) {
-    if (readBuffer[r] != readRomResult[r]) {
+    if (device->readBuffer[r] != readRomResult[r]) {
       resultChanged = 1;
     }
-    flashID[r] = readBuffer[r];
+    device->flashID[r] = device->readBuffer[r];
   }
 
   // Exit
-  gb_flash_write_address_byte(0x000, 0xF0);
+  gbx_gb_flash_write_address_byte(device, 0x000, 0xF0);
   delay_ms(5);
-  set_number(0, SET_START_ADDRESS);
+  gbx_set_number(device, 0, SET_START_ADDRESS);
   delay_ms(5);
 
   if (resultChanged == 0) {
     printf("\n*** Flash chip doesn't appear to be responding. Please re-seat "
            "the cart and power cycle GBxCart ***\n");
-    read_one_letter();
+    gbx_read_one_letter(device);
   }
 }
 
-int8_t gb_check_flash_id(void) {
+int8_t gbx_gb_check_flash_id(struct gbx_device *device) {
   uint8_t readROMResult[4];
 
   printf("          Read ROM: ");
-  set_number(0, SET_START_ADDRESS);
-  set_mode(READ_ROM_RAM);
-  com_read_bytes(READ_BUFFER, 64);
-  com_read_stop(); // End read
+  gbx_set_number(device, 0, SET_START_ADDRESS);
+  gbx_set_mode(device, READ_ROM_RAM);
+  gbx_com_read_bytes(device, READ_BUFFER, 64);
+  gbx_com_read_stop(device); // End read
 
   for (uint8_t r = 0; r < 4; r++) {
-    readROMResult[r] = readBuffer[r];
+    readROMResult[r] = device->readBuffer[r];
   }
   for (uint8_t r = 0; r < 8; r++) {
-    printf("0x%X, ", readBuffer[r]);
+    printf("0x%X, ", device->readBuffer[r]);
   }
   printf("\n");
 
-  set_mode(GB_CART_MODE);           // Gameboy mode
-  gb_flash_pin_setup(WE_AS_WR_PIN); // WR pin
+  gbx_set_mode(device, GB_CART_MODE);           // Gameboy mode
+  gbx_gb_flash_pin_setup(device, WE_AS_WR_PIN); // WR pin
 
   printf("Flash ID (555, AA): ");
-  gb_flash_write_address_byte(0x555, 0xAA);
-  gb_flash_write_address_byte(0x2AA, 0x55);
-  gb_flash_write_address_byte(0x555, 0x90);
+  gbx_gb_flash_write_address_byte(device, 0x555, 0xAA);
+  gbx_gb_flash_write_address_byte(device, 0x2AA, 0x55);
+  gbx_gb_flash_write_address_byte(device, 0x555, 0x90);
   delay_ms(50);
 
-  set_number(0, SET_START_ADDRESS);
-  set_mode(READ_ROM_RAM);
-  com_read_bytes(READ_BUFFER, 64);
-  com_read_stop(); // End read
+  gbx_set_number(device, 0, SET_START_ADDRESS);
+  gbx_set_mode(device, READ_ROM_RAM);
+  gbx_com_read_bytes(device, READ_BUFFER, 64);
+  gbx_com_read_stop(device); // End read
 
   for (uint8_t r = 0; r < 8; r++) {
-    printf("0x%X, ", readBuffer[r]);
+    printf("0x%X, ", device->readBuffer[r]);
   }
   printf("\n");
-  gb_flash_write_address_byte(0x000, 0xF0);
+  gbx_gb_flash_write_address_byte(device, 0x000, 0xF0);
 
   uint8_t sameData = 1;
   for (uint8_t r = 0; r < 4; r++) {
-    if (readROMResult[r] != readBuffer[r]) {
+    if (readROMResult[r] != device->readBuffer[r]) {
       sameData = 0;
     }
   }
@@ -1976,25 +2957,25 @@ int8_t gb_check_flash_id(void) {
   }
 
   printf("Flash ID (555, A9): ");
-  gb_flash_write_address_byte(0x555, 0xA9);
-  gb_flash_write_address_byte(0x2AA, 0x56);
-  gb_flash_write_address_byte(0x555, 0x90);
+  gbx_gb_flash_write_address_byte(device, 0x555, 0xA9);
+  gbx_gb_flash_write_address_byte(device, 0x2AA, 0x56);
+  gbx_gb_flash_write_address_byte(device, 0x555, 0x90);
   delay_ms(50);
 
-  set_number(0, SET_START_ADDRESS);
-  set_mode(READ_ROM_RAM);
-  com_read_bytes(READ_BUFFER, 64);
-  com_read_stop(); // End read
+  gbx_set_number(device, 0, SET_START_ADDRESS);
+  gbx_set_mode(device, READ_ROM_RAM);
+  gbx_com_read_bytes(device, READ_BUFFER, 64);
+  gbx_com_read_stop(device); // End read
 
   for (uint8_t r = 0; r < 8; r++) {
-    printf("0x%X, ", readBuffer[r]);
+    printf("0x%X, ", device->readBuffer[r]);
   }
   printf("\n");
-  gb_flash_write_address_byte(0x000, 0xF0);
+  gbx_gb_flash_write_address_byte(device, 0x000, 0xF0);
 
   sameData = 1;
   for (uint8_t r = 0; r < 4; r++) {
-    if (readROMResult[r] != readBuffer[r]) {
+    if (readROMResult[r] != device->readBuffer[r]) {
       sameData = 0;
     }
   }
@@ -2003,25 +2984,25 @@ int8_t gb_check_flash_id(void) {
   }
 
   printf("Flash ID (AAA, AA): ");
-  gb_flash_write_address_byte(0xAAA, 0xAA);
-  gb_flash_write_address_byte(0x555, 0x55);
-  gb_flash_write_address_byte(0xAAA, 0x90);
+  gbx_gb_flash_write_address_byte(device, 0xAAA, 0xAA);
+  gbx_gb_flash_write_address_byte(device, 0x555, 0x55);
+  gbx_gb_flash_write_address_byte(device, 0xAAA, 0x90);
   delay_ms(50);
 
-  set_number(0, SET_START_ADDRESS);
-  set_mode(READ_ROM_RAM);
-  com_read_bytes(READ_BUFFER, 64);
-  com_read_stop(); // End read
+  gbx_set_number(device, 0, SET_START_ADDRESS);
+  gbx_set_mode(device, READ_ROM_RAM);
+  gbx_com_read_bytes(device, READ_BUFFER, 64);
+  gbx_com_read_stop(device); // End read
 
   for (uint8_t r = 0; r < 8; r++) {
-    printf("0x%X, ", readBuffer[r]);
+    printf("0x%X, ", device->readBuffer[r]);
   }
   printf("\n");
-  gb_flash_write_address_byte(0x000, 0xF0);
+  gbx_gb_flash_write_address_byte(device, 0x000, 0xF0);
 
   sameData = 1;
   for (uint8_t r = 0; r < 4; r++) {
-    if (readROMResult[r] != readBuffer[r]) {
+    if (readROMResult[r] != device->readBuffer[r]) {
       sameData = 0;
     }
   }
@@ -2030,25 +3011,25 @@ int8_t gb_check_flash_id(void) {
   }
 
   printf("Flash ID (AAA, A9): ");
-  gb_flash_write_address_byte(0xAAA, 0xA9);
-  gb_flash_write_address_byte(0x555, 0x56);
-  gb_flash_write_address_byte(0xAAA, 0x90);
+  gbx_gb_flash_write_address_byte(device, 0xAAA, 0xA9);
+  gbx_gb_flash_write_address_byte(device, 0x555, 0x56);
+  gbx_gb_flash_write_address_byte(device, 0xAAA, 0x90);
   delay_ms(50);
 
-  set_number(0, SET_START_ADDRESS);
-  set_mode(READ_ROM_RAM);
-  com_read_bytes(READ_BUFFER, 64);
-  com_read_stop(); // End read
+  gbx_set_number(device, 0, SET_START_ADDRESS);
+  gbx_set_mode(device, READ_ROM_RAM);
+  gbx_com_read_bytes(device, READ_BUFFER, 64);
+  gbx_com_read_stop(device); // End read
 
   for (uint8_t r = 0; r < 8; r++) {
-    printf("0x%X, ", readBuffer[r]);
+    printf("0x%X, ", device->readBuffer[r]);
   }
   printf("\n");
-  gb_flash_write_address_byte(0x000, 0xF0);
+  gbx_gb_flash_write_address_byte(device, 0x000, 0xF0);
 
   sameData = 1;
   for (uint8_t r = 0; r < 4; r++) {
-    if (readROMResult[r] != readBuffer[r]) {
+    if (readROMResult[r] != device->readBuffer[r]) {
       sameData = 0;
     }
   }
@@ -2058,7 +3039,7 @@ int8_t gb_check_flash_id(void) {
 
   printf("\n*** Flash chip doesn't appear to be responding. Please re-seat the "
          "cart and power cycle GBxCart ***\n");
-  read_one_letter();
+  gbx_read_one_letter(device);
 
   return -1;
 }
@@ -2066,66 +3047,67 @@ int8_t gb_check_flash_id(void) {
 // ****** GBA Cart Flasher functions ******
 
 // GBA Flash Cart, write address and byte
-void gba_flash_write_address_byte(uint32_t address, uint16_t byte) {
+void gbx_gba_flash_write_address_byte(struct gbx_device *device,
+                                      uint32_t address, uint16_t byte) {
   // Divide address by 2 as one address has 16 bytes of data
   address /= 2;
 
   char AddrString[20];
   sprintf(AddrString, "%c%x", 'n', address);
-  RS232_cputs(cport_nr, AddrString);
-  RS232_SendByte(cport_nr, 0);
-  RS232_drain(cport_nr);
+  RS232_cputs(device->cport_nr, AddrString);
+  RS232_SendByte(device->cport_nr, 0);
+  RS232_drain(device->cport_nr);
   delay_ms(5);
 
   char byteString[15];
   sprintf(byteString, "%c%x", 'n', byte);
-  RS232_cputs(cport_nr, byteString);
-  RS232_SendByte(cport_nr, 0);
-  RS232_drain(cport_nr);
+  RS232_cputs(device->cport_nr, byteString);
+  RS232_SendByte(device->cport_nr, 0);
+  RS232_drain(device->cport_nr);
   delay_ms(5);
 
-  com_wait_for_ack();
+  gbx_com_wait_for_ack(device);
 }
 
-int8_t gba_check_flash_id(void) {
+int8_t gbx_gba_check_flash_id(struct gbx_device *device) {
   uint8_t readROMResult[4];
 
   printf("          Read ROM: ");
-  currAddr = 0x0000;
-  set_number(currAddr, SET_START_ADDRESS);
-  set_mode(GBA_READ_ROM);
-  com_read_bytes(READ_BUFFER, 64);
-  com_read_stop();
+  device->currAddr = 0x0000;
+  gbx_set_number(device, device->currAddr, SET_START_ADDRESS);
+  gbx_set_mode(device, GBA_READ_ROM);
+  gbx_com_read_bytes(device, READ_BUFFER, 64);
+  gbx_com_read_stop(device);
 
   for (uint8_t r = 0; r < 4; r++) {
-    readROMResult[r] = readBuffer[r];
+    readROMResult[r] = device->readBuffer[r];
   }
   for (uint8_t r = 0; r < 8; r++) {
-    printf("0x%X, ", readBuffer[r]);
+    printf("0x%X, ", device->readBuffer[r]);
   }
   printf("\n");
-  gba_flash_write_address_byte(0x000, 0xF0);
+  gbx_gba_flash_write_address_byte(device, 0x000, 0xF0);
 
   printf("Flash ID (AAA, A9): ");
-  gba_flash_write_address_byte(0xAAA, 0xA9);
-  gba_flash_write_address_byte(0x555, 0x56);
-  gba_flash_write_address_byte(0xAAA, 0x90);
+  gbx_gba_flash_write_address_byte(device, 0xAAA, 0xA9);
+  gbx_gba_flash_write_address_byte(device, 0x555, 0x56);
+  gbx_gba_flash_write_address_byte(device, 0xAAA, 0x90);
 
-  currAddr = 0x0000;
-  set_number(currAddr, SET_START_ADDRESS);
-  set_mode(GBA_READ_ROM);
-  com_read_bytes(READ_BUFFER, 64);
-  com_read_stop();
+  device->currAddr = 0x0000;
+  gbx_set_number(device, device->currAddr, SET_START_ADDRESS);
+  gbx_set_mode(device, GBA_READ_ROM);
+  gbx_com_read_bytes(device, READ_BUFFER, 64);
+  gbx_com_read_stop(device);
 
   for (uint8_t r = 0; r < 8; r++) {
-    printf("0x%X, ", readBuffer[r]);
+    printf("0x%X, ", device->readBuffer[r]);
   }
   printf("\n");
-  gba_flash_write_address_byte(0x000, 0xF0);
+  gbx_gba_flash_write_address_byte(device, 0x000, 0xF0);
 
   uint8_t sameData = 1;
   for (uint8_t r = 0; r < 4; r++) {
-    if (readROMResult[r] != readBuffer[r]) {
+    if (readROMResult[r] != device->readBuffer[r]) {
       sameData = 0;
     }
   }
@@ -2134,25 +3116,25 @@ int8_t gba_check_flash_id(void) {
   }
 
   printf("Flash ID (AAA, AA): ");
-  gba_flash_write_address_byte(0xAAA, 0xAA);
-  gba_flash_write_address_byte(0x555, 0x55);
-  gba_flash_write_address_byte(0xAAA, 0x90);
+  gbx_gba_flash_write_address_byte(device, 0xAAA, 0xAA);
+  gbx_gba_flash_write_address_byte(device, 0x555, 0x55);
+  gbx_gba_flash_write_address_byte(device, 0xAAA, 0x90);
 
-  currAddr = 0x0000;
-  set_number(currAddr, SET_START_ADDRESS);
-  set_mode(GBA_READ_ROM);
-  com_read_bytes(READ_BUFFER, 64);
-  com_read_stop();
+  device->currAddr = 0x0000;
+  gbx_set_number(device, device->currAddr, SET_START_ADDRESS);
+  gbx_set_mode(device, GBA_READ_ROM);
+  gbx_com_read_bytes(device, READ_BUFFER, 64);
+  gbx_com_read_stop(device);
 
   for (uint8_t r = 0; r < 8; r++) {
-    printf("0x%X, ", readBuffer[r]);
+    printf("0x%X, ", device->readBuffer[r]);
   }
   printf("\n");
-  gba_flash_write_address_byte(0x000, 0xF0);
+  gbx_gba_flash_write_address_byte(device, 0x000, 0xF0);
 
   sameData = 1;
   for (uint8_t r = 0; r < 4; r++) {
-    if (readROMResult[r] != readBuffer[r]) {
+    if (readROMResult[r] != device->readBuffer[r]) {
       sameData = 0;
     }
   }
@@ -2162,7 +3144,7 @@ int8_t gba_check_flash_id(void) {
 
   printf("\n*** Flash chip doesn't appear to be responding. Please re-seat the "
          "cart and power cycle GBxCart ***\n");
-  read_one_letter();
+  gbx_read_one_letter(device);
 
   return -1;
 }
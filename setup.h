@@ -24,8 +24,8 @@
 
 // COM Port settings (default)
 #include "rs232/rs232.h"
-extern int cport_nr;
-extern int bdrate;
+
+#define PORT_ENV_VARIABLE "GBXCART_PORT" // Port number as in config.ini
 
 #define CART_MODE 'C'
 #define GB_MODE 1
@@ -42,6 +42,7 @@ extern int bdrate;
 #define EEPROM_NONE 0
 #define EEPROM_4KBIT 1
 #define EEPROM_64KBIT 2
+#define EEPROM_READ_AHEAD 2 // Blocks asked for before the one being read has arrived
 
 #define SRAM_FLASH_NONE 0
 #define SRAM_FLASH_256KBIT 1
@@ -133,112 +134,274 @@ extern int bdrate;
 // Common vars
 #define READ_BUFFER 0
 
-extern uint8_t gbxcartFirmwareVersion;
-extern uint8_t gbxcartPcbVersion;
-extern uint8_t readBuffer[257];
-extern uint8_t writeBuffer[257];
-
-extern char gameTitle[17];
-extern uint16_t cartridgeType;
-extern uint32_t currAddr;
-extern uint32_t endAddr;
-extern uint16_t romSize;
-extern uint32_t romEndAddr;
-extern uint16_t romBanks;
-extern int ramSize;
-extern uint16_t ramBanks;
-extern uint32_t ramEndAddress;
-extern int eepromSize;
-extern uint16_t eepromEndAddress;
-extern int hasFlashSave;
-extern uint8_t cartridgeMode;
-extern int flashCartType;
-extern uint8_t flashID[10];
-extern uint8_t mode5vOverride;
-extern int8_t detectedFlashWritingMethod;
-
-extern uint32_t bytesReadPrevious;
-extern uint8_t ledBlinking;
-extern uint8_t ledProgress;
-extern uint8_t headerCheckSumOk;
-extern uint8_t fastReadEnabled;
-// Read the config.ini file for the COM port to use and baud rate
-void read_config(void);
+// How long the device can stay quiet, the waits sleep until bytes come in rather than polling
+#define COM_READ_TIMEOUT_MS 100
+#define COM_ACK_TIMEOUT_MS 1250
+#define COM_REQUEST_TIMEOUT_MS 250
+
+// Block read retries
+#define READ_RETRY_MAX_ATTEMPTS 12
+#define READ_RETRY_BACKOFF_MIN_MS 1
+#define READ_RETRY_BACKOFF_MAX_MS 256
+
+// Everything known about one GBxCart RW and the cart in it. Each gbx_ function works on the device it's given, so
+// several devices can be used from one program.
+struct gbx_device {
+  // COM port
+  int cport_nr;
+  int bdrate;
+  uint8_t cportFixed; // Port given by GBXCART_PORT, don't look for others
+
+  uint8_t gbxcartFirmwareVersion;
+  uint8_t gbxcartPcbVersion;
+  uint8_t readBuffer[257];
+  uint8_t writeBuffer[257];
+
+  // Cart
+  char gameTitle[17];
+  uint16_t cartridgeType;
+  uint32_t currAddr;
+  uint32_t endAddr;
+  uint16_t romSize;
+  uint32_t romEndAddr;
+  uint16_t romBanks;
+  int ramSize;
+  uint16_t ramBanks;
+  uint32_t ramEndAddress;
+  int eepromSize;
+  uint16_t eepromEndAddress;
+  int hasFlashSave;
+  uint8_t cartridgeMode;
+  int flashCartType;
+  uint8_t flashID[10];
+  uint8_t mode5vOverride;
+  int8_t detectedFlashWritingMethod;
+  uint8_t headerCheckSumOk;
+  uint8_t fastReadEnabled;
+  uint8_t cartCacheEnabled;
+  uint16_t ramSampleBank; // RAM bank selected by gb_read_ram_sample(), 0xFFFF if not known
+
+  // Progress and GBxMas LEDs
+  uint32_t bytesReadPrevious;
+  uint32_t ledStatus;
+  uint32_t ledCountLeft;
+  uint32_t ledCountRight;
+  uint8_t ledSegment;
+  uint8_t ledProgress;
+  uint8_t ledBlinking;
+
+  // Block read retries
+  uint32_t retryShortReads;
+  uint32_t retryMismatchedReads;
+  uint32_t retryCount;
+  uint32_t retryBackoffMs;
+  int16_t retryLastVerifiedFill;
+
+  // Set by programs that can't stop and ask or exit (libgbxcart), see gbx_device_init()
+  uint8_t nonInteractive;                                          // read_one_letter() returns '\n' straight away
+  void (*fatalHandler)(void);                                      // Called by gbx_fatal() before it exits
+  void (*progressHandler)(uint32_t bytesDone, uint32_t bytesTotal); // Gets the progress instead of it being printed
+};
+
+// What a device starts with, for struct gbx_device device = GBX_DEVICE_DEFAULTS. Port 7 is /dev/ttyS7 (COM8 on
+// windows) at 1,000,000 baud until read_config() says otherwise.
+#define GBX_DEVICE_DEFAULTS                                                                                            \
+  {.cport_nr = 7, .bdrate = 1000000, .endAddr = 0x7FFF, .cartridgeMode = GB_MODE, .cartCacheEnabled = 1,               \
+   .ramSampleBank = 0xFFFF, .retryLastVerifiedFill = -1}
+
+// The device used through the old variable and function names, see the end of this file
+extern struct gbx_device gbxDefaultDevice;
+
+// Reset a device to the defaults, before reading its config or opening its port. A program that can't wait for a key
+// passes nonInteractive 1, fatalHandler to get back control when the device stops answering (it mustn't return if the
+// program is to go on) and progressHandler to get the progress. The tools pass 0, NULL and NULL.
+void gbx_device_init(struct gbx_device *device, uint8_t nonInteractive, void (*fatalHandler)(void),
+                     void (*progressHandler)(uint32_t bytesDone, uint32_t bytesTotal));
+
+// Cartridge identity cache
+#define CART_CACHE_LINE_LENGTH 1024
+#define CART_CACHE_MAX_ENTRIES 256
+
+// What cart_identify() found, the device's fields are set too
+struct cart_identity {
+  uint8_t firmwareVersion;
+  uint8_t pcbVersion;
+  uint8_t mode;
+  char title[17];
+  uint32_t romLength;  // Bytes
+  uint32_t saveLength; // Bytes of SRAM, Flash or EEPROM, 0 if none
+  uint8_t headerOk;
+};
+
+// Read the config.ini file for the COM port to use and baud rate, a port in the GBXCART_PORT environment variable
+// overrides it and stops other ports being tried
+void gbx_read_config(struct gbx_device *device);
 
 // Write the config.ini file for the COM port to use and baud rate
-void write_config(void);
+void gbx_write_config(struct gbx_device *device);
 
 // Load a file which contains the cartridge RAM settings (only needed if Erase RAM option was used, only applies to GBA games)
-void load_cart_ram_info(void);
+void gbx_load_cart_ram_info(struct gbx_device *device);
 
 // Write a file which contains the cartridge RAM settings before it's wiped using Erase RAM (Only applies to GBA games)
-void write_cart_ram_info(void);
+void gbx_write_cart_ram_info(struct gbx_device *device);
 
 void delay_ms(uint16_t ms);
 
-// Read one letter from stdin
-char read_one_letter(void);
+// Read one letter from stdin, or return '\n' straight away if the device is nonInteractive (libgbxcart, where the
+// "press enter" pauses would wait on the program's stdin)
+char gbx_read_one_letter(struct gbx_device *device);
+
+// Give up when the device stops answering part way through: wait for enter and exit, unless the device's fatalHandler
+// doesn't return (libgbxcart longjmps back out of the call from it)
+void gbx_fatal(struct gbx_device *device);
 
-// Print progress
-void print_progress_percent(uint32_t bytesRead, uint32_t hashNumber);
+// Compare two buffers, returns the offset of the first differing byte or -1 if they match (SSE2 when available)
+int32_t compare_first_diff(const uint8_t *first, const uint8_t *second, uint32_t length);
 
-void led_progress_percent (uint32_t bytesRead, uint32_t hashNumber);
-void xmas_set_leds (uint32_t value);
-void xmas_blink_led (uint8_t value);
-void xmas_reset_values (void);
-void xmas_setup (uint32_t progressNumber);
-void xmas_idle_on (void);
-void xmas_idle_off (void);
-void xmas_chip_erase_animation (void);
-void xmas_wake_up (void);
+// Print progress, or pass it to the device's progressHandler instead if that's set
+void gbx_print_progress_percent(struct gbx_device *device, uint32_t bytesRead, uint32_t hashNumber);
+
+void gbx_led_progress_percent(struct gbx_device *device, uint32_t bytesRead, uint32_t hashNumber);
+void gbx_xmas_set_leds(struct gbx_device *device, uint32_t value);
+void gbx_xmas_blink_led(struct gbx_device *device, uint8_t value);
+void gbx_xmas_reset_values(struct gbx_device *device);
+void gbx_xmas_setup(struct gbx_device *device, uint32_t progressNumber);
+void gbx_xmas_idle_on(struct gbx_device *device);
+void gbx_xmas_idle_off(struct gbx_device *device);
+void gbx_xmas_chip_erase_animation(struct gbx_device *device);
+void gbx_xmas_wake_up(struct gbx_device *device);
 
 // Wait for a "1" acknowledgement from the ATmega
-void com_wait_for_ack (void);
+void gbx_com_wait_for_ack(struct gbx_device *device);
 
 // Stop reading blocks of data
-void com_read_stop(void);
+void gbx_com_read_stop(struct gbx_device *device);
 
 // Continue reading the next block of data
-void com_read_cont(void);
+void gbx_com_read_cont(struct gbx_device *device);
 
 // Test opening the COM port,if can't be open, try autodetecting device on other COM ports
-uint8_t com_test_port(void);
+uint8_t gbx_com_test_port(struct gbx_device *device);
 
 // Read 1 to 256 bytes from the COM port and write it to the global read buffer or to a file if specified. 
 // When polling the com port it return less than the bytes we want, keep polling and wait until we have all bytes requested. 
 // We expect no more than 256 bytes.
-uint8_t com_read_bytes(FILE *file, int count);
+uint16_t gbx_com_read_bytes(struct gbx_device *device, FILE *file, int count);
+
+// Read an already requested block into the read buffer, re-reading just that block with a capped exponential
+// backoff if it comes back short, or if it's uniform (all one byte) and a second read doesn't agree.
+// The start number is what SET_START_ADDRESS needs to restart at this block (GBA ROM addresses divided by 2).
+uint16_t gbx_com_read_block_checked(struct gbx_device *device, uint32_t startNumber, char readMode, int count);
+
+// Clear / print the block read retry statistics for this run
+void gbx_reset_retry_stats(struct gbx_device *device);
+void gbx_print_retry_stats(struct gbx_device *device);
 
 // Read 1-128 bytes from the file (or buffer) and write it the COM port with the command given
-void com_write_bytes_from_file(uint8_t command, FILE *file, int count);
+void gbx_com_write_bytes_from_file(struct gbx_device *device, uint8_t command, FILE *file, int count);
 
 // Send a single command byte
-void set_mode (char command);
+void gbx_set_mode(struct gbx_device *device, char command);
 
 // Send a command with a hex number and a null terminator byte
-void set_number (uint32_t number, uint8_t command);
+void gbx_set_number(struct gbx_device *device, uint32_t number, uint8_t command);
 
 // Read the cartridge mode
-uint8_t read_cartridge_mode (void);
+uint8_t gbx_read_cartridge_mode(struct gbx_device *device);
 
 // Send 1 byte and read 1 byte
-uint8_t request_value (uint8_t command);
+uint8_t gbx_request_value(struct gbx_device *device, uint8_t command);
+
+// Break out of any running function and get the firmware/PCB version and cartridge mode in one batched request.
+// Returns 0 if the device didn't answer.
+uint8_t gbx_request_device_info(struct gbx_device *device);
+
+// Get the firmware/PCB version and cartridge mode in one batched request, set the voltage (0 to pick it from
+// the cartridge mode on PCB v1.3) and read the header. Returns 0 if the device didn't answer.
+uint8_t gbx_cart_identify(struct gbx_device *device, struct cart_identity *identity, char voltage);
+
+// Set the voltage and read the header of a cart inserted since the device info was requested. Returns 0 if the
+// cartridge mode isn't known.
+uint8_t gbx_cart_read_identity(struct gbx_device *device, struct cart_identity *identity, char voltage);
+
+// Check whether a cart is inserted by reading the Nintendo logo from its header (one 64 byte read)
+uint8_t gbx_cart_present(struct gbx_device *device);
 
 
 // Check if OS can support the faster reading
-void fast_reading_check(void);
+void gbx_fast_reading_check(struct gbx_device *device);
+
+// ****** Cartridge identity cache ******
+
+// CRC32 (reflected, poly 0xEDB88320), pass 0 to start a new checksum
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, uint32_t length);
+
+// FNV-1a 64 bit, pass HASH64_START to start a new hash. Used to name content addressed backup data.
+#define HASH64_START 0xCBF29CE484222325ULL
+uint64_t hash64_update(uint64_t hash, const uint8_t *data, uint32_t length);
+
+// Read one 64 byte block of ROM from the address given into the read buffer
+void gbx_read_rom_sample(struct gbx_device *device, uint8_t mode, uint32_t address);
+
+// Hash a few sparse 64 byte windows of ROM to tell apart carts sharing a header
+uint32_t gbx_cart_fingerprint(struct gbx_device *device, uint8_t mode);
+
+// Look up the cart-cache.ini entry for the mode, header checksum and fingerprint,
+// the cached data is copied to entryData. Returns 1 if found.
+uint8_t gbx_cart_cache_lookup(struct gbx_device *device, uint8_t mode, uint32_t checkSum, uint32_t fingerprint, char *entryData, int entryLength);
+
+// Store a cart-cache.ini entry, replacing the stale one for the same header checksum
+void gbx_cart_cache_store(struct gbx_device *device, uint8_t mode, uint32_t checkSum, uint32_t fingerprint, const char *entryData);
+
+// ****** ROM read and compare ******
+
+// Called with each block of ROM read, romOffset is where it starts in the ROM. Return 1 to go on reading, 0 to stop.
+typedef uint8_t (*gbx_rom_block_handler)(void *context, uint32_t romOffset, const uint8_t *data, uint16_t length);
+
+// Read length bytes of ROM starting at offset (a multiple of 64) and pass them to onBlock a block at a time, with
+// progress. The last block is cut to the end of the range when length isn't a multiple of the block length. GB carts
+// need the header read first for the MBC. Returns how far it got, length unless onBlock stopped it.
+uint32_t gbx_read_rom(struct gbx_device *device, uint32_t offset, uint32_t length, gbx_rom_block_handler onBlock,
+                      void *context);
+
+// Called with each block of ROM that differs from the data, bank is the GB ROM bank or the GBA 4MB bank and diffOffset
+// the first byte in the block that differs. Return 1 to go on comparing, 0 to stop.
+typedef uint8_t (*gbx_rom_diff_handler)(void *context, uint16_t bank, uint32_t romOffset, const uint8_t *cartData,
+                                        const uint8_t *romData, uint16_t length, uint16_t diffOffset);
+
+// Read the cart's ROM from the start with gbx_read_rom() and compare it with romData up to compareLength bytes. Returns
+// the number of blocks that differ, onDiff (can be NULL to stop at the first) is called for each.
+uint32_t gbx_compare_rom(struct gbx_device *device, const uint8_t *romData, uint32_t compareLength,
+                         gbx_rom_diff_handler onDiff, void *context);
 
 // ****** Gameboy / Gameboy Colour functions ******
 
 // Set bank for ROM/RAM switching, send address first and then bank number
-void set_bank (uint16_t address, uint8_t bank);
+void gbx_set_bank(struct gbx_device *device, uint16_t address, uint8_t bank);
+
+// Switch the ROM bank mapped at 0x4000-0x7FFF using the cart's MBC (MBC1, MBC1 Hudson or MBC2 and above)
+void gbx_gb_set_rom_bank(struct gbx_device *device, uint16_t bank);
 
 // MBC2 Fix (unknown why this fixes reading the ram, maybe has to read ROM before RAM?)
 // Read 64 bytes of ROM, (really only 1 byte is required)
-void mbc2_fix (void);
+void gbx_mbc2_fix(struct gbx_device *device);
 
 // Read the first 384 bytes of ROM and process the Gameboy header information
-void read_gb_header (void);
+void gbx_read_gb_header(struct gbx_device *device);
+
+// Get the MBC ready for reading or writing the cart RAM (RAM mode on MBC1, RAM enabled)
+void gbx_gb_ram_enable(struct gbx_device *device);
+
+// Read 64 bytes of cart RAM into the read buffer, offset from the start of RAM bank 0. Call gb_ram_enable() first
+void gbx_gb_read_ram_sample(struct gbx_device *device, uint32_t offset);
+
+// Read the whole cart RAM into the buffer given (ramBanks * RAM bank size bytes), with progress
+void gbx_gb_read_ram(struct gbx_device *device, uint8_t *ramData);
+
+// Write a save to the cart RAM, only sending the 64 byte blocks that differ from the cart's current RAM (read first,
+// with progress), then read those blocks back. Returns the number of blocks that didn't verify.
+uint32_t gbx_gb_write_ram_delta(struct gbx_device *device, const uint8_t *ramData, uint32_t dataLength, uint32_t *changedBlocks);
 
 
 
@@ -246,31 +409,41 @@ void read_gb_header (void);
 
 // Check the rom size by reading 64 bytes from different addresses and checking if they are all 0x00. There can be some ROMs 
 // that do have valid 0x00 data, so we check 32 different addresses in a 4MB chunk, if 30 or more are all 0x00 then we've reached the end.
-uint8_t gba_check_rom_size (void);
+uint8_t gbx_gba_check_rom_size(struct gbx_device *device);
 
 // Used before we write to RAM as we need to check if we have an SRAM or Flash. 
 // Write 1 byte to 0x00 on the SRAM/Flash save, if we read it back successfully then we know SRAM is present, then we write
 // the original byte back to how it was. This can be a destructive process to the first byte, if anything goes wrong the user
 // could lose the first byte, so we only do this check when writing a save back to the SRAM/Flash.
-uint8_t gba_test_sram_flash_write (void);
+uint8_t gbx_gba_test_sram_flash_write(struct gbx_device *device);
 
 // Check if SRAM/Flash is present and test the size. 
 // When a 256Kbit SRAM is read past 256Kbit, the address is loops around, there are some times where the bytes don't all 
 // match up 100%, it's like 90% so be a bit lenient. A cartridge that doesn't have an SRAM/Flash reads all 0x00's.
-uint8_t gba_check_sram_flash (void);
+uint8_t gbx_gba_check_sram_flash(struct gbx_device *device);
 
 // Erase 4K sector on flash on sector address
-void flash_4k_sector_erase (uint8_t sector);
+void gbx_flash_4k_sector_erase(struct gbx_device *device, uint8_t sector);
+
+// Read part of the SRAM/Flash save (in the flash bank already selected) into the buffer given, length is a multiple of 64
+void gbx_gba_read_save(struct gbx_device *device, uint32_t address, uint8_t *data, uint32_t length);
 
 // Check if an EEPROM is present and test the size. A 4Kbit EEPROM when accessed like a 64Kbit EEPROM sends the first 8 bytes over
 // and over again. A cartridge that doesn't have an EEPROM reads all 0x00 or 0xFF.
-uint8_t gba_check_eeprom (void);
+uint8_t gbx_gba_check_eeprom(struct gbx_device *device);
+
+// Read the whole EEPROM (eepromEndAddress bytes) into the buffer given, with progress
+void gbx_gba_read_eeprom(struct gbx_device *device, uint8_t *data);
+
+// Write a save to the EEPROM, only sending the 8 byte blocks that differ from the EEPROM's current data (read first,
+// with progress), then read those blocks back. Returns the number of blocks that didn't verify.
+uint32_t gbx_gba_write_eeprom_delta(struct gbx_device *device, const uint8_t *data, uint32_t dataLength, uint32_t *changedBlocks);
 
 // Read GBA game title (used for reading title when ROM mapping)
-void gba_read_gametitle(void);
+void gbx_gba_read_gametitle(struct gbx_device *device);
 
 // Read the first 192 bytes of ROM, read the title, check and test for ROM, SRAM, EEPROM and Flash
-void read_gba_header (void);
+void gbx_read_gba_header(struct gbx_device *device);
 
 
 
@@ -280,36 +453,158 @@ void read_gba_header (void);
 void write_flash_config(int number);
 
 // Read the config-flash.ini file for the flash cart type
-void read_config_flash(void);
+void gbx_read_config_flash(struct gbx_device *device);
 
 // Wait for first byte of chosen address to be 0xFF, that's when we know the sector has been erased
-void wait_for_flash_sector_ff(uint16_t address);
+void gbx_wait_for_flash_sector_ff(struct gbx_device *device, uint16_t address);
 
 // Wait for first byte of Flash to be 0xFF, that's when we know the sector has been erased
-void wait_for_flash_chip_erase_ff(uint8_t printProgress);
+void gbx_wait_for_flash_chip_erase_ff(struct gbx_device *device, uint8_t printProgress);
 
 // Select which pin need to pulse as WE (Audio or WR)
-void gb_flash_pin_setup(char pin);
+void gbx_gb_flash_pin_setup(struct gbx_device *device, char pin);
 
 // Select which flash program method to use
-void gb_flash_program_setup(uint8_t method);
+void gbx_gb_flash_program_setup(struct gbx_device *device, uint8_t method);
 
 // Write address and byte to flash
-void gb_flash_write_address_byte (uint16_t address, uint8_t byte);
+void gbx_gb_flash_write_address_byte(struct gbx_device *device, uint16_t address, uint8_t byte);
 
-void gb_check_change_flash_id (uint8_t flashMethod);
+void gbx_gb_check_change_flash_id(struct gbx_device *device, uint8_t flashMethod);
 
-void gb_check_stable_cart_data (void);
+void gbx_gb_check_stable_cart_data(struct gbx_device *device);
 
-int8_t gb_check_flash_id(void);
+int8_t gbx_gb_check_flash_id(struct gbx_device *device);
 
 // ****** GBA Cart Flasher functions ******
 
 // GBA Flash Cart, write address and byte
-void gba_flash_write_address_byte (uint32_t address, uint16_t byte);
-
-void wait_for_gba_flash_erase_ff(uint32_t address);
+void gbx_gba_flash_write_address_byte(struct gbx_device *device, uint32_t address, uint16_t byte);
+
+void gbx_wait_for_gba_flash_erase_ff(struct gbx_device *device, uint32_t address);
+
+void gbx_wait_for_gba_flash_sector_ff(struct gbx_device *device, uint32_t address, uint8_t byteOne, uint8_t byteTwo);
+
+int8_t gbx_gba_check_flash_id(struct gbx_device *device);
+
+
+// ****** Default device ******
+
+// The names from before there was a gbx_device work on gbxDefaultDevice, so a tool that only talks to one device can
+// keep using them. Define GBX_NO_DEFAULT_DEVICE before including this file to leave them out.
+#ifndef GBX_NO_DEFAULT_DEVICE
+
+// The old globals are plain names like currAddr and romSize, which would take over any variable or field called that,
+// so they're only there for the tools written against them. Define GBX_LEGACY_GLOBALS before including this file to
+// get them, other code uses gbxDefaultDevice.<name>.
+#ifdef GBX_LEGACY_GLOBALS
+#define cport_nr (gbxDefaultDevice.cport_nr)
+#define bdrate (gbxDefaultDevice.bdrate)
+#define cportFixed (gbxDefaultDevice.cportFixed)
+#define gbxcartFirmwareVersion (gbxDefaultDevice.gbxcartFirmwareVersion)
+#define gbxcartPcbVersion (gbxDefaultDevice.gbxcartPcbVersion)
+#define readBuffer (gbxDefaultDevice.readBuffer)
+#define writeBuffer (gbxDefaultDevice.writeBuffer)
+#define gameTitle (gbxDefaultDevice.gameTitle)
+#define cartridgeType (gbxDefaultDevice.cartridgeType)
+#define currAddr (gbxDefaultDevice.currAddr)
+#define endAddr (gbxDefaultDevice.endAddr)
+#define romSize (gbxDefaultDevice.romSize)
+#define romEndAddr (gbxDefaultDevice.romEndAddr)
+#define romBanks (gbxDefaultDevice.romBanks)
+#define ramSize (gbxDefaultDevice.ramSize)
+#define ramBanks (gbxDefaultDevice.ramBanks)
+#define ramEndAddress (gbxDefaultDevice.ramEndAddress)
+#define eepromSize (gbxDefaultDevice.eepromSize)
+#define eepromEndAddress (gbxDefaultDevice.eepromEndAddress)
+#define hasFlashSave (gbxDefaultDevice.hasFlashSave)
+#define cartridgeMode (gbxDefaultDevice.cartridgeMode)
+#define flashCartType (gbxDefaultDevice.flashCartType)
+#define flashID (gbxDefaultDevice.flashID)
+#define mode5vOverride (gbxDefaultDevice.mode5vOverride)
+#define detectedFlashWritingMethod (gbxDefaultDevice.detectedFlashWritingMethod)
+#define bytesReadPrevious (gbxDefaultDevice.bytesReadPrevious)
+#define ledBlinking (gbxDefaultDevice.ledBlinking)
+#define ledProgress (gbxDefaultDevice.ledProgress)
+#define headerCheckSumOk (gbxDefaultDevice.headerCheckSumOk)
+#define fastReadEnabled (gbxDefaultDevice.fastReadEnabled)
+#define cartCacheEnabled (gbxDefaultDevice.cartCacheEnabled)
+#define ramSampleBank (gbxDefaultDevice.ramSampleBank)
+#define retryShortReads (gbxDefaultDevice.retryShortReads)
+#define retryMismatchedReads (gbxDefaultDevice.retryMismatchedReads)
+#define retryCount (gbxDefaultDevice.retryCount)
+#define retryBackoffMs (gbxDefaultDevice.retryBackoffMs)
+#endif
 
-void wait_for_gba_flash_sector_ff(uint32_t address, uint8_t byteOne,  uint8_t byteTwo);
+#define read_config() gbx_read_config(&gbxDefaultDevice)
+#define write_config() gbx_write_config(&gbxDefaultDevice)
+#define load_cart_ram_info() gbx_load_cart_ram_info(&gbxDefaultDevice)
+#define write_cart_ram_info() gbx_write_cart_ram_info(&gbxDefaultDevice)
+#define read_one_letter() gbx_read_one_letter(&gbxDefaultDevice)
+#define print_progress_percent(bytesRead, hashNumber) gbx_print_progress_percent(&gbxDefaultDevice, bytesRead, hashNumber)
+#define led_progress_percent(bytesRead, hashNumber) gbx_led_progress_percent(&gbxDefaultDevice, bytesRead, hashNumber)
+#define xmas_set_leds(value) gbx_xmas_set_leds(&gbxDefaultDevice, value)
+#define xmas_blink_led(value) gbx_xmas_blink_led(&gbxDefaultDevice, value)
+#define xmas_reset_values() gbx_xmas_reset_values(&gbxDefaultDevice)
+#define xmas_setup(progressNumber) gbx_xmas_setup(&gbxDefaultDevice, progressNumber)
+#define xmas_idle_on() gbx_xmas_idle_on(&gbxDefaultDevice)
+#define xmas_idle_off() gbx_xmas_idle_off(&gbxDefaultDevice)
+#define xmas_chip_erase_animation() gbx_xmas_chip_erase_animation(&gbxDefaultDevice)
+#define xmas_wake_up() gbx_xmas_wake_up(&gbxDefaultDevice)
+#define com_wait_for_ack() gbx_com_wait_for_ack(&gbxDefaultDevice)
+#define com_read_stop() gbx_com_read_stop(&gbxDefaultDevice)
+#define com_read_cont() gbx_com_read_cont(&gbxDefaultDevice)
+#define com_test_port() gbx_com_test_port(&gbxDefaultDevice)
+#define com_read_bytes(file, count) gbx_com_read_bytes(&gbxDefaultDevice, file, count)
+#define com_read_block_checked(startNumber, readMode, count) gbx_com_read_block_checked(&gbxDefaultDevice, startNumber, readMode, count)
+#define reset_retry_stats() gbx_reset_retry_stats(&gbxDefaultDevice)
+#define print_retry_stats() gbx_print_retry_stats(&gbxDefaultDevice)
+#define com_write_bytes_from_file(command, file, count) gbx_com_write_bytes_from_file(&gbxDefaultDevice, command, file, count)
+#define set_mode(command) gbx_set_mode(&gbxDefaultDevice, command)
+#define set_number(number, command) gbx_set_number(&gbxDefaultDevice, number, command)
+#define read_cartridge_mode() gbx_read_cartridge_mode(&gbxDefaultDevice)
+#define request_value(command) gbx_request_value(&gbxDefaultDevice, command)
+#define request_device_info() gbx_request_device_info(&gbxDefaultDevice)
+#define cart_identify(identity, voltage) gbx_cart_identify(&gbxDefaultDevice, identity, voltage)
+#define cart_read_identity(identity, voltage) gbx_cart_read_identity(&gbxDefaultDevice, identity, voltage)
+#define cart_present() gbx_cart_present(&gbxDefaultDevice)
+#define fast_reading_check() gbx_fast_reading_check(&gbxDefaultDevice)
+#define read_rom_sample(mode, address) gbx_read_rom_sample(&gbxDefaultDevice, mode, address)
+#define cart_fingerprint(mode) gbx_cart_fingerprint(&gbxDefaultDevice, mode)
+#define read_rom(offset, length, onBlock, context) gbx_read_rom(&gbxDefaultDevice, offset, length, onBlock, context)
+#define compare_rom(romData, compareLength, onDiff, context) gbx_compare_rom(&gbxDefaultDevice, romData, compareLength, onDiff, context)
+#define cart_cache_lookup(mode, checkSum, fingerprint, entryData, entryLength) gbx_cart_cache_lookup(&gbxDefaultDevice, mode, checkSum, fingerprint, entryData, entryLength)
+#define cart_cache_store(mode, checkSum, fingerprint, entryData) gbx_cart_cache_store(&gbxDefaultDevice, mode, checkSum, fingerprint, entryData)
+#define set_bank(address, bank) gbx_set_bank(&gbxDefaultDevice, address, bank)
+#define gb_set_rom_bank(bank) gbx_gb_set_rom_bank(&gbxDefaultDevice, bank)
+#define mbc2_fix() gbx_mbc2_fix(&gbxDefaultDevice)
+#define read_gb_header() gbx_read_gb_header(&gbxDefaultDevice)
+#define gb_ram_enable() gbx_gb_ram_enable(&gbxDefaultDevice)
+#define gb_read_ram_sample(offset) gbx_gb_read_ram_sample(&gbxDefaultDevice, offset)
+#define gb_read_ram(ramData) gbx_gb_read_ram(&gbxDefaultDevice, ramData)
+#define gb_write_ram_delta(ramData, dataLength, changedBlocks) gbx_gb_write_ram_delta(&gbxDefaultDevice, ramData, dataLength, changedBlocks)
+#define gba_check_rom_size() gbx_gba_check_rom_size(&gbxDefaultDevice)
+#define gba_test_sram_flash_write() gbx_gba_test_sram_flash_write(&gbxDefaultDevice)
+#define gba_check_sram_flash() gbx_gba_check_sram_flash(&gbxDefaultDevice)
+#define flash_4k_sector_erase(sector) gbx_flash_4k_sector_erase(&gbxDefaultDevice, sector)
+#define gba_read_save(address, data, length) gbx_gba_read_save(&gbxDefaultDevice, address, data, length)
+#define gba_check_eeprom() gbx_gba_check_eeprom(&gbxDefaultDevice)
+#define gba_read_eeprom(data) gbx_gba_read_eeprom(&gbxDefaultDevice, data)
+#define gba_write_eeprom_delta(data, dataLength, changedBlocks) gbx_gba_write_eeprom_delta(&gbxDefaultDevice, data, dataLength, changedBlocks)
+#define gba_read_gametitle() gbx_gba_read_gametitle(&gbxDefaultDevice)
+#define read_gba_header() gbx_read_gba_header(&gbxDefaultDevice)
+#define read_config_flash() gbx_read_config_flash(&gbxDefaultDevice)
+#define wait_for_flash_sector_ff(address) gbx_wait_for_flash_sector_ff(&gbxDefaultDevice, address)
+#define wait_for_flash_chip_erase_ff(printProgress) gbx_wait_for_flash_chip_erase_ff(&gbxDefaultDevice, printProgress)
+#define gb_flash_pin_setup(pin) gbx_gb_flash_pin_setup(&gbxDefaultDevice, pin)
+#define gb_flash_program_setup(method) gbx_gb_flash_program_setup(&gbxDefaultDevice, method)
+#define gb_flash_write_address_byte(address, byte) gbx_gb_flash_write_address_byte(&gbxDefaultDevice, address, byte)
+#define gb_check_change_flash_id(flashMethod) gbx_gb_check_change_flash_id(&gbxDefaultDevice, flashMethod)
+#define gb_check_stable_cart_data() gbx_gb_check_stable_cart_data(&gbxDefaultDevice)
+#define gb_check_flash_id() gbx_gb_check_flash_id(&gbxDefaultDevice)
+#define gba_flash_write_address_byte(address, byte) gbx_gba_flash_write_address_byte(&gbxDefaultDevice, address, byte)
+#define wait_for_gba_flash_erase_ff(address) gbx_wait_for_gba_flash_erase_ff(&gbxDefaultDevice, address)
+#define wait_for_gba_flash_sector_ff(address, byteOne, byteTwo) gbx_wait_for_gba_flash_sector_ff(&gbxDefaultDevice, address, byteOne, byteTwo)
+#define gba_check_flash_id() gbx_gba_check_flash_id(&gbxDefaultDevice)
 
-int8_t gba_check_flash_id(void);
+#endif
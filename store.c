@@ -0,0 +1,568 @@
+/*
+ Backup store by DEFENSE MECHANISM
+
+ See store.h. chunks.idx is an open addressing hash table: a header with the
+ slot count followed by the slots, kept in host byte order. Manifests are text:
+
+   GBX-MANIFEST 1
+   title <title>
+   chunk <hash> <crc> <length>      one per chunk, in order
+   length <total length>
+
+ */
+
+#ifndef _WIN32
+#define _XOPEN_SOURCE 600 // Must come before the first system header
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+#include "setup.h"
+#include "store.h"
+
+struct store_index_header {
+  char magic[8];
+  uint32_t capacity;
+  uint32_t count;
+};
+
+// A slot with a length of 0 is empty
+struct store_index_entry {
+  uint64_t hash;
+  uint64_t offset;
+  uint32_t crc;
+  uint32_t length;
+};
+
+static struct store_index_header *indexHeader = NULL;
+static size_t indexLength = 0;
+static FILE *packFile = NULL;
+#ifndef _WIN32
+static int indexFd = -1;
+#endif
+
+#define INDEX_ENTRIES ((struct store_index_entry *)(indexHeader + 1))
+
+static size_t index_size(uint32_t capacity) {
+  return sizeof(struct store_index_header) +
+         ((size_t)capacity * sizeof(struct store_index_entry));
+}
+
+// Map the index at the length given, the file grows to fit
+static int index_map(size_t length) {
+#ifdef _WIN32
+  // No mmap here, the index is read in and index_unmap() writes it back
+  uint8_t *data = (uint8_t *)calloc(1, length);
+  if (data == NULL) {
+    return 1;
+  }
+  FILE *indexFile = fopen(STORE_INDEX_FILE, "rb");
+  if (indexFile != NULL) {
+    fread(data, 1, length, indexFile);
+    fclose(indexFile);
+  }
+  indexHeader = (struct store_index_header *)data;
+#else
+  struct stat indexStat;
+  if (fstat(indexFd, &indexStat) != 0) {
+    return 1;
+  }
+  if ((size_t)indexStat.st_size < length && ftruncate(indexFd, length) != 0) {
+    return 1;
+  }
+  void *data =
+      mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, indexFd, 0);
+  if (data == MAP_FAILED) {
+    return 1;
+  }
+  indexHeader = (struct store_index_header *)data;
+#endif
+  indexLength = length;
+  return 0;
+}
+
+static void index_unmap(void) {
+  if (indexHeader == NULL) {
+    return;
+  }
+#ifdef _WIN32
+  FILE *indexFile = fopen(STORE_INDEX_FILE, "wb");
+  if (indexFile != NULL) {
+    fwrite(indexHeader, 1, indexLength, indexFile);
+    fclose(indexFile);
+  }
+  free(indexHeader);
+#else
+  munmap(indexHeader, indexLength);
+#endif
+  indexHeader = NULL;
+}
+
+// Find the slot holding this chunk, or the empty slot it would go in
+static struct store_index_entry *index_find(uint64_t hash, uint32_t crc) {
+  struct store_index_entry *entries = INDEX_ENTRIES;
+  uint32_t mask = indexHeader->capacity - 1;
+  uint32_t slot = hash & mask;
+  while (entries[slot].length != 0) {
+    if (entries[slot].hash == hash && entries[slot].crc == crc) {
+      break;
+    }
+    slot = (slot + 1) & mask;
+  }
+  return &entries[slot];
+}
+
+// Double the slots once the table is 3/4 full and put every entry back
+static int index_grow(void) {
+  uint32_t oldCapacity = indexHeader->capacity;
+  size_t oldEntriesLength = oldCapacity * sizeof(struct store_index_entry);
+  struct store_index_entry *oldEntries =
+      (struct store_index_entry *)malloc(oldEntriesLength);
+  if (oldEntries == NULL) {
+    return 1;
+  }
+  memcpy(oldEntries, INDEX_ENTRIES, oldEntriesLength);
+
+  index_unmap();
+  if (index_map(index_size(oldCapacity * 2)) != 0) {
+    free(oldEntries);
+    return 1;
+  }
+  indexHeader->capacity = oldCapacity * 2;
+  indexHeader->count = 0;
+  memset(INDEX_ENTRIES, 0,
+         indexHeader->capacity * sizeof(struct store_index_entry));
+
+  for (uint32_t x = 0; x < oldCapacity; x++) {
+    if (oldEntries[x].length != 0) {
+      *index_find(oldEntries[x].hash, oldEntries[x].crc) = oldEntries[x];
+      indexHeader->count++;
+    }
+  }
+  free(oldEntries);
+  return 0;
+}
+
+static void store_close(void) {
+  index_unmap();
+#ifndef _WIN32
+  if (indexFd >= 0) {
+    close(indexFd);
+    indexFd = -1;
+  }
+#endif
+  if (packFile != NULL) {
+    fclose(packFile);
+    packFile = NULL;
+  }
+}
+
+static int store_open(void) {
+#ifdef _WIN32
+  _mkdir(STORE_DIR);
+  _mkdir(STORE_MANIFEST_DIR);
+#else
+  mkdir(STORE_DIR, 0755);
+  mkdir(STORE_MANIFEST_DIR, 0755);
+#endif
+
+  packFile = fopen(STORE_PACK_FILE, "a+b");
+  if (packFile == NULL) {
+    printf("Couldn't open %s\n", STORE_PACK_FILE);
+    return 1;
+  }
+
+  // Read the header first for the slot count, an empty file gets a new index
+  struct store_index_header header;
+  memset(&header, 0, sizeof(header));
+  size_t headerLength = 0;
+  FILE *indexFile = fopen(STORE_INDEX_FILE, "rb");
+  if (indexFile != NULL) {
+    headerLength = fread(&header, 1, sizeof(header), indexFile);
+    fclose(indexFile);
+  }
+  uint8_t newIndex = (headerLength == 0);
+  if (newIndex == 0 &&
+      (headerLength != sizeof(header) ||
+       strncmp(header.magic, STORE_INDEX_MAGIC, sizeof(header.magic)) != 0 ||
+       header.capacity == 0 ||
+       (header.capacity & (header.capacity - 1)) != 0)) {
+    printf("%s is damaged\n", STORE_INDEX_FILE);
+    store_close();
+    return 1;
+  }
+  if (newIndex == 1) {
+    header.capacity = STORE_INDEX_START_CAPACITY;
+  }
+
+#ifndef _WIN32
+  indexFd = open(STORE_INDEX_FILE, O_RDWR | O_CREAT, 0644);
+  if (indexFd < 0) {
+    printf("Couldn't open %s\n", STORE_INDEX_FILE);
+    store_close();
+    return 1;
+  }
+#endif
+  if (index_map(index_size(header.capacity)) != 0) {
+    printf("Couldn't map %s\n", STORE_INDEX_FILE);
+    store_close();
+    return 1;
+  }
+  if (newIndex == 1) {
+    memset(indexHeader, 0, indexLength);
+    memcpy(indexHeader->magic, STORE_INDEX_MAGIC, sizeof(STORE_INDEX_MAGIC));
+    indexHeader->capacity = header.capacity;
+  }
+  return 0;
+}
+
+// Store a chunk unless it's already there. Returns 1 if it was new, 0 if it
+// was already stored or -1 if it couldn't be written.
+static int store_chunk(const uint8_t *data, uint32_t length, uint64_t *hash,
+                       uint32_t *crc) {
+  *hash = hash64_update(HASH64_START, data, length);
+  *crc = crc32_update(0, data, length);
+
+  struct store_index_entry *entry = index_find(*hash, *crc);
+  if (entry->length != 0) {
+    return 0;
+  }
+
+  if ((indexHeader->count + 1) * 4 > indexHeader->capacity * 3) {
+    if (index_grow() != 0) {
+      return -1;
+    }
+    entry = index_find(*hash, *crc);
+  }
+
+  fseek(packFile, 0, SEEK_END);
+  long offset = ftell(packFile);
+  if (offset < 0 || fwrite(data, 1, length, packFile) != length ||
+      fflush(packFile) != 0) {
+    return -1;
+  }
+
+  entry->hash = *hash;
+  entry->offset = offset;
+  entry->crc = *crc;
+  entry->length = length;
+  indexHeader->count++;
+  return 1;
+}
+
+// Write out the chunk buffer and list it in the manifest
+static void store_flush_chunk(struct store_snapshot *snapshot) {
+  if (snapshot->chunkFill == 0 || snapshot->failed == 1) {
+    return;
+  }
+
+  uint64_t hash = 0;
+  uint32_t crc = 0;
+  int result =
+      store_chunk(snapshot->chunk, snapshot->chunkFill, &hash, &crc);
+  if (result < 0) {
+    snapshot->failed = 1;
+    return;
+  }
+  if (result == 1) {
+    snapshot->newChunks++;
+    snapshot->newBytes += snapshot->chunkFill;
+  }
+  fprintf(snapshot->manifestFile, "chunk %016llX %08X %u\n",
+          (unsigned long long)hash, (unsigned int)crc,
+          (unsigned int)snapshot->chunkFill);
+  snapshot->chunkCount++;
+  snapshot->chunkFill = 0;
+}
+
+static void last_manifest_path(char *path, const char *title,
+                               const char *extension) {
+  snprintf(path, 256, "%s/%s.%s.last", STORE_MANIFEST_DIR, title, extension);
+}
+
+int store_begin(struct store_snapshot *snapshot, const char *title,
+                const char *timestamp, const char *extension,
+                uint32_t chunkSize) {
+  memset(snapshot, 0, sizeof(struct store_snapshot));
+  strncpy(snapshot->title, title, 16);
+  snapshot->chunkSize = chunkSize;
+  snapshot->chunk = (uint8_t *)malloc(chunkSize);
+  if (snapshot->chunk == NULL || store_open() != 0) {
+    free(snapshot->chunk);
+    return 1;
+  }
+
+  snprintf(snapshot->manifestPath, sizeof(snapshot->manifestPath),
+           "%s/%s-%s.%s", STORE_MANIFEST_DIR, title, timestamp, extension);
+
+  // Written next to it and renamed once complete
+  char tempPath[260];
+  snprintf(tempPath, sizeof(tempPath), "%s.tmp", snapshot->manifestPath);
+  snapshot->manifestFile = fopen(tempPath, "wt");
+  if (snapshot->manifestFile == NULL) {
+    printf("Couldn't create %s\n", tempPath);
+    store_close();
+    free(snapshot->chunk);
+    return 1;
+  }
+  fprintf(snapshot->manifestFile, "%s\ntitle %s\n", STORE_MANIFEST_HEADER,
+          title);
+  return 0;
+}
+
+void store_write(struct store_snapshot *snapshot, const uint8_t *data,
+                 uint32_t length) {
+  while (length > 0) {
+    uint32_t copyLength = snapshot->chunkSize - snapshot->chunkFill;
+    if (copyLength > length) {
+      copyLength = length;
+    }
+    memcpy(&snapshot->chunk[snapshot->chunkFill], data, copyLength);
+    snapshot->chunkFill += copyLength;
+    snapshot->length += copyLength;
+    data += copyLength;
+    length -= copyLength;
+
+    if (snapshot->chunkFill == snapshot->chunkSize) {
+      store_flush_chunk(snapshot);
+    }
+  }
+}
+
+int store_finish(struct store_snapshot *snapshot) {
+  store_flush_chunk(snapshot);
+  fprintf(snapshot->manifestFile, "length %u\n",
+          (unsigned int)snapshot->length);
+
+  char tempPath[260];
+  snprintf(tempPath, sizeof(tempPath), "%s.tmp", snapshot->manifestPath);
+  if (fclose(snapshot->manifestFile) != 0) {
+    snapshot->failed = 1;
+  }
+  store_close();
+  free(snapshot->chunk);
+
+  if (snapshot->failed == 1) {
+    remove(tempPath);
+    printf("Couldn't write to %s\n", STORE_DIR);
+    return 1;
+  }
+  remove(snapshot->manifestPath);
+  if (rename(tempPath, snapshot->manifestPath) != 0) {
+    printf("Couldn't create %s\n", snapshot->manifestPath);
+    return 1;
+  }
+
+  // Extension is what follows the timestamp
+  char lastPath[256];
+  last_manifest_path(lastPath, snapshot->title,
+                     strrchr(snapshot->manifestPath, '.') + 1);
+  FILE *lastFile = fopen(lastPath, "wt");
+  if (lastFile != NULL) {
+    fprintf(lastFile, "%s\n", snapshot->manifestPath);
+    fclose(lastFile);
+  }
+
+  printf("Stored %s: %u of %u chunks new (%u bytes)\n", snapshot->manifestPath,
+         (unsigned int)snapshot->newChunks, (unsigned int)snapshot->chunkCount,
+         (unsigned int)snapshot->newBytes);
+  return 0;
+}
+
+int store_extract(const char *manifestPath, const char *outPath) {
+  FILE *manifestFile = fopen(manifestPath, "rt");
+  if (manifestFile == NULL) {
+    printf("\n%s \nFile not found\n", manifestPath);
+    return 1;
+  }
+  char line[256];
+  if (fgets(line, sizeof(line), manifestFile) == NULL ||
+      strncmp(line, STORE_MANIFEST_HEADER, strlen(STORE_MANIFEST_HEADER)) !=
+          0) {
+    fclose(manifestFile);
+    printf("%s isn't a backup manifest\n", manifestPath);
+    return 1;
+  }
+
+  if (outPath == NULL) {
+    const char *baseName = strrchr(manifestPath, '/');
+    outPath = (baseName != NULL) ? baseName + 1 : manifestPath;
+  }
+
+  if (store_open() != 0) {
+    fclose(manifestFile);
+    return 1;
+  }
+  uint8_t *chunk = NULL;
+  FILE *outFile = fopen(outPath, "wb");
+  if (outFile == NULL) {
+    printf("Couldn't create %s\n", outPath);
+    fclose(manifestFile);
+    store_close();
+    return 1;
+  }
+
+  int result = 0;
+  uint32_t writtenLength = 0;
+  uint32_t expectedLength = 0xFFFFFFFF;
+  while (result == 0 && fgets(line, sizeof(line), manifestFile) != NULL) {
+    unsigned long long hash = 0;
+    unsigned int crc = 0;
+    unsigned int length = 0;
+    if (sscanf(line, "chunk %llx %x %u", &hash, &crc, &length) == 3) {
+      struct store_index_entry *entry = index_find(hash, crc);
+      if (entry->length != length || length == 0) {
+        printf("Chunk %016llX is missing from the store\n", hash);
+        result = 1;
+        break;
+      }
+
+      chunk = (uint8_t *)realloc(chunk, length);
+      if (chunk == NULL || fseek(packFile, entry->offset, SEEK_SET) != 0 ||
+          fread(chunk, 1, length, packFile) != length ||
+          hash64_update(HASH64_START, chunk, length) != hash ||
+          crc32_update(0, chunk, length) != crc) {
+        printf("Chunk %016llX is damaged\n", hash);
+        result = 1;
+        break;
+      }
+      if (fwrite(chunk, 1, length, outFile) != length) {
+        result = 1;
+        break;
+      }
+      writtenLength += length;
+    } else if (sscanf(line, "length %u", &length) == 1) {
+      expectedLength = length;
+    }
+  }
+  fclose(manifestFile);
+  free(chunk);
+  store_close();
+
+  if (fclose(outFile) != 0 || writtenLength != expectedLength) {
+    result = 1;
+  }
+  if (result != 0) {
+    remove(outPath);
+    printf("Couldn't extract %s\n", manifestPath);
+    return 1;
+  }
+  printf("Extracted %s (%u bytes)\n", outPath, (unsigned int)writtenLength);
+  return 0;
+}
+
+int store_reader_open(struct store_reader *reader, const char *manifestPath) {
+  memset(reader, 0, sizeof(struct store_reader));
+  FILE *manifestFile = fopen(manifestPath, "rt");
+  if (manifestFile == NULL) {
+    return 1;
+  }
+  if (store_open() != 0) {
+    fclose(manifestFile);
+    return 1;
+  }
+
+  // Look each chunk up once, reads then only seek in the pack
+  char line[256];
+  uint32_t capacity = 0;
+  int result = 0;
+  while (fgets(line, sizeof(line), manifestFile) != NULL) {
+    unsigned long long hash = 0;
+    unsigned int crc = 0;
+    unsigned int chunkLength = 0;
+    if (sscanf(line, "chunk %llx %x %u", &hash, &crc, &chunkLength) != 3) {
+      continue;
+    }
+    struct store_index_entry *entry = index_find(hash, crc);
+    if (entry->length != chunkLength || chunkLength == 0) {
+      result = 1;
+      break;
+    }
+    if (reader->chunkCount == capacity) {
+      capacity = (capacity == 0) ? 64 : capacity * 2;
+      struct store_reader_chunk *chunks = (struct store_reader_chunk *)realloc(
+          reader->chunks, capacity * sizeof(struct store_reader_chunk));
+      if (chunks == NULL) {
+        result = 1;
+        break;
+      }
+      reader->chunks = chunks;
+    }
+    reader->chunks[reader->chunkCount].offset = entry->offset;
+    reader->chunks[reader->chunkCount].length = chunkLength;
+    reader->chunkCount++;
+    reader->length += chunkLength;
+  }
+  fclose(manifestFile);
+
+  if (result != 0) {
+    store_reader_close(reader);
+  }
+  return result;
+}
+
+int store_read_range(struct store_reader *reader, uint32_t offset,
+                     uint8_t *data, uint32_t length) {
+  if (offset > reader->length || length > reader->length - offset) {
+    return 1;
+  }
+
+  // Walk the chunks, reading the part of each one the range covers
+  uint32_t chunkStart = 0;
+  uint32_t copiedLength = 0;
+  for (uint32_t x = 0; x < reader->chunkCount && copiedLength < length; x++) {
+    struct store_reader_chunk *chunk = &reader->chunks[x];
+    uint32_t wantedStart = offset + copiedLength;
+    if (wantedStart < chunkStart + chunk->length) {
+      uint32_t inChunk = wantedStart - chunkStart;
+      uint32_t readLength = chunk->length - inChunk;
+      if (readLength > length - copiedLength) {
+        readLength = length - copiedLength;
+      }
+      if (fseek(packFile, chunk->offset + inChunk, SEEK_SET) != 0 ||
+          fread(&data[copiedLength], 1, readLength, packFile) != readLength) {
+        return 1;
+      }
+      copiedLength += readLength;
+    }
+    chunkStart += chunk->length;
+  }
+  return (copiedLength != length);
+}
+
+void store_reader_close(struct store_reader *reader) {
+  free(reader->chunks);
+  reader->chunks = NULL;
+  reader->chunkCount = 0;
+  store_close();
+}
+
+uint8_t store_last_manifest(const char *title, const char *extension,
+                            char *manifestPath) {
+  char lastPath[256];
+  last_manifest_path(lastPath, title, extension);
+  FILE *lastFile = fopen(lastPath, "rt");
+  if (lastFile == NULL) {
+    return 0;
+  }
+  uint8_t found = 0;
+  if (fgets(manifestPath, 256, lastFile) != NULL) {
+    manifestPath[strcspn(manifestPath, "\r\n")] = '\0';
+    found = 1;
+  }
+  fclose(lastFile);
+  return found;
+}
@@ -0,0 +1,76 @@
+/*
+ Backup store by DEFENSE MECHANISM
+
+ Content addressed store for ROM and save backups. Backups are cut into fixed
+ size chunks (16KB ROM banks, 8KB SRAM banks) and each chunk is appended to
+ gbx-store/chunks.pack once, found again through the hash table in
+ gbx-store/chunks.idx which is memory mapped. Each backup is a manifest in
+ gbx-store/manifests/ listing its chunks, so backing up the same ROM or an
+ almost unchanged save again only adds the chunks that are new.
+
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define STORE_DIR "gbx-store"
+#define STORE_MANIFEST_DIR "gbx-store/manifests"
+#define STORE_PACK_FILE "gbx-store/chunks.pack"
+#define STORE_INDEX_FILE "gbx-store/chunks.idx"
+#define STORE_MANIFEST_HEADER "GBX-MANIFEST 1"
+#define STORE_INDEX_MAGIC "GBXIDX1"
+#define STORE_INDEX_START_CAPACITY 4096 // Slots, always a power of 2
+
+#define STORE_ROM_CHUNK_SIZE 0x4000
+#define STORE_RAM_CHUNK_SIZE 0x2000
+
+// A backup being written into the store
+struct store_snapshot {
+  char title[17];
+  char manifestPath[256];
+  FILE *manifestFile;
+  uint8_t *chunk;
+  uint32_t chunkSize;
+  uint32_t chunkFill;
+  uint32_t length;
+  uint32_t chunkCount;
+  uint32_t newChunks;
+  uint32_t newBytes;
+  uint8_t failed;
+};
+
+// Start a backup named title-timestamp.extension (extension is "sav", "gb" or "gba"). Returns 0 if it worked.
+int store_begin(struct store_snapshot *snapshot, const char *title, const char *timestamp, const char *extension, uint32_t chunkSize);
+
+// Add data to the backup, each chunk is stored once it fills up
+void store_write(struct store_snapshot *snapshot, const uint8_t *data, uint32_t length);
+
+// Store the last chunk and write the manifest, which also becomes the title's last backup. Returns 0 if it worked.
+int store_finish(struct store_snapshot *snapshot);
+
+// Write the file a manifest describes to outPath (NULL to use the manifest's name). Returns 0 if it worked.
+int store_extract(const char *manifestPath, const char *outPath);
+
+// Where one chunk of an opened backup is in chunks.pack
+struct store_reader_chunk {
+  uint64_t offset;
+  uint32_t length;
+};
+
+// A stored backup opened to read parts of it, the store stays open until it's closed
+struct store_reader {
+  struct store_reader_chunk *chunks;
+  uint32_t chunkCount;
+  uint32_t length; // Of the whole backup
+};
+
+// Open the backup a manifest describes and find its chunks. Returns 0 if it worked and every chunk is there.
+int store_reader_open(struct store_reader *reader, const char *manifestPath);
+
+// Read part of an opened backup, from the offset given, without extracting it. Returns 0 if it worked.
+int store_read_range(struct store_reader *reader, uint32_t offset, uint8_t *data, uint32_t length);
+
+void store_reader_close(struct store_reader *reader);
+
+// Copy the path of the last manifest stored for this title and extension. Returns 1 if there is one.
+uint8_t store_last_manifest(const char *title, const char *extension, char *manifestPath);
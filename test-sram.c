@@ -0,0 +1,335 @@
+/*
+ LSDj Cart SRAM Test by DEFENSE MECHANISM
+ based on GBxCart RW - Console Interface by insideGadgets
+
+ Tests a Game Boy cart's SRAM/FRAM for when saves come back corrupt. The save
+ is backed up first (to <title>-<timestamp>-pretest.sav), then a March C- test
+ runs over every bank on three data backgrounds: all 0s, 0x55 and the address
+ of each byte, each against its inverse. The elements go through the RAM
+ ascending and descending, reading each 64 byte block (the smallest the device
+ reads and writes) and checking it before writing it with the next pattern,
+ which catches stuck bits, bits that affect each other and address lines or
+ banks that alias. The save is then written back and checked.
+
+   test-sram
+
+ Failing addresses are listed with the bits that were wrong. Exits with 0 if
+ every background was clean and the save went back, 1 otherwise.
+
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "output.h"
+#define GBX_LEGACY_GLOBALS // Uses currAddr, romSize and the rest
+#include "setup.h" // See defines, variables, constants, functions here
+
+#define TEST_BACKGROUNDS 3
+#define MARCH_ELEMENTS 6
+#define TEST_LIST_LIMIT 32 // Failing addresses listed, the rest are counted
+
+uint32_t errorCount = 0;
+uint32_t stuckLow[8];  // Wrote a 1, read a 0
+uint32_t stuckHigh[8]; // Wrote a 0, read a 1
+
+// Fill the buffer with a data background, or its inverse
+void fill_pattern(uint8_t *data, uint32_t ramLength, uint8_t background,
+                  uint8_t inverted) {
+  for (uint32_t offset = 0; offset < ramLength; offset++) {
+    uint8_t addressByte =
+        (uint8_t)(offset ^ (offset >> 8) ^ (offset >> 16) ^ (offset >> 24));
+    switch (background) {
+    case 0:
+      data[offset] = 0x00;
+      break;
+    case 1:
+      data[offset] = 0x55;
+      break;
+    default:
+      data[offset] = addressByte;
+      break;
+    }
+    if (inverted == 1) {
+      data[offset] = ~data[offset];
+    }
+  }
+}
+
+// Write one 64 byte block of RAM at offset, in the bank gb_read_ram_sample()
+// left selected
+void write_block(const uint8_t *data, uint32_t offset) {
+  uint32_t bankSize = ramEndAddress - 0xA000 + 1;
+  uint16_t bank = offset / bankSize;
+  if (bank != ramSampleBank) {
+    set_bank(0x4000, bank);
+    ramSampleBank = bank;
+  }
+  set_number(0xA000 + (offset % bankSize), SET_START_ADDRESS);
+  memcpy(writeBuffer, &data[offset], 64);
+  com_write_bytes_from_file(WRITE_RAM, NULL, 64);
+  com_wait_for_ack();
+}
+
+// Compare the length bytes read from start with what was written there
+// (expected is the whole RAM's pattern), noting the bits that differ. Returns
+// the number of bytes that were wrong.
+uint32_t check_range(const uint8_t *pattern, const uint8_t *actual,
+                     uint32_t start, uint32_t length, uint8_t mask) {
+  uint32_t bankSize = ramEndAddress - 0xA000 + 1;
+  uint32_t wrongBytes = 0;
+  const uint8_t *expected = &pattern[start];
+
+  int32_t offset = compare_first_diff(actual, expected, length);
+  while (offset >= 0 && (uint32_t)offset < length) {
+    uint8_t diff = (actual[offset] ^ expected[offset]) & mask;
+    if (diff != 0) {
+      wrongBytes++;
+      errorCount++;
+
+      char bits[24] = "";
+      for (uint8_t b = 0; b < 8; b++) {
+        if (diff & (1 << b)) {
+          if (expected[offset] & (1 << b)) {
+            stuckLow[b]++;
+          } else {
+            stuckHigh[b]++;
+          }
+          char bit[4];
+          snprintf(bit, sizeof(bit), "%s%i", (bits[0] != '\0') ? "," : "", b);
+          strncat(bits, bit, sizeof(bits) - strlen(bits) - 1);
+        }
+      }
+      if (errorCount <= TEST_LIST_LIMIT) {
+        printf("Bank %u 0x%04X: wrote %02X, read %02X (bit %s)\n",
+               (unsigned int)((start + offset) / bankSize),
+               (unsigned int)(0xA000 + ((start + offset) % bankSize)),
+               expected[offset], actual[offset], bits);
+      }
+    }
+
+    offset++;
+    if ((uint32_t)offset >= length) {
+      break;
+    }
+    int32_t next = compare_first_diff(&actual[offset], &expected[offset],
+                                      length - offset);
+    if (next < 0) {
+      break;
+    }
+    offset += next;
+  }
+  return wrongBytes;
+}
+
+// One march element: each block in turn, ascending or descending, is read and
+// checked against the pattern it should hold (if there is one) and then
+// written with the next one (if there is one). Returns the bytes that were
+// wrong.
+uint32_t march_element(const uint8_t *readPattern, const uint8_t *writePattern,
+                       uint32_t ramLength, uint8_t descending, uint8_t mask) {
+  uint32_t wrongBytes = 0;
+  gb_ram_enable();
+
+  for (uint32_t x = 0; x < ramLength; x += 64) {
+    uint32_t offset = (descending == 1) ? ramLength - 64 - x : x;
+    if (readPattern != NULL) {
+      gb_read_ram_sample(offset);
+      wrongBytes += check_range(readPattern, readBuffer, offset, 64, mask);
+    }
+    if (writePattern != NULL) {
+      write_block(writePattern, offset);
+    }
+    print_progress_percent(x + 64, ramLength / 64);
+  }
+  set_bank(0x0000, 0x00); // Disable RAM
+  return wrongBytes;
+}
+
+int main(int argc, char **argv) {
+
+  printf("LSDj Cart SRAM Test by DEFENSE MECHANISM\n");
+  printf("based on GBxCart RW v1.24 by insideGadgets\n");
+  printf("################################\n");
+
+  read_config();
+
+  // Open COM port
+  if (com_test_port() == 0) {
+    printf("Device not connected and couldn't be auto detected\n");
+    read_one_letter();
+    return 1;
+  }
+  printf("Connected on COM port: %i\n", cport_nr + 1);
+
+  // Get firmware/PCB version and cartridge mode, set the voltage and read the
+  // header in one go
+  struct cart_identity cart;
+  if (cart_identify(&cart, 0) == 0) {
+    printf("Device didn't respond, please re-seat the cartridge and try "
+           "again\n");
+    read_one_letter();
+    return 1;
+  }
+  if (cartridgeMode != GB_MODE || ramEndAddress == 0 ||
+      headerCheckSumOk == 0) {
+    printf("\nOnly Game Boy carts with RAM can be tested\n");
+    read_one_letter();
+    return 1;
+  }
+  if (cartridgeType == 252 && gbxcartFirmwareVersion == 1) {
+    printf("\nGame Boy Camera carts need newer firmware to be tested\n");
+    read_one_letter();
+    return 1;
+  }
+
+  uint32_t ramLength = cart.saveLength;
+  uint8_t mask = 0xFF;
+  if (cartridgeType == 5 || cartridgeType == 6) { // MBC2 only has 4 bit RAM
+    mask = 0x0F;
+  }
+  uint8_t *saveData = (uint8_t *)malloc(ramLength);
+  uint8_t *patternData = (uint8_t *)malloc(ramLength);
+  uint8_t *inverseData = (uint8_t *)malloc(ramLength);
+  uint8_t *readData = (uint8_t *)malloc(ramLength);
+  if (saveData == NULL || patternData == NULL || inverseData == NULL ||
+      readData == NULL) {
+    printf("Not enough memory\n");
+    return 1;
+  }
+
+  printf("\n*** This will overwrite the save on the cartridge, it's backed up "
+         "first and written back at the end ***");
+  printf("\nPress y to continue or any other key to abort.\n");
+  if (read_one_letter() != 'y') {
+    printf("Aborted\n");
+    return 1;
+  }
+
+  // Back up the save
+  char backupFilename[80];
+  char timebuffer[25];
+  time_t rawtime;
+  time(&rawtime);
+  strftime(timebuffer, sizeof(timebuffer), "%Y%m%d%H%M%S", localtime(&rawtime));
+  snprintf(backupFilename, sizeof(backupFilename), "%s-%s-pretest.sav",
+           gameTitle, timebuffer);
+  printf("\n--- Backing up save to %s ---\n", backupFilename);
+  printf("[             25%%             50%%             75%%            "
+         "100%%]\n[");
+  reset_retry_stats();
+  gb_read_ram(saveData);
+  printf("]");
+  print_retry_stats();
+  printf("\n");
+
+  struct output_file backup;
+  if (output_open(&backup, backupFilename, ramLength) != 0) {
+    read_one_letter();
+    return 1;
+  }
+  output_write(&backup, saveData, ramLength);
+  if (output_finish(&backup) != 0) {
+    printf("The save couldn't be backed up, not testing\n");
+    read_one_letter();
+    return 1;
+  }
+
+  // March C-: up w0, up r0 w1, up r1 w0, down r0 w1, down r1 w0, up r0
+  const char *backgroundNames[TEST_BACKGROUNDS] = {"0x00/0xFF", "0x55/0xAA",
+                                                   "address/inverted address"};
+  const char *elementNames[MARCH_ELEMENTS] = {
+      "up, write 0",          "up, read 0, write 1",   "up, read 1, write 0",
+      "down, read 0, write 1", "down, read 1, write 0", "up, read 0"};
+  uint32_t passErrors[TEST_BACKGROUNDS];
+
+  reset_retry_stats();
+  for (uint8_t background = 0; background < TEST_BACKGROUNDS; background++) {
+    printf("\n--- Background %i of %i: %s ---\n", background + 1,
+           TEST_BACKGROUNDS, backgroundNames[background]);
+    fill_pattern(patternData, ramLength, background, 0);
+    fill_pattern(inverseData, ramLength, background, 1);
+    passErrors[background] = 0;
+
+    for (uint8_t element = 0; element < MARCH_ELEMENTS; element++) {
+      printf("%s\n", elementNames[element]);
+      printf("[             25%%             50%%             75%%        "
+             "    100%%]\n[");
+      uint32_t wrongBytes = 0;
+      switch (element) {
+      case 0:
+        wrongBytes = march_element(NULL, patternData, ramLength, 0, mask);
+        break;
+      case 1:
+        wrongBytes =
+            march_element(patternData, inverseData, ramLength, 0, mask);
+        break;
+      case 2:
+        wrongBytes =
+            march_element(inverseData, patternData, ramLength, 0, mask);
+        break;
+      case 3:
+        wrongBytes =
+            march_element(patternData, inverseData, ramLength, 1, mask);
+        break;
+      case 4:
+        wrongBytes =
+            march_element(inverseData, patternData, ramLength, 1, mask);
+        break;
+      default: // Nothing's written, so read it all in one go
+        gb_read_ram(readData);
+        wrongBytes = check_range(patternData, readData, 0, ramLength, mask);
+        break;
+      }
+      printf("]\n");
+      passErrors[background] += wrongBytes;
+    }
+    printf("%u bytes wrong\n", (unsigned int)passErrors[background]);
+  }
+  print_retry_stats();
+
+  // Put the save back
+  printf("\n--- Restoring save from %s ---\n", backupFilename);
+  printf("[             25%%             50%%             75%%            "
+         "100%%]\n[");
+  uint32_t changedBlocks = 0;
+  uint32_t badBlocks = gb_write_ram_delta(saveData, ramLength, &changedBlocks);
+
+  // Report
+  printf("\n--- Result ---\n");
+  for (uint8_t background = 0; background < TEST_BACKGROUNDS; background++) {
+    printf("Background %i (%s): %u bytes wrong\n", background + 1,
+           backgroundNames[background], (unsigned int)passErrors[background]);
+  }
+  if (errorCount > TEST_LIST_LIMIT) {
+    printf("%u failing bytes, only the first %i are listed above\n",
+           (unsigned int)errorCount, TEST_LIST_LIMIT);
+  }
+  for (uint8_t b = 0; b < 8; b++) {
+    if (stuckLow[b] > 0 || stuckHigh[b] > 0) {
+      printf("Bit %i: %u times read 0 instead of 1, %u times read 1 instead "
+             "of 0\n",
+             b, (unsigned int)stuckLow[b], (unsigned int)stuckHigh[b]);
+    }
+  }
+
+  if (badBlocks > 0) {
+    printf("\n%u blocks of the save didn't write back, it's still in %s\n",
+           (unsigned int)badBlocks, backupFilename);
+  }
+  free(readData);
+  free(inverseData);
+  free(patternData);
+  free(saveData);
+
+  if (errorCount > 0 || badBlocks > 0) {
+    printf("\nSRAM test FAILED\n");
+    return 1;
+  }
+  printf("\nSRAM passed every background and the save was written back. If saves "
+         "still go missing, check the battery.\n");
+  return 0;
+}
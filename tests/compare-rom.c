@@ -0,0 +1,127 @@
+/*
+ ROM read and compare test by DEFENSE MECHANISM
+
+ Runs gbx_compare_rom() against a fake GBxCart RW (fake-rs232.c) with ROM files
+ that aren't a multiple of the read block length, to check the bytes in the
+ short last block are compared too, and gbx_read_rom() across a GB bank.
+
+ */
+
+#ifndef _WIN32
+#define _XOPEN_SOURCE 600 // Must come before the first system header
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GBX_NO_DEFAULT_DEVICE
+#include "../setup.h"
+#include "fake-rs232.h"
+
+#define CART_LENGTH 0x10000
+#define FILE_LENGTH (0x8000 + 37) // Ends 37 bytes into a block of bank 2
+
+uint8_t cartRom[CART_LENGTH];
+uint8_t fileRom[CART_LENGTH];
+int failures = 0;
+
+static void no_progress(uint32_t bytesDone, uint32_t bytesTotal) {}
+
+// Keep where the first difference is and stop the compare there
+static uint8_t first_diff(void *context, uint16_t bank, uint32_t romOffset,
+                          const uint8_t *cartData, const uint8_t *romData,
+                          uint16_t length, uint16_t diffOffset) {
+  *(int32_t *)context = romOffset + diffOffset;
+  return 0;
+}
+
+static void check(const char *name, struct gbx_device *device,
+                  uint32_t compareLength, int32_t expectedDiff) {
+  int32_t firstDiff = -1;
+  uint32_t diffBlocks =
+      gbx_compare_rom(device, fileRom, compareLength, first_diff, &firstDiff);
+  if (firstDiff != expectedDiff || (diffBlocks > 0) != (expectedDiff >= 0)) {
+    printf("FAIL %s: first difference %d, expected %d\n", name, firstDiff,
+           expectedDiff);
+    failures++;
+  } else {
+    printf("ok   %s\n", name);
+  }
+}
+
+// Copy each block read into fileRom
+static uint8_t copy_block(void *context, uint32_t romOffset,
+                          const uint8_t *data, uint16_t length) {
+  memcpy(&fileRom[romOffset], data, length);
+  return 1;
+}
+
+// Read a range that starts 64 bytes before the end of bank 0 and ends 64 bytes
+// into bank 2
+static void check_read(const char *name, struct gbx_device *device) {
+  memset(fileRom, 0, CART_LENGTH);
+  uint32_t readLength =
+      gbx_read_rom(device, 0x3FC0, 0x4080, copy_block, NULL);
+  if (readLength != 0x4080 ||
+      memcmp(&fileRom[0x3FC0], &cartRom[0x3FC0], 0x4080) != 0 ||
+      fileRom[0x3FBF] != 0 || fileRom[0x8040] != 0) {
+    printf("FAIL %s, read across banks\n", name);
+    failures++;
+  } else {
+    printf("ok   %s, read across banks\n", name);
+  }
+}
+
+// Same file, then with the last byte of the file changed, then with a byte
+// changed on the cart past the end of the file
+static void check_mode(const char *name, struct gbx_device *device) {
+  char testName[100];
+  memcpy(fileRom, cartRom, CART_LENGTH);
+  snprintf(testName, sizeof(testName), "%s, matching", name);
+  check(testName, device, FILE_LENGTH, -1);
+
+  fileRom[FILE_LENGTH - 1] ^= 0x5A;
+  snprintf(testName, sizeof(testName), "%s, last byte differs", name);
+  check(testName, device, FILE_LENGTH, FILE_LENGTH - 1);
+  fileRom[FILE_LENGTH - 1] ^= 0x5A;
+
+  fileRom[FILE_LENGTH] ^= 0x5A;
+  snprintf(testName, sizeof(testName), "%s, past the end differs", name);
+  check(testName, device, FILE_LENGTH, -1);
+  fileRom[FILE_LENGTH] ^= 0x5A;
+
+  snprintf(testName, sizeof(testName), "%s, shorter than a block", name);
+  check(testName, device, 37, -1);
+
+  check_read(name, device);
+}
+
+int main(void) {
+  // No two blocks the same, so block reads aren't retried as a floating bus
+  for (uint32_t x = 0; x < CART_LENGTH; x++) {
+    cartRom[x] = (uint8_t)((x * 7) ^ (x >> 8));
+  }
+  fake_rs232_load(cartRom, CART_LENGTH);
+
+  struct gbx_device device;
+  gbx_device_init(&device, 1, NULL, no_progress); // Only print the results
+
+  device.cartridgeMode = GB_MODE;
+  device.cartridgeType = 0x19; // MBC5
+  check_mode("GB", &device);
+
+  device.cartridgeMode = GBA_MODE;
+  device.gbxcartPcbVersion = PCB_1_3;
+  check_mode("GBA 256 byte reads", &device);
+
+  device.gbxcartPcbVersion = PCB_1_0;
+  check_mode("GBA 64 byte reads", &device);
+
+  if (failures > 0) {
+    printf("%d failed\n", failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,169 @@
+/*
+ Fake GBxCart RW by DEFENSE MECHANISM
+
+ Stands in for rs232.c in the tests. Instead of a serial port it answers the
+ ROM read and bank switch commands from a ROM image in memory, the way the
+ ATmega on a GBxCart RW would with that ROM on an MBC5 (GB) or GBA cart.
+
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../rs232/rs232.h"
+#include "fake-rs232.h"
+
+static const uint8_t *fakeRom = NULL;
+static uint32_t fakeRomLength = 0;
+
+// Bytes waiting to be polled
+static uint8_t outBuffer[1024];
+static uint16_t outLength = 0;
+
+// Command being received
+static char command = 0;
+static char number[20];
+static uint8_t numberLength = 0;
+
+static uint32_t address = 0;
+static uint16_t readLength = 0;
+static char readCommand = 0;
+static uint16_t bankAddress = 0;
+static uint8_t bankAddressSet = 0;
+static uint16_t romBank = 1;
+
+void fake_rs232_load(const uint8_t *rom, uint32_t length) {
+  fakeRom = rom;
+  fakeRomLength = length;
+  outLength = 0;
+  command = 0;
+  readCommand = 0;
+  bankAddressSet = 0;
+  romBank = 1;
+}
+
+static uint8_t rom_byte(uint32_t offset) {
+  if (offset < fakeRomLength) {
+    return fakeRom[offset];
+  }
+  return 0xFF;
+}
+
+// Queue the block at the current address
+static void send_block(void) {
+  for (uint16_t x = 0; x < readLength; x++) {
+    uint32_t offset;
+    if (readCommand == 'R') { // GB, bank 0 then the bank switched in
+      uint32_t gbAddress = address + x;
+      offset = gbAddress;
+      if (gbAddress >= 0x4000) {
+        offset = ((uint32_t)romBank * 0x4000) + (gbAddress - 0x4000);
+      }
+    } else { // GBA, the address is in 16 bit words
+      offset = (address * 2) + x;
+    }
+    outBuffer[outLength++] = rom_byte(offset);
+  }
+}
+
+// Set the MBC5 ROM bank, the address is sent first and then the bank
+static void set_bank(const char *value) {
+  if (bankAddressSet == 0) {
+    bankAddress = strtoul(value, NULL, 16);
+    bankAddressSet = 1;
+    return;
+  }
+  uint16_t bank = strtoul(value, NULL, 10);
+  if (bankAddress >= 0x2000 && bankAddress < 0x3000) {
+    romBank = (romBank & 0x100) | bank;
+  } else if (bankAddress >= 0x3000 && bankAddress < 0x4000) {
+    romBank = (romBank & 0xFF) | ((bank & 1) << 8);
+  }
+  bankAddressSet = 0;
+}
+
+static void receive(uint8_t byte) {
+  if (command != 0) { // The rest of a number
+    if (byte != 0) {
+      if (numberLength < sizeof(number) - 1) {
+        number[numberLength++] = byte;
+      }
+      return;
+    }
+    number[numberLength] = '\0';
+    if (command == 'A') {
+      address = strtoul(number, NULL, 16);
+    } else {
+      set_bank(number);
+    }
+    command = 0;
+    return;
+  }
+
+  switch (byte) {
+  case 'A':
+  case 'B':
+    command = byte;
+    numberLength = 0;
+    break;
+  case 'R':
+  case 'r':
+    readCommand = byte;
+    readLength = 64;
+    send_block();
+    break;
+  case 'j':
+    readCommand = byte;
+    readLength = 256;
+    send_block();
+    break;
+  case '1':
+    if (readCommand != 0) {
+      address += (readCommand == 'R') ? readLength : readLength / 2;
+      send_block();
+    }
+    break;
+  case '0':
+    readCommand = 0;
+    break;
+  }
+}
+
+int RS232_OpenComport(int comport_number, int baudrate, const char *mode) {
+  return 0;
+}
+
+int RS232_PollComport(int comport_number, unsigned char *buf, int size) {
+  int length = (outLength < size) ? outLength : size;
+  memcpy(buf, outBuffer, length);
+  memmove(outBuffer, &outBuffer[length], outLength - length);
+  outLength -= length;
+  return length;
+}
+
+int RS232_WaitComport(int comport_number, int timeoutMs) {
+  return outLength > 0;
+}
+
+int RS232_SendByte(int comport_number, unsigned char byte) {
+  receive(byte);
+  return 0;
+}
+
+int RS232_SendBuf(int comport_number, unsigned char *buf, int size) {
+  for (int x = 0; x < size; x++) {
+    receive(buf[x]);
+  }
+  return size;
+}
+
+void RS232_cputs(int comport_number, const char *text) {
+  while (*text != 0) {
+    receive(*text++);
+  }
+}
+
+void RS232_CloseComport(int comport_number) {}
+
+void RS232_drain(int comport_number) {}
@@ -0,0 +1,2 @@
+// Answer reads from the ROM given, bytes past its length read as 0xFF
+void fake_rs232_load(const uint8_t *rom, uint32_t length);
@@ -0,0 +1,232 @@
+/*
+ LSDj Cart Verify by DEFENSE MECHANISM
+ based on GBxCart RW - Console Interface by insideGadgets
+
+ Checks whether the ROM on a cart matches a ROM file without dumping it first.
+ The cart is streamed bank by bank and compared against the file as it's read.
+ By default it stops at the first bank that differs, add "full" to list every
+ range that differs instead.
+
+   verify-cart <ROMFile> [full]
+
+ Exits with 0 if the cart matches, 1 if it doesn't.
+
+ */
+
+#ifndef _WIN32
+#define _XOPEN_SOURCE 600 // Must come before the first system header
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define GBX_LEGACY_GLOBALS // Uses currAddr, romSize and the rest
+#include "setup.h" // See defines, variables, constants, functions here
+
+uint32_t rangeStart = 0;
+uint32_t rangeEnd = 0;
+uint8_t rangeOpen = 0;
+uint32_t rangeCount = 0;
+uint32_t diffBytes = 0;
+uint16_t diffBank = 0;
+
+// Map the reference file read only, returns NULL if it can't be opened
+uint8_t *map_file(const char *path, long *length) {
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    return NULL;
+  }
+  *length = GetFileSize(file, NULL);
+  HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(file);
+  if (mapping == NULL) {
+    return NULL;
+  }
+  uint8_t *data = (uint8_t *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  return data;
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+    close(fd);
+    return NULL;
+  }
+  *length = fileStat.st_size;
+  void *data = mmap(NULL, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return NULL;
+  }
+  return (uint8_t *)data;
+#endif
+}
+
+void unmap_file(uint8_t *data, long length) {
+#ifdef _WIN32
+  UnmapViewOfFile(data);
+#else
+  munmap(data, length);
+#endif
+}
+
+// Print the range of differing bytes collected so far
+void close_range(void) {
+  if (rangeOpen == 1) {
+    printf("Differs: 0x%06X-0x%06X (%u bytes)\n", (unsigned int)rangeStart,
+           (unsigned int)rangeEnd, (unsigned int)(rangeEnd - rangeStart + 1));
+    rangeOpen = 0;
+  }
+}
+
+// Add a differing byte, joining it to the current range if it's next to it
+void note_diff(uint32_t address) {
+  diffBytes++;
+  if (rangeOpen == 1 && address == rangeEnd + 1) {
+    rangeEnd = address;
+    return;
+  }
+  close_range();
+  rangeStart = address;
+  rangeEnd = address;
+  rangeOpen = 1;
+  rangeCount++;
+}
+
+// Called for each block that differs. In full mode every differing byte is
+// noted and the compare goes on, otherwise it stops at the first.
+uint8_t verify_diff(void *context, uint16_t bank, uint32_t romOffset,
+                    const uint8_t *cartData, const uint8_t *romData,
+                    uint16_t length, uint16_t diffOffset) {
+  uint8_t fullMode = *(uint8_t *)context;
+  if (fullMode == 0) {
+    diffBank = bank;
+    rangeStart = romOffset + diffOffset;
+    return 0;
+  }
+
+  while (1) {
+    note_diff(romOffset + diffOffset);
+    diffOffset++;
+    if (diffOffset >= length) {
+      break;
+    }
+    int32_t nextOffset = compare_first_diff(
+        &cartData[diffOffset], &romData[diffOffset], length - diffOffset);
+    if (nextOffset < 0) {
+      break;
+    }
+    diffOffset += nextOffset;
+  }
+  return 1;
+}
+
+int main(int argc, char **argv) {
+
+  printf("LSDj Cart Verify by DEFENSE MECHANISM\n");
+  printf("based on GBxCart RW v1.24 by insideGadgets\n");
+  printf("################################\n");
+
+  if (argc < 2) {
+    printf("Usage: verify-cart <ROMFile> [full]\n");
+    read_one_letter();
+    return 1;
+  }
+  uint8_t fullMode = 0;
+  if (argc >= 3 && strncmp(argv[2], "full", 4) == 0) {
+    fullMode = 1;
+  }
+
+  long romLength = 0;
+  uint8_t *romData = map_file(argv[1], &romLength);
+  if (romData == NULL) {
+    printf("\n%s \nFile not found\n", argv[1]);
+    read_one_letter();
+    return 1;
+  }
+
+  read_config();
+
+  // Open COM port
+  if (com_test_port() == 0) {
+    printf("Device not connected and couldn't be auto detected\n");
+    read_one_letter();
+    return 1;
+  }
+  printf("Connected on COM port: %i\n", cport_nr + 1);
+
+  // Get firmware/PCB version and cartridge mode, set the voltage and read the
+  // header in one go
+  struct cart_identity cart;
+  if (cart_identify(&cart, 0) == 0) {
+    printf("Device didn't respond, please re-seat the cartridge and try "
+           "again\n");
+    read_one_letter();
+    return 1;
+  }
+  uint32_t cartLength = cart.romLength;
+
+  printf("\n--- Verify ROM ---\n");
+  uint8_t mismatch = 0;
+  uint32_t compareLength = cartLength;
+  if ((uint32_t)romLength != cartLength) {
+    printf("Size differs: cart %u bytes, file %ld bytes\n",
+           (unsigned int)cartLength, romLength);
+    mismatch = 1;
+    if ((uint32_t)romLength < compareLength) {
+      compareLength = romLength;
+    }
+  }
+  printf("Comparing cart to %s\n", argv[1]);
+  printf("[             25%%             50%%             75%%            "
+         "100%%]\n[");
+
+  reset_retry_stats();
+  uint32_t diffBlocks = compare_rom(romData, compareLength, verify_diff,
+                                    &fullMode);
+  printf("]\n");
+  if (diffBlocks > 0) {
+    mismatch = 1;
+  }
+  if (fullMode == 1) {
+    close_range();
+    if (rangeCount > 0) {
+      printf("%u bytes differ in %u ranges\n", (unsigned int)diffBytes,
+             (unsigned int)rangeCount);
+    }
+  } else if (diffBlocks > 0) {
+    if (cartridgeMode == GB_MODE) {
+      printf("First difference in bank %u at 0x%06X\n", diffBank,
+             (unsigned int)rangeStart);
+    } else {
+      printf("First difference in 4MB bank %u at 0x%06X\n", diffBank,
+             (unsigned int)rangeStart);
+    }
+  }
+  print_retry_stats();
+  unmap_file(romData, romLength);
+
+  if (mismatch == 1) {
+    printf("\nCart does NOT match %s\n", argv[1]);
+    return 1;
+  }
+  printf("\nCart matches %s\n", argv[1]);
+  return 0;
+}